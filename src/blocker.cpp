@@ -1,41 +1,325 @@
 // blocker.cpp
 #include "blocker.h"
+#include "asyncio.h"
+#include "builtinlists.h"
+#include "compiled.h"
+#include "domainset.h"
+#include "executor.h"
+#include "filelock.h"
+#include "importer.h"
+#include "log.h"
+#include "mappedfile.h"
+#include "memtrack.h"
+#include "metrics.h"
+#include "sinkhole.h"
+#include "trace.h"
 #include <fstream>
-#include <iostream>
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <future>
 #include <system_error>
+#ifdef _WIN32
 #include <windows.h>
 #include <aclapi.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
 
-// Debug logging helpers
-void Blocker::debugLog(const std::string& message) const {
-    if (m_debugMode) {
-        std::cout << "[DEBUG] " << message << std::endl;
+namespace {
+    constexpr const char* FILTER_FILENAME = "blocklist.filter";
+
+    // Schedule states are compiled into subdirectories of the compiled
+    // directory, named by category mask
+    constexpr const char* SCHEDULE_DIRNAME = "schedule";
+    constexpr const char* SCHEDULE_LOCK_FILENAME = "schedule.lock";
+
+    // Comment line written just above the start marker
+    constexpr std::string_view MANAGED_HEADER = "# Managed by ChickenJockey\n";
+
+    // Only line inside a sinkhole-mode managed block:
+    // "# sinkhole <n> domain(s) in sinkhole.list sha256 <digest of the list file>"
+    constexpr std::string_view SINKHOLE_LINE = "# sinkhole ";
+    constexpr std::string_view SINKHOLE_DIGEST = " sha256 ";
+
+    // Host names compare case-insensitively and ignore a trailing root dot
+    std::string_view StripRootDot(std::string_view host) {
+        if (!host.empty() && host.back() == '.') host.remove_suffix(1);
+        return host;
+    }
+
+    int CompareHosts(std::string_view a, std::string_view b) {
+        a = StripRootDot(a);
+        b = StripRootDot(b);
+        const size_t n = std::min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            const int ca = std::tolower(static_cast<unsigned char>(a[i]));
+            const int cb = std::tolower(static_cast<unsigned char>(b[i]));
+            if (ca != cb) return ca < cb ? -1 : 1;
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+
+    // The list digest a sinkhole-mode block records, as hex; false for a
+    // block without one (or no managed block at all)
+    bool FindSinkholeDigest(std::string_view hosts, std::string_view& hex) {
+        const size_t start = hosts.find(Blocker::BLOCK_START_MARKER);
+        if (start == std::string_view::npos) return false;
+        const size_t end = hosts.find(Blocker::BLOCK_END_MARKER, start);
+        const std::string_view block = hosts.substr(start, end == std::string_view::npos ? end : end - start);
+        const size_t line = block.find(SINKHOLE_LINE);
+        if (line == std::string_view::npos) return false;
+        std::string_view rest = block.substr(line);
+        rest = rest.substr(0, rest.find_first_of("\r\n"));
+        const size_t digest = rest.find(SINKHOLE_DIGEST);
+        if (digest == std::string_view::npos) return false;
+        hex = rest.substr(digest + SINKHOLE_DIGEST.size());
+        return !hex.empty();
     }
-}
 
-void Blocker::debugLog(const std::wstring& message) const {
-    if (m_debugMode) {
-        std::wcout << L"[DEBUG] " << message << std::endl;
+    // Does the list file hash to the digest its block records?
+    bool SinkholeListMatches(const fs::path& listPath, std::string_view hex) {
+        utils::MappedFile list;
+        crypto::Digest digest{};
+        return list.Open(listPath, utils::MappedFile::Access::Sequential) &&
+               crypto::Sha256(list.View().data(), list.View().size(), digest) && crypto::ToHex(digest) == hex;
     }
+
+    // What the sinkhole serves: `domains` not already covered by an enabled
+    // built-in category, then those categories' entries
+    void CollectSinkholeEntries(const utils::DomainPool& domains, uint32_t builtinMask,
+                                utils::DomainPool& entries) {
+        size_t builtinCount = 0, builtinBytes = 0;
+        for (size_t i = 0; builtinMask && i < BuiltinLists::EntryCount(); ++i) {
+            if (BuiltinLists::EntryCategories(i) & builtinMask) {
+                ++builtinCount;
+                builtinBytes += BuiltinLists::EntryName(i).size();
+            }
+        }
+        entries.Clear();
+        entries.Reserve(domains.size() + builtinCount, domains.ArenaBytes() + builtinBytes);
+        for (std::string_view domain : domains) {
+            if (builtinMask && (BuiltinLists::Lookup(domain) & builtinMask)) continue;
+            entries.Add(domain);
+        }
+        for (size_t i = 0; builtinMask && i < BuiltinLists::EntryCount(); ++i) {
+            if (BuiltinLists::EntryCategories(i) & builtinMask) entries.Add(BuiltinLists::EntryName(i));
+        }
+    }
+
+    // The managed block (header comment through end marker) rendered on the
+    // executor in pieces: the header and start marker, one piece per slice of
+    // domains, the enabled built-ins, then the end marker. Pieces are taken in
+    // order, so the first can be written out while later ones still render.
+    // Pieces allocate through a TrackingResource, so the block's footprint is
+    // known even without the global allocation hooks.
+    class BlockRender {
+    public:
+        static constexpr size_t SLICE_DOMAINS = 32768;
+
+        explicit BlockRender(utils::Executor& executor) : m_executor(executor) {}
+        ~BlockRender() {
+            // Tasks borrow the domains and this object; none may outlive them
+            for (std::future<std::pmr::string>& piece : m_pending) {
+                if (!piece.valid()) continue;
+                try {
+                    m_executor.Await(piece);
+                } catch (const std::exception&) {
+                }
+            }
+        }
+        BlockRender(const BlockRender&) = delete;
+        BlockRender& operator=(const BlockRender&) = delete;
+
+        // "127.0.0.1 <domain>" lines, skipping domains an enabled built-in repeats
+        void StartEntries(const utils::DomainPool& domains, uint32_t builtinMask) {
+            static constexpr std::string_view ENTRY_PREFIX = "127.0.0.1 ";
+            AddFixed(std::string(MANAGED_HEADER) + Blocker::BLOCK_START_MARKER + '\n');
+            for (size_t first = 0; first < domains.size(); first += SLICE_DOMAINS) {
+                const size_t last = std::min(domains.size(), first + SLICE_DOMAINS);
+                Add([this, &domains, builtinMask, first, last] {
+                    size_t bytes = 0;
+                    for (size_t i = first; i < last; ++i) bytes += ENTRY_PREFIX.size() + domains[i].size() + 1;
+                    std::pmr::string text(&m_resource);
+                    text.reserve(bytes);
+                    for (size_t i = first; i < last; ++i) {
+                        const std::string_view domain = domains[i];
+                        if (builtinMask && (BuiltinLists::Lookup(domain) & builtinMask)) continue;
+                        text += ENTRY_PREFIX;
+                        text += domain;
+                        text += '\n';
+                    }
+                    return text;
+                });
+            }
+            if (builtinMask) {
+                Add([this, builtinMask] {
+                    std::pmr::string text(&m_resource);
+                    for (size_t i = 0; i < BuiltinLists::EntryCount(); ++i) {
+                        if (!(BuiltinLists::EntryCategories(i) & builtinMask)) continue;
+                        text += ENTRY_PREFIX;
+                        text += BuiltinLists::EntryName(i);
+                        text += '\n';
+                    }
+                    return text;
+                });
+            }
+            AddFixed(std::string(Blocker::BLOCK_END_MARKER) + '\n');
+        }
+
+        // The block only names the sinkhole list and records its digest. Its
+        // entries are collected into `entries` and, given a `listPath`, saved
+        // there; Failed() reports a list that couldn't be saved once every
+        // piece was taken.
+        void StartSinkhole(const utils::DomainPool& domains, uint32_t builtinMask, utils::DomainPool& entries,
+                           const fs::path* listPath) {
+            AddFixed(std::string(MANAGED_HEADER) + Blocker::BLOCK_START_MARKER + '\n');
+            Add([this, &domains, builtinMask, &entries, listPath] {
+                CollectSinkholeEntries(domains, builtinMask, entries);
+                const std::string list = utils::DnsSinkhole::RenderList(entries);
+                crypto::Digest digest{};
+                if (!crypto::Sha256(list.data(), list.size(), digest) ||
+                    (listPath && !utils::DnsSinkhole::SaveList(*listPath, list))) {
+                    CJ_LOG_ERROR("Blocker", "Failed to write sinkhole list: " << (listPath ? *listPath : fs::path()));
+                    m_failed = true;
+                }
+                std::pmr::string line(SINKHOLE_LINE, &m_resource);
+                line += std::to_string(entries.size());
+                line += " domain(s) in ";
+                line += utils::DnsSinkhole::LIST_FILENAME;
+                line += SINKHOLE_DIGEST;
+                line += crypto::ToHex(digest);
+                line += '\n';
+                return line;
+            });
+            AddFixed(std::string(Blocker::BLOCK_END_MARKER) + '\n');
+        }
+
+        size_t size() const noexcept { return m_pieces.size(); }
+
+        // Waits for piece `i`, helping the executor meanwhile
+        std::string_view Get(size_t i) {
+            if (m_pending[i].valid()) m_pieces[i] = m_executor.Await(m_pending[i]);
+            return m_pieces[i];
+        }
+
+        bool Failed() const noexcept { return m_failed; }
+        MemTrack::Usage GetUsage() const noexcept { return m_resource.Get(); }
+
+        // Takes every piece and appends them to `out`, growing it once
+        void AppendTo(std::string& out) {
+            size_t bytes = 0;
+            for (size_t i = 0; i < size(); ++i) bytes += Get(i).size();
+            out.reserve(out.size() + bytes);
+            for (const std::pmr::string& piece : m_pieces) out += piece;
+        }
+
+        // The whole block as one string, once every piece was taken
+        std::string Join() const {
+            size_t bytes = 0;
+            for (const std::pmr::string& piece : m_pieces) bytes += piece.size();
+            std::string block;
+            block.reserve(bytes);
+            for (const std::pmr::string& piece : m_pieces) block += piece;
+            return block;
+        }
+
+    private:
+        template <typename Function>
+        void Add(Function&& function) {
+            m_pending.push_back(m_executor.Submit(std::forward<Function>(function)));
+            m_pieces.emplace_back(&m_resource);
+        }
+
+        void AddFixed(std::string_view text) {
+            m_pending.emplace_back();
+            m_pieces.emplace_back(text, &m_resource);
+        }
+
+        utils::Executor& m_executor;
+        MemTrack::TrackingResource m_resource;  // Outlives the pieces and the tasks filling them
+        std::vector<std::future<std::pmr::string>> m_pending;
+        std::vector<std::pmr::string> m_pieces;
+        bool m_failed = false;  // Written by the sinkhole task before its piece is ready
+    };
+
+    // A sinkhole list saved beside the live one and renamed over it only once
+    // the block naming its digest was written, so a failed write never leaves
+    // the block in place pointing at a list it doesn't describe. Removed
+    // unless committed; declare it before anything still writing it.
+    class StagedList {
+    public:
+        explicit StagedList(const fs::path& list) : m_list(list), m_staged(fs::path(list) += ".staged") {}
+        ~StagedList() {
+            if (m_committed) return;
+            std::error_code ec;
+            fs::remove(m_staged, ec);
+        }
+        StagedList(const StagedList&) = delete;
+        StagedList& operator=(const StagedList&) = delete;
+
+        const fs::path& GetPath() const noexcept { return m_staged; }
+
+        bool Commit() {
+            std::error_code ec;
+            fs::rename(m_staged, m_list, ec);
+            if (ec) {
+                CJ_LOG_ERROR("Blocker", "Can't replace sinkhole list " << m_list << ": " << ec.message());
+                return false;
+            }
+            m_committed = true;
+            return true;
+        }
+
+    private:
+        const fs::path& m_list;
+        fs::path m_staged;
+        bool m_committed = false;
+    };
 }
 
 // Constructor
 Blocker::Blocker(const fs::path& hostsPath, const fs::path& backupPath, bool debugMode)
-    : m_hostsPath(hostsPath), m_backupPath(backupPath), m_debugMode(debugMode) {
-    debugLog("Blocker constructor called");
-    debugLog(L"Hosts path: " + m_hostsPath.wstring());
-    debugLog(L"Backup path: " + m_backupPath.wstring());
+    : m_hostsPath(hostsPath), m_backupPath(backupPath),
+      m_statePath(backupPath.parent_path() / StateCache::STATE_FILENAME),
+      m_filterPath(backupPath.parent_path() / FILTER_FILENAME),
+      m_sinkholeListPath(backupPath.parent_path() / utils::DnsSinkhole::LIST_FILENAME),
+      m_catalogPath(backupPath.parent_path() / utils::DomainCatalog::FILENAME),
+      m_compiledDir(backupPath.parent_path() / utils::CompiledBlocklist::DIRNAME),
+      m_snapshots(backupPath.parent_path() / utils::SnapshotStore::DIRNAME),
+      m_journal(backupPath.parent_path()) {
+    if (debugMode) setDebugMode(true);
+    CJ_LOG_DEBUG("Blocker", "Blocker constructor called");
+    CJ_LOG_DEBUG("Blocker", "Hosts path: " << m_hostsPath);
+    CJ_LOG_DEBUG("Blocker", "Backup path: " << m_backupPath);
+    CJ_LOG_DEBUG("Blocker", "State path: " << m_statePath);
+    CJ_LOG_DEBUG("Blocker", "Filter path: " << m_filterPath);
+    CJ_LOG_DEBUG("Blocker", "Sinkhole list path: " << m_sinkholeListPath);
+    CJ_LOG_DEBUG("Blocker", "Catalog path: " << m_catalogPath);
+    CJ_LOG_DEBUG("Blocker", "Compiled blocklist: " << m_compiledDir);
+    CJ_LOG_DEBUG("Blocker", "Snapshot store: " << m_snapshots.GetRoot());
+    CJ_LOG_DEBUG("Blocker", "Journal path: " << m_journal.GetPath());
+}
+
+// Debug mode lowers the process-wide log threshold to Debug (never raising
+// a Trace one); turning it off restores whatever level was set before
+void Blocker::setDebugMode(bool debug) {
+    if (debug == m_debugMode) return;
+    m_debugMode = debug;
+    if (debug) {
+        m_savedLogLevel = Logging::GetLevel();
+        if (m_savedLogLevel > Logging::Level::Debug) Logging::SetLevel(Logging::Level::Debug);
+    } else {
+        Logging::SetLevel(m_savedLogLevel);
+    }
 }
 
 // Trim whitespace
 std::string Blocker::trim(const std::string& str) const {
-    debugLog("Trimming string: " + str);
+    CJ_LOG_TRACE("Blocker", "Trimming string: " << str);
     auto start = std::find_if_not(str.begin(), str.end(), [](unsigned char c) {
         return std::isspace(c);
     });
@@ -45,59 +329,96 @@ std::string Blocker::trim(const std::string& str) const {
     return (start < end) ? std::string(start, end) : "";
 }
 
-// Check admin privileges (Windows-specific)
+// Check admin privileges. Elsewhere than Windows: whoever can write the hosts
+// file (root for /etc/hosts, the owner of a scratch copy)
 bool Blocker::checkAdminPrivileges() const {
-    debugLog("Checking admin privileges");
+    CJ_LOG_DEBUG("Blocker", "Checking admin privileges");
+#ifndef _WIN32
+    std::error_code ec;
+    const fs::path target = fs::exists(m_hostsPath, ec) ? m_hostsPath : m_hostsPath.parent_path();
+    const bool writable = geteuid() == 0 || access(target.empty() ? "." : target.c_str(), W_OK) == 0;
+    CJ_LOG_DEBUG("Blocker", (writable ? "Hosts file is writable" : "Hosts file is not writable"));
+    return writable;
+#else
     BOOL isAdmin = FALSE;
     PSID adminGroup = NULL;
     SID_IDENTIFIER_AUTHORITY NtAuthority = SECURITY_NT_AUTHORITY;
 
     if (!AllocateAndInitializeSid(&NtAuthority, 2, SECURITY_BUILTIN_DOMAIN_RID, 
                                  DOMAIN_ALIAS_RID_ADMINS, 0, 0, 0, 0, 0, 0, &adminGroup)) {
-        debugLog("Failed to allocate and initialize SID");
+        CJ_LOG_DEBUG("Blocker", "Failed to allocate and initialize SID");
         return false;
     }
 
     if (!CheckTokenMembership(NULL, adminGroup, &isAdmin)) {
         isAdmin = FALSE;
-        debugLog("Failed to check token membership");
+        CJ_LOG_DEBUG("Blocker", "Failed to check token membership");
     }
 
     FreeSid(adminGroup);
-    debugLog(isAdmin ? "User has admin privileges" : "User does not have admin privileges");
+    CJ_LOG_DEBUG("Blocker", (isAdmin ? "User has admin privileges" : "User does not have admin privileges"));
     return isAdmin == TRUE;
+#endif
 }
 
 // New writing stuff.
 bool Blocker::secureWrite(const fs::path& path, const std::string& content) const {
-    debugLog("Starting secureWrite operation");
+    Trace::Span span("Blocker::secureWrite");
+    span.Arg("bytes", content.size());
+    CJ_LOG_DEBUG("Blocker", "Starting secureWrite operation");
     fs::path tempPath = path;
     tempPath += ".tmp";
-    debugLog(L"Temporary file path: " + tempPath.wstring());
+    CJ_LOG_DEBUG("Blocker", "Temporary file path: " << tempPath);
 
     try {
         {
-            debugLog("Creating temporary file");
-            std::ofstream ofs(tempPath, std::ios::binary);
-            if (!ofs) {
-                debugLog("Failed to open temporary file");
+            Trace::Span writeSpan("secureWrite.tempFile");
+            writeSpan.Arg("bytes", content.size());
+            CJ_LOG_DEBUG("Blocker", "Creating temporary file");
+            utils::IoBatch batch;
+            batch.Write(batch.Create(tempPath), 0, content.data(), content.size());
+            if (!batch.Wait()) {
+                CJ_LOG_DEBUG("Blocker", "Failed to write temporary file: " << batch.GetError());
                 return false;
             }
-            ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-            ofs << content;
-            debugLog("Content written to temporary file");
+            CJ_LOG_DEBUG("Blocker", "Content written to temporary file");
         }
 
+        const bool written = launchWriter(tempPath, path, content.size());
+
+        // Always delete the temp file, regardless of success/failure
+        std::error_code ec;
+        {
+            Trace::Span cleanupSpan("secureWrite.cleanup");
+            fs::remove(tempPath, ec);
+        }
+        if (ec) {
+            CJ_LOG_DEBUG("Blocker", "Failed to remove temporary file: " << ec.message());
+        }
+        return written;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Blocker", "Secure write error: " << e.what());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+}
+
+// Copies `source` over `path` through the elevated hostswriter.exe; elsewhere
+// the file is overwritten in place, like CopyFile, keeping its owner and mode
+bool Blocker::launchWriter(const fs::path& source, const fs::path& path, uint64_t bytes) const {
+    try {
+#ifdef _WIN32
         // Construct path to hostswriter.exe
         wchar_t exePath[MAX_PATH];
         GetModuleFileNameW(NULL, exePath, MAX_PATH);
         std::wstring exeDir = fs::path(exePath).parent_path();
         std::wstring writerPath = exeDir + L"\\hostswriter.exe";
-        debugLog(L"hostswriter.exe path: " + writerPath);
+        CJ_LOG_DEBUG("Blocker", "hostswriter.exe path: " << writerPath);
 
-        // Arguments: "<tempPath>" "<targetPath>"
-        std::wstring args = L"\"" + tempPath.wstring() + L"\" \"" + path.wstring() + L"\"";
-        debugLog(L"Process arguments: " + args);
+        // Arguments: "<sourcePath>" "<targetPath>"
+        std::wstring args = L"\"" + source.wstring() + L"\" \"" + path.wstring() + L"\"";
+        CJ_LOG_DEBUG("Blocker", "Process arguments: " << args);
 
         // Launch elevated process
         SHELLEXECUTEINFOW sei = { sizeof(sei) };
@@ -107,189 +428,1136 @@ bool Blocker::secureWrite(const fs::path& path, const std::string& content) cons
         sei.nShow = SW_HIDE;
         sei.fMask = SEE_MASK_NOCLOSEPROCESS;
         
-        debugLog("Attempting to launch hostswriter.exe with elevation");
-        if (!ShellExecuteExW(&sei) || !sei.hProcess) {
-            debugLog("Failed to launch hostswriter.exe with elevation");
-            std::wcerr << L"[Blocker] Failed to launch hostswriter.exe with elevation.\n";
-            fs::remove(tempPath);
+        CJ_LOG_DEBUG("Blocker", "Attempting to launch hostswriter.exe with elevation");
+        BOOL launched;
+        {
+            Trace::Span launchSpan("secureWrite.launchWriter");
+            launched = ShellExecuteExW(&sei);
+        }
+        if (!launched || !sei.hProcess) {
+            CJ_LOG_ERROR("Blocker", "Failed to launch hostswriter.exe with elevation.");
             return false;
         }
         
-        debugLog("Waiting for hostswriter.exe to complete");
-        WaitForSingleObject(sei.hProcess, INFINITE);
-
+        CJ_LOG_DEBUG("Blocker", "Waiting for hostswriter.exe to complete");
         DWORD exitCode = 1;
-        GetExitCodeProcess(sei.hProcess, &exitCode);
-        CloseHandle(sei.hProcess);
-        debugLog(L"hostswriter.exe exit code: " + std::to_wstring(exitCode));
-
-        // Always delete the temp file, regardless of success/failure
-        std::error_code ec;
-        fs::remove(tempPath, ec);
-        if (ec) {
-            debugLog("Failed to remove temporary file: " + std::string(ec.message()));
+        {
+            Trace::Span waitSpan("secureWrite.waitWriter");
+            WaitForSingleObject(sei.hProcess, INFINITE);
+            GetExitCodeProcess(sei.hProcess, &exitCode);
+            CloseHandle(sei.hProcess);
         }
+        CJ_LOG_DEBUG("Blocker", "hostswriter.exe exit code: " << exitCode);
 
         if (exitCode != 0) {
-            debugLog("hostswriter.exe returned error");
-            std::wcerr << L"[Blocker] hostswriter.exe returned error: " << exitCode << std::endl;
+            CJ_LOG_ERROR("Blocker", "hostswriter.exe returned error: " << exitCode);
+            return false;
+        }
+        CJ_LOG_INFO("Blocker", "hostswriter.exe succeeded.");
+#else
+        std::error_code ec;
+        {
+            Trace::Span copySpan("secureWrite.copy");
+            fs::copy_file(source, path, fs::copy_options::overwrite_existing, ec);
+        }
+        if (ec) {
+            CJ_LOG_ERROR("Blocker", "Failed to copy " << source << " over " << path << ": " << ec.message());
             return false;
         }
+#endif
 
         if (!fs::exists(path)) {
-            debugLog("Hosts file was not created after hostswriter execution");
-            std::wcerr << L"[Blocker] Hosts file was not created after hostswriter execution.\n";
+            CJ_LOG_ERROR("Blocker", "Hosts file was not created after hostswriter execution.");
             return false;
         }
 
-        debugLog("hostswriter.exe succeeded");
-        std::wcout << L"[Blocker] hostswriter.exe succeeded.\n";
+        static Metrics::Counter& writes = Metrics::GetCounter(
+            "cj_hosts_writes_total", "Successful hosts file writes through hostswriter");
+        static Metrics::Counter& writeBytes = Metrics::GetCounter(
+            "cj_hosts_write_bytes_total", "Bytes written to the hosts file through hostswriter");
+        writes.Add();
+        writeBytes.Add(bytes);
         return true;
     } catch (const std::exception& e) {
-        debugLog("Exception in secureWrite: " + std::string(e.what()));
-        std::cerr << "[Blocker] Secure write error: " << e.what() << std::endl;
-        std::error_code ec;
-        fs::remove(tempPath, ec);
+        CJ_LOG_ERROR("Blocker", "Secure write error: " << e.what());
         return false;
     }
 }
 
+// A failed write leaves its transaction open; the next recovery settles it
+bool Blocker::writeHosts(const std::string& content, uint64_t snapshotId, const utils::FileLock* held) {
+    utils::FileLock lock;
+    uint64_t transaction = 0;
+    const bool locked = (held && held->IsHeld()) || m_journal.Lock(lock);
+    const bool journaled = locked && m_journal.Begin(m_hostsPath, content, snapshotId, transaction);
+    if (!journaled) {
+        CJ_LOG_WARN("Blocker", "Hosts update not journaled; an interruption would need a repair");
+    }
+    if (!secureWrite(m_hostsPath, content)) return false;
+    if (journaled && !m_journal.Commit(transaction)) {
+        CJ_LOG_WARN("Blocker", "Failed to record completed hosts update");
+    }
+    return true;
+}
+
+utils::HostsJournal::Outcome Blocker::recoverHostsTransition() {
+    return m_journal.Recover(m_hostsPath, m_snapshots, [this](const std::string& content) {
+        return secureWrite(m_hostsPath, content);
+    });
+}
+
 // Load domains - single combined implementation
 bool Blocker::loadDomains(const std::vector<std::string>& domains) {
-    debugLog("Loading domains from vector");
+    Trace::Span span("Blocker::loadDomains");
+    span.Arg("domains", domains.size());
+    CJ_LOG_DEBUG("Blocker", "Loading domains from vector");
+    if (domains.empty()) {
+        CJ_LOG_ERROR("Blocker", "Domain list is empty.");
+        return false;
+    }
+
+    m_domains = utils::DomainPool::FromStrings(domains);
+    m_compiled.Detach();
+    resetLookup();
+    CJ_LOG_INFO("Blocker", "Loaded " << m_domains.size() << " domain(s).");
+    return true;
+}
+
+bool Blocker::loadDomains(utils::DomainPool&& domains) {
+    Trace::Span span("Blocker::loadDomains");
+    span.Arg("domains", domains.size());
+    CJ_LOG_DEBUG("Blocker", "Loading domains from pool");
+    if (domains.empty()) {
+        CJ_LOG_ERROR("Blocker", "Domain list is empty.");
+        return false;
+    }
+
+    m_domains = std::move(domains);
+    m_compiled.Detach();
+    resetLookup();
+    CJ_LOG_INFO("Blocker", "Loaded " << m_domains.size() << " domain(s).");
+    return true;
+}
+
+// Load domains from a blocklist file in any format the importer understands.
+// Wildcard rules are only kept in sinkhole mode, where they can be enforced.
+bool Blocker::loadDomainsFromFile(const fs::path& filePath) {
+    Trace::Span span("Blocker::loadDomainsFromFile");
+    CJ_LOG_DEBUG("Blocker", "Loading domains from " << filePath);
+
+    utils::ListImporter::Options options;
+    options.wildcards = m_sinkholeMode;
+    utils::ListImporter::Stats stats;
+    utils::ListImporter::Format format = utils::ListImporter::Format::Auto;
+    utils::DomainPool domains;
+    if (!utils::ListImporter::ImportFile(filePath, options, domains, &stats, &format)) {
+        CJ_LOG_ERROR("Blocker", "Failed to import " << filePath);
+        return false;
+    }
+
+    span.Arg("lines", stats.lines).Arg("domains", stats.domains);
+    CJ_LOG_INFO("Blocker", "Imported " << utils::ListImporter::FormatName(format) << " list: "
+                << stats.domains << " domain(s) from " << stats.lines << " line(s), "
+                << stats.skipped << " skipped, " << stats.invalid << " invalid.");
+    return loadDomains(std::move(domains));
+}
+
+// Switching categories is a filter pass over the catalog's mask column; no list is re-read
+bool Blocker::loadDomains(const utils::DomainCatalog& catalog, uint32_t categories) {
+    Trace::Span span("Blocker::loadDomains(catalog)");
+    span.Arg("categories", categories);
+    utils::DomainPool domains;
+    catalog.Select(categories, domains);
+    CJ_LOG_DEBUG("Blocker", "Selected " << domains.size() << " of " << catalog.size()
+                 << " catalog domain(s) for category mask " << categories);
+    return loadDomains(std::move(domains));
+}
+
+// Names resolve to catalog categories first, then to list files
+bool Blocker::loadProfile(std::string_view expression, const utils::DomainCatalog& catalog) {
+    Trace::Span span("Blocker::loadProfile");
+    utils::SetExpression profile;
+    if (!profile.Parse(expression)) return false;
+
+    utils::ListImporter::Options options;
+    options.wildcards = m_sinkholeMode;
+    utils::DomainSet result;
+    const bool evaluated = profile.Evaluate([&](std::string_view name, utils::DomainSet& out) {
+        utils::DomainPool domains;
+        if (const uint32_t mask = catalog.CategoryMask(name)) {
+            catalog.Select(mask, domains);
+        } else if (!utils::ListImporter::ImportFile(fs::u8path(name), options, domains)) {
+            return false;
+        }
+        out = utils::DomainSet::FromPool(domains);
+        return true;
+    }, result);
+    if (!evaluated) {
+        CJ_LOG_ERROR("Blocker", "Profile \"" << expression << "\" failed: " << profile.GetError());
+        return false;
+    }
+
+    utils::DomainPool domains;
+    result.ToPool(domains);
+    span.Arg("domains", domains.size());
+    CJ_LOG_INFO("Blocker", "Profile \"" << expression << "\" selects " << domains.size() << " domain(s).");
+    return loadDomains(std::move(domains));
+}
+
+// Load domains from the managed block already present in the hosts file.
+// Watchdogs start without a GUI-provided list, so this is what lets
+// reapplyBlock() restore the same entries after tampering. A sinkhole-mode
+// block points at the sinkhole list instead, which also switches the mode on.
+bool Blocker::loadManagedDomains() {
+    Trace::Span span("Blocker::loadManagedDomains");
+    if (attachCompiled()) {
+        span.Arg("compiled", 1);
+        return true;
+    }
+    CJ_LOG_DEBUG("Blocker", "Loading domains from managed block");
+    std::ifstream inFile(m_hostsPath);
+    if (!inFile) {
+        CJ_LOG_ERROR("Blocker", "Can't read hosts file.");
+        return false;
+    }
+
+    utils::DomainPool domains;
+    bool insideBlock = false, sinkholeBlock = false;
+    std::string line, listDigest;
+
+    while (std::getline(inFile, line)) {
+        if (line.find(BLOCK_START_MARKER) != std::string::npos) {
+            insideBlock = true;
+            continue;
+        }
+        if (line.find(BLOCK_END_MARKER) != std::string::npos) {
+            break;
+        }
+        if (!insideBlock) continue;
+
+        // "<address> <domain>" with arbitrary blanks; commented entries are skipped
+        const char* blanks = " \t\r";
+        const std::string_view view(line);
+        const size_t addressStart = view.find_first_not_of(blanks);
+        if (addressStart == std::string_view::npos) continue;
+        if (view.substr(addressStart, SINKHOLE_LINE.size()) == SINKHOLE_LINE) {
+            sinkholeBlock = true;
+            const size_t digest = view.find(SINKHOLE_DIGEST, addressStart);
+            if (digest != std::string_view::npos) {
+                listDigest = view.substr(digest + SINKHOLE_DIGEST.size());
+                listDigest.erase(listDigest.find_last_not_of(blanks) + 1);
+            }
+            continue;
+        }
+        if (view[addressStart] == '#') continue;
+        const size_t addressEnd = view.find_first_of(blanks, addressStart);
+        const size_t domainStart = view.find_first_not_of(blanks, addressEnd);
+        if (addressEnd == std::string_view::npos || domainStart == std::string_view::npos) continue;
+        const size_t domainEnd = view.find_first_of(blanks, domainStart);
+        domains.Add(view.substr(domainStart, domainEnd == std::string_view::npos
+                                                 ? std::string_view::npos : domainEnd - domainStart));
+    }
+
+    if (sinkholeBlock) {
+        if (!listDigest.empty() && !SinkholeListMatches(m_sinkholeListPath, listDigest)) {
+            CJ_LOG_ERROR("Blocker", "Sinkhole list doesn't match the managed block: " << m_sinkholeListPath);
+            return false;
+        }
+        if (!utils::DnsSinkhole::LoadList(m_sinkholeListPath, domains)) {
+            CJ_LOG_ERROR("Blocker", "Can't read sinkhole list: " << m_sinkholeListPath);
+            return false;
+        }
+        m_sinkholeMode = true;
+    }
+
     if (domains.empty()) {
-        debugLog("Domain list is empty");
-        std::cerr << "[Error] Domain list is empty." << std::endl;
+        CJ_LOG_DEBUG("Blocker", "No managed domains found");
         return false;
     }
 
-    m_domains = domains;
-    debugLog("Loaded " + std::to_string(m_domains.size()) + " domain(s)");
-    std::cout << "[Info] Loaded " << m_domains.size() << " domain(s).\n";
+    m_domains = std::move(domains);
+    m_compiled.Detach();
+    resetLookup();
+    span.Arg("domains", m_domains.size());
+    CJ_LOG_DEBUG("Blocker", "Recovered " << m_domains.size() << " managed domain(s)");
     return true;
 }
 
+// Under the journal lock, so an apply's list and the block naming its digest
+// are never seen half-written. The list is rebuilt from whatever this process
+// enforces: the loaded domains or the mapped compiled blocklist (the active
+// schedule state's while one is enforced). It only replaces the file when it hashes to the digest
+// the block records; otherwise what we hold isn't what the block names.
+bool Blocker::repairSinkholeList() {
+    Trace::Span span("Blocker::repairSinkholeList");
+    utils::FileLock lock;
+    m_journal.Lock(lock);
+
+    utils::MappedFile hosts;
+    hosts.Open(m_hostsPath, utils::MappedFile::Access::Sequential, utils::MappedFile::BUFFERED);
+    std::string_view recorded;
+    if (!FindSinkholeDigest(hosts.View(), recorded)) {
+        CJ_LOG_DEBUG("Blocker", "Managed block records no sinkhole list digest");
+        return true;
+    }
+    if (SinkholeListMatches(m_sinkholeListPath, recorded)) return true;
+
+    std::string list;
+    try {
+        utils::DomainPool entries;
+        if (!m_domains.empty() || m_builtinMask) {
+            CollectSinkholeEntries(m_domains, m_builtinMask, entries);
+            list = utils::DnsSinkhole::RenderList(entries);
+        } else if (m_compiled.IsAttached()) {
+            m_compiled.ToPool(entries);
+            list = utils::DnsSinkhole::RenderList(entries);
+        } else {
+            CJ_LOG_ERROR("Blocker", "Sinkhole list was edited and no domains are loaded to restore it from");
+            return false;
+        }
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Blocker", "Failed to render sinkhole list: " << e.what());
+        return false;
+    }
+
+    crypto::Digest digest{};
+    if (!crypto::Sha256(list.data(), list.size(), digest) || crypto::ToHex(digest) != recorded) {
+        CJ_LOG_ERROR("Blocker", "Sinkhole list was edited, but the enforced domains don't match the managed block");
+        return false;
+    }
+    if (!utils::DnsSinkhole::SaveList(m_sinkholeListPath, list)) {
+        CJ_LOG_ERROR("Blocker", "Failed to write sinkhole list: " << m_sinkholeListPath);
+        return false;
+    }
+    span.Arg("bytes", list.size());
+    CJ_LOG_WARN("Blocker", "Sinkhole list was edited; restored " << m_sinkholeListPath);
+    return true;
+}
 
-// Backup hosts file
+// Backup hosts file. Versions share unchanged chunks, so this only stores
+// what changed since the previous snapshot.
 bool Blocker::backupHosts() {
+    Trace::Span span("Blocker::backupHosts");
     if (!checkAdminPrivileges()) {
-        std::cerr << "[Error] Admin rights required for backup." << std::endl;
+        CJ_LOG_ERROR("Blocker", "Admin rights required for backup.");
         return false;
     }
 
-    try {
-        fs::create_directories(m_backupPath.parent_path());
-        fs::copy_file(m_hostsPath, m_backupPath, fs::copy_options::overwrite_existing);
-        fs::permissions(m_backupPath,
-            fs::perms::owner_read | fs::perms::owner_write,
-            fs::perm_options::replace);
-        
-        std::cout << "[Info] Backup created: " << m_backupPath << std::endl;
-        return true;
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "[Error] Backup failed: " << e.what() << std::endl;
+    utils::SnapshotStore::Version version;
+    if (!m_snapshots.SaveFile(m_hostsPath, "backup", &version)) {
+        CJ_LOG_ERROR("Blocker", "Backup failed.");
         return false;
     }
+    CJ_LOG_INFO("Blocker", "Backup created: snapshot version " << version.id);
+    return true;
+}
+
+// Put back the hosts file as it was without our block: the newest snapshot
+// that has no managed block, which at worst is the first one ever taken.
+bool Blocker::restoreOriginalHosts() {
+    Trace::Span span("Blocker::restoreOriginalHosts");
+    const std::vector<utils::SnapshotStore::Version> versions = m_snapshots.List();
+    std::string content;
+    for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+        if (!m_snapshots.Load(it->id, content)) continue;  // Damaged; try an older one
+        if (content.find(BLOCK_START_MARKER) != std::string::npos) continue;
+
+        if (!writeHosts(content, 0)) {
+            CJ_LOG_ERROR("Blocker", "Failed to write restored hosts file.");
+            return false;
+        }
+        span.Arg("version", it->id);
+        CJ_LOG_INFO("Blocker", "Hosts file restored from snapshot version " << it->id);
+        return true;
+    }
+    CJ_LOG_WARN("Blocker", "No usable snapshot to restore from.");
+    return false;
 }
 
 // Apply block
 bool Blocker::applyBlock() {
+    Trace::Span span("Blocker::applyBlock");
+    span.Arg("domains", m_domains.size());
+    MemTrack::Scope memory("apply");
+
     if (!checkAdminPrivileges()) {
-        std::cerr << "[Error] Admin rights required to modify hosts file." << std::endl;
+        CJ_LOG_ERROR("Blocker", "Admin rights required to modify hosts file.");
+        return false;
+    }
+
+    if (m_domains.empty() && m_builtinMask == 0) {
+        if (m_compiled.IsAttached()) return applyCompiledBlock();
+        CJ_LOG_ERROR("Blocker", "No domains to block.");
+        return false;
+    }
+
+    // The block renders on the executor while this thread reads, snapshots
+    // and strips the hosts file. Each piece then goes straight into the
+    // journal's staged copy, hashed on the way, and the hosts writer copies
+    // from there; the lookup filter and the compiled blocklist are built while
+    // the writer runs.
+    utils::Executor& executor = utils::Executor::Shared();
+
+    // Held from the read the new content is built around until the commit,
+    // so no other process's transition interleaves with this one. Taken
+    // before the render, which stages the sinkhole list the block names; the
+    // list replaces the live one after the hosts write.
+    utils::FileLock lock;
+    const bool locked = m_journal.Lock(lock);
+
+    StagedList stagedList(m_sinkholeListPath);  // Outlives the render's tasks
+    utils::DomainPool sinkholeEntries;
+    BlockRender render(executor);
+    if (m_sinkholeMode) {
+        render.StartSinkhole(m_domains, m_builtinMask, sinkholeEntries, &stagedList.GetPath());
+    } else {
+        render.StartEntries(m_domains, m_builtinMask);
+    }
+
+    std::string content;
+    uint64_t snapshotId = 0;
+    crypto::Digest oldDigest{};
+    bool hasOld = false;
+    if (!readUnmanagedContent(content, snapshotId, "apply", &oldDigest, &hasOld)) return false;
+
+    uint64_t transaction = 0;
+    fs::path stagingPath;
+    const bool staged = locked && m_journal.Stage(transaction, stagingPath);
+    if (!staged) {
+        stagingPath = m_hostsPath;
+        stagingPath += ".tmp";
+    }
+
+    const size_t blockStart = content.size() + MANAGED_HEADER.size();
+    uint64_t size = 0;
+    crypto::Digest newDigest{}, blockDigest{};
+    bool hashed = false;
+    try {
+        Trace::Span streamSpan("apply.stream");
+        // Each piece is written at its offset as soon as it is ready, while
+        // the next one is hashed; the pieces stay put until Wait()
+        utils::IoBatch writes;
+        const utils::IoBatch::File staging = writes.Create(stagingPath);
+        crypto::Sha256Stream fileHasher, blockHasher;
+        writes.Write(staging, 0, content.data(), content.size());
+        writes.Submit();
+        fileHasher.Update(content.data(), content.size());
+        size = content.size();
+        for (size_t i = 0; i < render.size(); ++i) {
+            const std::string_view piece = render.Get(i);
+            writes.Write(staging, size, piece.data(), piece.size());
+            writes.Submit();
+            fileHasher.Update(piece.data(), piece.size());
+            const size_t skip = i == 0 ? MANAGED_HEADER.size() : 0;
+            blockHasher.Update(piece.data() + skip, piece.size() - skip);
+            size += piece.size();
+        }
+        hashed = fileHasher.Final(newDigest) && blockHasher.Final(blockDigest);
+        if (!writes.Wait()) {
+            CJ_LOG_ERROR("Blocker", "Failed to stage hosts file: " << writes.GetError());
+            hashed = false;
+        }
+        streamSpan.Arg("bytes", size).Arg("pieces", render.size()).Arg("renderPeak", render.GetUsage().peakBytes);
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Blocker", "Failed to stage hosts file: " << e.what());
+    }
+    content = std::string();
+
+    std::error_code ec;
+    if (!hashed || render.Failed()) {
+        fs::remove(stagingPath, ec);
         return false;
     }
 
-    if (m_domains.empty()) {
-        std::cerr << "[Error] No domains to block." << std::endl;
+    const bool journaled = staged && m_journal.BeginStaged(transaction, hasOld ? &oldDigest : nullptr, newDigest,
+                                                           size, snapshotId);
+    if (!journaled) {
+        CJ_LOG_WARN("Blocker", "Hosts update not journaled; an interruption would need a repair");
+    }
+    const fs::path source = journaled ? m_journal.GetStagedPath(transaction) : stagingPath;
+
+    // Repairs rewrite the same domains; only rebuild when they changed. A
+    // generation published for a write that then fails is never attached:
+    // its digest doesn't match the state record.
+    std::future<bool> filterBuilt;
+    if (!m_filterSaved || !fs::exists(m_filterPath)) filterBuilt = executor.Submit([this] { return buildFilter(); });
+    std::future<void> published = executor.Submit([this, &render] { publishCompiled(render.Join()); });
+
+    const bool written = launchWriter(source, m_hostsPath, size);
+    if (filterBuilt.valid() && !executor.Await(filterBuilt)) {
+        CJ_LOG_WARN("Blocker", "Host lookup filter not updated; queries fall back to exact matching");
+    }
+    executor.Await(published);
+    span.Arg("bytes", size);
+
+    // A failed journaled write leaves its transaction open; the next recovery settles it
+    if (!journaled) fs::remove(source, ec);
+    if (!written) {
+        CJ_LOG_ERROR("Blocker", "Failed to update hosts file.");
+        return false;
+    }
+    if (journaled && !m_journal.Commit(transaction)) {
+        CJ_LOG_WARN("Blocker", "Failed to record completed hosts update");
+    }
+    recordAppliedState(size, blockStart, blockDigest);
+    if (m_sinkholeMode && !stagedList.Commit()) return false;
+
+    CJ_LOG_INFO("Blocker", "Hosts file updated successfully.");
+    return true;
+}
+
+// Read the hosts file without our managed block. A hosts file that was
+// deleted or can't be read is rebuilt from the latest snapshot, so a repair
+// still restores the user's own entries around the block. `snapshotId` is the
+// version holding what a write would replace, for rolling back a torn write.
+bool Blocker::readUnmanagedContent(std::string& content, uint64_t& snapshotId, const char* reason,
+                                   crypto::Digest* existingDigest, bool* hasExisting) {
+    std::string existing;
+    bool fromSnapshot = false;
+    snapshotId = 0;
+    if (hasExisting) *hasExisting = false;
+    {
+        Trace::Span readSpan("apply.readHosts");
+        std::ifstream inFile(m_hostsPath);
+        if (inFile) {
+            std::ostringstream raw;
+            raw << inFile.rdbuf();
+            existing = raw.str();
+        } else {
+            utils::SnapshotStore::Version latest;
+            if (!m_snapshots.Latest(latest) || !m_snapshots.Load(latest.id, existing)) {
+                CJ_LOG_ERROR("Blocker", "Can't read hosts file.");
+                return false;
+            }
+            CJ_LOG_WARN("Blocker", "Hosts file unreadable; rebuilding from snapshot version " << latest.id);
+            fromSnapshot = true;
+            snapshotId = latest.id;
+        }
+        readSpan.Arg("bytes", existing.size());
+    }
+
+    // Snapshot what we are about to replace on the executor while the block
+    // is stripped here; unchanged content stores nothing
+    utils::Executor& executor = utils::Executor::Shared();
+    utils::SnapshotStore::Version saved;
+    std::future<bool> backedUp;
+    if (!fromSnapshot) {
+        backedUp = executor.Submit([this, &existing, reason, &saved] {
+            Trace::Span backupSpan("apply.autoBackup");
+            return m_snapshots.Save(existing, reason, &saved);
+        });
+    }
+    struct AwaitBackup {
+        utils::Executor& executor;
+        std::future<bool>& backedUp;
+        ~AwaitBackup() {
+            if (!backedUp.valid()) return;
+            try {
+                executor.Await(backedUp);
+            } catch (const std::exception&) {
+            }
+        }
+    } awaitBackup{ executor, backedUp };
+
+    // Strip the previous managed block
+    content.clear();
+    content.reserve(existing.size());
+    {
+        Trace::Span parseSpan("apply.stripManaged");
+        bool insideBlock = false;
+        size_t pos = 0;
+
+        while (pos < existing.size()) {
+            size_t eol = existing.find('\n', pos);
+            if (eol == std::string::npos) eol = existing.size();
+            const std::string_view line(existing.data() + pos, eol - pos);
+            pos = eol + 1;
+
+            if (line.find(BLOCK_START_MARKER) != std::string_view::npos) {
+                insideBlock = true;
+                continue;
+            }
+            if (line.find(BLOCK_END_MARKER) != std::string_view::npos) {
+                insideBlock = false;
+                continue;
+            }
+            if (!insideBlock) {
+                content.append(line.data(), line.size());
+                content += '\n';
+            }
+        }
+        parseSpan.Arg("bytes", existing.size());
+    }
+
+    if (backedUp.valid()) {
+        if (executor.Await(backedUp)) {
+            snapshotId = saved.id;
+            if (existingDigest) *existingDigest = saved.digest;
+            if (hasExisting) *hasExisting = true;
+        } else {
+            CJ_LOG_WARN("Blocker", "Failed to snapshot hosts file before applying");
+            // Continue anyway — not critical unless factory reset happens
+            if (existingDigest && hasExisting) {
+                *hasExisting = crypto::Sha256(existing.data(), existing.size(), *existingDigest);
+            }
+        }
+    }
+    return true;
+}
+
+// The managed block (header comment through end marker) for `domains` and
+// the enabled built-in categories, as applyBlock() would write it. In
+// sinkhole mode it names the list without saving it.
+bool Blocker::renderManagedBlock(const utils::DomainPool& domains, std::string& block) const {
+    Trace::Span renderSpan("apply.render");
+    utils::DomainPool sinkholeEntries;  // Outlives the render's tasks
+    BlockRender render(utils::Executor::Shared());
+    if (m_sinkholeMode) {
+        render.StartSinkhole(domains, m_builtinMask, sinkholeEntries, nullptr);
+    } else {
+        render.StartEntries(domains, m_builtinMask);
+    }
+    block.clear();
+    render.AppendTo(block);
+    renderSpan.Arg("domains", domains.size()).Arg("bytes", block.size());
+    return !render.Failed();
+}
+
+// Atomic write of a rendered hosts file, then the state record that lets
+// isBlocked() trust it without reading it back
+bool Blocker::writeManagedBlock(const std::string& rendered, size_t blockStart, uint64_t snapshotId,
+                                const utils::FileLock* held) {
+    if (!writeHosts(rendered, snapshotId, held)) {
+        CJ_LOG_ERROR("Blocker", "Failed to update hosts file.");
         return false;
     }
+    recordAppliedState(rendered, blockStart);
+    return true;
+}
 
-    // Automatically create backup if it doesn't exist
+// ----- Scheduling -----
+// Each state gets its domains selected, its block rendered and both compiled
+// into <compiled>/schedule/<categories> now, so a transition at a window
+// boundary is one write of the hosts file's own content and a mapped block.
+// Between transitions neither the domains nor the rendered files stay on the
+// heap; the peer watchdog maps the same files.
+bool Blocker::prepareSchedule(const utils::DomainCatalog& catalog, const std::vector<uint32_t>& states) {
+    Trace::Span span("Blocker::prepareSchedule");
+    span.Arg("states", states.size());
+    clearSchedule();
+    const fs::path scheduleDir = m_compiledDir / SCHEDULE_DIRNAME;
+
+    // Both watchdogs prepare the same states; one publishes at a time
+    utils::FileLock lock;
+    if (!lock.Acquire(m_compiledDir / SCHEDULE_LOCK_FILENAME)) {
+        CJ_LOG_WARN("Blocker", "Can't lock " << scheduleDir << "; compiling the schedule unlocked");
+    }
+    size_t bytes = 0;
     try {
-        if (!fs::exists(m_backupPath)) {
-            fs::create_directories(m_backupPath.parent_path());
-            fs::copy_file(m_hostsPath, m_backupPath, fs::copy_options::overwrite_existing);
-            fs::permissions(m_backupPath,
-                fs::perms::owner_read | fs::perms::owner_write,
-                fs::perm_options::replace);
-            std::cout << "[Info] Auto-backup created: " << m_backupPath << std::endl;
+        m_scheduledStates.reserve(states.size());
+        for (uint32_t categories : states) {
+            utils::DomainPool domains;
+            if (categories) catalog.Select(categories, domains);
+            const fs::path directory = scheduleDir / std::to_string(categories);
+            auto state = std::make_unique<ScheduledState>();
+            state->categories = categories;
+            std::string block;
+            if (!renderManagedBlock(domains, block) ||
+                !publishCompiled(directory, domains, block, m_sinkholeMode, nullptr) ||
+                !state->compiled.Attach(directory)) {
+                CJ_LOG_ERROR("Blocker", "Failed to compile schedule state " << categories << " into " << directory);
+                clearSchedule();
+                return false;
+            }
+            bytes += state->compiled.GetBlock().size();
+            m_scheduledStates.push_back(std::move(state));
         }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "[Warning] Failed to auto-create backup: " << e.what() << std::endl;
-        // Continue anyway — not critical unless factory reset happens
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Blocker", "Failed to compile schedule states: " << e.what());
+        clearSchedule();
+        return false;
     }
 
-    // Read existing content
-    std::ifstream inFile(m_hostsPath);
-    if (!inFile) {
-        std::cerr << "[Error] Can't read hosts file." << std::endl;
+    // States of an earlier schedule; one the peer still maps goes once it lets go
+    std::error_code ec;
+    for (fs::directory_iterator it(scheduleDir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().u8string();
+        const bool prepared = std::any_of(m_scheduledStates.begin(), m_scheduledStates.end(),
+            [&](const std::unique_ptr<ScheduledState>& state) { return std::to_string(state->categories) == name; });
+        std::error_code removeError;
+        if (!prepared) fs::remove_all(it->path(), removeError);
+    }
+    lock.Release();
+
+    if (!readScheduleContent()) {
+        clearSchedule();
         return false;
     }
+    span.Arg("bytes", bytes);
+    CJ_LOG_INFO("Blocker", "Prepared " << m_scheduledStates.size() << " schedule state(s), "
+                << bytes << " block byte(s)");
+    return true;
+}
 
-    std::ostringstream content;
-    bool insideBlock = false;
-    std::string line;
+// Reads the hosts file's own content, which every state is written around.
+// Also the slow path taken when someone else edited the file.
+bool Blocker::readScheduleContent() {
+    Trace::Span span("Blocker::readScheduleContent");
+    std::string content;
+    uint64_t snapshotId = 0;
+    if (!readUnmanagedContent(content, snapshotId, "schedule")) return false;
+    m_scheduledContent = std::move(content);
+    m_scheduledSnapshot = snapshotId;
+    m_scheduledIdentity = {};
+    StateCache::QueryIdentity(m_hostsPath, m_scheduledIdentity);
+    span.Arg("bytes", m_scheduledContent.size());
+    return true;
+}
 
-    while (std::getline(inFile, line)) {
-        if (line.find(BLOCK_START_MARKER) != std::string::npos) {
-            insideBlock = true;
-            continue;
+void Blocker::clearSchedule() {
+    m_scheduledStates.clear();
+    m_scheduledContent = std::string();
+    m_scheduledIdentity = {};
+    m_scheduledSnapshot = 0;
+    m_scheduleActive = false;
+}
+
+// While the hosts file is the one m_scheduledContent was read from (or one we
+// wrote since), the transition is a metadata query and a write. Otherwise it
+// is read once: the peer watchdog may already have written this state, and
+// only edits outside the managed block require reading the content again.
+// Lookups then go to the state's mapping, and the state is republished as
+// the compiled blocklist for processes that attach to that.
+bool Blocker::applyScheduledState(uint32_t categories) {
+    Trace::Span span("Blocker::applyScheduledState");
+    span.Arg("categories", categories);
+    MemTrack::Scope memory("schedule");
+    const ScheduledState* state = nullptr;
+    for (const std::unique_ptr<ScheduledState>& candidate : m_scheduledStates) {
+        if (candidate->categories == categories) state = candidate.get();
+    }
+    if (!state) {
+        CJ_LOG_ERROR("Blocker", "No prepared schedule state for category mask " << categories);
+        return false;
+    }
+    if (!checkAdminPrivileges()) {
+        CJ_LOG_ERROR("Blocker", "Admin rights required to modify hosts file.");
+        return false;
+    }
+
+    bool alreadyWritten = false;
+    StateCache::FileIdentity identity;
+    if (!StateCache::QueryIdentity(m_hostsPath, identity) || identity != m_scheduledIdentity) {
+        // Read, never mapped: the hosts writer rewrites the file in place.
+        // Unreadable compares as empty.
+        utils::MappedFile hosts;
+        hosts.Open(m_hostsPath, utils::MappedFile::Access::Sequential, utils::MappedFile::BUFFERED);
+        const std::string_view current = hosts.View();
+        bool known = false;
+        if (current.substr(0, m_scheduledContent.size()) == m_scheduledContent) {
+            const std::string_view block = current.substr(m_scheduledContent.size());
+            for (const std::unique_ptr<ScheduledState>& candidate : m_scheduledStates) {
+                if (candidate->compiled.GetBlock() != block) continue;
+                known = true;
+                alreadyWritten = candidate->categories == categories;
+                break;
+            }
         }
-        if (line.find(BLOCK_END_MARKER) != std::string::npos) {
-            insideBlock = false;
-            continue;
+        if (!known) {
+            CJ_LOG_INFO("Blocker", "Hosts file changed outside the schedule; reading it again");
+            if (!readScheduleContent()) return false;
         }
-        if (!insideBlock) {
-            content << line << '\n';
+    }
+
+    const std::string_view block = state->compiled.GetBlock();
+    if (alreadyWritten) {
+        CJ_LOG_DEBUG("Blocker", "Hosts file already holds schedule state " << categories);
+    } else {
+        // The list and the block naming its digest change under one lock (see repairSinkholeList)
+        utils::FileLock lock;
+        m_journal.Lock(lock);
+        StagedList stagedList(m_sinkholeListPath);
+        std::string rendered;
+        try {
+            if (state->compiled.IsSinkhole()) {
+                utils::DomainPool entries;
+                state->compiled.ToPool(entries);
+                if (!utils::DnsSinkhole::SaveList(stagedList.GetPath(), entries)) {
+                    CJ_LOG_ERROR("Blocker", "Failed to write sinkhole list: " << stagedList.GetPath());
+                    return false;
+                }
+            }
+            rendered.reserve(m_scheduledContent.size() + block.size());
+            rendered.append(m_scheduledContent).append(block.data(), block.size());
+        } catch (const std::exception& e) {
+            CJ_LOG_ERROR("Blocker", "Failed to assemble schedule state " << categories << ": " << e.what());
+            return false;
         }
+        const size_t blockStart = m_scheduledContent.size() + state->compiled.GetBlockOffset();
+        if (!writeManagedBlock(rendered, blockStart, m_scheduledSnapshot, &lock)) return false;
+        if (state->compiled.IsSinkhole() && !stagedList.Commit()) return false;
+    }
+    StateCache::QueryIdentity(m_hostsPath, m_scheduledIdentity);
+    span.Arg("written", alreadyWritten ? 0 : 1).Arg("bytes", m_scheduledContent.size() + block.size());
+
+    if (!alreadyWritten && !utils::CompiledBlocklist::Republish(m_compiledDir, state->compiled)) {
+        CJ_LOG_WARN("Blocker", "Compiled blocklist not published; watchdogs will parse the hosts file");
+    }
+    // Lookups follow the enforced state; the filter is rebuilt after the write, off the transition
+    if (!m_compiled.Attach(m_compiledDir / SCHEDULE_DIRNAME / std::to_string(categories))) {
+        CJ_LOG_WARN("Blocker", "Can't map schedule state " << categories << "; lookups use the previous list");
+    }
+    m_domains = utils::DomainPool();
+    resetLookup();
+    m_scheduleActive = true;
+    m_scheduledCategories = categories;
+    if (!buildFilter()) {
+        CJ_LOG_WARN("Blocker", "Host lookup filter not updated; queries fall back to exact matching");
+    }
+
+    CJ_LOG_INFO("Blocker", "Schedule state " << categories << " enforced (" << state->compiled.size()
+                << " domain(s))");
+    return true;
+}
+
+// ----- Compiled blocklist -----
+// Publishes what was just written for the watchdogs to map: the domains (with
+// enabled built-ins, as the filter covers them) and the managed block as text,
+// `block` starting at its header comment
+void Blocker::publishCompiled(std::string_view block) const {
+    if (!publishCompiled(m_compiledDir, m_domains, block, m_sinkholeMode, nullptr)) {
+        CJ_LOG_WARN("Blocker", "Compiled blocklist not published; watchdogs will parse the hosts file");
     }
+}
 
-    // Build new content
-    std::ostringstream newContent;
-    newContent << content.str()
-               << "# Managed by ChickenJockey\n"
-               << BLOCK_START_MARKER << '\n';
-    
-    for (const auto& domain : m_domains) {
-        newContent << "127.0.0.1 " << domain << '\n';
+bool Blocker::publishCompiled(const fs::path& directory, const utils::DomainPool& domains, std::string_view block,
+                              bool sinkhole, uint64_t* generation) const {
+    if (m_builtinMask == 0) {
+        return utils::CompiledBlocklist::Publish(directory, domains, block, MANAGED_HEADER.size(), sinkhole,
+                                                 generation);
+    }
+    utils::DomainPool withBuiltins = domains;
+    for (size_t i = 0; i < BuiltinLists::EntryCount(); ++i) {
+        if (BuiltinLists::EntryCategories(i) & m_builtinMask) withBuiltins.Add(BuiltinLists::EntryName(i));
     }
-    
-    newContent << BLOCK_END_MARKER << '\n';
+    return utils::CompiledBlocklist::Publish(directory, withBuiltins, block, MANAGED_HEADER.size(), sinkhole,
+                                             generation);
+}
 
-    // Atomic write
-    if (!secureWrite(m_hostsPath, newContent.str())) {
-        std::cerr << "[Error] Failed to update hosts file." << std::endl;
+// The hosts-file block for the loaded domains (a sinkhole block in sinkhole
+// mode), compiled into `directory` without reading or writing the hosts file
+// (building one ahead of time)
+bool Blocker::compileBlock(const fs::path& directory, uint64_t* generation) const {
+    Trace::Span span("Blocker::compileBlock");
+    span.Arg("domains", m_domains.size());
+    MemTrack::Scope memory("compile");
+    if (m_domains.empty() && m_builtinMask == 0) {
+        CJ_LOG_ERROR("Blocker", "No domains to compile.");
         return false;
     }
+    // In sinkhole mode the block names the list by digest; the list itself is
+    // saved by whoever applies the generation
+    std::string block;
+    if (!renderManagedBlock(m_domains, block) ||
+        !publishCompiled(directory, m_domains, block, m_sinkholeMode, generation)) {
+        CJ_LOG_ERROR("Blocker", "Failed to compile blocklist into " << directory);
+        return false;
+    }
+    return true;
+}
+
+// Maps the published blocklist when it is the block the hosts file holds (the
+// state record's digest is the block's), and drops the private domain list,
+// so a watchdog's own memory no longer grows with the list
+bool Blocker::attachCompiled() {
+    Trace::Span span("Blocker::attachCompiled");
+    if (!m_compiled.Attach(m_compiledDir) || !isBlocked()) return false;
 
-    std::cout << "[Info] Hosts file updated successfully.\n";
+    StateCache::HostsState state;
+    if (!StateCache::Load(m_statePath, state) || !state.hasDigest ||
+        state.blockDigest != m_compiled.GetBlockDigest()) {
+        CJ_LOG_DEBUG("Blocker", "Compiled generation " << m_compiled.GetGeneration()
+                     << " doesn't match the managed block");
+        m_compiled.Detach();
+        return false;
+    }
+
+    m_domains = utils::DomainPool();
+    m_sinkholeMode = m_compiled.IsSinkhole();
+    resetLookup();
+    span.Arg("generation", m_compiled.GetGeneration()).Arg("domains", m_compiled.size());
+    CJ_LOG_DEBUG("Blocker", "Attached compiled generation " << m_compiled.GetGeneration() << " ("
+                 << m_compiled.size() << " domain(s))");
     return true;
 }
 
+// Repair from the mapping: the user's content plus the published block text,
+// with nothing rendered. A newer generation, if one was published, wins.
+bool Blocker::applyCompiledBlock() {
+    Trace::Span span("Blocker::applyCompiledBlock");
+    m_compiled.Attach(m_compiledDir);
+    if (!m_compiled.IsAttached()) return false;
+    m_sinkholeMode = m_compiled.IsSinkhole();
+
+    std::string rendered;
+    uint64_t snapshotId = 0;
+    if (!readUnmanagedContent(rendered, snapshotId, "apply")) return false;
+    const std::string_view block = m_compiled.GetBlock();
+    rendered.append(block.data(), block.size());
+    const size_t blockStart = rendered.size() - block.size() + m_compiled.GetBlockOffset();
+    span.Arg("generation", m_compiled.GetGeneration()).Arg("bytes", rendered.size());
+
+    if (!writeManagedBlock(rendered, blockStart, snapshotId)) return false;
+    CJ_LOG_INFO("Blocker", "Hosts file restored from compiled generation " << m_compiled.GetGeneration());
+    return true;
+}
 
-// Check block status
+// Check block status. While the hosts file's identity (file ID, size, mtime)
+// matches the persisted state record, the answer costs one metadata query;
+// otherwise the file is rescanned and the record refreshed.
 bool Blocker::isBlocked() {
-    std::ifstream inFile(m_hostsPath);
-    if (!inFile) return false;
+    Trace::Span span("Blocker::isBlocked");
+    StateCache::FileIdentity identity;
+    if (!StateCache::QueryIdentity(m_hostsPath, identity)) return false;
 
-    bool foundStart = false, foundEnd = false;
-    std::string line;
+    StateCache::HostsState state;
+    if (StateCache::Load(m_statePath, state) && state.identity == identity) {
+        CJ_LOG_DEBUG("Blocker", "State cache hit");
+        span.Arg("cacheHit", 1);
+        return state.blocked;
+    }
 
-    while (std::getline(inFile, line)) {
-        if (line.find(BLOCK_START_MARKER) != std::string::npos) foundStart = true;
-        if (line.find(BLOCK_END_MARKER) != std::string::npos) foundEnd = true;
-        if (foundStart && foundEnd) break;
+    CJ_LOG_DEBUG("Blocker", "State cache miss - scanning hosts file");
+    span.Arg("cacheHit", 0);
+    if (!scanHostsFile(state)) return false;
+
+    state.identity = identity;
+    StateCache::Save(m_statePath, state);
+    return state.blocked;
+}
+
+// isBlocked() without trusting the state cache: the block is always read back
+// and hashed, and the refreshed record then serves later isBlocked() calls
+bool Blocker::verifyBlock() {
+    Trace::Span span("Blocker::verifyBlock");
+    StateCache::FileIdentity identity;
+    if (!StateCache::QueryIdentity(m_hostsPath, identity)) return false;
+
+    StateCache::HostsState state;
+    StateCache::Load(m_statePath, state);  // Keeps the digest we expect, if there is one
+    if (!scanHostsFile(state)) return false;
+
+    state.identity = identity;
+    StateCache::Save(m_statePath, state);
+    return state.blocked;
+}
+
+// Locate the managed block and compare its digest with the one we last wrote.
+// With no recorded digest (state predates the cache) the block found is trusted.
+bool Blocker::scanHostsFile(StateCache::HostsState& state) const {
+    Trace::Span span("Blocker::scanHostsFile");
+    try {
+        // Read into one buffer (never mapped: the hosts writer rewrites the
+        // file in place); lines are found in it and the block hashed in one pass
+        utils::MappedFile hosts;
+        if (!hosts.Open(m_hostsPath, utils::MappedFile::Access::Sequential, utils::MappedFile::BUFFERED)) return false;
+        const std::string_view text = hosts.View();
+
+        bool foundStart = false, foundEnd = false;
+        uint64_t offset = 0;
+        while (offset < text.size()) {
+            const uint64_t lineStart = offset;
+            size_t lineEnd = text.find('\n', lineStart);
+            if (lineEnd == std::string_view::npos) lineEnd = text.size();
+            const std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+            offset = lineEnd + 1;
+
+            if (!foundStart) {
+                if (line.find(BLOCK_START_MARKER) == std::string_view::npos) continue;
+                foundStart = true;
+                state.blockStart = lineStart;
+            }
+
+            if (line.find(BLOCK_END_MARKER) != std::string_view::npos) {
+                foundEnd = true;
+                state.blockEnd = offset;
+                break;
+            }
+        }
+        span.Arg("bytes", offset);
+
+        state.blocked = false;
+        if (foundStart && foundEnd) {
+            // A final line without a newline is hashed as if it had one
+            crypto::Sha256Stream hasher;
+            const size_t hashedEnd = static_cast<size_t>(std::min<uint64_t>(state.blockEnd, text.size()));
+            hasher.Update(text.data() + state.blockStart, hashedEnd - static_cast<size_t>(state.blockStart));
+            if (hashedEnd < state.blockEnd) hasher.Update("\n", 1);
+            crypto::Digest digest{};
+            if (!hasher.Final(digest)) return false;
+            if (!state.hasDigest) {
+                state.blockDigest = digest;
+                state.hasDigest = true;
+            }
+            state.blocked = digest == state.blockDigest;
+            if (!state.blocked) {
+                CJ_LOG_DEBUG("Blocker", "Managed block digest mismatch");
+            }
+        }
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Blocker", "Hosts scan failed: " << e.what());
+        return false;
+    }
+}
+
+// Persist the state of a hosts file we just wrote, so the next status check
+// doesn't need to read it back
+void Blocker::recordAppliedState(const std::string& content, size_t blockStart) const {
+    crypto::Digest blockDigest{};
+    if (!crypto::Sha256(content.data() + blockStart, content.size() - blockStart, blockDigest)) {
+        std::error_code ec;
+        fs::remove(m_statePath, ec);
+        return;
+    }
+    recordAppliedState(content.size(), blockStart, blockDigest);
+}
+
+// `blockDigest` covers the start marker through the end of the file
+void Blocker::recordAppliedState(uint64_t size, size_t blockStart, const crypto::Digest& blockDigest) const {
+    StateCache::HostsState state;
+    std::error_code ec;
+
+    // A size mismatch means someone raced us; let the next check rescan
+    if (!StateCache::QueryIdentity(m_hostsPath, state.identity) || state.identity.size != size) {
+        fs::remove(m_statePath, ec);
+        return;
     }
 
-    return foundStart && foundEnd;
+    state.blocked = true;
+    state.hasDigest = true;
+    state.blockDigest = blockDigest;
+    state.blockStart = blockStart;
+    state.blockEnd = size;
+    StateCache::Save(m_statePath, state);
 }
 
 // Reapply block
 bool Blocker::reapplyBlock() {
+    MemTrack::Scope memory("repair");
     if (!isBlocked()) {
-        std::cout << "[Warning] Block compromised - reapplying.\n";
+        CJ_LOG_WARN("Blocker", "Block compromised - reapplying.");
+        // A scheduled state may have no domains; restore it around the edited file
+        if (m_scheduleActive) return readScheduleContent() && applyScheduledState(m_scheduledCategories);
         return applyBlock();
     }
-    std::cout << "[Info] Block integrity verified.\n";
+    CJ_LOG_INFO("Blocker", "Block integrity verified.");
+    return true;
+}
+
+// Host lookup. The filter is built from the loaded domains, or mapped from the
+// file written at the last apply when this Blocker has none (e.g. a helper
+// process that only answers queries). Exact confirmation needs the real list,
+// so it is recovered from the hosts file on the first filter hit.
+bool Blocker::isHostBlocked(std::string_view host) {
+    if (m_builtinMask && (BuiltinLists::Lookup(host) & m_builtinMask)) {
+        return true;
+    }
+
+    if (!m_filter.IsLoaded()) {
+        const bool ready = m_domains.empty() && m_builtinMask == 0 ? m_filter.Map(m_filterPath) : populateFilter();
+        if (!ready) {
+            CJ_LOG_DEBUG("Blocker", "No host lookup filter; using exact matching only");
+        }
+    }
+
+    if (m_filter.IsLoaded() && !m_filter.MayContain(host)) {
+        return false;
+    }
+
+    if (m_domains.empty() && !m_compiled.IsAttached()) {
+        if (!loadManagedDomains()) return false;
+        m_filter.Map(m_filterPath);  // Loading the list dropped the mapping; keep using the file
+    }
+    if (m_domains.empty()) return m_compiled.Contains(host);
+    if (m_sortedDomains.empty()) {
+        Trace::Span span("Blocker::sortDomains");
+        span.Arg("domains", m_domains.size());
+        m_sortedDomains.assign(m_domains.begin(), m_domains.end());
+        std::sort(m_sortedDomains.begin(), m_sortedDomains.end(),
+                  [](std::string_view a, std::string_view b) { return CompareHosts(a, b) < 0; });
+    }
+
+    auto it = std::lower_bound(m_sortedDomains.begin(), m_sortedDomains.end(), host,
+                               [](std::string_view a, std::string_view b) { return CompareHosts(a, b) < 0; });
+    return it != m_sortedDomains.end() && CompareHosts(*it, host) == 0;
+}
+
+bool Blocker::buildFilter() {
+    Trace::Span span("Blocker::buildFilter");
+    if (!populateFilter()) {
+        CJ_LOG_ERROR("Blocker", "Failed to build host lookup filter.");
+        return false;
+    }
+    if (!m_filter.Save(m_filterPath)) {
+        CJ_LOG_ERROR("Blocker", "Failed to save host lookup filter: " << m_filterPath);
+        return false;
+    }
+    m_filterSaved = true;
+    CJ_LOG_DEBUG("Blocker", "Host lookup filter saved (" << m_filter.SizeBytes() << " bytes for "
+                 << m_filter.EntryCount() << " domain(s))");
     return true;
-}
\ No newline at end of file
+}
+
+// The filter covers everything the managed block will contain, so a process
+// that only maps the file still sees enabled built-in categories. Without
+// loaded domains it is built from the mapped blocklist (a schedule state).
+bool Blocker::populateFilter() {
+    std::vector<uint64_t> keys;
+    try {
+        if (m_domains.empty() && m_compiled.IsAttached()) {
+            keys.reserve(m_compiled.size());
+            for (size_t i = 0; i < m_compiled.size(); ++i) keys.push_back(utils::FuseFilter::DomainKey(m_compiled[i]));
+        } else {
+            keys.reserve(m_domains.size());
+            for (std::string_view domain : m_domains) keys.push_back(utils::FuseFilter::DomainKey(domain));
+        }
+        for (size_t i = 0; m_builtinMask && i < BuiltinLists::EntryCount(); ++i) {
+            if (BuiltinLists::EntryCategories(i) & m_builtinMask) {
+                keys.push_back(utils::FuseFilter::DomainKey(BuiltinLists::EntryName(i)));
+            }
+        }
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Blocker", "Failed to collect filter keys: " << e.what());
+        return false;
+    }
+    return m_filter.BuildFromKeys(std::move(keys));
+}
+
+bool Blocker::enableBuiltinCategory(std::string_view name) {
+    const uint32_t mask = BuiltinLists::CategoryMask(name);
+    if (mask == 0) {
+        CJ_LOG_ERROR("Blocker", "Unknown built-in category: " << name);
+        return false;
+    }
+    if (!(m_builtinMask & mask)) {
+        m_builtinMask |= mask;
+        resetLookup();
+    }
+    CJ_LOG_INFO("Blocker", "Enabled built-in category " << name);
+    return true;
+}
+
+void Blocker::clearBuiltinCategories() {
+    if (m_builtinMask) {
+        m_builtinMask = 0;
+        resetLookup();
+    }
+}
+
+// Domains changed: the filter and the sorted index describe the old list
+void Blocker::resetLookup() {
+    m_filter.Reset();
+    m_filterSaved = false;
+    m_sortedDomains.clear();
+}
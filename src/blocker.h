@@ -2,9 +2,20 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "catalog.h"
+#include "compiled.h"
+#include "domainpool.h"
+#include "fusefilter.h"
+#include "journal.h"
+#include "log.h"
+#include "snapshot.h"
+#include "statecache.h"
+
 namespace fs = std::filesystem;
 
 class Blocker {
@@ -14,29 +25,130 @@ public:
             bool debugMode = false);
     
     bool loadDomains(const std::vector<std::string>& domains);
+    bool loadDomains(utils::DomainPool&& domains);  // Takes ownership, no per-domain copies
     bool loadDomainsFromFile(const fs::path& filePath);
-    bool backupHosts();
+    bool loadDomains(const utils::DomainCatalog& catalog, uint32_t categories);  // Rows in any of `categories`
+    // Set expression over catalog categories and list files, e.g.
+    // (ads | "C:\lists\corp.txt") - "C:\lists\allow.txt" (see SetExpression)
+    bool loadProfile(std::string_view expression, const utils::DomainCatalog& catalog);
+    bool loadManagedDomains();  // Recover the domain list from the managed block in the hosts file
+    // Map the compiled blocklist the last apply published instead of holding a
+    // private copy; fails unless it matches the managed block (see CompiledBlocklist)
+    bool attachCompiled();
+    bool backupHosts();  // Store the current hosts file as a new snapshot version
+    bool restoreOriginalHosts();  // Newest snapshot without a managed block (factory reset)
+    // Rolls an interrupted hosts update forward or back (see HostsJournal)
+    utils::HostsJournal::Outcome recoverHostsTransition();
     bool applyBlock();
     bool isBlocked();
+    bool verifyBlock();  // isBlocked() that always reads the block back
     bool reapplyBlock();
+
+    // ----- Scheduling -----
+    // Compiles each state (a catalog category mask, 0 for nothing blocked) up
+    // front into a compiled blocklist of its own, mapped rather than held;
+    // applyScheduledState() then writes the hosts file's own content and the
+    // state's block, and repairs restore the active state instead of the
+    // loaded domains.
+    bool prepareSchedule(const utils::DomainCatalog& catalog, const std::vector<uint32_t>& states);
+    bool applyScheduledState(uint32_t categories);
+    void clearSchedule();
+    bool hasSchedule() const { return !m_scheduledStates.empty(); }
+
     bool checkAdminPrivileges() const;  // Moved to public
+
+    // Is `host` one of the blocked domains? Misses are answered by the
+    // approximate filter alone; only filter hits are confirmed exactly.
+    bool isHostBlocked(std::string_view host);
+    bool buildFilter();  // Rebuild from the loaded domains and persist beside the backup
+    // Publish a compiled blocklist for the loaded domains without touching the hosts file
+    bool compileBlock(const fs::path& directory, uint64_t* generation = nullptr) const;
+
+    // Built-in categories (compiled in via CJ_BUILTIN_LISTS) rendered after the loaded domains
+    bool enableBuiltinCategory(std::string_view name);
+    void clearBuiltinCategories();
+    uint32_t getBuiltinCategories() const { return m_builtinMask; }
     bool secureWrite(const fs::path& path, const std::string& content) const;  // Moved to public
 
+    // Sinkhole mode: the domains are written to a list served by the watchdogs'
+    // loopback DNS sinkhole, and the managed block only names that list.
+    // Entries may be wildcards ("*.example.com").
+    void setSinkholeMode(bool enabled) { m_sinkholeMode = enabled; }
+    bool isSinkholeMode() const { return m_sinkholeMode; }
+    // The block records the list's digest. A list that no longer matches it
+    // is rewritten from the enforced domains; false when it can't be.
+    bool repairSinkholeList();
+
     // Getters
     const fs::path& getHostsPath() const { return m_hostsPath; }
     const fs::path& getBackupPath() const { return m_backupPath; }
-    void setDebugMode(bool debug) { m_debugMode = debug; }
+    const fs::path& getFilterPath() const { return m_filterPath; }
+    const fs::path& getSinkholeListPath() const { return m_sinkholeListPath; }
+    const fs::path& getCatalogPath() const { return m_catalogPath; }
+    const fs::path& getCompiledDir() const { return m_compiledDir; }
+    utils::SnapshotStore& getSnapshots() { return m_snapshots; }
+    const utils::DomainPool& getDomains() const { return m_domains; }
+    const utils::CompiledBlocklist& getCompiled() const { return m_compiled; }
+    void setDebugMode(bool debug);  // Off restores the log level from before it was turned on
 
-private:
     static constexpr const char* BLOCK_START_MARKER = "### ChickenJockey Block Start ###";
     static constexpr const char* BLOCK_END_MARKER = "### ChickenJockey Block End ###";
 
-    std::vector<std::string> m_domains;
+private:
+    // Mapped from <compiled>/schedule/<categories>: the state's domains (with
+    // enabled built-ins) and its managed block. Never moved once attached.
+    struct ScheduledState {
+        uint32_t categories = 0;
+        utils::CompiledBlocklist compiled;
+    };
+
+    utils::DomainPool m_domains;
     fs::path m_hostsPath;
     fs::path m_backupPath;
-    bool m_debugMode;
+    fs::path m_statePath;
+    fs::path m_filterPath;
+    fs::path m_sinkholeListPath;
+    fs::path m_catalogPath;
+    fs::path m_compiledDir;
+    utils::SnapshotStore m_snapshots;
+    utils::HostsJournal m_journal;
+    utils::FuseFilter m_filter;
+    utils::CompiledBlocklist m_compiled;  // Shared, read-only domains when m_domains is empty
+    bool m_filterSaved = false;  // m_filter matches m_domains and is on disk
+    uint32_t m_builtinMask = 0;   // BuiltinLists category bits
+    bool m_debugMode = false;
+    Logging::Level m_savedLogLevel = Logging::Level::Info;  // Restored when debug mode is turned off
+    bool m_sinkholeMode = false;
+    std::vector<std::string_view> m_sortedDomains;  // Views into m_domains, built on first filter hit
+    std::vector<std::unique_ptr<ScheduledState>> m_scheduledStates;
+    std::string m_scheduledContent;  // Hosts file minus the managed block; every state is written around it
+    StateCache::FileIdentity m_scheduledIdentity;  // Hosts file m_scheduledContent was read from, or our last write
+    uint64_t m_scheduledSnapshot = 0;
+    uint32_t m_scheduledCategories = 0;
+    bool m_scheduleActive = false;
+
+    // Has the elevated hostswriter.exe copy `source` over `path`
+    bool launchWriter(const fs::path& source, const fs::path& path, uint64_t bytes) const;
+    // secureWrite() bracketed by journal records; `snapshotId` holds the content being replaced
+    // (taking the journal lock unless the caller passes it `held`)
+    bool writeHosts(const std::string& content, uint64_t snapshotId, const utils::FileLock* held = nullptr);
+    // Hosts file minus the managed block; the original is snapshotted with `reason`
+    // and, if asked, hashed into `existingDigest` (`hasExisting` false when it was rebuilt from a snapshot)
+    bool readUnmanagedContent(std::string& content, uint64_t& snapshotId, const char* reason,
+                              crypto::Digest* existingDigest = nullptr, bool* hasExisting = nullptr);
+    bool renderManagedBlock(const utils::DomainPool& domains, std::string& block) const;
+    bool writeManagedBlock(const std::string& rendered, size_t blockStart, uint64_t snapshotId,
+                           const utils::FileLock* held = nullptr);
+    bool readScheduleContent();
+    void publishCompiled(std::string_view block) const;
+    bool publishCompiled(const fs::path& directory, const utils::DomainPool& domains, std::string_view block,
+                         bool sinkhole, uint64_t* generation) const;
+    bool applyCompiledBlock();
+    bool scanHostsFile(StateCache::HostsState& state) const;
+    void recordAppliedState(const std::string& content, size_t blockStart) const;
+    void recordAppliedState(uint64_t size, size_t blockStart, const crypto::Digest& blockDigest) const;
+    void resetLookup();
+    bool populateFilter();
 
-    void debugLog(const std::string& message) const;
-    void debugLog(const std::wstring& message) const;
     std::string trim(const std::string& str) const;
 };
\ No newline at end of file
@@ -0,0 +1,756 @@
+// cli.cpp
+#include "cli.h"
+#include "blocker.h"
+#include "catalog.h"
+#include "compiled.h"
+#include "dnsbench.h"
+#include "filelock.h"
+#include "importer.h"
+#include "log.h"
+#include "memtrack.h"
+#include "selftest.h"
+#include "tamper.h"
+#include "textbench.h"
+#include "trace.h"
+#include "transcode.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    // ----- Exit Codes -----
+    constexpr int EXIT_OK = 0;
+    constexpr int EXIT_USAGE = 1;
+    constexpr int EXIT_FAILED = 2;
+    constexpr int EXIT_NOT_BLOCKED = 3;  // verify: block missing or edited
+    constexpr int EXIT_OVER_BUDGET = 4;  // An operation peaked over its --memory-budget
+
+#ifdef _WIN32
+    constexpr const char* DEFAULT_HOSTS = R"(C:\Windows\System32\drivers\etc\hosts)";
+    constexpr const char* DEFAULT_DATA_DIR = R"(C:\ProgramData\ChickenJockey)";
+#else
+    constexpr const char* DEFAULT_HOSTS = "/etc/hosts";
+    constexpr const char* DEFAULT_DATA_DIR = "/var/lib/chickenjockey";
+#endif
+    constexpr const char* BACKUP_FILENAME = "hosts_backup.txt";
+    constexpr const char* CATALOG_LOCK_FILENAME = "catalog.lock";
+    constexpr const char* STDIN_NAME = "-";
+    constexpr uint64_t TRANSCODE_BENCH_MIB = 256;
+    constexpr uint64_t IDNA_BENCH_MIB = 32;
+    constexpr size_t TRANSCODE_CHECK_ROUNDS = 20000;
+
+    constexpr const char* COMMANDS[] = { "apply", "verify", "status", "compile", "catalog", "bench", "selftest" };
+
+    struct Options {
+        std::string command;
+        std::vector<std::string> operands;
+        fs::path hostsPath = fs::u8path(DEFAULT_HOSTS);
+        fs::path dataDir = fs::u8path(DEFAULT_DATA_DIR);
+        fs::path tracePath;
+        std::string profile;   // Set expression that replaces the list operand
+        utils::ListImporter::Format format = utils::ListImporter::Format::Auto;
+        bool sinkhole = false;
+        bool verbose = false;
+    };
+
+    void ShowUsage(const std::string& program) {
+        std::cerr << "Usage: " << program << " [options] <command> [operands]\n"
+                  << "Commands:\n"
+                  << "  apply <list|->           Import a blocklist (any supported format, gzip/zstd, '-' for\n"
+                  << "                           stdin) and apply it to the hosts file\n"
+                  << "  apply --profile <expr>   Apply a set expression over catalog categories and list\n"
+                  << "                           files instead, e.g. \"(ads | social) - allow.txt\"\n"
+                  << "  verify                   Read the managed block back and check its digest\n"
+                  << "                           (exit 3 if it is missing or was edited)\n"
+                  << "  status                   Report the block state from the state cache\n"
+                  << "  compile <list|-> [dir]   Import a blocklist and publish a compiled generation to dir\n"
+                  << "                           (default <data>/compiled) without touching the hosts file;\n"
+                  << "                           with --profile, [dir] is the only operand\n"
+                  << "  catalog add <category> <list|->\n"
+                  << "                           Import a blocklist as a category of <data>/catalog.bin,\n"
+                  << "                           replacing what the category held; schedule.txt names these\n"
+                  << "  catalog list             Report the catalog's categories and their sizes\n"
+                  << "  bench transcode [MiB]    Cross-check the transcoding kernels of every ISA, then time\n"
+                  << "                           each on a generated CRLF hosts list (default 256 MiB)\n"
+                  << "  bench idna [MiB]         Cross-check built-in IDN mapping against ICU/IdnToAscii over\n"
+                  << "                           the BMP, then time imports with 0-10% IDN names (default 32)\n"
+                  << "  bench dns [key=value...] Drive the DNS sinkhole on loopback against a stand-in upstream\n"
+                  << "                           (queries, domains, clients, window, blocked, tcp, timeout)\n"
+                  << "  bench tamper [key=value...]\n"
+                  << "                           Tamper with a temp hosts file while the watchdog's guard\n"
+                  << "                           repairs it (rounds, domains, poll, gap, timeout, probe, mix, csv)\n"
+                  << "  selftest                 Check import, catalog masks, profiles, apply, journal\n"
+                  << "                           recovery, compiled generations, the sinkhole and the\n"
+                  << "                           watchdog's guard on files in a temp directory\n"
+                  << "Options:\n"
+                  << "  --hosts <path>           Hosts file (default " << DEFAULT_HOSTS << ")\n"
+                  << "  --data <dir>             Snapshots, journal and state (default " << DEFAULT_DATA_DIR << ")\n"
+                  << "  --format <name>          List format: hosts, plain, adblock, dnsmasq, unbound, rpz\n"
+                  << "  --sinkhole               Enforce through the DNS sinkhole list (keeps wildcards)\n"
+                  << "  --trace <file>           Write Chrome trace-event JSON for this run\n"
+                  << "  --memory-budget <operation>=<MiB>\n"
+                  << "                           Peak memory allowed for import, apply or compile; going\n"
+                  << "                           over fails the command (exit 4)\n"
+                  << "  --verbose                Debug logging on stderr\n"
+                  << "Output is one JSON object on stdout.\n";
+    }
+
+    bool ParseFormat(std::string_view name, utils::ListImporter::Format& format) {
+        using Format = utils::ListImporter::Format;
+        for (Format candidate : { Format::Auto, Format::Hosts, Format::Plain, Format::Adblock, Format::Dnsmasq,
+                                  Format::Unbound, Format::Rpz }) {
+            if (name == utils::ListImporter::FormatName(candidate)) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ParseOptions(const std::vector<std::string>& args, Options& options) {
+        for (size_t i = 0; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            const bool hasValue = i + 1 < args.size();
+            if (arg == "--hosts" && hasValue) options.hostsPath = fs::u8path(args[++i]);
+            else if (arg == "--data" && hasValue) options.dataDir = fs::u8path(args[++i]);
+            else if (arg == "--trace" && hasValue) options.tracePath = fs::u8path(args[++i]);
+            else if (arg == "--format" && hasValue) {
+                if (!ParseFormat(args[++i], options.format)) return false;
+            }
+            else if (arg == "--profile" && hasValue) options.profile = args[++i];
+            else if (arg == "--memory-budget" && hasValue) {
+                if (!MemTrack::ParseBudget(args[++i])) return false;
+            }
+            else if (arg == "--sinkhole") options.sinkhole = true;
+            else if (arg == "--verbose") options.verbose = true;
+            else if (arg.size() > 1 && arg[0] == '-' && arg[1] == '-') return false;
+            else if (options.command.empty()) options.command = arg;
+            else options.operands.push_back(arg);
+        }
+        return IsCliCommand(options.command);
+    }
+
+    // ----- JSON Output -----
+    // Flat objects, nested by passing a finished object or array as raw JSON
+    class JsonObject {
+    public:
+        JsonObject& String(const char* key, std::string_view value) {
+            Key(key);
+            m_body += '"';
+            for (char c : value) {
+                const unsigned char u = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\') {
+                    m_body += '\\';
+                    m_body += c;
+                } else if (u < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", u);
+                    m_body += escaped;
+                } else {
+                    m_body += c;
+                }
+            }
+            m_body += '"';
+            return *this;
+        }
+        JsonObject& Number(const char* key, uint64_t value) {
+            Key(key);
+            m_body += std::to_string(value);
+            return *this;
+        }
+        JsonObject& Millis(const char* key, double value) {
+            Key(key);
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.3f", value);
+            m_body += text;
+            return *this;
+        }
+        JsonObject& Bool(const char* key, bool value) {
+            Key(key);
+            m_body += value ? "true" : "false";
+            return *this;
+        }
+        JsonObject& Raw(const char* key, const std::string& json) {
+            Key(key);
+            m_body += json;
+            return *this;
+        }
+        std::string Str() const { return '{' + m_body + '}'; }
+
+    private:
+        void Key(const char* key) {
+            if (!m_body.empty()) m_body += ',';
+            m_body += '"';
+            m_body += key;
+            m_body += "\":";
+        }
+
+        std::string m_body;
+    };
+
+    // ----- Stages -----
+    // What a command reports: one entry per stage in the order run, then the
+    // command's own fields
+    class Report {
+    public:
+        struct Stage {
+            uint64_t bytes = 0;
+            uint64_t domains = 0;
+        };
+
+        explicit Report(const std::string& command) : m_start(std::chrono::steady_clock::now()) {
+            m_fields.String("command", command);
+        }
+
+        // Times `function(Stage&) -> bool`; a failed stage ends the command
+        template <typename Function>
+        bool Run(const char* name, Function&& function) {
+            Stage stage;
+            const auto start = std::chrono::steady_clock::now();
+            bool ok = false;
+            uint64_t peakBytes = 0;
+            {
+                MemTrack::Scope memory("cli.stage");
+                ok = function(stage);
+                peakBytes = memory.Get().peakBytes;
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            JsonObject entry;
+            entry.String("name", name).Millis("ms", elapsed.count()).Bool("ok", ok);
+            if (stage.bytes) entry.Number("bytes", stage.bytes);
+            if (stage.domains) entry.Number("domains", stage.domains);
+            if (MemTrack::GLOBAL_HOOKS) entry.Number("peakBytes", peakBytes);
+            if (!m_stages.empty()) m_stages += ',';
+            m_stages += entry.Str();
+            if (!ok && m_error.empty()) m_error = std::string(name) + " failed";
+            return ok;
+        }
+
+        JsonObject& Fields() { return m_fields; }
+        void Fail(std::string error) { if (m_error.empty()) m_error = std::move(error); }
+
+        // Prints the report and returns `code`, EXIT_FAILED after an error, or
+        // EXIT_OVER_BUDGET when an operation went over its memory budget
+        int Finish(int code) {
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_start;
+            const bool failed = !m_error.empty();
+            std::string overBudget;
+            for (const MemTrack::Report& usage : MemTrack::GetReports()) {
+                if (!usage.overBudget) continue;
+                JsonObject entry;
+                entry.String("operation", usage.operation).Number("peakBytes", usage.peakBytes)
+                    .Number("budgetBytes", usage.budgetBytes);
+                if (!overBudget.empty()) overBudget += ',';
+                overBudget += entry.Str();
+                Fail(usage.operation + " went over its memory budget");
+            }
+            JsonObject out = m_fields;
+            out.Bool("ok", m_error.empty()).Millis("totalMs", elapsed.count()).Raw("stages", '[' + m_stages + ']');
+            if (!overBudget.empty()) out.Raw("overBudget", '[' + overBudget + ']');
+            if (!m_error.empty()) out.String("error", m_error);
+            std::cout << out.Str() << std::endl;
+            if (failed) return EXIT_FAILED;
+            return overBudget.empty() ? code : EXIT_OVER_BUDGET;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+        JsonObject m_fields;
+        std::string m_stages;
+        std::string m_error;
+    };
+
+    // Streams the list through the importer; nothing but the domains is kept
+    bool ImportList(const Options& options, const std::string& source, utils::DomainPool& domains,
+                    Report::Stage& stage) {
+        utils::ListImporter::Options importOptions;
+        importOptions.format = options.format;
+        importOptions.wildcards = options.sinkhole;
+        utils::ListImporter::Stats stats;
+        bool imported = false;
+        if (source == STDIN_NAME) {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            imported = utils::ListImporter::ImportStream(std::cin, "<stdin>", importOptions, domains, &stats);
+        } else {
+            imported = utils::ListImporter::ImportFile(fs::u8path(source), importOptions, domains, &stats);
+        }
+        stage.bytes = stats.bytes;
+        stage.domains = domains.size();
+        return imported && !domains.empty();
+    }
+
+    uint64_t FileSize(const fs::path& path) {
+        std::error_code ec;
+        const uintmax_t size = fs::file_size(path, ec);
+        return ec ? 0 : static_cast<uint64_t>(size);
+    }
+
+    // The domains to block: the imported list operand or, with --profile, the
+    // profile evaluated over the catalog and the list files it names
+    bool LoadSource(const Options& options, Blocker& blocker, Report& report, size_t& domainCount) {
+        if (!options.profile.empty()) {
+            report.Fields().String("profile", options.profile);
+            return report.Run("profile", [&](Report::Stage& stage) {
+                utils::DomainCatalog catalog;
+                std::error_code ec;
+                if (fs::exists(blocker.getCatalogPath(), ec) && !catalog.Load(blocker.getCatalogPath())) return false;
+                const bool ok = blocker.loadProfile(options.profile, catalog);
+                stage.domains = domainCount = blocker.getDomains().size();
+                return ok && domainCount > 0;
+            });
+        }
+
+        report.Fields().String("list", options.operands[0]);
+        utils::DomainPool domains;
+        return report.Run("import", [&](Report::Stage& stage) {
+                return ImportList(options, options.operands[0], domains, stage);
+            }) &&
+            report.Run("load", [&](Report::Stage& stage) {
+                stage.domains = domainCount = domains.size();
+                return blocker.loadDomains(std::move(domains));
+            });
+    }
+
+    // ----- Commands -----
+    int Apply(const Options& options, Blocker& blocker, Report& report) {
+        if (options.operands.size() != (options.profile.empty() ? 1u : 0u)) return EXIT_USAGE;
+
+        bool recovered = report.Run("recover", [&](Report::Stage&) {
+            return blocker.recoverHostsTransition() != utils::HostsJournal::Outcome::Failed;
+        });
+        if (!recovered) return report.Finish(EXIT_FAILED);
+        // Same rule as the GUI: an applied block is locked in place
+        if (blocker.isBlocked()) {
+            report.Fail("hosts file is already blocked");
+            return report.Finish(EXIT_FAILED);
+        }
+
+        size_t domainCount = 0;
+        const bool applied =
+            LoadSource(options, blocker, report, domainCount) &&
+            report.Run("apply", [&](Report::Stage& stage) {
+                const bool ok = blocker.applyBlock();
+                stage.bytes = FileSize(options.hostsPath);
+                stage.domains = domainCount;
+                return ok;
+            }) &&
+            report.Run("verify", [&](Report::Stage& stage) {
+                stage.bytes = FileSize(options.hostsPath);
+                return blocker.verifyBlock();
+            });
+        report.Fields().Number("domains", domainCount);
+        return report.Finish(applied ? EXIT_OK : EXIT_FAILED);
+    }
+
+    int Verify(const Options& options, Blocker& blocker, Report& report) {
+        if (!options.operands.empty()) return EXIT_USAGE;
+        bool blocked = false;
+        report.Run("verify", [&](Report::Stage& stage) {
+            stage.bytes = FileSize(options.hostsPath);
+            blocked = blocker.verifyBlock();
+            return fs::exists(options.hostsPath);
+        });
+        report.Fields().Bool("blocked", blocked);
+        return report.Finish(blocked ? EXIT_OK : EXIT_NOT_BLOCKED);
+    }
+
+    int Status(const Options& options, Blocker& blocker, Report& report) {
+        if (!options.operands.empty()) return EXIT_USAGE;
+        bool blocked = false;
+        uint64_t hostsBytes = 0, generation = 0;
+        size_t snapshots = 0;
+        report.Run("status", [&](Report::Stage& stage) {
+            blocked = blocker.isBlocked();
+            stage.bytes = hostsBytes = FileSize(options.hostsPath);
+            generation = utils::CompiledBlocklist::CurrentGeneration(blocker.getCompiledDir());
+            snapshots = blocker.getSnapshots().List().size();
+            return true;
+        });
+        report.Fields().Bool("blocked", blocked).Number("hostsBytes", hostsBytes)
+            .Number("compiledGeneration", generation).Number("snapshots", snapshots)
+            .Bool("filter", fs::exists(blocker.getFilterPath()));
+        return report.Finish(EXIT_OK);
+    }
+
+    int Compile(const Options& options, Blocker& blocker, Report& report) {
+        const size_t lists = options.profile.empty() ? 1 : 0;
+        if (options.operands.size() < lists || options.operands.size() > lists + 1) return EXIT_USAGE;
+        const fs::path directory = options.operands.size() > lists ? fs::u8path(options.operands[lists])
+                                                                   : blocker.getCompiledDir();
+
+        report.Fields().String("directory", directory.u8string());
+
+        size_t domainCount = 0;
+        uint64_t generation = 0;
+        const bool compiled =
+            LoadSource(options, blocker, report, domainCount) &&
+            report.Run("compile", [&](Report::Stage& stage) {
+                stage.domains = domainCount;
+                const bool ok = blocker.compileBlock(directory, &generation);
+                if (ok) {
+                    stage.bytes = FileSize(directory / ("compiled-" + std::to_string(generation) + ".bin"));
+                }
+                return ok;
+            });
+        report.Fields().Number("domains", domainCount).Number("generation", generation);
+        return report.Finish(compiled ? EXIT_OK : EXIT_FAILED);
+    }
+
+    // The schedule's categories: each list is imported once, here, and the
+    // watchdogs pick the rewritten catalog up by its timestamp
+    int Catalog(const Options& options, Blocker& blocker, Report& report) {
+        const std::vector<std::string>& operands = options.operands;
+        const fs::path& path = blocker.getCatalogPath();
+        utils::DomainCatalog catalog;
+        auto loadCatalog = [&](Report::Stage& stage) {
+            std::error_code ec;
+            if (!fs::exists(path, ec)) return true;  // Starts empty
+            stage.bytes = FileSize(path);
+            const bool ok = catalog.Load(path);
+            stage.domains = catalog.size();
+            return ok;
+        };
+        auto reportCategories = [&] {
+            std::string categories;
+            for (size_t i = 0; i < catalog.CategoryCount(); ++i) {
+                const std::string_view name = catalog.CategoryName(i);
+                JsonObject entry;
+                entry.String("name", name).Number("domains", catalog.Count(catalog.CategoryMask(name)));
+                if (!categories.empty()) categories += ',';
+                categories += entry.Str();
+            }
+            report.Fields().String("catalog", path.u8string()).Number("rows", catalog.size())
+                .Raw("categories", '[' + categories + ']');
+        };
+
+        if (operands.size() == 1 && operands[0] == "list") {
+            const bool listed = report.Run("load", loadCatalog);
+            reportCategories();
+            return report.Finish(listed ? EXIT_OK : EXIT_FAILED);
+        }
+        if (operands.size() != 3 || operands[0] != "add") return EXIT_USAGE;
+        const std::string& category = operands[1];
+        report.Fields().String("category", category).String("list", operands[2]);
+
+        // Imported before the lock; only the load-modify-save is serialized
+        utils::DomainPool domains;
+        utils::FileLock lock;
+        const bool added =
+            report.Run("import", [&](Report::Stage& stage) {
+                return ImportList(options, operands[2], domains, stage);
+            }) &&
+            report.Run("lock", [&](Report::Stage&) {
+                return lock.Acquire(path.parent_path() / CATALOG_LOCK_FILENAME);
+            }) &&
+            report.Run("load", loadCatalog) &&
+            report.Run("add", [&](Report::Stage& stage) {
+                stage.domains = domains.size();
+                catalog.ClearCategory(category);
+                if (!catalog.AddDomains(category, domains)) return false;
+                catalog.Compact();
+                return true;
+            }) &&
+            report.Run("save", [&](Report::Stage& stage) {
+                const bool ok = catalog.Save(path);
+                stage.bytes = FileSize(path);
+                stage.domains = catalog.size();
+                return ok;
+            });
+        reportCategories();
+        return report.Finish(added ? EXIT_OK : EXIT_FAILED);
+    }
+    // Sizes in MiB from the optional second operand
+    bool ParseMebibytes(const std::vector<std::string>& operands, uint64_t fallback, uint64_t& bytes) {
+        uint64_t mib = fallback;
+        if (operands.size() == 2) {
+            const std::string& text = operands[1];
+            if (text.empty() || text.size() > 6 || text.find_first_not_of("0123456789") != std::string::npos) {
+                return false;
+            }
+            mib = std::stoull(text);
+        }
+        bytes = mib << 20;
+        return mib > 0 && operands.size() <= 2;
+    }
+
+    // Kernels first checked against each other and an independent encoder,
+    // then timed one ISA at a time over the same corpus
+    int BenchTranscode(const Options& options, Report& report) {
+        uint64_t bytes = 0;
+        if (!ParseMebibytes(options.operands, TRANSCODE_BENCH_MIB, bytes)) return EXIT_USAGE;
+        const Transcode::Isa active = Transcode::ActiveIsa();
+        report.Fields().String("isa", Transcode::IsaName(active));
+
+        bool ok = report.Run("crosscheck", [&](Report::Stage&) {
+            std::string failure;
+            if (TextBench::CheckTranscode(TRANSCODE_CHECK_ROUNDS, 1, failure)) return true;
+            report.Fail("crosscheck: " + failure);
+            return false;
+        });
+
+        std::string corpus;
+        ok = ok && report.Run("corpus", [&](Report::Stage& stage) {
+            corpus = TextBench::HostsCorpus(bytes, 10, true);
+            stage.bytes = corpus.size();
+            return true;
+        });
+        for (Transcode::Isa wanted : { Transcode::Isa::Scalar, Transcode::Isa::Sse2, Transcode::Isa::Avx2 }) {
+            if (!ok) break;
+            const Transcode::Isa isa = Transcode::ForceIsa(wanted);
+            if (isa != wanted) continue;   // Not on this CPU
+            const std::string prefix = std::string(Transcode::IsaName(isa)) + '.';
+            std::u16string utf16;
+            ok = report.Run((prefix + "utf8to16").c_str(), [&](Report::Stage& stage) {
+                    utf16 = Transcode::Utf8ToUtf16(corpus);
+                    stage.bytes = corpus.size();
+                    return !utf16.empty();
+                }) &&
+                report.Run((prefix + "crlf").c_str(), [&](Report::Stage& stage) {
+                    // The corpus is CRLF already, so nothing may change
+                    stage.bytes = utf16.size() * sizeof(char16_t);
+                    return Transcode::ToCrlf(utf16) == utf16;
+                }) &&
+                report.Run((prefix + "utf16to8").c_str(), [&](Report::Stage& stage) {
+                    stage.bytes = utf16.size() * sizeof(char16_t);
+                    return Transcode::Utf16ToUtf8(utf16) == corpus;
+                });
+            utf16 = {};
+            std::string lf = corpus;
+            ok = ok && report.Run((prefix + "lf").c_str(), [&](Report::Stage& stage) {
+                Transcode::ToLf(lf);
+                stage.bytes = corpus.size();
+                return lf.size() < corpus.size() && lf.find('\r') == std::string::npos;
+            });
+        }
+        Transcode::ForceIsa(active);
+        return report.Finish(ok ? EXIT_OK : EXIT_FAILED);
+    }
+
+    // The built-in mapping checked against the platform's, then each backend
+    // timed on list imports with a growing share of internationalized names
+    int BenchIdna(const Options& options, Report& report) {
+        uint64_t bytes = 0;
+        if (!ParseMebibytes(options.operands, IDNA_BENCH_MIB, bytes)) return EXIT_USAGE;
+        const Idna::Backend active = Idna::ActiveBackend();
+        const Idna::Backend reference = TextBench::ReferenceBackend();
+        report.Fields().String("backend", Idna::BackendName(active)).String("reference", Idna::BackendName(reference));
+
+        // Nothing to check against without ICU or IdnToAscii; the timings still run
+        bool ok = reference == Idna::Backend::Builtin || report.Run("crosscheck", [&](Report::Stage& stage) {
+            size_t checked = 0, referenceOnly = 0;
+            std::string failure;
+            const bool agreed = TextBench::CheckIdna(checked, referenceOnly, failure);
+            stage.domains = checked;
+            report.Fields().Number("checked", checked).Number("referenceOnly", referenceOnly);
+            if (!agreed) report.Fail("crosscheck: " + failure);
+            return agreed;
+        });
+
+        std::vector<Idna::Backend> backends{ Idna::Backend::Builtin };
+        if (reference != Idna::Backend::Builtin) backends.push_back(reference);
+        utils::ListImporter::Options importOptions;
+        importOptions.format = utils::ListImporter::Format::Hosts;
+        for (unsigned permille : { 0u, 1u, 10u, 100u }) {
+            if (!ok) break;
+            const std::string corpus = TextBench::HostsCorpus(bytes, permille, false);
+            for (Idna::Backend backend : backends) {
+                Idna::ForceBackend(backend);
+                const std::string name = std::string(Idna::BackendName(backend)) + ".idn" +
+                                         std::to_string(permille / 10) + '.' + std::to_string(permille % 10) + '%';
+                ok = ok && report.Run(name.c_str(), [&](Report::Stage& stage) {
+                    utils::DomainPool domains;
+                    utils::ListImporter::Stats stats;
+                    utils::ListImporter::ImportText(corpus, importOptions, domains, &stats);
+                    stage.bytes = corpus.size();
+                    stage.domains = domains.size();
+                    return stats.invalid == 0 && !domains.empty();
+                });
+            }
+        }
+        Idna::ForceBackend(active);
+        return report.Finish(ok ? EXIT_OK : EXIT_FAILED);
+    }
+
+    void LatencyFields(JsonObject& out, const utils::DnsBenchmark::Latency& latency) {
+        out.Number("answered", latency.answered).Number("p50Us", latency.p50Micros)
+            .Number("p99Us", latency.p99Micros).Number("maxUs", latency.maxMicros);
+    }
+
+    // Blocked and forwarded queries over UDP from several clients, then a run
+    // over one TCP connection; every answer is checked against its path
+    int BenchDns(const Options& options, Report& report) {
+        utils::DnsBenchmark::Options benchOptions;
+        const std::vector<std::string> settings(options.operands.begin() + 1, options.operands.end());
+        if (!utils::DnsBenchmark::ParseOptions(settings, benchOptions)) return EXIT_USAGE;
+
+        utils::DnsBenchmark::Result result;
+        const bool ok = report.Run("queries", [&](Report::Stage& stage) {
+            if (!utils::DnsBenchmark::Measure(benchOptions, result)) return false;
+            stage.domains = benchOptions.domains;
+            if (!result.Passed(benchOptions)) {
+                report.Fail(std::to_string(result.lost) + " lost, " + std::to_string(result.wrong) +
+                            " wrong, tcp " + std::to_string(result.tcpCorrect) + '/' +
+                            std::to_string(benchOptions.tcpQueries) + " correct");
+                return false;
+            }
+            return true;
+        });
+
+        JsonObject blocked, forwarded;
+        LatencyFields(blocked, result.blocked);
+        LatencyFields(forwarded, result.forwarded);
+        const double qps = result.wallSeconds > 0 ? result.answered / result.wallSeconds : 0.0;
+        report.Fields().Number("sent", result.sent).Number("lost", result.lost).Number("wrong", result.wrong)
+            .Number("qps", static_cast<uint64_t>(qps)).Millis("indexMs", result.buildMs)
+            .Number("upstreamTimeouts", result.upstreamTimeouts).Number("tcpCorrect", result.tcpCorrect)
+            .Raw("blocked", blocked.Str()).Raw("forwarded", forwarded.Str());
+        return report.Finish(ok ? EXIT_OK : EXIT_FAILED);
+    }
+
+    JsonObject TamperSummary(const utils::TamperSimulator::Summary& summary) {
+        JsonObject out;
+        out.Number("events", summary.events).Number("repaired", summary.repaired)
+            .Number("p50Us", summary.p50.count()).Number("p99Us", summary.p99.count())
+            .Number("maxUs", summary.max.count());
+        return out;
+    }
+
+    // The watchdog's guard against an adversary thread, on a hosts file in a
+    // temporary directory; --hosts is left alone
+    int BenchTamper(const Options& options, Report& report) {
+        using Simulator = utils::TamperSimulator;
+        Simulator::Options simOptions;
+        const std::vector<std::string> settings(options.operands.begin() + 1, options.operands.end());
+        if (!Simulator::ParseOptions(settings, simOptions)) return EXIT_USAGE;
+
+        Simulator::Result result;
+        const bool ok = report.Run("tamper", [&](Report::Stage& stage) {
+            if (!Simulator::Measure(simOptions, result)) return false;
+            stage.domains = simOptions.domains;
+            const Simulator::Summary all = Simulator::Summarize(result.samples, Simulator::Mode::Count);
+            if (all.repaired != all.events) {
+                report.Fail(std::to_string(all.events - all.repaired) + " event(s) not repaired");
+                return false;
+            }
+            return true;
+        });
+
+        JsonObject modes;
+        for (size_t m = 0; m < static_cast<size_t>(Simulator::Mode::Count); ++m) {
+            const auto mode = static_cast<Simulator::Mode>(m);
+            const Simulator::Summary summary = Simulator::Summarize(result.samples, mode);
+            if (summary.events > 0) modes.Raw(Simulator::ModeName(mode), TamperSummary(summary).Str());
+        }
+        report.Fields().Raw("all", TamperSummary(Simulator::Summarize(result.samples, Simulator::Mode::Count)).Str())
+            .Raw("modes", modes.Str()).Number("guardRestarts", result.guardRestarts)
+            .Millis("guardCpuMs", std::chrono::duration<double, std::milli>(result.guardCpu).count());
+        if (!simOptions.csvPath.empty()) report.Fields().String("csv", simOptions.csvPath.u8string());
+        return report.Finish(ok ? EXIT_OK : EXIT_FAILED);
+    }
+
+    int Bench(const Options& options, Report& report) {
+        if (options.operands.empty()) return EXIT_USAGE;
+        const std::string& target = options.operands[0];
+        report.Fields().String("target", target);
+        if (target == "transcode") return BenchTranscode(options, report);
+        if (target == "idna") return BenchIdna(options, report);
+        if (target == "dns") return BenchDns(options, report);
+        if (target == "tamper") return BenchTamper(options, report);
+        return EXIT_USAGE;
+    }
+    // Every check runs, each on its own files in a scratch directory; the
+    // hosts file and data directory in the options are left alone
+    int RunSelfTest(const Options& options, Report& report) {
+        if (!options.operands.empty()) return EXIT_USAGE;
+        std::error_code ec;
+        const fs::path workDir = fs::temp_directory_path(ec) / ("cj-selftest-" + std::to_string(std::random_device{}()));
+        if (ec || !fs::create_directories(workDir, ec)) {
+            report.Fail("can't create a scratch directory");
+            return report.Finish(EXIT_FAILED);
+        }
+        report.Fields().String("workDir", workDir.u8string());
+
+        using Check = std::function<bool(std::string&)>;
+        const std::pair<const char*, Check> checks[] = {
+            { "import", SelfTest::CheckImport },
+            { "catalog", [&](std::string& failure) { return SelfTest::CheckCatalog(workDir, failure); } },
+            { "profile", SelfTest::CheckProfile },
+            { "apply", [&](std::string& failure) { return SelfTest::CheckApply(workDir, failure); } },
+            { "journal", [&](std::string& failure) { return SelfTest::CheckJournal(workDir, failure); } },
+            { "compile", [&](std::string& failure) { return SelfTest::CheckCompiled(workDir, failure); } },
+            { "compile.sinkhole", [&](std::string& failure) { return SelfTest::CheckCompileSinkhole(workDir, failure); } },
+            { "apply.sinkhole", [&](std::string& failure) { return SelfTest::CheckSinkholeApply(workDir, failure); } },
+            { "sinkhole", SelfTest::CheckSinkholeAnswers },
+            { "guard", SelfTest::CheckGuard },
+        };
+        bool ok = true;
+        for (const auto& [name, check] : checks) {
+            ok = report.Run(name, [&](Report::Stage&) {
+                std::string failure;
+                if (check(failure)) return true;
+                report.Fail(std::string(name) + ": " + failure);
+                return false;
+            }) && ok;
+        }
+        fs::remove_all(workDir, ec);
+        return report.Finish(ok ? EXIT_OK : EXIT_FAILED);
+    }
+}
+
+bool IsCliCommand(const std::string& arg) {
+    for (const char* command : COMMANDS) {
+        if (arg == command) return true;
+    }
+    return false;
+}
+
+int RunCli(const std::vector<std::string>& args, const std::string& program) {
+    Options options;
+    if (!ParseOptions(args, options)) {
+        ShowUsage(program);
+        return EXIT_USAGE;
+    }
+
+    // stdout carries the report; every log line goes to stderr
+    Logging::Config logConfig;
+    logConfig.consoleStderr = true;
+    logConfig.level = options.verbose ? Logging::Level::Debug : Logging::Level::Warn;
+    logConfig.consoleLevel = logConfig.level;
+    Logging::Session logSession(logConfig);
+    Trace::Session traceSession(options.tracePath);
+
+    std::error_code ec;
+    fs::create_directories(options.dataDir, ec);
+    Blocker blocker(options.hostsPath, options.dataDir / BACKUP_FILENAME);
+    blocker.setSinkholeMode(options.sinkhole);
+
+    Report report(options.command);
+    report.Fields().String("hosts", options.hostsPath.u8string());
+    int code = EXIT_USAGE;
+    if (options.command == "apply") code = Apply(options, blocker, report);
+    else if (options.command == "verify") code = Verify(options, blocker, report);
+    else if (options.command == "status") code = Status(options, blocker, report);
+    else if (options.command == "compile") code = Compile(options, blocker, report);
+    else if (options.command == "catalog") code = Catalog(options, blocker, report);
+    else if (options.command == "bench") code = Bench(options, report);
+    else if (options.command == "selftest") code = RunSelfTest(options, report);
+    if (code == EXIT_USAGE) ShowUsage(program);
+    return code;
+}
@@ -0,0 +1,15 @@
+// cli.h
+#pragma once
+
+#include <string>
+#include <vector>
+
+// ----- Headless Commands -----
+// apply, verify, status, compile and catalog for deployment scripts and
+// automation, bench for the text-path, sinkhole and watchdog cross-checks and
+// throughput, and selftest (run by ctest) for the engine's end-to-end checks:
+// no dialogs, one JSON object on stdout with per-stage timings, logs on stderr.
+// Arguments are UTF-8 and exclude the program name; the return value is the
+// process exit code. `program` is the name the usage text shows.
+bool IsCliCommand(const std::string& arg);
+int RunCli(const std::vector<std::string>& args, const std::string& program = "chickenjockey-cli");
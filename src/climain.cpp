@@ -0,0 +1,14 @@
+// climain.cpp
+#include "cli.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Headless build for platforms without the Windows front end; there the same
+// commands are the first argument to ChickenJockey.exe
+int main(int argc, char* argv[]) {
+    const std::string program = argc > 0 ? std::filesystem::u8path(argv[0]).filename().u8string() : "";
+    return RunCli(std::vector<std::string>(argv + 1, argv + argc),
+                  program.empty() ? "chickenjockey-cli" : program);
+}
@@ -2,6 +2,9 @@
 
 #include "gui.h"
 #include "blocker.h"
+#include "decompress.h"
+#include "importer.h"
+#include "transcode.h"
 #include <windows.h>
 #include <commdlg.h>
 #include <dwmapi.h>
@@ -11,7 +14,6 @@
 #include <vector>
 #include <sstream>
 #include <iostream>
-#include <regex>
 #include <shlwapi.h>
 #include <shlobj.h>
 #include <shellapi.h>
@@ -42,6 +44,7 @@ HWND g_hStatusBar = nullptr;
 HWND hButtonBrowse = nullptr;
 HWND hButtonApply = nullptr;
 bool g_darkMode = false;
+bool g_sinkholeMode = false;
 
 // Forward declarations
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -52,6 +55,11 @@ HFONT CreateCustomFont(int size, bool bold = false);
 void ApplyDarkTheme(HWND hwnd, bool enable);
 void ShowErrorMessage(HWND hwnd, const wchar_t* message);
 
+// wchar_t is UTF-16 on Windows, so wide strings go to Transcode as they are
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "wchar_t must be UTF-16");
+inline char16_t* AsUtf16(wchar_t* text) { return reinterpret_cast<char16_t*>(text); }
+inline const char16_t* AsUtf16(const wchar_t* text) { return reinterpret_cast<const char16_t*>(text); }
+
 bool AddStartupEntry(const std::wstring& name, const std::wstring& command) {
     HKEY hKey;
     if (RegOpenKeyExW(HKEY_LOCAL_MACHINE,
@@ -72,7 +80,8 @@ bool AddStartupEntry(const std::wstring& name, const std::wstring& command) {
 
 
 
-int RunGUI() {
+int RunGUI(bool sinkholeMode) {
+    g_sinkholeMode = sinkholeMode;
     Blocker checkBlock;
     if (checkBlock.isBlocked()) {
         MessageBoxW(NULL,
@@ -161,29 +170,22 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     // Retrieve and process blocklist
                     int len = GetWindowTextLengthW(g_hEdit);
                     std::wstring buffer(len + 1, L'\0');
-                    GetWindowTextW(g_hEdit, &buffer[0], len + 1);
-
-                    // Convert to UTF-8
-                    int utf8Size = WideCharToMultiByte(CP_UTF8, 0, buffer.c_str(), -1, nullptr, 0, nullptr, nullptr);
-                    std::string utf8BlockList(utf8Size, 0);
-                    WideCharToMultiByte(CP_UTF8, 0, buffer.c_str(), -1, &utf8BlockList[0], utf8Size, nullptr, nullptr);
-
-                    // Parse domains
-                    std::istringstream stream(utf8BlockList);
-                    std::string line;
-                    std::vector<std::string> domains;
-                    std::regex hostPattern(R"((?:0\.0\.0\.0|127\.0\.0\.1)?\s*([a-zA-Z0-9\.\-_]+))");
-
-                    while (std::getline(stream, line)) {
-                        if (line.empty() || line[0] == '#') continue;
-                        std::smatch match;
-                        if (std::regex_search(line, match, hostPattern)) {
-                            domains.push_back(match[1].str());
-                        }
-                    }
+                    const size_t copied = static_cast<size_t>(GetWindowTextW(g_hEdit, &buffer[0], len + 1));
+
+                    // Convert to UTF-8; the importer copes with CRLF itself
+                    std::string utf8BlockList(Transcode::Utf8Length(AsUtf16(buffer.data()), copied), '\0');
+                    Transcode::Utf16ToUtf8(AsUtf16(buffer.data()), copied, utf8BlockList.data());
+
+                    // Parse domains in whatever list format was pasted or loaded.
+                    // Hosts entries can't express wildcards; only the sinkhole can.
+                    utils::ListImporter::Options importOptions;
+                    importOptions.wildcards = g_sinkholeMode;
+                    utils::DomainPool domains;
+                    utils::ListImporter::ImportText(utf8BlockList, importOptions, domains);
 
                     Blocker blocker;
-if (!blocker.loadDomains(domains) || !blocker.applyBlock()) {
+                    blocker.setSinkholeMode(g_sinkholeMode);
+if (!blocker.loadDomains(std::move(domains)) || !blocker.applyBlock()) {
     ShowErrorMessage(hwnd, L"Failed to apply blocklist.");
 } else {
     MessageBoxW(hwnd, 
@@ -283,7 +285,7 @@ bool LoadFileToEditControl(HWND hEdit) {
     wchar_t szFileName[MAX_PATH] = L"";
 
     ofn.hwndOwner = hEdit;
-    ofn.lpstrFilter = L"Hosts Files (*.txt;*.hosts)\0*.txt;*.hosts\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFilter = L"Block Lists (*.txt;*.hosts;*.gz;*.zst)\0*.txt;*.hosts;*.gz;*.zst\0All Files (*.*)\0*.*\0";
     ofn.lpstrFile = szFileName;
     ofn.nMaxFile = MAX_PATH;
     ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST;
@@ -291,30 +293,17 @@ bool LoadFileToEditControl(HWND hEdit) {
 
     if (!GetOpenFileNameW(&ofn)) return false;
 
-    HANDLE hFile = CreateFileW(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
-                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile == INVALID_HANDLE_VALUE) return false;
+    // Compressed lists are inflated on the way in
+    std::string buffer;
+    if (!utils::DecompressingReader::ReadAll(szFileName, buffer)) return false;
 
-    DWORD fileSize = GetFileSize(hFile, NULL);
-    std::string buffer(fileSize + 1, 0);
-    DWORD bytesRead;
-    ReadFile(hFile, buffer.data(), fileSize, &bytesRead, NULL);
-    CloseHandle(hFile);
-
-    int wideSize = MultiByteToWideChar(CP_UTF8, 0, buffer.data(), bytesRead, NULL, 0);
-    std::wstring wbuffer(wideSize, 0);
-    MultiByteToWideChar(CP_UTF8, 0, buffer.data(), bytesRead, &wbuffer[0], wideSize);
+    const std::string_view text = Transcode::StripBom(buffer);
+    std::wstring wbuffer(Transcode::Utf16Length(text.data(), text.size()), L'\0');
+    Transcode::Utf8ToUtf16(text.data(), text.size(), AsUtf16(wbuffer.data()));
 
     // 🔧 Normalize to CRLF line endings for multiline display
-    std::wstring normalized;
-    for (wchar_t ch : wbuffer) {
-        if (ch == L'\n') {
-            if (normalized.empty() || normalized.back() != L'\r') {
-                normalized += L'\r';
-            }
-        }
-        normalized += ch;
-    }
+    std::wstring normalized(Transcode::CrlfLength(AsUtf16(wbuffer.data()), wbuffer.size()), L'\0');
+    Transcode::ToCrlf(AsUtf16(wbuffer.data()), wbuffer.size(), AsUtf16(normalized.data()));
 
     SetWindowTextW(hEdit, normalized.c_str());
     return true;
@@ -2,5 +2,6 @@
 
 #pragma once
 
-// Run the Chicken Jockey setup GUI
-int RunGUI();
\ No newline at end of file
+// Run the Chicken Jockey setup GUI. In sinkhole mode the list is enforced by
+// the watchdogs' DNS sinkhole instead of hosts entries.
+int RunGUI(bool sinkholeMode = false);
\ No newline at end of file
@@ -8,13 +8,31 @@
 #include <sddl.h>
 
 #include "blocker.h"
+#include "cli.h"
 #include "utils/watcher.h"
+#include "utils/tamper.h"
+#include "utils/dnsbench.h"
+#include "utils/sinkhole.h"
 #include "gui.h"
+#include "asyncio.h"
+#include "builtinlists.h"
+#include "catalog.h"
 #include "crypto.h"
+#include "domainset.h"
+#include "idna.h"
+#include "importer.h"
 #include "path.h"
+#include "log.h"
+#include "mappedfile.h"
+#include "memtrack.h"
+#include "schedule.h"
+#include "selftest.h"
+#include "trace.h"
+#include "transcode.h"
 #include <thread>   // Needed for std::this_thread
 #include <chrono>      // for std::chrono::milliseconds
 #include <fstream>       // Required for std::ofstream
+#include <functional>
 
 bool PerformFactoryReset();
 constexpr int EXIT_ADMIN_REQUIRED = 1001;
@@ -85,6 +103,14 @@ void RunDebugMode() {
         std::wcout << L"[Debug] Hosts file path: " << blocker.getHostsPath() << L"\n";
     }
     
+    // Built-in categories compiled from CJ_BUILTIN_LISTS
+    std::wcout << L"[Debug] Built-in categories: " << BuiltinLists::CategoryCount() << L"\n";
+    for (size_t i = 0; i < BuiltinLists::CategoryCount(); ++i) {
+        const std::string_view name = BuiltinLists::CategoryName(i);
+        std::wcout << L"[Debug]   " << std::wstring(name.begin(), name.end()) << L": "
+                  << BuiltinLists::CategoryDomainCount(i) << L" domain(s)\n";
+    }
+    
     // Section 2: Core Functionality Tests
     std::wcout << L"\n[Debug] === Core Functionality Tests ===\n";
     
@@ -103,6 +129,16 @@ void RunDebugMode() {
         std::wcout << L"[Debug] Testing backup functionality...\n";
         if (blocker.backupHosts()) {
             std::wcout << L"[Debug] Backup created successfully\n";
+
+            // Every stored version must reassemble to its recorded digest
+            utils::SnapshotStore::VerifyReport snapshotReport;
+            if (blocker.getSnapshots().Verify(&snapshotReport)) {
+                std::wcout << L"[Debug] Snapshot integrity check passed (" << snapshotReport.versions
+                          << L" version(s), " << snapshotReport.chunks << L" chunk(s))\n";
+            } else {
+                std::wcerr << L"[Debug] ERROR: Snapshot integrity check failed ("
+                          << snapshotReport.badVersions << L" damaged version(s))\n";
+            }
             
             // Test applying block
             std::wcout << L"[Debug] Testing block application...\n";
@@ -115,6 +151,13 @@ void RunDebugMode() {
                 } else {
                     std::wcerr << L"[Debug] ERROR: Block verification failed\n";
                 }
+
+                // Test host lookup through the filter
+                if (blocker.isHostBlocked("Debug.Example.NET.") && !blocker.isHostBlocked("not-blocked.invalid")) {
+                    std::wcout << L"[Debug] Host lookup test passed\n";
+                } else {
+                    std::wcerr << L"[Debug] ERROR: Host lookup test failed\n";
+                }
                 
                 // Test reapply
                 std::wcout << L"[Debug] Testing reapply functionality...\n";
@@ -167,7 +210,99 @@ void RunDebugMode() {
         throw std::runtime_error("Watcher initialization failed");
     }
     std::wcout << L"[Debug] Watcher test passed\n";
-    
+
+    // Transcoding round trip: non-ASCII, a surrogate pair and mixed line endings
+    const std::string transcodeSample = "caf\xC3\xA9 \xF0\x9F\x90\x94\r\nads.example\rx\n";
+    std::string transcoded = Transcode::Utf16ToUtf8(Transcode::ToCrlf(Transcode::Utf8ToUtf16(transcodeSample)));
+    Transcode::ToLf(transcoded);
+    if (transcoded == "caf\xC3\xA9 \xF0\x9F\x90\x94\nads.example\nx\n") {
+        std::wcout << L"[Debug] Transcoding test passed ("
+                  << Transcode::IsaName(Transcode::ActiveIsa()) << L")\n";
+    } else {
+        std::wcerr << L"[Debug] ERROR: Transcoding test failed\n";
+    }
+
+    // Batched file I/O: two atomic writes, one failing chain, reads back
+    const fs::path ioDir = fs::temp_directory_path() / "cj_debug_io";
+    fs::create_directories(ioDir);
+    const std::string ioFirst = "first", ioSecond(100000, 's');
+    utils::IoBatch ioWrites;
+    ioWrites.WriteAtomically(ioDir / "a", ioFirst.data(), ioFirst.size());
+    ioWrites.WriteAtomically(ioDir / "missing" / "b", ioFirst.data(), ioFirst.size());
+    ioWrites.WriteAtomically(ioDir / "c", ioSecond.data(), ioSecond.size(), true);
+    const bool ioWritten = !ioWrites.Wait() && !ioWrites.GetError().empty();
+    std::string ioReadFirst, ioReadSecond;
+    utils::IoBatch ioReads;
+    ioReads.Read(ioDir / "a", ioReadFirst);
+    ioReads.Chain();
+    ioReads.Read(ioDir / "c", ioReadSecond);
+    const bool ioPassed = ioWritten && ioReads.Wait() && ioReadFirst == ioFirst && ioReadSecond == ioSecond &&
+                          !fs::exists(ioDir / "a.tmp");
+    if (ioPassed) {
+        std::wcout << L"[Debug] Async I/O test passed ("
+                   << utils::IoBatch::BackendName(utils::IoBatch::ActiveBackend()) << L")\n";
+    } else {
+        std::wcerr << L"[Debug] ERROR: Async I/O test failed\n";
+    }
+
+    // Mapped views: the large file is mapped, the small one read into a buffer
+    utils::MappedFile mappedLarge, mappedSmall;
+    const bool mappedPassed = mappedLarge.Open(ioDir / "c") && mappedLarge.IsMapped() &&
+                              mappedLarge.View() == ioSecond && mappedSmall.Open(ioDir / "a") &&
+                              !mappedSmall.IsMapped() && mappedSmall.View() == ioFirst;
+    mappedLarge.Close();
+    mappedSmall.Close();
+    if (mappedPassed) {
+        std::wcout << L"[Debug] Mapped file test passed\n";
+    } else {
+        std::wcerr << L"[Debug] ERROR: Mapped file test failed\n";
+    }
+    fs::remove_all(ioDir);
+
+    // Engine checks shared with the headless selftest command
+    const fs::path selfTestDir = fs::temp_directory_path() / "cj_debug_selftest";
+    fs::create_directories(selfTestDir);
+    const std::pair<const wchar_t*, std::function<bool(std::string&)>> selfTests[] = {
+        { L"List import", SelfTest::CheckImport },
+        { L"Sinkhole matching", SelfTest::CheckSinkholeAnswers },
+        { L"Category catalog", [&](std::string& failure) { return SelfTest::CheckCatalog(selfTestDir, failure); } },
+        { L"Profile algebra", SelfTest::CheckProfile },
+    };
+    for (const auto& [name, check] : selfTests) {
+        std::string failure;
+        if (check(failure)) {
+            std::wcout << L"[Debug] " << name << L" test passed\n";
+        } else {
+            std::wcerr << L"[Debug] ERROR: " << name << L" test failed: " << failure.c_str() << L"\n";
+        }
+    }
+    fs::remove_all(selfTestDir);
+
+    // Memory budgets: a scope charged past its budget is flagged, and no
+    // operation run above may have gone over one given with --memory-budget
+    bool budgetPassed = true;
+    {
+        MemTrack::SetBudget("debug.budget", 1024);
+        MemTrack::TrackingResource resource;
+        MemTrack::Scope probe("debug.budget");
+        std::pmr::vector<char> buffer(4096, 0, &resource);
+        budgetPassed = probe.OverBudget() && resource.Get().peakBytes >= 4096;
+    }
+    MemTrack::SetBudget("debug.budget", 0);
+    for (const MemTrack::Report& report : MemTrack::GetReports()) {
+        if (report.operation == "debug.budget" || report.overBudget == 0) continue;
+        std::wcerr << L"[Debug] " << report.operation.c_str() << L" peaked at " << report.peakBytes
+                   << L" bytes, over its budget of " << report.budgetBytes << L"\n";
+        budgetPassed = false;
+    }
+    MemTrack::LogReports();
+    if (budgetPassed) {
+        std::wcout << L"[Debug] Memory budget test passed"
+                   << (MemTrack::GLOBAL_HOOKS ? L"\n" : L" (built without CJ_TRACK_ALLOCATIONS)\n");
+    } else {
+        std::wcerr << L"[Debug] ERROR: Memory budget test failed\n";
+    }
+
     // Final summary
     std::wcout << L"\n===== [Debug] Diagnostic Tests Completed =====\n\n";
     
@@ -184,10 +319,25 @@ void ShowHelp() {
                << L"  --gui              Launch graphical interface\n"
                << L"  --debug            Run diagnostic tests\n"
                << L"  --test-crypto      Test encryption modules\n"
-               << L"  --watchdog <A|B>   Run as watchdog process\n"
+               << L"  --watchdog <A|B> [peerPID]\n"
+               << L"                     Run as watchdog process (metrics in <data>\\metrics\\)\n"
+               << L"  --tamper-sim [key=value...]\n"
+               << L"                     Measure watchdog repair latency against a temp hosts file\n"
+               << L"                     (rounds, domains, poll, gap, timeout, probe, mix, csv)\n"
+               << L"  --sinkhole         With --gui: enforce through the watchdogs' DNS sinkhole on\n"
+               << L"                     127.0.0.1:53 (point the network adapter's DNS server there)\n"
+               << L"  --dns-bench [key=value...]\n"
+               << L"                     Measure sinkhole throughput against a local stand-in upstream\n"
+               << L"                     (queries, domains, clients, window, blocked, tcp, timeout)\n"
                << L"  --stop-everything  Kill all Chicken Jockey processes\n"
                << L"  --factory-reset    Restore defaults and delete app data\n"
-               << L"  --help             Show this help message\n";
+               << L"  --trace <file>     Write Chrome trace-event JSON for this run\n"
+               << L"  --memory-budget <operation>=<MiB>\n"
+               << L"                     Peak memory allowed for import, apply, repair or schedule;\n"
+               << L"                     --debug fails an operation that goes over\n"
+               << L"  --help             Show this help message\n"
+               << L"  apply|verify|status|compile|catalog|bench|selftest ...\n"
+               << L"                     Headless commands with JSON output (<command> --help for usage)\n";
 }
 
 
@@ -245,17 +395,17 @@ bool PerformFactoryReset() {
     system("icacls C:\\Windows\\System32\\drivers\\etc\\hosts /grant Everyone:F >nul 2>&1");
     system("icacls C:\\Windows\\System32\\drivers\\etc\\hosts /inheritance:r >nul 2>&1");
 
-    // 📁 Attempt to restore from backup
-    std::filesystem::path backupPath = L"C:\\ProgramData\\ChickenJockey\\hosts.bak";
+    // 📁 Attempt to restore from the snapshot store, then from backups left by older versions
     std::filesystem::path targetPath = L"C:\\Windows\\System32\\drivers\\etc\\hosts";
     std::error_code ec;
 
-    bool restored = false;
-    if (std::filesystem::exists(backupPath)) {
+    bool restored = Blocker().restoreOriginalHosts();
+    for (const wchar_t* legacyName : { L"hosts_backup.txt", L"hosts.bak" }) {
+        const std::filesystem::path backupPath = std::filesystem::path(L"C:\\ProgramData\\ChickenJockey") / legacyName;
+        if (restored || !std::filesystem::exists(backupPath)) continue;
         std::filesystem::copy_file(backupPath, targetPath, std::filesystem::copy_options::overwrite_existing, ec);
         if (!ec) {
             restored = true;
-             // std::filesystem::remove(backupPath, ec); (Not needed due to issues)
         } else {
             std::wcerr << L"[Reset] Failed to restore hosts file: " << ec.message().c_str() << std::endl;
         }
@@ -288,6 +438,15 @@ bool PerformFactoryReset() {
 
 int wmain(int argc, wchar_t* argv[]) {
     SetConsoleOutputCP(CP_UTF8);
+
+    // Headless commands print JSON on stdout and never open a dialog
+    if (argc > 1) {
+        std::vector<std::string> cliArgs;
+        for (int i = 1; i < argc; ++i) {
+            cliArgs.push_back(Transcode::Utf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(argv[i]))));
+        }
+        if (IsCliCommand(cliArgs[0])) return RunCli(cliArgs, fs::path(argv[0]).filename().u8string());
+    }
     std::wcout << L"----- Chicken Jockey Initialization -----\n";
 
     // Remove the standalone debugMode declaration here
@@ -304,6 +463,10 @@ int wmain(int argc, wchar_t* argv[]) {
 
     // This is the only place debugMode should be declared
     bool guiMode = false, debugMode = false, cryptoTest = false, stopAll = false, factoryReset = false;
+    bool tamperSim = false, watchdogMode = false, sinkholeMode = false, dnsBench = false;
+    std::wstring watchdogRole, watchdogPeer;
+    std::filesystem::path tracePath;
+    std::vector<std::string> tamperArgs, dnsBenchArgs;
 
     for (int i = 1; i < argc; ++i) {
         std::wstring arg = argv[i];
@@ -312,6 +475,35 @@ int wmain(int argc, wchar_t* argv[]) {
         else if (arg == L"--factory-reset") factoryReset = true;
         else if (arg == L"--debug") debugMode = true;
         else if (arg == L"--test-crypto") cryptoTest = true;
+        else if (arg == L"--trace" && i + 1 < argc) tracePath = argv[++i];
+        else if (arg == L"--memory-budget" && i + 1 < argc) {
+            const std::wstring spec = argv[++i];
+            if (!MemTrack::ParseBudget(std::string(spec.begin(), spec.end()))) {
+                std::wcerr << L"[Error] Bad memory budget: " << spec << L"\n";
+                ShowHelp();
+                return 1;
+            }
+        }
+        else if (arg == L"--watchdog" && i + 1 < argc) {
+            watchdogMode = true;
+            watchdogRole = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != L'-') watchdogPeer = argv[++i];
+        }
+        else if (arg == L"--tamper-sim") {
+            tamperSim = true;
+            while (i + 1 < argc && std::wstring(argv[i + 1]).find(L'=') != std::wstring::npos) {
+                ++i;
+                tamperArgs.push_back(Transcode::Utf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(argv[i]))));
+            }
+        }
+        else if (arg == L"--sinkhole") sinkholeMode = true;
+        else if (arg == L"--dns-bench") {
+            dnsBench = true;
+            while (i + 1 < argc && std::wstring(argv[i + 1]).find(L'=') != std::wstring::npos) {
+                ++i;
+                dnsBenchArgs.push_back(Transcode::Utf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(argv[i]))));
+            }
+        }
         else if (arg == L"--help") {
             ShowHelp();
             return 0;
@@ -322,21 +514,76 @@ int wmain(int argc, wchar_t* argv[]) {
         }
     }
 
-    
+
+    // Logging goes to the console and a rotating file in the data directory
+    Logging::Config logConfig;
+    logConfig.file = L"C:\\ProgramData\\ChickenJockey\\logs\\chickenjockey.log";
+    if (watchdogMode) {
+        // Both watchdogs run at once; keep their logs apart
+        logConfig.file.replace_filename(L"watchdog-" + watchdogRole + L".log");
+    }
+    if (debugMode) {
+        logConfig.level = Logging::Level::Debug;
+        logConfig.consoleLevel = Logging::Level::Debug;
+    }
+    Logging::Session logSession(logConfig);
+    Trace::Session traceSession(tracePath);
+
     if (stopAll) {
         bool result = ConfirmAndStopEverything();
+        Trace::Stop();
+        Logging::Stop();
         ExitProcess(result ? 0 : 1);
     }
     
     if (factoryReset) {
         bool result = PerformFactoryReset();
+        Trace::Stop();
+        Logging::Stop();
         ExitProcess(result ? 0 : 1);
     }
+
+    // The simulator only touches a temp directory, so it runs even when blocked
+    if (tamperSim) {
+        utils::TamperSimulator::Options options;
+        if (!utils::TamperSimulator::ParseOptions(tamperArgs, options)) {
+            ShowHelp();
+            return 1;
+        }
+        return utils::TamperSimulator::Run(options);
+    }
+
+    // Loopback only, with its own stand-in upstream; like the simulator it runs even when blocked
+    if (dnsBench) {
+        utils::DnsBenchmark::Options options;
+        if (!utils::DnsBenchmark::ParseOptions(dnsBenchArgs, options)) {
+            ShowHelp();
+            return 1;
+        }
+        return utils::DnsBenchmark::Run(options);
+    }
+
+    // Watchdogs exist to keep the block in place, so they start before the lock check
+    if (watchdogMode) {
+        std::vector<std::string> watchdogArgs = { "ChickenJockey", "--watchdog",
+            std::string(watchdogRole.begin(), watchdogRole.end()) };
+        if (!watchdogPeer.empty()) {
+            watchdogArgs.emplace_back(watchdogPeer.begin(), watchdogPeer.end());
+        }
+        std::vector<char*> watchdogArgv;
+        for (auto& watchdogArg : watchdogArgs) watchdogArgv.push_back(watchdogArg.data());
+
+        int result = utils::Watcher::Run(static_cast<int>(watchdogArgv.size()), watchdogArgv.data());
+        return result == EXIT_SUCCESS ? 0 : EXIT_WATCHDOG_ERROR;
+    }
     
     
 
     // 🔒 Enforce blocking after those critical flags
     Blocker blocker;
+    if (blocker.recoverHostsTransition() == utils::HostsJournal::Outcome::Failed) {
+        std::wcerr << L"[Chicken Jockey] An interrupted hosts update could not be recovered.\n";
+    }
     if (blocker.isBlocked()) {
         std::wcerr << L"[Chicken Jockey] Access denied: Hosts file is already blocked.\n";
         MessageBoxW(nullptr,
@@ -349,7 +596,7 @@ int wmain(int argc, wchar_t* argv[]) {
     // 🧠 Main logic modes
     if (guiMode || argc == 1) {
         std::wcout << L"Launching GUI...\n";
-        return RunGUI();
+        return RunGUI(sinkholeMode);
     }
 
     if (debugMode) {
@@ -0,0 +1,768 @@
+// asyncio.cpp
+#include "asyncio.h"
+#include "executor.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// RENAMEAT arrived in 5.11; the next feature flag marks headers that have it
+#ifdef IORING_FEAT_NATIVE_WORKERS
+#define CJ_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace utils {
+
+namespace {
+
+#ifdef _WIN32
+using Handle = HANDLE;
+const Handle NO_HANDLE = INVALID_HANDLE_VALUE;
+#else
+using Handle = int;
+constexpr Handle NO_HANDLE = -1;
+#endif
+
+constexpr size_t IO_THREADS = 4;
+constexpr size_t MAX_TRANSFER = size_t(1) << 30;  // Larger reads and writes are split
+
+// Blocking I/O would starve the compute workers of Executor::Shared()
+Executor& IoPool() {
+    static Executor pool(IO_THREADS);
+    return pool;
+}
+
+std::error_code LastError() noexcept {
+#ifdef _WIN32
+    return std::error_code(static_cast<int>(GetLastError()), std::system_category());
+#else
+    return std::error_code(errno, std::generic_category());
+#endif
+}
+
+// ----- Platform Calls -----
+Handle OpenRead(const fs::path& path, uint64_t& size, std::error_code& ec) {
+#ifdef _WIN32
+    const Handle handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER length{};
+    if (handle == NO_HANDLE || !GetFileSizeEx(handle, &length)) {
+        ec = LastError();
+        if (handle != NO_HANDLE) CloseHandle(handle);
+        return NO_HANDLE;
+    }
+    size = static_cast<uint64_t>(length.QuadPart);
+    return handle;
+#else
+    const Handle handle = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info{};
+    if (handle < 0 || fstat(handle, &info) != 0) {
+        ec = LastError();
+        if (handle >= 0) close(handle);
+        return NO_HANDLE;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+    return handle;
+#endif
+}
+
+Handle OpenWrite(const fs::path& path, std::error_code& ec) {
+#ifdef _WIN32
+    const Handle handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                      FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    const Handle handle = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+#endif
+    if (handle == NO_HANDLE) ec = LastError();
+    return handle;
+}
+
+void CloseFile(Handle handle) noexcept {
+#ifdef _WIN32
+    CloseHandle(handle);
+#else
+    close(handle);
+#endif
+}
+
+// Bytes transferred, at most MAX_TRANSFER; 0 with `ec` set on failure
+size_t TransferAt(Handle handle, bool write, char* buffer, size_t size, uint64_t offset, std::error_code& ec) {
+    size = std::min(size, MAX_TRANSFER);
+#ifdef _WIN32
+    OVERLAPPED position{};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD done = 0;
+    const BOOL ok = write ? WriteFile(handle, buffer, static_cast<DWORD>(size), &done, &position)
+                          : ReadFile(handle, buffer, static_cast<DWORD>(size), &done, &position);
+    if (!ok) ec = LastError();
+    return done;
+#else
+    while (true) {
+        const ssize_t done = write ? pwrite(handle, buffer, size, static_cast<off_t>(offset))
+                                   : pread(handle, buffer, size, static_cast<off_t>(offset));
+        if (done >= 0) return static_cast<size_t>(done);
+        if (errno == EINTR) continue;
+        ec = LastError();
+        return 0;
+    }
+#endif
+}
+
+void SyncFile(Handle handle, std::error_code& ec) {
+#ifdef _WIN32
+    if (!FlushFileBuffers(handle)) ec = LastError();
+#else
+    if (fsync(handle) != 0) ec = LastError();
+#endif
+}
+
+void RenameFile(const fs::path& from, const fs::path& to, std::error_code& ec) {
+#ifdef _WIN32
+    // ReplaceFileW keeps the target's ACL and attributes, as PathUtil always has
+    if (GetFileAttributesW(to.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        if (!ReplaceFileW(to.c_str(), from.c_str(), nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr)) {
+            ec = LastError();
+        }
+    } else if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ec = LastError();
+    }
+#else
+    if (std::rename(from.c_str(), to.c_str()) != 0) ec = LastError();
+#endif
+}
+
+} // anonymous namespace
+
+// ----- Batch State -----
+struct IoBatch::Op {
+    enum class Type { Read, Write, Sync, Rename };
+
+    State* state = nullptr;
+    Type type = Type::Read;
+    size_t chain = 0;
+    File file = 0;
+    Handle handle = NO_HANDLE;   // Copied from the file, which the caller may still be adding to
+    char* buffer = nullptr;
+    size_t size = 0;
+    uint64_t offset = 0;
+    fs::path from, to;
+    size_t transferred = 0;
+    std::error_code error;   // Set when queued if the file couldn't be opened
+};
+
+struct IoBatch::State {
+    struct FileEntry {
+        fs::path path;
+        Handle handle = NO_HANDLE;
+        std::error_code error;
+    };
+
+    Backend backend = Backend::Pool;
+    std::deque<Op> ops;                                     // Stable addresses while in flight
+    std::vector<FileEntry> files;
+    std::vector<std::pair<size_t, fs::path>> temporaries;  // Removed when their chain fails
+    size_t chain = 0;
+    size_t submitted = 0;                                   // ops before this index have been started
+    std::vector<std::future<void>> tasks;                  // Pool backend
+
+    // io_uring completions arrive on the reaper thread
+    std::mutex mutex;
+    std::condition_variable completed;
+    size_t inFlight = 0;
+
+    uint64_t bytes = 0;
+    std::string error;
+
+    Op& Add(Op::Type type) {
+        Op& op = ops.emplace_back();
+        op.state = this;
+        op.type = type;
+        op.chain = chain;
+        return op;
+    }
+};
+
+namespace {
+
+using Op = IoBatch::Op;
+
+void RunOp(Op& op) {
+    switch (op.type) {
+        case Op::Type::Read:
+        case Op::Type::Write: {
+            const bool write = op.type == Op::Type::Write;
+            while (op.transferred < op.size && !op.error) {
+                const size_t done = TransferAt(op.handle, write, op.buffer + op.transferred,
+                                               op.size - op.transferred, op.offset + op.transferred, op.error);
+                if (done == 0 && !op.error) op.error = std::make_error_code(std::errc::io_error);  // Shrank under us
+                op.transferred += done;
+            }
+            break;
+        }
+        case Op::Type::Sync:
+            SyncFile(op.handle, op.error);
+            break;
+        case Op::Type::Rename:
+            RenameFile(op.from, op.to, op.error);
+            break;
+    }
+}
+
+const char* OpName(Op::Type type) noexcept {
+    switch (type) {
+        case Op::Type::Read:   return "read";
+        case Op::Type::Write:  return "write";
+        case Op::Type::Sync:   return "sync";
+        case Op::Type::Rename: return "rename";
+        default:               return "unknown";
+    }
+}
+
+// ----- io_uring -----
+#ifdef CJ_IO_URING
+// Straight system calls, so liburing isn't a dependency. One ring serves the
+// process: submitters take the mutex, and a reaper thread collects
+// completions and hands them back to their batch.
+class Uring {
+public:
+    static Uring* Get() noexcept {
+        static const std::unique_ptr<Uring> instance = Create();
+        return instance.get();
+    }
+
+    ~Uring() {
+        if (m_reaper.joinable()) {
+            Op* none = nullptr;
+            Push(&none, 1);   // A null user_data tells the reaper to stop
+            m_reaper.join();
+        }
+        if (m_sqes) munmap(m_sqes, m_sqesSize);
+        if (m_cqRing && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing) munmap(m_sqRing, m_sqRingSize);
+        if (m_fd >= 0) close(m_fd);
+    }
+
+    size_t MaxChain() const noexcept { return m_sqEntries; }
+
+    // Queues whole chains as linked requests, as many per system call as the
+    // rings allow. The batch's in-flight count must already include them.
+    void Push(Op* const* ops, size_t count) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t first = 0;
+        while (first < count) {
+            // Whole chains only: a link can't span two enters
+            size_t last = first;
+            size_t fits = first;
+            const size_t room = std::min<size_t>(m_sqEntries, m_cqEntries - std::min(m_inFlight, size_t(m_cqEntries)));
+            while (last < count && last - first < room) {
+                ++last;
+                if (last == count || !ops[last] || !ops[last - 1] || ops[last]->chain != ops[last - 1]->chain) {
+                    fits = last;
+                }
+            }
+            if (fits == first) {
+                m_space.wait(lock);   // Not even one chain fits until completions are reaped
+                continue;
+            }
+            Enqueue(ops + first, fits - first, lock);
+            first = fits;
+        }
+    }
+
+private:
+    Uring() = default;
+
+    void Enqueue(Op* const* ops, size_t count, std::unique_lock<std::mutex>& lock) {
+        unsigned tail = *m_sqTail;
+        for (size_t i = 0; i < count; ++i) {
+            const unsigned index = tail & m_sqMask;
+            io_uring_sqe& sqe = m_sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            Prepare(sqe, ops[i]);
+            if (i + 1 < count && ops[i] && ops[i + 1] && ops[i + 1]->chain == ops[i]->chain) {
+                sqe.flags |= IOSQE_IO_LINK;
+            }
+            m_sqArray[index] = index;
+            ++tail;
+        }
+        __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+        m_inFlight += count;
+
+        // Every enter drains the submission ring, so all of it goes in together
+        size_t remaining = count;
+        while (remaining > 0) {
+            const int entered = Enter(static_cast<unsigned>(remaining), 0, 0);
+            if (entered > 0) remaining -= static_cast<size_t>(entered);
+            else if (entered == 0 || errno == EINTR || errno == EAGAIN || errno == EBUSY) std::this_thread::yield();
+            else break;
+        }
+        if (remaining > 0) {
+            // Take back what the kernel didn't consume and fail it here
+            const std::error_code ec = LastError();
+            __atomic_store_n(m_sqTail, tail - static_cast<unsigned>(remaining), __ATOMIC_RELEASE);
+            m_inFlight -= remaining;
+            lock.unlock();
+            for (size_t i = count - remaining; i < count; ++i) {
+                if (ops[i]) Complete(ops[i], -(ec.value() ? ec.value() : EIO));
+            }
+            lock.lock();
+        }
+    }
+
+    static std::unique_ptr<Uring> Create() noexcept {
+        try {
+            std::unique_ptr<Uring> ring(new Uring());
+            if (!ring->Setup()) return nullptr;
+            ring->m_reaper = std::thread([raw = ring.get()] { raw->Reap(); });
+            CJ_LOG_DEBUG("AsyncIo", "File I/O through io_uring (" << ring->m_sqEntries << " entries)");
+            return ring;
+        } catch (const std::exception& e) {
+            CJ_LOG_WARN("AsyncIo", "io_uring unavailable: " << e.what());
+            return nullptr;
+        }
+    }
+
+    int Enter(unsigned submit, unsigned wait, unsigned flags) noexcept {
+        return static_cast<int>(syscall(__NR_io_uring_enter, m_fd, submit, wait, flags, nullptr, 0));
+    }
+
+    bool Setup() {
+        io_uring_params params{};
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        if (m_fd < 0) {
+            CJ_LOG_DEBUG("AsyncIo", "io_uring_setup failed: " << LastError().message());
+            return false;
+        }
+        if (!(params.features & IORING_FEAT_NODROP) || !Supported()) {
+            CJ_LOG_DEBUG("AsyncIo", "io_uring lacks a required feature; using the thread pool");
+            return false;
+        }
+
+        m_sqEntries = params.sq_entries;
+        m_cqEntries = params.cq_entries;
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+        m_sqRing = Map(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = single ? m_sqRing : Map(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(Map(m_sqesSize, IORING_OFF_SQES));
+        if (!m_sqRing || !m_cqRing || !m_sqes) return false;
+
+        char* sq = static_cast<char*>(m_sqRing);
+        char* cq = static_cast<char*>(m_cqRing);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void* Map(size_t size, off_t offset) noexcept {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    bool Supported() noexcept {
+        constexpr unsigned OPS = 256;
+        alignas(io_uring_probe) unsigned char buffer[sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op)] = {};
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer);
+        if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, OPS) < 0) return false;
+        for (unsigned op : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_RENAMEAT }) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    static void Prepare(io_uring_sqe& sqe, Op* op) noexcept {
+        sqe.user_data = reinterpret_cast<uint64_t>(op);
+        if (!op) {
+            sqe.opcode = IORING_OP_NOP;
+            return;
+        }
+        switch (op->type) {
+            case Op::Type::Read:
+            case Op::Type::Write:
+                sqe.opcode = op->type == Op::Type::Read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe.fd = op->handle;
+                sqe.addr = reinterpret_cast<uint64_t>(op->buffer);
+                sqe.len = static_cast<uint32_t>(op->size);
+                sqe.off = op->offset;
+                break;
+            case Op::Type::Sync:
+                sqe.opcode = IORING_OP_FSYNC;
+                sqe.fd = op->handle;
+                break;
+            case Op::Type::Rename:
+                sqe.opcode = IORING_OP_RENAMEAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(op->from.c_str());
+                sqe.len = static_cast<uint32_t>(AT_FDCWD);
+                sqe.off = reinterpret_cast<uint64_t>(op->to.c_str());   // addr2
+                break;
+        }
+    }
+
+    // Runs on the reaper (or a submitter that failed to enter)
+    static void Complete(Op* op, int result) noexcept {
+        if (result < 0) {
+            op->error = std::error_code(-result, std::generic_category());
+        } else if (op->type == Op::Type::Read || op->type == Op::Type::Write) {
+            op->transferred = static_cast<size_t>(result);  // Short ones are finished by Wait()
+        }
+        IoBatch::State& state = *op->state;
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (--state.inFlight == 0) state.completed.notify_all();   // Under the lock: the batch may go away after
+    }
+
+    void Reap() {
+        bool stopping = false;
+        while (!stopping) {
+            if (Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                CJ_LOG_ERROR("AsyncIo", "io_uring_enter failed: " << LastError().message());
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            unsigned head = *m_cqHead;
+            const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+            size_t reaped = 0;
+            for (; head != tail; ++head, ++reaped) {
+                const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+                if (cqe.user_data == 0) stopping = true;
+                else Complete(reinterpret_cast<Op*>(cqe.user_data), cqe.res);
+            }
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+            if (reaped > 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_inFlight -= reaped;
+                m_space.notify_all();
+            }
+        }
+    }
+
+    static constexpr unsigned RING_ENTRIES = 256;
+
+    int m_fd = -1;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0, m_cqRingSize = 0, m_sqesSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0, m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+    unsigned m_cqMask = 0, m_cqEntries = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_space;
+    size_t m_inFlight = 0;   // Guarded by m_mutex; kept within the completion ring
+    std::thread m_reaper;
+};
+#endif
+
+IoBatch::Backend DefaultBackend() noexcept {
+#ifdef CJ_IO_URING
+    if (Uring::Get()) return IoBatch::Backend::IoUring;
+#endif
+    return IoBatch::Backend::Pool;
+}
+
+std::atomic<int> g_backend{-1};   // Backend, or -1 until first use
+
+} // anonymous namespace
+
+// ----- Backend Selection -----
+IoBatch::Backend IoBatch::ActiveBackend() noexcept {
+    int backend = g_backend.load(std::memory_order_acquire);
+    if (backend < 0) {
+        backend = static_cast<int>(DefaultBackend());
+        int expected = -1;
+        if (!g_backend.compare_exchange_strong(expected, backend, std::memory_order_acq_rel)) backend = expected;
+    }
+    return static_cast<Backend>(backend);
+}
+
+IoBatch::Backend IoBatch::ForceBackend(Backend backend) noexcept {
+    if (backend == Backend::IoUring) backend = DefaultBackend();
+    g_backend.store(static_cast<int>(backend), std::memory_order_release);
+    return backend;
+}
+
+const char* IoBatch::BackendName(Backend backend) noexcept {
+    switch (backend) {
+        case Backend::Pool:    return "pool";
+        case Backend::IoUring: return "io_uring";
+        default:               return "unknown";
+    }
+}
+
+// ----- Queueing -----
+IoBatch::IoBatch() : m_state(std::make_unique<State>()) {
+    m_state->backend = ActiveBackend();
+}
+
+IoBatch::~IoBatch() {
+    try {
+        Wait();
+    } catch (const std::exception&) {
+    }
+}
+
+void IoBatch::Chain() {
+    ++m_state->chain;
+}
+
+void IoBatch::Read(const fs::path& path, std::string& out) {
+    State::FileEntry entry;
+    entry.path = path;
+    uint64_t size = 0;
+    entry.handle = OpenRead(path, size, entry.error);
+    out.clear();
+    if (!entry.error) {
+        try {
+            out.resize(static_cast<size_t>(size));
+        } catch (const std::exception&) {
+            entry.error = std::make_error_code(std::errc::not_enough_memory);
+        }
+    }
+    const File file = m_state->files.size();
+    m_state->files.push_back(std::move(entry));
+
+    for (size_t offset = 0; offset < out.size() || offset == 0; offset += MAX_TRANSFER) {
+        Op& op = m_state->Add(Op::Type::Read);
+        op.file = file;
+        op.buffer = out.data() + offset;
+        op.size = std::min(MAX_TRANSFER, out.size() - offset);
+        op.offset = offset;
+        op.handle = m_state->files[file].handle;
+        op.error = m_state->files[file].error;
+        if (out.size() - offset <= MAX_TRANSFER) break;
+    }
+}
+
+void IoBatch::Read(const fs::path& path, void* buffer, size_t size) {
+    State::FileEntry entry;
+    entry.path = path;
+    uint64_t actual = 0;
+    entry.handle = OpenRead(path, actual, entry.error);
+    if (!entry.error && actual != size) entry.error = std::make_error_code(std::errc::invalid_argument);
+    const File file = m_state->files.size();
+    m_state->files.push_back(std::move(entry));
+
+    char* bytes = static_cast<char*>(buffer);
+    for (size_t offset = 0; offset < size || offset == 0; offset += MAX_TRANSFER) {
+        Op& op = m_state->Add(Op::Type::Read);
+        op.file = file;
+        op.buffer = bytes + offset;
+        op.size = std::min(MAX_TRANSFER, size - offset);
+        op.offset = offset;
+        op.handle = m_state->files[file].handle;
+        op.error = m_state->files[file].error;
+        if (size - offset <= MAX_TRANSFER) break;
+    }
+}
+
+IoBatch::File IoBatch::Create(const fs::path& path) {
+    State::FileEntry entry;
+    entry.path = path;
+    entry.handle = OpenWrite(path, entry.error);
+    m_state->files.push_back(std::move(entry));
+    return m_state->files.size() - 1;
+}
+
+void IoBatch::Write(File file, uint64_t offset, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    for (size_t done = 0; done < size || done == 0; done += MAX_TRANSFER) {
+        Op& op = m_state->Add(Op::Type::Write);
+        op.file = file;
+        op.buffer = const_cast<char*>(bytes + done);   // Only ever written from
+        op.size = std::min(MAX_TRANSFER, size - done);
+        op.offset = offset + done;
+        op.handle = m_state->files[file].handle;
+        op.error = m_state->files[file].error;
+        if (size - done <= MAX_TRANSFER) break;
+    }
+}
+
+void IoBatch::Sync(File file) {
+    Op& op = m_state->Add(Op::Type::Sync);
+    op.file = file;
+    op.handle = m_state->files[file].handle;
+    op.error = m_state->files[file].error;
+}
+
+void IoBatch::Rename(const fs::path& from, const fs::path& to) {
+    Op& op = m_state->Add(Op::Type::Rename);
+    op.from = from;
+    op.to = to;
+}
+
+void IoBatch::WriteAtomically(const fs::path& path, const void* data, size_t size, bool sync) {
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    Chain();
+    const File file = Create(tempPath);
+    Write(file, 0, data, size);
+    if (sync) Sync(file);
+    Rename(tempPath, path);
+    m_state->temporaries.emplace_back(m_state->chain, std::move(tempPath));
+    Chain();
+}
+
+// ----- Submission -----
+void IoBatch::Submit() {
+    State& state = *m_state;
+    std::deque<Op>& ops = state.ops;
+    size_t first = state.submitted;
+    state.submitted = ops.size();
+    Chain();   // A chain never spans two submissions
+
+#ifdef CJ_IO_URING
+    Uring* ring = state.backend == Backend::IoUring ? Uring::Get() : nullptr;
+    std::vector<Op*> linked;   // Chains for the ring, in one go
+#endif
+    while (first < ops.size()) {
+        size_t last = first + 1;
+        while (last < ops.size() && ops[last].chain == ops[first].chain) ++last;
+
+        std::vector<Op*> chain;
+        chain.reserve(last - first);
+        bool openFailed = false;
+        for (size_t i = first; i < last; ++i) {
+            chain.push_back(&ops[i]);
+            openFailed = openFailed || static_cast<bool>(ops[i].error);
+        }
+        first = last;
+#ifdef CJ_IO_URING
+        if (ring && !openFailed && chain.size() <= ring->MaxChain()) {
+            linked.insert(linked.end(), chain.begin(), chain.end());
+            continue;
+        }
+#endif
+        // A failed open cancels its chain in the task, like a failed link would
+        state.tasks.push_back(IoPool().Submit([chain = std::move(chain)] {
+            bool failed = false;
+            for (Op* op : chain) {
+                if (failed) op->error = std::make_error_code(std::errc::operation_canceled);
+                else if (!op->error) RunOp(*op);
+                failed = failed || static_cast<bool>(op->error);
+            }
+        }));
+    }
+#ifdef CJ_IO_URING
+    if (!linked.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.inFlight += linked.size();
+        }
+        ring->Push(linked.data(), linked.size());
+    }
+#endif
+}
+
+bool IoBatch::Wait() {
+    State& state = *m_state;
+    Submit();
+    for (std::future<void>& task : state.tasks) IoPool().Await(task);
+    state.tasks.clear();
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.completed.wait(lock, [&] { return state.inFlight == 0; });
+    }
+
+    // io_uring may complete a transfer short, which also cancels the rest of
+    // its chain; those are finished here
+    size_t failures = 0;
+    std::vector<size_t> failedChains;
+    for (size_t i = 0; i < state.ops.size(); ++i) {
+        Op& op = state.ops[i];
+        const bool chainStart = i == 0 || state.ops[i - 1].chain != op.chain;
+        const bool previousOk = !chainStart && !state.ops[i - 1].error;
+        if (op.error == std::errc::operation_canceled && previousOk) {
+            op.error.clear();
+            op.transferred = 0;
+            RunOp(op);
+        } else if (!op.error && op.transferred < op.size) {
+            RunOp(op);
+        } else if (!op.error && !chainStart && state.ops[i - 1].error) {
+            op.error = std::make_error_code(std::errc::operation_canceled);
+        }
+
+        if (op.error) {
+            ++failures;
+            if (failedChains.empty() || failedChains.back() != op.chain) failedChains.push_back(op.chain);
+            if (state.error.empty() && op.error != std::errc::operation_canceled) {
+                const fs::path& path = op.type == Op::Type::Rename ? op.from : state.files[op.file].path;
+                state.error = std::string(OpName(op.type)) + " " + path.u8string() + ": " + op.error.message();
+            }
+        } else {
+            state.bytes += op.transferred;
+        }
+    }
+
+    for (State::FileEntry& entry : state.files) {
+        if (entry.handle != NO_HANDLE) CloseFile(entry.handle);
+        entry.handle = NO_HANDLE;
+    }
+    for (const auto& [chain, path] : state.temporaries) {
+        if (std::binary_search(failedChains.begin(), failedChains.end(), chain)) {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    }
+
+    const bool ok = failures == 0;
+    state.ops.clear();
+    state.files.clear();
+    state.temporaries.clear();
+    state.submitted = 0;
+    return ok;
+}
+
+size_t IoBatch::GetOperations() const noexcept {
+    return m_state->ops.size();
+}
+
+uint64_t IoBatch::GetBytes() const noexcept {
+    return m_state->bytes;
+}
+
+const std::string& IoBatch::GetError() const noexcept {
+    return m_state->error;
+}
+
+} // namespace utils
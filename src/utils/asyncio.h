@@ -0,0 +1,76 @@
+// asyncio.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Batched asynchronous file I/O: operations are queued, started by Submit()
+// and collected by Wait(), and the caller computes in between.
+//
+// Operations queued between two Chain() calls form a chain. They run in
+// order, each only if the one before it succeeded (a write, its fsync, the
+// rename that publishes it); chains run concurrently with each other, so
+// writes to different offsets of one file each get a chain of their own.
+//
+// On Linux the batch goes to io_uring, one linked SQE chain per chain, when
+// the kernel supports every opcode used (5.11). Elsewhere each chain runs as
+// one task on a small I/O thread pool. Either way, files are opened and reads
+// sized on the calling thread as operations are queued.
+class IoBatch {
+public:
+    enum class Backend { Pool, IoUring };
+
+    static Backend ActiveBackend() noexcept;
+    // Switches to `backend` if it is available (benchmarks and cross-checks).
+    // Returns the backend actually selected.
+    static Backend ForceBackend(Backend backend) noexcept;
+    static const char* BackendName(Backend backend) noexcept;
+
+    using File = size_t;
+
+    IoBatch();
+    ~IoBatch();  // Waits for anything still in flight
+    IoBatch(const IoBatch&) = delete;
+    IoBatch& operator=(const IoBatch&) = delete;
+
+    void Chain();
+
+    // Buffers must stay valid and untouched until Wait() returns.
+    // The whole file into `out`, sized when queued.
+    void Read(const fs::path& path, std::string& out);
+    // Exactly `size` bytes; a file of any other size fails
+    void Read(const fs::path& path, void* buffer, size_t size);
+
+    // Creates or truncates `path` for the writes and syncs below
+    File Create(const fs::path& path);
+    void Write(File file, uint64_t offset, const void* data, size_t size);
+    void Sync(File file);
+    // Replaces `to` if it exists (keeping its security descriptor on Windows)
+    void Rename(const fs::path& from, const fs::path& to);
+
+    // A chain of its own: "<path>.tmp" is written (and synced), then renamed
+    // over `path`. The temporary file is removed if the chain fails.
+    void WriteAtomically(const fs::path& path, const void* data, size_t size, bool sync = false);
+
+    void Submit();  // Starts what was queued since the last Submit()
+    bool Wait();    // Submits the rest and waits; true if every operation succeeded
+
+    size_t GetOperations() const noexcept;
+    uint64_t GetBytes() const noexcept;                      // Read and written
+    const std::string& GetError() const noexcept;            // First failure, for the log
+
+    struct Op;
+    struct State;
+
+private:
+    std::unique_ptr<State> m_state;
+};
+
+} // namespace utils
@@ -0,0 +1,81 @@
+// builtinlists.cpp
+#include "builtinlists.h"
+
+namespace BuiltinLists {
+    namespace data {
+        struct Category {
+            const char* name;
+            uint32_t domainCount;
+        };
+
+        struct Entry {
+            const char* name;
+            uint32_t length;
+            uint32_t categories;
+        };
+
+#include "builtinlists_data.inc"
+
+        static_assert(CATEGORY_COUNT <= MAX_CATEGORIES, "listgen emitted too many categories");
+
+        // Divisor for the slot hash; never zero, even with no lists configured
+        constexpr size_t SLOT_COUNT = ENTRY_COUNT ? ENTRY_COUNT : 1;
+    }
+
+    namespace {
+        bool EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+            if (a.size() != b.size()) return false;
+            for (size_t i = 0; i < a.size(); ++i) {
+                char c = a[i];
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+                if (c != b[i]) return false;  // Built-in names are stored lowercase
+            }
+            return true;
+        }
+    }
+
+    // ----- Categories -----
+    size_t CategoryCount() noexcept {
+        return data::CATEGORY_COUNT;
+    }
+
+    std::string_view CategoryName(size_t index) noexcept {
+        return index < data::CATEGORY_COUNT ? data::CATEGORIES[index].name : std::string_view();
+    }
+
+    size_t CategoryDomainCount(size_t index) noexcept {
+        return index < data::CATEGORY_COUNT ? data::CATEGORIES[index].domainCount : 0;
+    }
+
+    uint32_t CategoryMask(std::string_view name) noexcept {
+        for (size_t i = 0; i < data::CATEGORY_COUNT; ++i) {
+            if (EqualsIgnoreCase(name, data::CATEGORIES[i].name)) return uint32_t{1} << i;
+        }
+        return 0;
+    }
+
+    // ----- Domains -----
+    size_t EntryCount() noexcept {
+        return data::ENTRY_COUNT;
+    }
+
+    std::string_view EntryName(size_t index) noexcept {
+        if (index >= data::ENTRY_COUNT) return {};
+        return std::string_view(data::ENTRIES[index].name, data::ENTRIES[index].length);
+    }
+
+    uint32_t EntryCategories(size_t index) noexcept {
+        return index < data::ENTRY_COUNT ? data::ENTRIES[index].categories : 0;
+    }
+
+    uint32_t Lookup(std::string_view domain) noexcept {
+        if (data::ENTRY_COUNT == 0) return 0;
+
+        const uint64_t key = KeyHash(domain);
+        const uint32_t seed = data::BUCKET_SEEDS[Mix(key, 0) % data::BUCKET_COUNT];
+        const data::Entry& entry = data::ENTRIES[data::SLOTS[Mix(key, seed) % data::SLOT_COUNT]];
+
+        if (!domain.empty() && domain.back() == '.') domain.remove_suffix(1);
+        return EqualsIgnoreCase(domain, std::string_view(entry.name, entry.length)) ? entry.categories : 0;
+    }
+} // namespace BuiltinLists
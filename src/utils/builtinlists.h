@@ -0,0 +1,57 @@
+// builtinlists.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Blocklist categories compiled into the executable. The build runs listgen
+// over the lists named in CJ_BUILTIN_LISTS (CMake) and emits constant tables:
+// every domain once, sorted, tagged with a bitmask of its categories, plus a
+// minimal perfect hash over them. Everything is constant-initialized, so
+// enabling a category costs no I/O, parsing or allocation.
+namespace BuiltinLists {
+    constexpr size_t MAX_CATEGORIES = 32;
+
+    // ----- Categories -----
+    size_t CategoryCount() noexcept;
+    std::string_view CategoryName(size_t index) noexcept;
+    size_t CategoryDomainCount(size_t index) noexcept;
+
+    // Bit for a category name (case-insensitive), or 0 if no such category
+    uint32_t CategoryMask(std::string_view name) noexcept;
+
+    // ----- Domains -----
+    // Sorted and unique across all categories
+    size_t EntryCount() noexcept;
+    std::string_view EntryName(size_t index) noexcept;
+    uint32_t EntryCategories(size_t index) noexcept;
+
+    // Categories containing `domain` (case-insensitive, trailing dot ignored);
+    // 0 if it is not built in. One hash, two table reads, one compare.
+    uint32_t Lookup(std::string_view domain) noexcept;
+
+    // ----- Hashing -----
+    // Shared with listgen; the generated tables are only valid for exactly this function.
+    inline uint64_t KeyHash(std::string_view domain) noexcept {
+        if (!domain.empty() && domain.back() == '.') domain.remove_suffix(1);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (char c : domain) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (byte >= 'A' && byte <= 'Z') byte = static_cast<unsigned char>(byte - 'A' + 'a');
+            hash ^= byte;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    inline uint64_t Mix(uint64_t key, uint64_t seed) noexcept {
+        uint64_t h = key + seed * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+} // namespace BuiltinLists
@@ -0,0 +1,418 @@
+// catalog.cpp
+#include "catalog.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CJ_CATALOG_SSE2 1
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace utils {
+
+namespace {
+
+// ----- On-disk Format -----
+constexpr char CATALOG_MAGIC[4] = { 'C', 'J', 'C', 'T' };
+constexpr uint32_t CATALOG_VERSION = 1;
+constexpr size_t NAME_FIELD = DomainCatalog::MAX_CATEGORY_NAME + 1;  // NUL-padded
+constexpr size_t MIN_SLOTS = 1024;
+constexpr size_t PREFETCH_DISTANCE = 16;
+
+inline unsigned CountTrailingZeros(uint32_t mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+inline void Prefetch(const void* address) noexcept {
+#if CJ_CATALOG_SSE2
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+inline unsigned PopCount4(uint32_t bits) noexcept {
+    return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+}
+
+// Eight bytes per multiply; names are already lowercased by the importer
+uint64_t HashName(std::string_view name) noexcept {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ name.size();
+    size_t i = 0;
+    for (; i + 8 <= name.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, name.data() + i, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, name.data() + i, name.size() - i);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 29;
+    hash *= 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+std::string NormalizeCategory(std::string_view name) {
+    std::string normalized(name);
+    for (char& c : normalized) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return normalized;
+}
+
+// Calls visit(row) for each row whose mask shares a bit with `mask`
+template <typename Visit>
+void ScanMasks(const uint32_t* masks, size_t count, uint32_t mask, Visit&& visit) {
+    size_t i = 0;
+#if CJ_CATALOG_SSE2
+    const __m128i want = _mm_set1_epi32(static_cast<int>(mask));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+        const __m128i none = _mm_cmpeq_epi32(_mm_and_si128(block, want), zero);
+        uint32_t hits = ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(none))) & 0xF;
+        while (hits) {
+            visit(i + CountTrailingZeros(hits));
+            hits &= hits - 1;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (masks[i] & mask) visit(i);
+    }
+}
+
+} // anonymous namespace
+
+// ----- Categories -----
+uint32_t DomainCatalog::AddCategory(std::string_view name) {
+    if (const uint32_t existing = CategoryMask(name)) return existing;
+    if (name.empty() || name.size() > MAX_CATEGORY_NAME) {
+        CJ_LOG_ERROR("Catalog", "Invalid category name \"" << name << "\"");
+        return 0;
+    }
+    if (m_categories.size() >= MAX_CATEGORIES) {
+        CJ_LOG_ERROR("Catalog", "No room for category \"" << name << "\"; all " << MAX_CATEGORIES << " are in use");
+        return 0;
+    }
+    m_categories.push_back(NormalizeCategory(name));
+    return 1u << (m_categories.size() - 1);
+}
+
+uint32_t DomainCatalog::CategoryMask(std::string_view name) const noexcept {
+    for (size_t i = 0; i < m_categories.size(); ++i) {
+        const std::string& category = m_categories[i];
+        if (category.size() != name.size()) continue;
+        bool same = true;
+        for (size_t j = 0; same && j < name.size(); ++j) {
+            char c = name[j];
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            same = c == category[j];
+        }
+        if (same) return 1u << i;
+    }
+    return 0;
+}
+
+uint32_t DomainCatalog::AllCategories() const noexcept {
+    return m_categories.size() >= MAX_CATEGORIES ? ~0u : (1u << m_categories.size()) - 1;
+}
+
+// ----- Building -----
+// The tag keeps probes away from the arena until a hash actually matches
+size_t DomainCatalog::FindSlot(std::string_view domain, uint64_t hash) const noexcept {
+    const size_t mask = m_slots.size() - 1;
+    const uint64_t tag = hash & 0xFFFFFFFF00000000ULL;
+    size_t slot = static_cast<size_t>(hash) & mask;
+    for (uint64_t entry; (entry = m_slots[slot]) != 0; slot = (slot + 1) & mask) {
+        if ((entry & 0xFFFFFFFF00000000ULL) == tag && m_domains[static_cast<uint32_t>(entry) - 1] == domain) break;
+    }
+    return slot;
+}
+
+// Sizes the index for `rows` at no more than half full and inserts every row
+void DomainCatalog::Reindex(size_t rows) const {
+    size_t capacity = MIN_SLOTS;
+    while (capacity < rows * 2) capacity *= 2;
+    m_slots.assign(capacity, 0);
+    const size_t mask = capacity - 1;
+    const size_t count = m_masks.size();
+    uint64_t hashes[PREFETCH_DISTANCE];
+    for (size_t row = 0; row < count && row < PREFETCH_DISTANCE; ++row) {
+        hashes[row] = HashName(m_domains[row]);
+        Prefetch(&m_slots[static_cast<size_t>(hashes[row]) & mask]);
+    }
+    for (size_t row = 0; row < count; ++row) {
+        const uint64_t hash = hashes[row % PREFETCH_DISTANCE];
+        if (row + PREFETCH_DISTANCE < count) {
+            const uint64_t ahead = HashName(m_domains[row + PREFETCH_DISTANCE]);
+            hashes[row % PREFETCH_DISTANCE] = ahead;
+            Prefetch(&m_slots[static_cast<size_t>(ahead) & mask]);
+        }
+        size_t slot = static_cast<size_t>(hash) & mask;
+        while (m_slots[slot] != 0) slot = (slot + 1) & mask;  // Rows are unique; no compare needed
+        m_slots[slot] = (hash & 0xFFFFFFFF00000000ULL) | (row + 1);
+    }
+}
+
+bool DomainCatalog::AddDomains(std::string_view category, const DomainPool& domains) {
+    Trace::Span span("DomainCatalog::AddDomains");
+    span.Arg("domains", domains.size());
+    const uint32_t bit = AddCategory(category);
+    if (!bit) return false;
+
+    if (m_slots.size() < (m_masks.size() + domains.size()) * 2) Reindex(m_masks.size() + domains.size());
+    // Hashes run PREFETCH_DISTANCE names ahead so their slots are in cache by the time they are probed
+    uint64_t hashes[PREFETCH_DISTANCE];
+    const size_t count = domains.size();
+    for (size_t i = 0; i < count && i < PREFETCH_DISTANCE; ++i) {
+        hashes[i] = HashName(domains[i]);
+        Prefetch(&m_slots[static_cast<size_t>(hashes[i]) & (m_slots.size() - 1)]);
+    }
+    size_t added = 0;
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            const std::string_view domain = domains[i];
+            const uint64_t hash = hashes[i % PREFETCH_DISTANCE];
+            if (i + PREFETCH_DISTANCE < count) {
+                const uint64_t ahead = HashName(domains[i + PREFETCH_DISTANCE]);
+                hashes[i % PREFETCH_DISTANCE] = ahead;
+                Prefetch(&m_slots[static_cast<size_t>(ahead) & (m_slots.size() - 1)]);
+            }
+            const size_t slot = FindSlot(domain, hash);
+            if (m_slots[slot] != 0) {
+                m_masks[static_cast<uint32_t>(m_slots[slot]) - 1] |= bit;
+                continue;
+            }
+            m_domains.Add(domain);
+            m_masks.push_back(bit);
+            m_slots[slot] = (hash & 0xFFFFFFFF00000000ULL) | m_masks.size();
+            ++added;
+        }
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Catalog", "Adding to \"" << category << "\" failed: " << e.what());
+        Clear();
+        return false;
+    }
+    span.Arg("added", added);
+    CJ_LOG_DEBUG("Catalog", "\"" << category << "\": " << domains.size() << " domain(s), " << added
+                 << " new; " << m_masks.size() << " row(s) in total");
+    return true;
+}
+
+bool DomainCatalog::ImportFile(std::string_view category, const fs::path& path,
+                               const ListImporter::Options& options, ListImporter::Stats* stats) {
+    DomainPool domains;
+    ListImporter::Stats imported;
+    if (!ListImporter::ImportFile(path, options, domains, &imported)) {
+        CJ_LOG_ERROR("Catalog", "Failed to import " << path << " into \"" << category << "\"");
+        return false;
+    }
+    if (stats) *stats = imported;
+    return AddDomains(category, domains);
+}
+
+void DomainCatalog::ClearCategory(std::string_view category) noexcept {
+    const uint32_t keep = ~CategoryMask(category);
+    for (uint32_t& mask : m_masks) mask &= keep;
+}
+
+void DomainCatalog::Compact() {
+    Trace::Span span("DomainCatalog::Compact");
+    std::vector<uint32_t> rows;
+    Select(AllCategories(), rows);
+    if (rows.size() == m_masks.size()) return;
+
+    DomainPool domains;
+    std::vector<uint32_t> masks;
+    size_t bytes = 0;
+    for (const uint32_t row : rows) bytes += m_domains[row].size();
+    domains.Reserve(rows.size(), bytes);
+    masks.reserve(rows.size());
+    for (const uint32_t row : rows) {
+        domains.Add(m_domains[row]);
+        masks.push_back(m_masks[row]);
+    }
+    span.Arg("dropped", m_masks.size() - rows.size());
+    m_domains = std::move(domains);
+    m_masks = std::move(masks);
+    m_slots.clear();
+}
+
+void DomainCatalog::Clear() noexcept {
+    m_domains.Clear();
+    m_masks.clear();
+    m_categories.clear();
+    m_slots.clear();
+}
+
+// ----- Selection -----
+size_t DomainCatalog::Count(uint32_t mask) const noexcept {
+    size_t count = 0;
+    size_t i = 0;
+    const uint32_t* masks = m_masks.data();
+#if CJ_CATALOG_SSE2
+    const __m128i want = _mm_set1_epi32(static_cast<int>(mask));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= m_masks.size(); i += 4) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+        const __m128i none = _mm_cmpeq_epi32(_mm_and_si128(block, want), zero);
+        count += 4 - PopCount4(static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(none))));
+    }
+#endif
+    for (; i < m_masks.size(); ++i) count += (masks[i] & mask) != 0;
+    return count;
+}
+
+void DomainCatalog::Select(uint32_t mask, std::vector<uint32_t>& rows) const {
+    rows.clear();
+    rows.reserve(Count(mask));
+    ScanMasks(m_masks.data(), m_masks.size(), mask, [&rows](size_t row) {
+        rows.push_back(static_cast<uint32_t>(row));
+    });
+}
+
+void DomainCatalog::Select(uint32_t mask, DomainPool& out) const {
+    Trace::Span span("DomainCatalog::Select");
+    std::vector<uint32_t> rows;
+    Select(mask, rows);
+    size_t bytes = 0;
+    for (const uint32_t row : rows) bytes += m_domains.GetIndex()[row].length;
+
+    out.Clear();
+    out.Reserve(rows.size(), bytes);
+    for (const uint32_t row : rows) out.Add(m_domains[row]);
+    span.Arg("mask", mask).Arg("domains", rows.size());
+}
+
+uint32_t DomainCatalog::Lookup(std::string_view domain) const {
+    if (m_masks.empty()) return 0;
+    if (m_slots.empty()) Reindex(m_masks.size());
+    const uint32_t row = static_cast<uint32_t>(m_slots[FindSlot(domain, HashName(domain))]);
+    return row ? m_masks[row - 1] : 0;
+}
+
+// ----- Persistence -----
+bool DomainCatalog::Save(const fs::path& path) const noexcept {
+    Header header{};
+    std::memcpy(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    header.version = CATALOG_VERSION;
+    header.categoryCount = static_cast<uint32_t>(m_categories.size());
+    header.rows = m_masks.size();
+    header.arenaBytes = m_domains.ArenaBytes();
+
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    try {
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        {
+            std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+            if (!ofs) return false;
+            ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            for (const std::string& category : m_categories) {
+                char field[NAME_FIELD] = {};
+                std::memcpy(field, category.data(), category.size());
+                ofs.write(field, sizeof(field));
+            }
+            ofs.write(reinterpret_cast<const char*>(m_masks.data()),
+                      static_cast<std::streamsize>(m_masks.size() * sizeof(uint32_t)));
+            ofs.write(reinterpret_cast<const char*>(m_domains.GetIndex().data()),
+                      static_cast<std::streamsize>(m_masks.size() * sizeof(DomainPool::Entry)));
+            ofs.write(m_domains.GetArena().data(), static_cast<std::streamsize>(m_domains.ArenaBytes()));
+        }
+        fs::rename(tempPath, path);
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Catalog", "Save failed: " << e.what());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+}
+
+bool DomainCatalog::Load(const fs::path& path) {
+    Trace::Span span("DomainCatalog::Load");
+    try {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) return false;
+
+        Header header{};
+        if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 ||
+            header.version != CATALOG_VERSION || header.categoryCount > MAX_CATEGORIES ||
+            header.rows > UINT32_MAX || header.arenaBytes > UINT32_MAX) {
+            CJ_LOG_WARN("Catalog", "Ignoring " << path << ": not a catalog this version can read");
+            return false;
+        }
+        std::error_code ec;
+        const uint64_t expected = sizeof(header) + header.categoryCount * NAME_FIELD +
+            header.rows * (sizeof(uint32_t) + sizeof(DomainPool::Entry)) + header.arenaBytes;
+        if (fs::file_size(path, ec) != expected || ec) {
+            CJ_LOG_WARN("Catalog", "Ignoring " << path << ": truncated or oversized");
+            return false;
+        }
+
+        std::vector<std::string> categories;
+        for (uint32_t i = 0; i < header.categoryCount; ++i) {
+            char field[NAME_FIELD];
+            ifs.read(field, sizeof(field));
+            const size_t length = strnlen(field, sizeof(field));
+            if (length == 0 || length > MAX_CATEGORY_NAME) return false;
+            categories.emplace_back(field, length);
+        }
+        const size_t rows = static_cast<size_t>(header.rows);
+        std::vector<uint32_t> masks(rows);
+        std::vector<DomainPool::Entry> index(rows);
+        std::string arena(static_cast<size_t>(header.arenaBytes), '\0');
+        ifs.read(reinterpret_cast<char*>(masks.data()), static_cast<std::streamsize>(rows * sizeof(uint32_t)));
+        ifs.read(reinterpret_cast<char*>(index.data()),
+                 static_cast<std::streamsize>(rows * sizeof(DomainPool::Entry)));
+        ifs.read(arena.data(), static_cast<std::streamsize>(arena.size()));
+        if (!ifs) return false;
+
+        bool inBounds = true;
+        for (const DomainPool::Entry& entry : index) {
+            inBounds &= static_cast<uint64_t>(entry.offset) + entry.length <= arena.size();
+        }
+        if (!inBounds) {
+            CJ_LOG_WARN("Catalog", "Ignoring " << path << ": entry out of bounds");
+            return false;
+        }
+
+        m_categories = std::move(categories);
+        const uint32_t known = AllCategories();
+        for (uint32_t& mask : masks) mask &= known;
+        m_masks = std::move(masks);
+        m_domains = DomainPool(std::move(arena), std::move(index));
+        m_slots.clear();
+        span.Arg("rows", rows);
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Catalog", "Load failed: " << e.what());
+        return false;
+    }
+}
+
+size_t DomainCatalog::MemoryUsage() const noexcept {
+    return m_domains.MemoryUsage() + m_masks.capacity() * sizeof(uint32_t) + m_slots.capacity() * sizeof(uint64_t);
+}
+
+} // namespace utils
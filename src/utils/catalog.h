@@ -0,0 +1,97 @@
+// catalog.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "domainpool.h"
+#include "importer.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Category-tagged blocklists in columnar form: one deduplicated domain column
+// (a DomainPool) and a parallel column holding a bitmask of each domain's
+// categories. Lists are parsed once, when they are added. Switching the
+// enforced categories is then one pass over the mask column, comparing four
+// masks per SSE2 instruction, that copies the matching names into a pool for
+// the renderer; nothing is parsed and nothing is allocated per domain.
+//
+// The on-disk form is a fixed header followed by the category names, the mask
+// column, the entry column and the character arena, each a flat array, so
+// Load() is five reads and a bounds check. The hash index used to deduplicate
+// is not stored; it is rebuilt the first time a list is added after a load.
+class DomainCatalog {
+public:
+    static constexpr const char* FILENAME = "catalog.bin";
+    static constexpr size_t MAX_CATEGORIES = 32;
+    static constexpr size_t MAX_CATEGORY_NAME = 31;
+
+    // ----- Categories -----
+    // Bit for `name` (case-insensitive), adding the category if it is new.
+    // 0 if the name is empty or too long, or all 32 bits are taken.
+    uint32_t AddCategory(std::string_view name);
+    uint32_t CategoryMask(std::string_view name) const noexcept;  // 0 if unknown
+    size_t CategoryCount() const noexcept { return m_categories.size(); }
+    std::string_view CategoryName(size_t index) const noexcept { return m_categories[index]; }
+    uint32_t AllCategories() const noexcept;
+
+    // ----- Building -----
+    // Tags each domain with `category`; unseen domains get a new row
+    bool AddDomains(std::string_view category, const DomainPool& domains);
+    bool ImportFile(std::string_view category, const fs::path& path, const ListImporter::Options& options,
+                    ListImporter::Stats* stats = nullptr);
+
+    // Clears the category's bit on every row, e.g. before re-importing its list.
+    // Rows left without a category never match and are dropped by Compact().
+    void ClearCategory(std::string_view category) noexcept;
+    void Compact();
+    void Clear() noexcept;
+
+    // ----- Selection -----
+    // Rows tagged with any category in `mask`, in insertion order
+    size_t Count(uint32_t mask) const noexcept;
+    void Select(uint32_t mask, std::vector<uint32_t>& rows) const;
+    void Select(uint32_t mask, DomainPool& out) const;
+
+    // Categories of `domain` (exact, already normalized), 0 if absent
+    uint32_t Lookup(std::string_view domain) const;
+
+    size_t size() const noexcept { return m_masks.size(); }
+    bool empty() const noexcept { return m_masks.empty(); }
+    std::string_view operator[](size_t row) const noexcept { return m_domains[row]; }
+    uint32_t Categories(size_t row) const noexcept { return m_masks[row]; }
+
+    // ----- Persistence -----
+    // Written via a temp file and rename
+    bool Save(const fs::path& path) const noexcept;
+    bool Load(const fs::path& path);
+
+    size_t MemoryUsage() const noexcept;
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t categoryCount;
+        uint32_t reserved;
+        uint64_t rows;
+        uint64_t arenaBytes;
+    };
+
+    size_t FindSlot(std::string_view domain, uint64_t hash) const noexcept;
+    void Reindex(size_t rows) const;
+
+    DomainPool m_domains;
+    std::vector<uint32_t> m_masks;
+    std::vector<std::string> m_categories;
+    // Open addressing: high half is the name's hash tag, low half row + 1 (0 when empty)
+    mutable std::vector<uint64_t> m_slots;
+};
+
+} // namespace utils
@@ -0,0 +1,323 @@
+// compiled.cpp
+#include "compiled.h"
+#include "domainset.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace utils {
+
+namespace {
+
+constexpr char COMPILED_MAGIC[4] = { 'C', 'J', 'C', 'B' };
+constexpr char POINTER_MAGIC[4] = { 'C', 'J', 'C', 'P' };
+constexpr uint32_t COMPILED_VERSION = 1;
+
+struct Pointer {
+    char magic[4];
+    uint32_t version;
+    uint64_t generation;
+};
+
+fs::path GenerationPath(const fs::path& directory, uint64_t generation) {
+    return directory / ("compiled-" + std::to_string(generation) + ".bin");
+}
+
+char FoldCase(char c) noexcept {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool IsNormalized(std::string_view domain) noexcept {
+    if (!domain.empty() && domain.back() == '.') return false;
+    for (char c : domain) {
+        if (c >= 'A' && c <= 'Z') return false;
+    }
+    return true;
+}
+
+// `stored` is already normalized; `host` is folded as it is compared
+int CompareFolded(std::string_view stored, std::string_view host) noexcept {
+    const size_t n = std::min(stored.size(), host.size());
+    for (size_t i = 0; i < n; ++i) {
+        const unsigned char a = static_cast<unsigned char>(stored[i]);
+        const unsigned char b = static_cast<unsigned char>(FoldCase(host[i]));
+        if (a != b) return a < b ? -1 : 1;
+    }
+    return stored.size() == host.size() ? 0 : (stored.size() < host.size() ? -1 : 1);
+}
+
+bool WriteFileAtomically(const fs::path& path, const std::function<bool(std::ofstream&)>& write) {
+    const fs::path tempPath = fs::path(path).concat(".tmp");
+    std::error_code ec;
+    {
+        std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+        if (!ofs || !write(ofs) || !ofs.flush()) {
+            ofs.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        CJ_LOG_ERROR("Compiled", "Can't replace " << path << ": " << ec.message());
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+// ----- Lifetime -----
+CompiledBlocklist::~CompiledBlocklist() {
+    Detach();
+}
+
+void CompiledBlocklist::Detach() noexcept {
+    m_mapping.Close();
+    m_directory.clear();
+    m_header = Header{};
+    m_entries = nullptr;
+    m_arena = nullptr;
+    m_block = std::string_view();
+}
+
+// ----- Publishing -----
+bool CompiledBlocklist::Publish(const fs::path& directory, const DomainPool& domains, std::string_view block,
+                                size_t blockOffset, bool sinkhole, uint64_t* generation) {
+    Trace::Span span("CompiledBlocklist::Publish");
+    try {
+        if (blockOffset > block.size()) return false;
+        std::error_code ec;
+        fs::create_directories(directory, ec);
+
+        // Sorted, deduplicated and normalized, so readers can binary search.
+        // A pool that already is (a DomainSet's ToPool(), as the drop
+        // directory hands over) is written as it is: one linear check
+        // instead of sorting the whole list again for a small change.
+        DomainPool copy;
+        const DomainPool* sorted = &copy;
+        const bool folded = std::all_of(domains.begin(), domains.end(), IsNormalized);
+        if (folded && std::adjacent_find(domains.begin(), domains.end(),
+                                             [](std::string_view a, std::string_view b) { return a >= b; })
+                              == domains.end()) {
+            sorted = &domains;
+        } else if (folded) {
+            DomainSet::FromPool(domains).ToPool(copy);
+        } else {
+            DomainPool normalized;
+            normalized.Reserve(domains.size(), domains.ArenaBytes());
+            std::string name;
+            for (std::string_view domain : domains) {
+                if (!domain.empty() && domain.back() == '.') domain.remove_suffix(1);
+                name.assign(domain);
+                std::transform(name.begin(), name.end(), name.begin(), FoldCase);
+                normalized.Add(name);
+            }
+            DomainSet::FromPool(normalized).ToPool(copy);
+        }
+
+        Header header{};
+        header.domainCount = sorted->size();
+        header.arenaBytes = sorted->ArenaBytes();
+        header.blockBytes = block.size();
+        header.blockOffset = static_cast<uint32_t>(blockOffset);
+        header.flags = sinkhole ? FLAG_SINKHOLE : 0;
+        const std::string_view managed = block.substr(blockOffset);
+        if (!crypto::Sha256(managed.data(), managed.size(), header.blockDigest)) return false;
+
+        const auto& index = sorted->GetIndex();
+        const std::string_view entries(reinterpret_cast<const char*>(index.data()),
+                                       index.size() * sizeof(DomainPool::Entry));
+        if (!WriteGeneration(directory, header, { entries, sorted->GetArena(), block })) return false;
+
+        span.Arg("generation", header.generation).Arg("domains", header.domainCount).Arg("blockBytes", block.size());
+        CJ_LOG_DEBUG("Compiled", "Published generation " << header.generation << " (" << header.domainCount
+                     << " domain(s), " << block.size() << " block byte(s))");
+        if (generation) *generation = header.generation;
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Compiled", "Publish failed: " << e.what());
+        return false;
+    }
+}
+
+// Nothing is rebuilt: the header is kept but for its generation, and the
+// rest of the file is written straight from the source's mapping
+bool CompiledBlocklist::Republish(const fs::path& directory, const CompiledBlocklist& source,
+                                  uint64_t* generation) {
+    Trace::Span span("CompiledBlocklist::Republish");
+    if (!source.IsAttached()) return false;
+    try {
+        std::error_code ec;
+        fs::create_directories(directory, ec);
+        Header header = source.m_header;
+        if (!WriteGeneration(directory, header, { source.m_mapping.View().substr(sizeof(Header)) })) return false;
+
+        span.Arg("generation", header.generation).Arg("domains", header.domainCount);
+        CJ_LOG_DEBUG("Compiled", "Republished generation " << source.m_header.generation << " of "
+                     << source.m_directory << " as generation " << header.generation);
+        if (generation) *generation = header.generation;
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Compiled", "Republish failed: " << e.what());
+        return false;
+    }
+}
+
+bool CompiledBlocklist::WriteGeneration(const fs::path& directory, Header& header,
+                                        std::initializer_list<std::string_view> body) {
+    std::error_code ec;
+    std::memcpy(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+    header.version = COMPILED_VERSION;
+    header.generation = CurrentGeneration(directory) + 1;
+    while (fs::exists(GenerationPath(directory, header.generation), ec)) ++header.generation;
+
+    const fs::path path = GenerationPath(directory, header.generation);
+    const bool written = WriteFileAtomically(path, [&](std::ofstream& ofs) {
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (std::string_view part : body) ofs.write(part.data(), static_cast<std::streamsize>(part.size()));
+        return static_cast<bool>(ofs);
+    });
+    if (!written) {
+        CJ_LOG_ERROR("Compiled", "Failed to write " << path);
+        return false;
+    }
+
+    Pointer pointer{};
+    std::memcpy(pointer.magic, POINTER_MAGIC, sizeof(POINTER_MAGIC));
+    pointer.version = COMPILED_VERSION;
+    pointer.generation = header.generation;
+    if (!WriteFileAtomically(directory / CURRENT_FILENAME, [&](std::ofstream& ofs) {
+            return static_cast<bool>(ofs.write(reinterpret_cast<const char*>(&pointer), sizeof(pointer)));
+        })) {
+        fs::remove(path, ec);
+        return false;
+    }
+
+    // Keep the previous generation for readers switching over; older ones
+    // go (on Windows a file still mapped somewhere is removed once unmapped)
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().u8string();
+        if (name.rfind("compiled-", 0) != 0) continue;
+        char* parsedEnd = nullptr;
+        const uint64_t old = std::strtoull(name.c_str() + 9, &parsedEnd, 10);
+        if (parsedEnd && std::strcmp(parsedEnd, ".bin") == 0 && old + 1 < header.generation) {
+            std::error_code removeError;
+            fs::remove(it->path(), removeError);
+        }
+    }
+    return true;
+}
+
+uint64_t CompiledBlocklist::CurrentGeneration(const fs::path& directory) noexcept {
+    try {
+        std::ifstream ifs(directory / CURRENT_FILENAME, std::ios::binary);
+        Pointer pointer{};
+        if (!ifs || !ifs.read(reinterpret_cast<char*>(&pointer), sizeof(pointer)) ||
+            std::memcmp(pointer.magic, POINTER_MAGIC, sizeof(POINTER_MAGIC)) != 0 ||
+            pointer.version != COMPILED_VERSION) {
+            return 0;
+        }
+        return pointer.generation;
+    } catch (...) {
+        return 0;
+    }
+}
+
+// ----- Attaching -----
+// A generation that can't be mapped leaves the previous one attached
+bool CompiledBlocklist::Attach(const fs::path& directory) noexcept {
+    const uint64_t generation = CurrentGeneration(directory);
+    if (generation == 0) {
+        Detach();
+        return false;
+    }
+    if (m_mapping.IsOpen() && m_header.generation == generation && m_directory == directory) return true;
+
+    CompiledBlocklist next;
+    if (!next.Map(GenerationPath(directory, generation), generation)) return false;
+    try {
+        next.m_directory = directory;
+    } catch (...) {
+        return false;
+    }
+    std::swap(m_directory, next.m_directory);
+    std::swap(m_header, next.m_header);
+    std::swap(m_entries, next.m_entries);
+    std::swap(m_arena, next.m_arena);
+    std::swap(m_block, next.m_block);
+    std::swap(m_mapping, next.m_mapping);
+    return true;
+}
+
+bool CompiledBlocklist::Map(const fs::path& path, uint64_t generation) noexcept {
+    Trace::Span span("CompiledBlocklist::Map");
+    span.Arg("generation", generation);
+    // Mapped however small: every process guarding the block shares the one copy
+    if (!m_mapping.Open(path, MappedFile::Access::Random, 0) || m_mapping.size() < sizeof(Header)) {
+        Detach();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, m_mapping.data(), sizeof(header));
+    const uint64_t entryBytes = header.domainCount * sizeof(DomainPool::Entry);
+    if (std::memcmp(header.magic, COMPILED_MAGIC, sizeof(COMPILED_MAGIC)) != 0 ||
+        header.version != COMPILED_VERSION || header.generation != generation ||
+        header.domainCount > UINT32_MAX || header.arenaBytes > UINT32_MAX ||
+        header.blockOffset > header.blockBytes ||
+        m_mapping.size() != sizeof(Header) + entryBytes + header.arenaBytes + header.blockBytes) {
+        CJ_LOG_WARN("Compiled", "Ignoring malformed compiled blocklist " << path);
+        Detach();
+        return false;
+    }
+
+    const char* base = m_mapping.View().data();
+    m_header = header;
+    m_entries = reinterpret_cast<const DomainPool::Entry*>(base + sizeof(Header));
+    m_arena = base + sizeof(Header) + entryBytes;
+    m_block = std::string_view(m_arena + header.arenaBytes, static_cast<size_t>(header.blockBytes));
+    span.Arg("domains", header.domainCount).Arg("bytes", m_mapping.size());
+    CJ_LOG_DEBUG("Compiled", "Attached generation " << generation << " (" << header.domainCount << " domain(s))");
+    return true;
+}
+
+// ----- Lookup -----
+// Entries are bounds-checked here rather than all at Attach(), which would
+// fault the whole column in
+std::string_view CompiledBlocklist::operator[](size_t i) const noexcept {
+    const DomainPool::Entry& entry = m_entries[i];
+    if (static_cast<uint64_t>(entry.offset) + entry.length > m_header.arenaBytes) return std::string_view();
+    return std::string_view(m_arena + entry.offset, entry.length);
+}
+
+bool CompiledBlocklist::Contains(std::string_view host) const noexcept {
+    if (!host.empty() && host.back() == '.') host.remove_suffix(1);
+    size_t first = 0, count = size();
+    while (count > 0) {
+        const size_t half = count / 2;
+        if (CompareFolded((*this)[first + half], host) < 0) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first < size() && CompareFolded((*this)[first], host) == 0;
+}
+
+void CompiledBlocklist::ToPool(DomainPool& out) const {
+    out.Reserve(out.size() + size(), out.ArenaBytes() + static_cast<size_t>(m_header.arenaBytes));
+    for (size_t i = 0; i < size(); ++i) out.Add((*this)[i]);
+}
+
+} // namespace utils
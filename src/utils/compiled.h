@@ -0,0 +1,109 @@
+// compiled.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <string_view>
+
+#include "crypto.h"
+#include "domainpool.h"
+#include "mappedfile.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// The enforced blocklist, compiled once by whoever applies it and mapped
+// read-only by every process that guards it. Both watchdogs attach to the
+// same file, so the domain column and the rendered managed block sit in the
+// page cache once rather than on two private heaps.
+//
+// Each publish writes a new generation, compiled-<n>.bin, in full via a temp
+// file and rename, and only then replaces the small compiled.current pointer
+// the same way. A reader therefore only ever maps a finished file; one still
+// mapped stays valid after a newer generation replaces it, and files two or
+// more generations old are removed on the next publish.
+//
+// Layout: Header, DomainPool entries, the character arena, then the managed
+// block text. Domains are stored normalized (lowercase, no root dot), sorted
+// and deduplicated, so a lookup is a binary search over the mapping.
+//
+// The format isn't specific to the enforced list: the drop directory keeps
+// each file's domains and their union this way, and the schedule one
+// blocklist per state, each in its own directory.
+class CompiledBlocklist {
+public:
+    static constexpr const char* DIRNAME = "compiled";
+    static constexpr const char* CURRENT_FILENAME = "compiled.current";
+
+    CompiledBlocklist() = default;
+    ~CompiledBlocklist();
+    CompiledBlocklist(const CompiledBlocklist&) = delete;
+    CompiledBlocklist& operator=(const CompiledBlocklist&) = delete;
+
+    // `block` is the managed block as written to the hosts file (the header
+    // comment through the end marker); the start marker is at `blockOffset`
+    static bool Publish(const fs::path& directory, const DomainPool& domains, std::string_view block,
+                        size_t blockOffset, bool sinkhole, uint64_t* generation = nullptr);
+    // Publishes what `source` maps as the next generation of `directory`,
+    // copied from the mapping
+    static bool Republish(const fs::path& directory, const CompiledBlocklist& source,
+                          uint64_t* generation = nullptr);
+
+    // Generation compiled.current names, 0 if nothing was published
+    static uint64_t CurrentGeneration(const fs::path& directory) noexcept;
+
+    // Maps the current generation; a pointer read when already attached to it
+    // (in the same directory)
+    bool Attach(const fs::path& directory) noexcept;
+    void Detach() noexcept;
+    bool IsAttached() const noexcept { return m_mapping.IsOpen(); }
+
+    uint64_t GetGeneration() const noexcept { return m_header.generation; }
+    bool IsSinkhole() const noexcept { return (m_header.flags & FLAG_SINKHOLE) != 0; }
+    std::string_view GetBlock() const noexcept { return m_block; }
+    size_t GetBlockOffset() const noexcept { return m_header.blockOffset; }
+    // SHA-256 from the start marker to the end of the block, as StateCache records it
+    const crypto::Digest& GetBlockDigest() const noexcept { return m_header.blockDigest; }
+
+    size_t size() const noexcept { return static_cast<size_t>(m_header.domainCount); }
+    bool empty() const noexcept { return m_header.domainCount == 0; }
+    std::string_view operator[](size_t i) const noexcept;
+
+    // Case-insensitive, ignoring a trailing root dot
+    bool Contains(std::string_view host) const noexcept;
+    // Appends every domain, in order, for code that needs a private list
+    void ToPool(DomainPool& out) const;
+
+private:
+    static constexpr uint32_t FLAG_SINKHOLE = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t generation;
+        uint64_t domainCount;
+        uint64_t arenaBytes;
+        uint64_t blockBytes;
+        uint32_t blockOffset;
+        uint32_t flags;
+        crypto::Digest blockDigest;
+    };
+
+    // Writes `header`, numbered as the next generation, followed by `body`,
+    // then points compiled.current at it
+    static bool WriteGeneration(const fs::path& directory, Header& header,
+                                std::initializer_list<std::string_view> body);
+    bool Map(const fs::path& path, uint64_t generation) noexcept;
+
+    fs::path m_directory;
+    Header m_header{};
+    const DomainPool::Entry* m_entries = nullptr;
+    const char* m_arena = nullptr;
+    std::string_view m_block;
+    MappedFile m_mapping;
+};
+
+} // namespace utils
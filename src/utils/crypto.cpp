@@ -1,8 +1,14 @@
 // crypto.cpp
 #include "crypto.h"
+#include "asyncio.h"
+#include "mappedfile.h"
+#include "log.h"
+#include "trace.h"
 #pragma message("Using OpenSSL header from: " __FILE__)
 
+#ifdef _WIN32
 #include <windows.h>  // Required before OpenSSL on Windows
+#endif
 
 extern "C" {
     #include <openssl/evp.h>
@@ -11,12 +17,11 @@ extern "C" {
 }
 
 #include <filesystem>
-#include <fstream>
 #include <iomanip>
-#include <iostream>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <system_error>
 #include <vector>
 #include <stdexcept>
 
@@ -51,7 +56,7 @@ struct EVPCipherContext {
 void log_openssl_error(const std::string& context) {
     char err_buf[256];
     ERR_error_string_n(ERR_get_error(), err_buf, sizeof(err_buf));
-    std::cerr << "[Crypto] Error in " << context << ": " << err_buf << "\n";
+    CJ_LOG_ERROR("Crypto", "Error in " << context << ": " << err_buf);
 }
 
 // ----- Secure Random Generation -----
@@ -93,6 +98,8 @@ std::string GenerateRandomFilename(size_t length /*= FILENAME_LENGTH*/) {
 // ----- Encryption/Decryption -----
 bool EncryptData(const std::vector<unsigned char>& plaintext,
                  std::vector<unsigned char>& ciphertext) {
+    Trace::Span span("crypto::EncryptData");
+    span.Arg("bytes", plaintext.size());
     try {
         EVPCipherContext ctx;
         const EVP_CIPHER* cipher = EVP_aes_256_cbc();  // 5. explicit type
@@ -119,13 +126,20 @@ bool EncryptData(const std::vector<unsigned char>& plaintext,
         ciphertext.resize(out_len + final_len);
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "[Crypto] Exception: " << e.what() << "\n";
+        CJ_LOG_ERROR("Crypto", "Exception: " << e.what());
         return false;
     }
 }
 
 bool DecryptData(const std::vector<unsigned char>& ciphertext,
                  std::vector<unsigned char>& plaintext) {
+    return DecryptData(ciphertext.data(), ciphertext.size(), plaintext);
+}
+
+bool DecryptData(const unsigned char* ciphertext, size_t size,
+                 std::vector<unsigned char>& plaintext) {
+    Trace::Span span("crypto::DecryptData");
+    span.Arg("bytes", size);
     try {
         EVPCipherContext ctx;
         const EVP_CIPHER* cipher = EVP_aes_256_cbc();
@@ -135,10 +149,10 @@ bool DecryptData(const std::vector<unsigned char>& ciphertext,
             return false;
         }
 
-        plaintext.resize(ciphertext.size());
+        plaintext.resize(size);
         int out_len = 0;
         if (EVP_DecryptUpdate(ctx.ctx, plaintext.data(), &out_len,
-                              ciphertext.data(), (int)ciphertext.size()) != 1) {
+                              ciphertext, (int)size) != 1) {
             log_openssl_error("EVP_DecryptUpdate");
             return false;
         }
@@ -152,7 +166,7 @@ bool DecryptData(const std::vector<unsigned char>& ciphertext,
         plaintext.resize(out_len + final_len);
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "[Crypto] Exception: " << e.what() << "\n";
+        CJ_LOG_ERROR("Crypto", "Exception: " << e.what());
         return false;
     }
 }
@@ -160,27 +174,89 @@ bool DecryptData(const std::vector<unsigned char>& ciphertext,
 // ----- File Operations -----
 bool WriteBinaryToFile(const std::filesystem::path& file_path,
                        const std::vector<unsigned char>& data) {
-    std::ofstream ofs(file_path, std::ios::binary);
-    if (!ofs) {
-        std::cerr << "[Crypto] Error opening file: " << file_path << "\n";
+    Trace::Span span("crypto::WriteBinaryToFile");
+    span.Arg("bytes", data.size());
+    utils::IoBatch batch;
+    batch.Write(batch.Create(file_path), 0, data.data(), data.size());
+    if (!batch.Wait()) {
+        CJ_LOG_ERROR("Crypto", "Error writing file: " << batch.GetError());
         return false;
     }
-    ofs.write((const char*)data.data(), data.size());
-    return ofs.good();
+    return true;
 }
 
 bool ReadBinaryFromFile(const std::filesystem::path& file_path,
                         std::vector<unsigned char>& data) {
-    std::ifstream ifs(file_path, std::ios::binary | std::ios::ate);
-    if (!ifs) {
-        std::cerr << "[Crypto] Error opening file: " << file_path << "\n";
+    Trace::Span span("crypto::ReadBinaryFromFile");
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(file_path, ec);
+    if (ec) {
+        CJ_LOG_ERROR("Crypto", "Error opening file: " << file_path);
+        return false;
+    }
+    data.resize(static_cast<size_t>(size));
+    span.Arg("bytes", data.size());
+    utils::IoBatch batch;
+    batch.Read(file_path, data.data(), data.size());
+    if (!batch.Wait()) {
+        CJ_LOG_ERROR("Crypto", "Error reading file: " << batch.GetError());
+        return false;
+    }
+    return true;
+}
+
+// ----- Hashing -----
+bool Sha256(const void* data, size_t size, Digest& digest) {
+    Trace::Span span("crypto::Sha256");
+    span.Arg("bytes", size);
+    unsigned int len = 0;
+    if (EVP_Digest(data, size, digest.data(), &len, EVP_sha256(), nullptr) != 1 ||
+        len != digest.size()) {
+        log_openssl_error("EVP_Digest");
+        return false;
+    }
+    return true;
+}
+
+Sha256Stream::Sha256Stream() : m_ctx(EVP_MD_CTX_new()) {
+    if (!m_ctx) throw std::runtime_error("Failed to create EVP_MD_CTX");
+    if (EVP_DigestInit_ex(static_cast<EVP_MD_CTX*>(m_ctx), EVP_sha256(), nullptr) != 1) {
+        EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(m_ctx));
+        throw std::runtime_error("Failed to initialize SHA-256");
+    }
+}
+
+Sha256Stream::~Sha256Stream() {
+    EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(m_ctx));
+}
+
+bool Sha256Stream::Update(const void* data, size_t size) {
+    if (EVP_DigestUpdate(static_cast<EVP_MD_CTX*>(m_ctx), data, size) != 1) {
+        log_openssl_error("EVP_DigestUpdate");
         return false;
     }
-    auto size = (size_t)ifs.tellg();
-    ifs.seekg(0);
-    data.resize(size);
-    ifs.read((char*)data.data(), size);
-    return ifs.good();
+    return true;
+}
+
+bool Sha256Stream::Final(Digest& digest) {
+    unsigned int len = 0;
+    if (EVP_DigestFinal_ex(static_cast<EVP_MD_CTX*>(m_ctx), digest.data(), &len) != 1 ||
+        len != digest.size()) {
+        log_openssl_error("EVP_DigestFinal_ex");
+        return false;
+    }
+    return true;
+}
+
+std::string ToHex(const Digest& digest) {
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(digest.size() * 2);
+    for (unsigned char b : digest) {
+        out += hex[b >> 4];
+        out += hex[b & 0x0F];
+    }
+    return out;
 }
 
 // ----- Main Operations -----
@@ -188,7 +264,7 @@ bool GenerateAndStorePassword(const std::filesystem::path& storage_dir,
                               std::filesystem::path& out_file_path) {
     std::vector<unsigned char> password;
     if (!GenerateRandomBytes(password, DEFAULT_PASSWORD_LENGTH)) {
-        std::cerr << "[Crypto] Password generation failed\n";
+        CJ_LOG_ERROR("Crypto", "Password generation failed");
         return false;
     }
 
@@ -211,11 +287,13 @@ bool GenerateAndStorePassword(const std::filesystem::path& storage_dir,
 
 bool LoadAndDecryptPassword(const std::filesystem::path& file_path,
                             std::vector<unsigned char>& password) {
-    std::vector<unsigned char> encrypted;
-    if (!ReadBinaryFromFile(file_path, encrypted)) return false;
-    bool ok = DecryptData(encrypted, password);
-    std::fill(encrypted.begin(), encrypted.end(), 0);
-    return ok;
+    // Decrypted straight from the file's bytes; only the plaintext is copied
+    utils::MappedFile encrypted;
+    if (!encrypted.Open(file_path)) {
+        CJ_LOG_ERROR("Crypto", "Error opening file: " << file_path);
+        return false;
+    }
+    return DecryptData(encrypted.data(), encrypted.size(), password);
 }
 
 } // namespace crypto
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <string>
 #include <vector>
 #include <filesystem> // Include this since your cpp uses std::filesystem::path
@@ -24,6 +25,7 @@ bool EncryptData(const std::vector<unsigned char>& plaintext, std::vector<unsign
  * @brief Decrypts ciphertext using AES-256-CBC.
  */
 bool DecryptData(const std::vector<unsigned char>& ciphertext, std::vector<unsigned char>& plaintext);
+bool DecryptData(const unsigned char* ciphertext, size_t size, std::vector<unsigned char>& plaintext);
 
 /**
  * @brief Generates a secure random password.
@@ -36,7 +38,8 @@ bool GenerateRandomPassword(std::vector<unsigned char>& password, size_t length
 bool WriteBinaryToFile(const std::filesystem::path& filePath, const std::vector<unsigned char>& data);
 
 /**
- * @brief Reads binary data from a file.
+ * @brief Reads binary data from a file into a copy.
+ * utils::MappedFile (mappedfile.h) reads a file in place instead.
  */
 bool ReadBinaryFromFile(const std::filesystem::path& filePath, std::vector<unsigned char>& data);
 
@@ -50,4 +53,36 @@ bool GenerateAndStorePassword(const std::filesystem::path& storageDir, std::file
  */
 bool LoadAndDecryptPassword(const std::filesystem::path& filePath, std::vector<unsigned char>& password);
 
+/**
+ * @brief SHA-256 digest value.
+ */
+using Digest = std::array<unsigned char, 32>;
+
+/**
+ * @brief Computes the SHA-256 digest of a buffer.
+ */
+bool Sha256(const void* data, size_t size, Digest& digest);
+
+/**
+ * @brief Incremental SHA-256 for input that arrives in pieces.
+ */
+class Sha256Stream {
+public:
+    Sha256Stream();
+    ~Sha256Stream();
+    Sha256Stream(const Sha256Stream&) = delete;
+    Sha256Stream& operator=(const Sha256Stream&) = delete;
+
+    bool Update(const void* data, size_t size);
+    bool Final(Digest& digest);
+
+private:
+    void* m_ctx;  // EVP_MD_CTX*, opaque so callers don't need OpenSSL headers
+};
+
+/**
+ * @brief Renders a digest as lower-case hex.
+ */
+std::string ToHex(const Digest& digest);
+
 } // namespace crypto
@@ -0,0 +1,376 @@
+// decompress.cpp
+#include "decompress.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+#ifdef CJ_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+constexpr size_t INPUT_SIZE = 256 * 1024;  // Compressed bytes read per call
+constexpr size_t NO_BUFFER = static_cast<size_t>(-1);
+
+} // anonymous namespace
+
+struct DecompressingReader::State {
+    struct Chunk {
+        size_t buffer;
+        size_t size;
+    };
+
+    std::ifstream file;
+    std::istream* in = nullptr;        // `file`, or a stream the caller owns
+    std::string prefix;                // Read to detect the codec, served before `in`
+    size_t prefixUsed = 0;
+    Codec codec = Codec::None;
+    std::thread worker;
+
+    std::mutex mutex;
+    std::condition_variable filled;    // Worker -> consumer: a chunk is ready
+    std::condition_variable drained;   // Consumer -> worker: a buffer is free
+    std::vector<std::vector<char>> buffers;
+    std::vector<size_t> freeBuffers;
+    std::deque<Chunk> ready;
+    size_t held = NO_BUFFER;           // Buffer the consumer is reading
+    bool done = false;
+    bool stop = false;
+    std::atomic<bool> failed{ false };
+    std::atomic<uint64_t> compressedBytes{ 0 };
+
+    // ----- Worker side -----
+    size_t Acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return stop || !freeBuffers.empty(); });
+        if (stop) return NO_BUFFER;
+        const size_t index = freeBuffers.back();
+        freeBuffers.pop_back();
+        return index;
+    }
+
+    void Publish(size_t index, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back({ index, size });
+        filled.notify_one();
+    }
+
+    void Finish(bool ok) {
+        if (!ok) failed.store(true);
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        filled.notify_all();
+    }
+
+    size_t ReadInput(char* data, size_t capacity) {
+        size_t got = std::min(capacity, prefix.size() - prefixUsed);
+        std::memcpy(data, prefix.data() + prefixUsed, got);
+        prefixUsed += got;
+        if (got < capacity) {
+            in->read(data + got, static_cast<std::streamsize>(capacity - got));
+            got += static_cast<size_t>(in->gcount());
+        }
+        compressedBytes.fetch_add(got, std::memory_order_relaxed);
+        return got;
+    }
+
+    // Hands the current buffer over once it is full and picks up a fresh one.
+    // False when the reader is closing.
+    bool Rotate(size_t& index, size_t& used) {
+        if (used < CHUNK_SIZE) return true;
+        Publish(index, used);
+        used = 0;
+        index = Acquire();
+        return index != NO_BUFFER;
+    }
+
+    void Flush(size_t index, size_t used) {
+        if (index != NO_BUFFER && used > 0) Publish(index, used);
+    }
+
+    bool CopyPlain() {
+        size_t index = Acquire();
+        size_t used = 0;
+        while (index != NO_BUFFER) {
+            const size_t got = ReadInput(buffers[index].data() + used, CHUNK_SIZE - used);
+            used += got;
+            if (got == 0) {
+                Flush(index, used);
+                return !in->bad();
+            }
+            if (!Rotate(index, used)) break;
+        }
+        return true;
+    }
+
+    bool InflateGzip() {
+        z_stream stream{};
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {  // +32: accept gzip and zlib headers
+            CJ_LOG_ERROR("Decompress", "inflateInit2 failed");
+            return false;
+        }
+        std::vector<char> input(INPUT_SIZE);
+        size_t index = Acquire();
+        size_t used = 0;
+        bool ended = false;
+        bool eof = false;
+        bool ok = true;
+
+        while (index != NO_BUFFER) {
+            if (stream.avail_in == 0 && !eof) {
+                const size_t got = ReadInput(input.data(), input.size());
+                stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                stream.avail_in = static_cast<uInt>(got);
+                eof = got == 0;
+                if (in->bad()) {
+                    CJ_LOG_ERROR("Decompress", "Read error");
+                    ok = false;
+                    break;
+                }
+            }
+            if (ended) {
+                if (stream.avail_in == 0) break;  // Input can only be exhausted here at EOF
+                inflateReset(&stream);             // Another member follows
+                ended = false;
+            }
+
+            stream.next_out = reinterpret_cast<Bytef*>(buffers[index].data() + used);
+            stream.avail_out = static_cast<uInt>(CHUNK_SIZE - used);
+            const int rc = inflate(&stream, Z_NO_FLUSH);
+            used = CHUNK_SIZE - stream.avail_out;
+            if (rc == Z_STREAM_END) {
+                ended = true;
+            } else if (rc == Z_BUF_ERROR && eof) {
+                CJ_LOG_ERROR("Decompress", "gzip stream is truncated");
+                ok = false;
+                break;
+            } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                CJ_LOG_ERROR("Decompress", "gzip data is corrupt: " << (stream.msg ? stream.msg : "inflate failed"));
+                ok = false;
+                break;
+            }
+            if (!Rotate(index, used)) break;
+        }
+        inflateEnd(&stream);
+        if (ok) Flush(index, used);
+        return ok;
+    }
+
+#ifdef CJ_HAVE_ZSTD
+    bool InflateZstd() {
+        ZSTD_DStream* stream = ZSTD_createDStream();
+        if (!stream || ZSTD_isError(ZSTD_initDStream(stream))) {
+            CJ_LOG_ERROR("Decompress", "ZSTD_initDStream failed");
+            ZSTD_freeDStream(stream);
+            return false;
+        }
+        std::vector<char> input(INPUT_SIZE);
+        ZSTD_inBuffer source{ input.data(), 0, 0 };
+        size_t index = Acquire();
+        size_t used = 0;
+        size_t pending = 0;  // Non-zero while a frame is incomplete or output is buffered
+        bool eof = false;
+        bool ok = true;
+
+        while (index != NO_BUFFER) {
+            if (source.pos == source.size && !eof) {
+                const size_t got = ReadInput(input.data(), input.size());
+                source = { input.data(), got, 0 };
+                eof = got == 0;
+                if (in->bad()) {
+                    CJ_LOG_ERROR("Decompress", "Read error");
+                    ok = false;
+                    break;
+                }
+            }
+            if (eof && pending == 0) break;
+
+            ZSTD_outBuffer target{ buffers[index].data(), CHUNK_SIZE, used };
+            pending = ZSTD_decompressStream(stream, &target, &source);
+            if (ZSTD_isError(pending)) {
+                CJ_LOG_ERROR("Decompress", "zstd data is corrupt: " << ZSTD_getErrorName(pending));
+                ok = false;
+                break;
+            }
+            if (eof && pending != 0 && target.pos == used) {
+                CJ_LOG_ERROR("Decompress", "zstd stream is truncated");
+                ok = false;
+                break;
+            }
+            used = target.pos;
+            if (!Rotate(index, used)) break;
+        }
+        ZSTD_freeDStream(stream);
+        if (ok) Flush(index, used);
+        return ok;
+    }
+#endif
+
+    void Run() {
+        Trace::Span span("DecompressingReader::Run");
+        bool ok = false;
+        try {
+            switch (codec) {
+                case Codec::None: ok = CopyPlain(); break;
+                case Codec::Gzip: ok = InflateGzip(); break;
+#ifdef CJ_HAVE_ZSTD
+                case Codec::Zstd: ok = InflateZstd(); break;
+#endif
+                default: break;
+            }
+        } catch (const std::exception& e) {
+            CJ_LOG_ERROR("Decompress", "Worker failed: " << e.what());
+            ok = false;
+        }
+        span.Arg("compressed", compressedBytes.load());
+        Finish(ok);
+    }
+};
+
+DecompressingReader::DecompressingReader() = default;
+
+DecompressingReader::~DecompressingReader() {
+    if (!m_state) return;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->stop = true;
+        m_state->drained.notify_all();
+    }
+    if (m_state->worker.joinable()) m_state->worker.join();
+}
+
+DecompressingReader::Codec DecompressingReader::Detect(std::string_view prefix) noexcept {
+    if (prefix.size() >= 2 && static_cast<unsigned char>(prefix[0]) == 0x1F &&
+        static_cast<unsigned char>(prefix[1]) == 0x8B) {
+        return Codec::Gzip;
+    }
+    if (prefix.size() >= 4 && prefix.substr(0, 4) == std::string_view("\x28\xB5\x2F\xFD", 4)) {
+        return Codec::Zstd;
+    }
+    return Codec::None;
+}
+
+const char* DecompressingReader::CodecName(Codec codec) noexcept {
+    switch (codec) {
+        case Codec::None: return "none";
+        case Codec::Gzip: return "gzip";
+        case Codec::Zstd: return "zstd";
+        default:          return "unknown";
+    }
+}
+
+bool DecompressingReader::CodecSupported(Codec codec) noexcept {
+#ifdef CJ_HAVE_ZSTD
+    return codec == Codec::None || codec == Codec::Gzip || codec == Codec::Zstd;
+#else
+    return codec == Codec::None || codec == Codec::Gzip;
+#endif
+}
+
+bool DecompressingReader::ReadAll(const fs::path& path, std::string& out) {
+    DecompressingReader reader;
+    if (!reader.Open(path)) return false;
+    out.clear();
+    std::string_view chunk;
+    while (reader.Next(chunk)) out.append(chunk.data(), chunk.size());
+    return !reader.Failed();
+}
+
+bool DecompressingReader::Open(const fs::path& path) {
+    if (m_state) {
+        CJ_LOG_ERROR("Decompress", "Reader is already open");
+        return false;
+    }
+    auto state = std::make_unique<State>();
+    state->file.open(path, std::ios::binary);
+    if (!state->file) {
+        CJ_LOG_ERROR("Decompress", "Can't open " << path);
+        return false;
+    }
+    state->in = &state->file;
+    return Start(std::move(state), path.u8string());
+}
+
+bool DecompressingReader::Open(std::istream& stream, const std::string& name) {
+    if (m_state) {
+        CJ_LOG_ERROR("Decompress", "Reader is already open");
+        return false;
+    }
+    auto state = std::make_unique<State>();
+    state->in = &stream;
+    return Start(std::move(state), name);
+}
+
+// The magic is read rather than peeked so pipes work; ReadInput() replays it
+bool DecompressingReader::Start(std::unique_ptr<State> state, const std::string& name) {
+    char magic[4] = {};
+    state->in->read(magic, sizeof(magic));
+    state->prefix.assign(magic, static_cast<size_t>(state->in->gcount()));
+    if (state->in->bad()) {
+        CJ_LOG_ERROR("Decompress", "Can't read " << name);
+        return false;
+    }
+    state->in->clear(state->in->rdstate() & ~std::ios::failbit);
+    state->codec = Detect(state->prefix);
+    if (!CodecSupported(state->codec)) {
+        CJ_LOG_ERROR("Decompress", name << " is " << CodecName(state->codec)
+                     << "-compressed, which this build can't read");
+        return false;
+    }
+    CJ_LOG_DEBUG("Decompress", "Reading " << name << " (" << CodecName(state->codec) << ")");
+
+    state->buffers.resize(QUEUE_DEPTH);
+    for (size_t i = 0; i < QUEUE_DEPTH; ++i) {
+        state->buffers[i].resize(CHUNK_SIZE);
+        state->freeBuffers.push_back(QUEUE_DEPTH - 1 - i);
+    }
+    State* raw = state.get();
+    state->worker = std::thread([raw] { raw->Run(); });
+    m_state = std::move(state);
+    return true;
+}
+
+bool DecompressingReader::Next(std::string_view& chunk) {
+    if (!m_state) return false;
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    if (m_state->held != NO_BUFFER) {
+        m_state->freeBuffers.push_back(m_state->held);
+        m_state->held = NO_BUFFER;
+        m_state->drained.notify_one();
+    }
+    m_state->filled.wait(lock, [this] { return m_state->done || !m_state->ready.empty(); });
+    if (m_state->ready.empty()) return false;
+
+    const State::Chunk next = m_state->ready.front();
+    m_state->ready.pop_front();
+    m_state->held = next.buffer;
+    chunk = std::string_view(m_state->buffers[next.buffer].data(), next.size);
+    return true;
+}
+
+bool DecompressingReader::Failed() const noexcept {
+    return m_state && m_state->failed.load();
+}
+
+DecompressingReader::Codec DecompressingReader::GetCodec() const noexcept {
+    return m_state ? m_state->codec : Codec::None;
+}
+
+uint64_t DecompressingReader::CompressedBytes() const noexcept {
+    return m_state ? m_state->compressedBytes.load(std::memory_order_relaxed) : 0;
+}
+
+} // namespace utils
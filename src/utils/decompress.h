@@ -0,0 +1,63 @@
+// decompress.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Streams a blocklist file as plain bytes, transparently inflating it when the
+// first bytes are a gzip or zstd magic number. Reading and decompression run on
+// a worker thread that fills a small ring of fixed-size buffers, so whatever
+// consumes the chunks (the list importer) overlaps with the inflate. Memory is
+// bounded by QUEUE_DEPTH * CHUNK_SIZE regardless of the file size.
+//
+// gzip (including concatenated members and zlib streams) is always available;
+// zstd only when built with CJ_HAVE_ZSTD.
+class DecompressingReader {
+public:
+    enum class Codec { None, Gzip, Zstd };
+
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+    static constexpr size_t QUEUE_DEPTH = 4;
+
+    DecompressingReader();
+    ~DecompressingReader();  // Stops and joins the worker
+    DecompressingReader(const DecompressingReader&) = delete;
+    DecompressingReader& operator=(const DecompressingReader&) = delete;
+
+    static Codec Detect(std::string_view prefix) noexcept;
+    static const char* CodecName(Codec codec) noexcept;
+    static bool CodecSupported(Codec codec) noexcept;
+
+    // Whole file, decompressed, in one string (the GUI's import button)
+    static bool ReadAll(const fs::path& path, std::string& out);
+
+    // Opens the file, detects the codec and starts the worker
+    bool Open(const fs::path& path);
+    // Same over a stream the caller keeps open until the reader is done
+    // (standard input, a pipe); `name` is only for messages
+    bool Open(std::istream& stream, const std::string& name);
+
+    // Blocks for the next chunk, which stays valid until the following call.
+    // Returns false at the end of the data or on error; check Failed() then.
+    bool Next(std::string_view& chunk);
+    bool Failed() const noexcept;
+
+    Codec GetCodec() const noexcept;
+    uint64_t CompressedBytes() const noexcept;  // Read from disk so far
+
+private:
+    struct State;
+    bool Start(std::unique_ptr<State> state, const std::string& name);
+    std::unique_ptr<State> m_state;
+};
+
+} // namespace utils
@@ -0,0 +1,459 @@
+// dnsbench.cpp
+#include "dnsbench.h"
+#include "sinkhole.h"
+#include "metrics.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace utils {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using Socket = SOCKET;
+using SockLen = int;
+constexpr Socket INVALID_SOCK = INVALID_SOCKET;
+void CloseSocket(Socket s) { closesocket(s); }
+int PollSockets(pollfd* fds, size_t count, int timeoutMs) {
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+}
+#else
+using Socket = int;
+using SockLen = socklen_t;
+constexpr Socket INVALID_SOCK = -1;
+void CloseSocket(Socket s) { ::close(s); }
+int PollSockets(pollfd* fds, size_t count, int timeoutMs) {
+    return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+#endif
+
+constexpr unsigned RANDOM_SEED = 0xD45B;
+constexpr size_t WILDCARD_EVERY = 10;
+constexpr uint8_t UPSTREAM_ADDRESS[4] = { 192, 0, 2, 1 };  // TEST-NET-1
+constexpr uint8_t SINKHOLE_ADDRESS[4] = { 0, 0, 0, 0 };
+constexpr int POLL_INTERVAL_MS = 100;
+
+struct ClientResult {
+    size_t sent = 0;
+    size_t answered = 0;
+    size_t wrong = 0;
+    size_t lost = 0;
+};
+
+sockaddr_in Loopback(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+uint16_t BoundPort(Socket s) {
+    sockaddr_in bound{};
+    SockLen length = sizeof(bound);
+    ::getsockname(s, reinterpret_cast<sockaddr*>(&bound), &length);
+    return ntohs(bound.sin_port);
+}
+
+// Name for the i-th blocklist entry; every tenth entry is a wildcard
+std::string BlockedEntry(size_t i) {
+    return i % WILDCARD_EVERY == 0 ? "*.wild-" + std::to_string(i) + ".example"
+                                   : "blocked-" + std::to_string(i) + ".example";
+}
+
+// A name that entry i blocks
+std::string BlockedQuery(size_t i) {
+    return i % WILDCARD_EVERY == 0 ? "cdn.host-" + std::to_string(i) + ".wild-" + std::to_string(i) + ".example"
+                                   : "blocked-" + std::to_string(i) + ".example";
+}
+
+void BuildQuery(uint16_t id, const std::string& name, std::vector<uint8_t>& out) {
+    out.assign({ static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id), 0x01, 0x00,  // RD
+                 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 });
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t dot = name.find('.', start);
+        if (dot == std::string::npos) dot = name.size();
+        out.push_back(static_cast<uint8_t>(dot - start));
+        out.insert(out.end(), name.begin() + start, name.begin() + dot);
+        start = dot + 1;
+    }
+    out.insert(out.end(), { 0x00, 0x00, 0x01, 0x00, 0x01 });  // Root, A, IN
+}
+
+// True when the reply carries exactly one A record with `expected`
+bool HasAddress(const uint8_t* reply, size_t length, const uint8_t (&expected)[4]) {
+    return length >= 16 && reply[6] == 0 && reply[7] == 1 &&
+           std::memcmp(reply + length - 4, expected, 4) == 0;
+}
+
+// Stand-in for the real upstream: answers every A query with 192.0.2.1
+void UpstreamReply(const uint8_t* query, size_t length, std::vector<uint8_t>& reply) {
+    reply.assign(query, query + length);
+    reply[2] = static_cast<uint8_t>(0x80 | (query[2] & 0x01));
+    reply[3] = 0x80;
+    reply[7] = 1;
+    reply.insert(reply.end(), { 0xC0, 0x0C, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x04 });
+    reply.insert(reply.end(), std::begin(UPSTREAM_ADDRESS), std::end(UPSTREAM_ADDRESS));
+}
+
+bool RecvAll(Socket s, uint8_t* data, size_t length) {
+    size_t received = 0;
+    while (received < length) {
+        pollfd fd{};
+        fd.fd = s;
+        fd.events = POLLIN;
+        if (PollSockets(&fd, 1, 1000) <= 0) return false;
+        const int n = ::recv(s, reinterpret_cast<char*>(data + received), static_cast<int>(length - received), 0);
+        if (n <= 0) return false;
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool SendFramed(Socket s, const std::vector<uint8_t>& message) {
+    std::vector<uint8_t> framed;
+    framed.reserve(message.size() + 2);
+    framed.push_back(static_cast<uint8_t>(message.size() >> 8));
+    framed.push_back(static_cast<uint8_t>(message.size()));
+    framed.insert(framed.end(), message.begin(), message.end());
+    return ::send(s, reinterpret_cast<const char*>(framed.data()), static_cast<int>(framed.size()), 0) ==
+           static_cast<int>(framed.size());
+}
+
+bool RecvFramed(Socket s, std::vector<uint8_t>& message) {
+    uint8_t prefix[2];
+    if (!RecvAll(s, prefix, sizeof(prefix))) return false;
+    message.resize((prefix[0] << 8) | prefix[1]);
+    return RecvAll(s, message.data(), message.size());
+}
+
+void ServeUpstream(Socket udp, Socket tcp, const std::atomic<bool>& stop) {
+    std::vector<uint8_t> buffer(65535), reply;
+    pollfd fds[2]{};
+    fds[0].fd = udp;
+    fds[0].events = POLLIN;
+    fds[1].fd = tcp;
+    fds[1].events = POLLIN;
+
+    while (!stop.load()) {
+        if (PollSockets(fds, 2, POLL_INTERVAL_MS) <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            sockaddr_in from{};
+            SockLen fromLength = sizeof(from);
+            const int n = ::recvfrom(udp, reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0,
+                                     reinterpret_cast<sockaddr*>(&from), &fromLength);
+            if (n >= 12) {
+                UpstreamReply(buffer.data(), static_cast<size_t>(n), reply);
+                ::sendto(udp, reinterpret_cast<const char*>(reply.data()), static_cast<int>(reply.size()), 0,
+                         reinterpret_cast<const sockaddr*>(&from), fromLength);
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            const Socket connection = ::accept(tcp, nullptr, nullptr);
+            if (connection == INVALID_SOCK) continue;
+            std::vector<uint8_t> query;
+            while (RecvFramed(connection, query) && query.size() >= 12) {
+                UpstreamReply(query.data(), query.size(), reply);
+                if (!SendFramed(connection, reply)) break;
+            }
+            CloseSocket(connection);
+        }
+    }
+}
+
+ClientResult RunClient(size_t client, size_t share, uint16_t port, const DnsBenchmark::Options& options,
+                       Metrics::Histogram& blockedLatency, Metrics::Histogram& forwardedLatency) {
+    struct InFlight {
+        bool used = false;
+        bool blocked = false;
+        Clock::time_point sent;
+    };
+
+    ClientResult result;
+    const Socket s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const sockaddr_in server = Loopback(port);
+    if (s == INVALID_SOCK || ::connect(s, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0) {
+        result.lost = share;
+        if (s != INVALID_SOCK) CloseSocket(s);
+        return result;
+    }
+
+    std::mt19937 rng(RANDOM_SEED + static_cast<unsigned>(client));
+    std::uniform_int_distribution<size_t> pickDomain(0, options.domains - 1);
+    std::uniform_int_distribution<unsigned> pickPercent(0, 99);
+
+    std::vector<InFlight> inFlight(65536);
+    std::vector<uint8_t> query;
+    uint8_t reply[512];
+    uint16_t nextId = 0;
+    size_t outstanding = 0;
+    auto lastSweep = Clock::now();
+
+    while (result.answered + result.lost < share) {
+        while (result.sent < share && outstanding < options.window) {
+            const bool blocked = pickPercent(rng) < options.blockedPercent;
+            const std::string name = blocked ? BlockedQuery(pickDomain(rng))
+                                             : "allowed-" + std::to_string(rng()) + ".example.net";
+            const uint16_t id = nextId++;
+            BuildQuery(id, name, query);
+            inFlight[id] = InFlight{ true, blocked, Clock::now() };
+            ::send(s, reinterpret_cast<const char*>(query.data()), static_cast<int>(query.size()), 0);
+            ++result.sent;
+            ++outstanding;
+        }
+
+        pollfd fd{};
+        fd.fd = s;
+        fd.events = POLLIN;
+        if (PollSockets(&fd, 1, POLL_INTERVAL_MS) > 0) {
+            const int n = ::recv(s, reinterpret_cast<char*>(reply), sizeof(reply), 0);
+            if (n >= 12) {
+                InFlight& slot = inFlight[(reply[0] << 8) | reply[1]];
+                if (slot.used) {
+                    slot.used = false;
+                    --outstanding;
+                    ++result.answered;
+                    (slot.blocked ? blockedLatency : forwardedLatency).Record(Clock::now() - slot.sent);
+                    if (!HasAddress(reply, static_cast<size_t>(n), slot.blocked ? SINKHOLE_ADDRESS : UPSTREAM_ADDRESS)) {
+                        ++result.wrong;
+                    }
+                }
+            }
+        }
+
+        const auto now = Clock::now();
+        if (now - lastSweep >= std::chrono::milliseconds(POLL_INTERVAL_MS)) {
+            lastSweep = now;
+            for (auto& slot : inFlight) {
+                if (slot.used && now - slot.sent > options.timeout) {
+                    slot.used = false;
+                    --outstanding;
+                    ++result.lost;
+                }
+            }
+        }
+    }
+
+    CloseSocket(s);
+    return result;
+}
+
+// Sequential queries over one TCP connection, alternating blocked and allowed names.
+// Also checks that a wildcard doesn't block its own apex.
+size_t RunTcpCheck(uint16_t port, const DnsBenchmark::Options& options) {
+    const Socket s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    const sockaddr_in server = Loopback(port);
+    if (s == INVALID_SOCK || ::connect(s, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0) {
+        if (s != INVALID_SOCK) CloseSocket(s);
+        return 0;
+    }
+
+    size_t correct = 0;
+    std::vector<uint8_t> query, reply;
+    for (size_t i = 0; i < options.tcpQueries; ++i) {
+        const size_t domain = i % options.domains;
+        std::string name;
+        bool blocked = true;
+        if (i % 4 == 1) {
+            name = "allowed-" + std::to_string(i) + ".example.org";
+            blocked = false;
+        } else if (i % 4 == 3) {
+            name = "wild-" + std::to_string(domain - domain % WILDCARD_EVERY) + ".example";
+            blocked = false;
+        } else {
+            name = BlockedQuery(domain);
+        }
+        BuildQuery(static_cast<uint16_t>(i), name, query);
+        if (!SendFramed(s, query) || !RecvFramed(s, reply)) break;
+        if (HasAddress(reply.data(), reply.size(), blocked ? SINKHOLE_ADDRESS : UPSTREAM_ADDRESS)) ++correct;
+    }
+    CloseSocket(s);
+    return correct;
+}
+
+DnsBenchmark::Latency Summarize(const Metrics::Histogram& histogram) {
+    DnsBenchmark::Latency latency;
+    latency.answered = histogram.Count();
+    if (latency.answered > 0) {
+        latency.p50Micros = histogram.Percentile(0.50);
+        latency.p99Micros = histogram.Percentile(0.99);
+        latency.maxMicros = histogram.MaxMicros();
+    }
+    return latency;
+}
+
+void PrintLatency(const char* label, const DnsBenchmark::Latency& latency) {
+    std::cout << "  " << std::left << std::setw(10) << label << " answered " << latency.answered;
+    if (latency.answered > 0) {
+        std::cout << "  p50 " << latency.p50Micros << " us"
+                  << "  p99 " << latency.p99Micros << " us"
+                  << "  max " << latency.maxMicros << " us";
+    }
+    std::cout << '\n';
+}
+
+} // anonymous namespace
+
+bool DnsBenchmark::ParseOptions(const std::vector<std::string>& args, Options& options) {
+    for (const auto& arg : args) {
+        const size_t eq = arg.find('=');
+        if (eq == std::string::npos) {
+            CJ_LOG_ERROR("DnsBench", "Expected key=value, got: " << arg);
+            return false;
+        }
+        const std::string key = arg.substr(0, eq);
+        const std::string value = arg.substr(eq + 1);
+
+        try {
+            if (key == "queries") options.queries = std::stoul(value);
+            else if (key == "domains") options.domains = std::stoul(value);
+            else if (key == "clients") options.clients = std::stoul(value);
+            else if (key == "window") options.window = std::stoul(value);
+            else if (key == "blocked") options.blockedPercent = static_cast<unsigned>(std::stoul(value));
+            else if (key == "tcp") options.tcpQueries = std::stoul(value);
+            else if (key == "timeout") options.timeout = std::chrono::milliseconds(std::stoul(value));
+            else {
+                CJ_LOG_ERROR("DnsBench", "Unknown option: " << key);
+                return false;
+            }
+        } catch (...) {
+            CJ_LOG_ERROR("DnsBench", "Invalid value for " << key << ": " << value);
+            return false;
+        }
+    }
+    return options.queries > 0 && options.domains > 0 && options.clients > 0 &&
+           options.window > 0 && options.window <= 32768 && options.blockedPercent <= 100;
+}
+
+bool DnsBenchmark::Measure(const Options& options, Result& result) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        CJ_LOG_ERROR("DnsBench", "WSAStartup failed");
+        return false;
+    }
+#endif
+
+    // Stand-in upstream on UDP and TCP, same port
+    const Socket upstreamUdp = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const Socket upstreamTcp = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in upstream = Loopback(0);
+    bool ok = upstreamUdp != INVALID_SOCK && upstreamTcp != INVALID_SOCK &&
+              ::bind(upstreamUdp, reinterpret_cast<const sockaddr*>(&upstream), sizeof(upstream)) == 0;
+    if (ok) {
+        upstream.sin_port = htons(BoundPort(upstreamUdp));
+        ok = ::bind(upstreamTcp, reinterpret_cast<const sockaddr*>(&upstream), sizeof(upstream)) == 0 &&
+             ::listen(upstreamTcp, 16) == 0;
+    }
+    if (!ok) {
+        CJ_LOG_ERROR("DnsBench", "Can't set up the stand-in upstream");
+        if (upstreamUdp != INVALID_SOCK) CloseSocket(upstreamUdp);
+        if (upstreamTcp != INVALID_SOCK) CloseSocket(upstreamTcp);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    std::atomic<bool> stop{false};
+    std::thread upstreamThread([&] { ServeUpstream(upstreamUdp, upstreamTcp, stop); });
+
+    DomainPool entries;
+    for (size_t i = 0; i < options.domains; ++i) entries.Add(BlockedEntry(i));
+
+    const auto buildStarted = Clock::now();
+    SuffixIndex index;
+    index.Build(entries);
+    result.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - buildStarted).count();
+
+    DnsSinkhole::Config config;
+    config.port = 0;
+    config.upstreamAddress = "127.0.0.1";
+    config.upstreamPort = ntohs(upstream.sin_port);
+    config.upstreamTimeout = options.timeout;
+
+    DnsSinkhole sinkhole;
+    const bool started = sinkhole.Start(config, std::move(index));
+    if (started) {
+        Metrics::Histogram blockedLatency, forwardedLatency;
+        std::vector<ClientResult> results(options.clients);
+        std::vector<std::thread> clients;
+
+        const auto clientsStarted = Clock::now();
+        for (size_t c = 0; c < options.clients; ++c) {
+            const size_t share = options.queries / options.clients + (c < options.queries % options.clients ? 1 : 0);
+            clients.emplace_back([&, c, share] {
+                results[c] = RunClient(c, share, sinkhole.Port(), options, blockedLatency, forwardedLatency);
+            });
+        }
+        for (auto& client : clients) client.join();
+        result.wallSeconds = std::chrono::duration<double>(Clock::now() - clientsStarted).count();
+
+        result.tcpCorrect = RunTcpCheck(sinkhole.Port(), options);
+        result.upstreamTimeouts = sinkhole.GetStats().upstreamTimeouts;
+        for (const auto& r : results) {
+            result.sent += r.sent;
+            result.answered += r.answered;
+            result.wrong += r.wrong;
+            result.lost += r.lost;
+        }
+        result.blocked = Summarize(blockedLatency);
+        result.forwarded = Summarize(forwardedLatency);
+        sinkhole.Stop();
+    }
+
+    stop.store(true);
+    upstreamThread.join();
+    CloseSocket(upstreamUdp);
+    CloseSocket(upstreamTcp);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return started;
+}
+
+int DnsBenchmark::Run(const Options& options) {
+    Result result;
+    if (!Measure(options, result)) return 1;
+
+    std::cout << "\n===== [DnsBench] Report =====\n"
+              << "  queries " << result.sent << " from " << options.clients << " client(s), window "
+              << options.window << ", blocked " << options.blockedPercent << "%\n"
+              << std::fixed << std::setprecision(1)
+              << "  index " << options.domains << " entries built in " << result.buildMs << " ms\n"
+              << "  throughput " << std::setprecision(0)
+              << (result.wallSeconds > 0 ? result.answered / result.wallSeconds : 0.0)
+              << " qps over " << std::setprecision(2) << result.wallSeconds << " s\n";
+    PrintLatency("blocked", result.blocked);
+    PrintLatency("forwarded", result.forwarded);
+    std::cout << "  lost " << result.lost << ", wrong answers " << result.wrong
+              << ", upstream timeouts " << result.upstreamTimeouts << '\n'
+              << "  tcp " << result.tcpCorrect << '/' << options.tcpQueries << " correct\n";
+
+    return result.Passed(options) ? 0 : 1;
+}
+
+} // namespace utils
@@ -0,0 +1,68 @@
+// dnsbench.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// Load generator for the DNS sinkhole: starts a DnsSinkhole on a free loopback
+// port in front of a local stand-in upstream (which answers every name with
+// 192.0.2.1), then drives it from several client threads with a mix of blocked
+// and allowed names. Reports throughput and per-path latency percentiles.
+class DnsBenchmark {
+public:
+    struct Options {
+        size_t queries = 200000;                            // Total UDP queries across all clients
+        size_t domains = 10000;                             // Blocklist size (a tenth are wildcards)
+        size_t clients = 4;                                 // Client threads, one socket each
+        size_t window = 32;                                 // Queries in flight per client
+        unsigned blockedPercent = 50;                       // Share of queries for blocked names
+        size_t tcpQueries = 200;                            // Sequential queries over one TCP connection
+        std::chrono::milliseconds timeout{1000};            // Count a query as lost after this
+    };
+
+    struct Latency {
+        uint64_t answered = 0;
+        uint64_t p50Micros = 0;
+        uint64_t p99Micros = 0;
+        uint64_t maxMicros = 0;
+    };
+
+    struct Result {
+        size_t sent = 0;
+        size_t answered = 0;
+        size_t wrong = 0;                                   // Answered with the other path's address
+        size_t lost = 0;
+        size_t upstreamTimeouts = 0;
+        size_t tcpCorrect = 0;
+        double buildMs = 0.0;                               // Suffix index over the blocklist
+        double wallSeconds = 0.0;
+        Latency blocked;
+        Latency forwarded;
+
+        bool Passed(const Options& options) const noexcept {
+            return lost == 0 && wrong == 0 && tcpCorrect == options.tcpQueries;
+        }
+    };
+
+    // Parses key=value tokens (UTF-8) that follow --dns-bench or bench dns:
+    //   queries=N domains=N clients=N window=N blocked=PCT tcp=N timeout=MS
+    // Returns false (with a message on stderr) on unknown keys or bad values.
+    static bool ParseOptions(const std::vector<std::string>& args, Options& options);
+
+    // Runs the benchmark into `result`. False only when the sockets, the
+    // stand-in upstream or the sinkhole couldn't be set up.
+    static bool Measure(const Options& options, Result& result);
+
+    // Measure() plus a printed report.
+    // Returns 0 when every query got the expected answer, 1 otherwise.
+    static int Run(const Options& options);
+
+private:
+    DnsBenchmark() = delete;
+};
+
+} // namespace utils
@@ -0,0 +1,44 @@
+// domainpool.cpp
+#include "domainpool.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace utils {
+
+DomainPool DomainPool::FromStrings(const std::vector<std::string>& domains) {
+    size_t bytes = 0;
+    for (const auto& domain : domains) bytes += domain.size();
+
+    DomainPool pool;
+    pool.Reserve(domains.size(), bytes);
+    for (const auto& domain : domains) pool.Add(domain);
+    return pool;
+}
+
+void DomainPool::Reserve(size_t domains, size_t arenaBytes) {
+    m_index.reserve(domains);
+    m_arena.reserve(arenaBytes);
+}
+
+void DomainPool::Add(std::string_view domain) {
+    constexpr size_t LIMIT = std::numeric_limits<uint32_t>::max();
+    if (m_arena.size() > LIMIT - domain.size()) {
+        throw std::length_error("DomainPool arena exceeds 4 GiB");
+    }
+
+    m_index.push_back({ static_cast<uint32_t>(m_arena.size()), static_cast<uint32_t>(domain.size()) });
+    m_arena.append(domain.data(), domain.size());
+}
+
+void DomainPool::Clear() noexcept {
+    m_arena.clear();
+    m_index.clear();
+}
+
+void DomainPool::ShrinkToFit() {
+    m_arena.shrink_to_fit();
+    m_index.shrink_to_fit();
+}
+
+} // namespace utils
@@ -0,0 +1,544 @@
+// domainset.cpp
+#include "domainset.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CJ_DOMAINSET_PREFETCH 1
+#include <xmmintrin.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+constexpr size_t GALLOP_RATIO = 16;    // Gallop once one side is this many times larger
+constexpr size_t RADIX_BITS = 16;
+constexpr size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+constexpr size_t PREFETCH_DISTANCE = 8;   // Names requested ahead when walking sorted elements
+
+inline void Prefetch(const void* address) noexcept {
+#if CJ_DOMAINSET_PREFETCH
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+bool IsNameChar(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+} // anonymous namespace
+
+// ----- Elements -----
+uint64_t DomainSet::Key(std::string_view domain) noexcept {
+    uint64_t key = 0;
+    const size_t length = std::min<size_t>(domain.size(), 8);
+    for (size_t i = 0; i < length; ++i) {
+        key |= static_cast<uint64_t>(static_cast<unsigned char>(domain[i])) << (56 - 8 * i);
+    }
+    return key;
+}
+
+// Equal keys ending in a zero byte are the same name shorter than eight
+// bytes; otherwise both names are at least eight bytes long.
+int DomainSet::Compare(const Element& a, const Element& b) noexcept {
+    if (a.key != b.key) return a.key < b.key ? -1 : 1;
+    if ((a.key & 0xFF) == 0) return 0;
+    const int order = std::strcmp(a.name + 8, b.name + 8);
+    return (order > 0) - (order < 0);
+}
+
+void DomainSet::ShareArenas(DomainSet& out, const DomainSet& a, const DomainSet& b) {
+    out.m_arenas = a.m_arenas;
+    for (const auto& arena : b.m_arenas) {
+        if (std::find(out.m_arenas.begin(), out.m_arenas.end(), arena) == out.m_arenas.end()) {
+            out.m_arenas.push_back(arena);
+        }
+    }
+}
+
+namespace {
+
+// First element in [first, last) not less than `target`: exponential steps
+// from `first`, then a binary search inside the last step
+template <typename Element, typename Compare>
+const Element* Gallop(const Element* first, const Element* last, const Element& target, Compare compare) {
+    if (first == last || compare(*first, target) >= 0) return first;
+    size_t step = 1;
+    const Element* low = first;   // Known to be less than target
+    const Element* high = first + 1;
+    while (high < last && compare(*high, target) < 0) {
+        low = high;
+        step *= 2;
+        high = static_cast<size_t>(last - low) > step ? low + step : last;
+    }
+    return std::lower_bound(low + 1, high, target, [&](const Element& e, const Element& t) {
+        return compare(e, t) < 0;
+    });
+}
+
+// Eight name bytes from `offset` on, big-endian and zero-padded past the end
+uint64_t KeyAt(const char* name, size_t offset) noexcept {
+    uint64_t key = 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(name + offset);
+    for (unsigned i = 0; i < 8 && bytes[i] != 0; ++i) key |= static_cast<uint64_t>(bytes[i]) << (56 - 8 * i);
+    return key;
+}
+
+// Moves [first, last) down to `out` (which may overlap it) and returns the new end
+template <typename Element>
+Element* MoveRun(Element* out, const Element* first, const Element* last) noexcept {
+    const size_t count = static_cast<size_t>(last - first);
+    if (out != first && count) std::memmove(out, first, count * sizeof(Element));
+    return out + count;
+}
+
+} // anonymous namespace
+
+// Orders a run of names equal in their first `offset` bytes by the next
+// eight, one read per name and level, rather than by string comparisons
+// that would revisit every name log(n) times
+void DomainSet::SortTies(Element* first, Element* last, size_t offset, std::vector<KeyedElement>& scratch) {
+    scratch.clear();
+    for (Element* e = first; e != last; ++e) {
+        if (last - e > static_cast<std::ptrdiff_t>(PREFETCH_DISTANCE)) Prefetch(e[PREFETCH_DISTANCE].name + offset);
+        scratch.push_back({ KeyAt(e->name, offset), *e });
+    }
+    std::sort(scratch.begin(), scratch.end(),
+              [](const KeyedElement& a, const KeyedElement& b) { return a.key < b.key; });
+    for (size_t i = 0; i < scratch.size(); ++i) first[i] = scratch[i].element;
+
+    // Recurse into runs still tied. A key ending in a zero byte means the
+    // names ended together: those are duplicates, marked for removal.
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (size_t i = 0; i < scratch.size();) {
+        size_t end = i + 1;
+        while (end < scratch.size() && scratch[end].key == scratch[i].key) ++end;
+        if (end - i > 1) {
+            if ((scratch[i].key & 0xFF) != 0) {
+                runs.emplace_back(i, end);
+            } else {
+                for (size_t j = i + 1; j < end; ++j) first[j].name = nullptr;
+            }
+        }
+        i = end;
+    }
+    for (const auto& [begin, end] : runs) SortTies(first + begin, first + end, offset + 8, scratch);
+}
+
+// ----- Construction -----
+DomainSet DomainSet::FromPool(const DomainPool& domains) {
+    Trace::Span span("DomainSet::FromPool");
+    span.Arg("domains", domains.size());
+    DomainSet set;
+    const size_t count = domains.size();
+    if (count == 0) return set;
+
+    auto arena = std::make_shared<std::string>();
+    arena->reserve(domains.ArenaBytes() + count);
+    for (const std::string_view domain : domains) {
+        arena->append(domain.data(), domain.size());
+        arena->push_back('\0');
+    }
+    std::vector<Element> elements(count);
+    const char* cursor = arena->data();
+    for (size_t i = 0; i < count; ++i) {
+        const std::string_view domain = domains[i];
+        elements[i] = { Key(domain), cursor };
+        cursor += domain.size() + 1;
+    }
+
+    // LSD radix sort on the keys, 16 bits per pass; passes where every key
+    // has the same digit are skipped
+    {
+        Trace::Span sortSpan("DomainSet::FromPool.sort");
+        std::vector<Element> scratch(count);
+        std::vector<size_t> counts(RADIX_BUCKETS);
+        for (unsigned shift = 0; shift < 64; shift += RADIX_BITS) {
+            std::fill(counts.begin(), counts.end(), 0);
+            for (const Element& e : elements) ++counts[(e.key >> shift) & (RADIX_BUCKETS - 1)];
+            if (counts[(elements[0].key >> shift) & (RADIX_BUCKETS - 1)] == count) continue;
+
+            size_t offset = 0;
+            for (size_t& bucket : counts) {
+                const size_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+            for (const Element& e : elements) scratch[counts[(e.key >> shift) & (RADIX_BUCKETS - 1)]++] = e;
+            elements.swap(scratch);
+        }
+    }
+
+    // Names sharing their first eight bytes are ordered by the rest; duplicates
+    // come out of it marked with a null name
+    {
+        Trace::Span tieSpan("DomainSet::FromPool.ties");
+        std::vector<KeyedElement> scratch;
+        for (size_t i = 0; i < count;) {
+            size_t end = i + 1;
+            while (end < count && elements[end].key == elements[i].key) ++end;
+            if (end - i > 1 && (elements[i].key & 0xFF) != 0) {
+                SortTies(elements.data() + i, elements.data() + end, 8, scratch);
+            } else {
+                for (size_t j = i + 1; j < end; ++j) elements[j].name = nullptr;  // Short duplicates
+            }
+            i = end;
+        }
+    }
+    elements.erase(std::remove_if(elements.begin(), elements.end(), [](const Element& e) { return !e.name; }),
+                   elements.end());
+
+    // Lay the names out again in sorted order: merges and ToPool() then walk
+    // each arena front to back instead of jumping around it
+    auto sorted = std::make_shared<std::string>();
+    {
+        Trace::Span layoutSpan("DomainSet::FromPool.layout");
+        std::vector<uint32_t> sizes(elements.size());
+        size_t bytes = 0;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            if (i + PREFETCH_DISTANCE < elements.size()) Prefetch(elements[i + PREFETCH_DISTANCE].name);
+            sizes[i] = static_cast<uint32_t>(std::strlen(elements[i].name) + 1);
+            bytes += sizes[i];
+        }
+        sorted->resize(bytes);
+        char* out = sorted->data();
+        for (size_t i = 0; i < elements.size(); ++i) {
+            Element& e = elements[i];
+            if (i + PREFETCH_DISTANCE < elements.size()) Prefetch(elements[i + PREFETCH_DISTANCE].name);
+            const size_t size = sizes[i];
+            std::memcpy(out, e.name, size);
+            e.name = out;
+            out += size;
+        }
+    }
+
+    span.Arg("unique", elements.size());
+    set.m_arenas.push_back(std::move(sorted));
+    set.m_elements = std::move(elements);
+    return set;
+}
+
+// ----- Operators -----
+DomainSet DomainSet::Union(const DomainSet& a, const DomainSet& b) {
+    Trace::Span span("DomainSet::Union");
+    DomainSet out;
+    ShareArenas(out, a, b);
+    const bool aSmaller = a.size() <= b.size();
+    const std::vector<Element>& small = aSmaller ? a.m_elements : b.m_elements;
+    const std::vector<Element>& large = aSmaller ? b.m_elements : a.m_elements;
+    std::vector<Element>& result = out.m_elements;
+    result.reserve(a.size() + b.size());
+
+    const Element* x = small.data();
+    const Element* xEnd = x + small.size();
+    const Element* y = large.data();
+    const Element* yEnd = y + large.size();
+    if (small.size() * GALLOP_RATIO < large.size()) {
+        for (; x != xEnd; ++x) {
+            const Element* found = Gallop(y, yEnd, *x, Compare);
+            result.insert(result.end(), y, found);
+            y = found;
+            if (y != yEnd && Compare(*y, *x) == 0) ++y;
+            result.push_back(*x);
+        }
+    } else {
+        while (x != xEnd && y != yEnd) {
+            const int order = Compare(*x, *y);
+            result.push_back(order <= 0 ? *x : *y);
+            x += order <= 0;
+            y += order >= 0;
+        }
+        result.insert(result.end(), x, xEnd);
+    }
+    result.insert(result.end(), y, yEnd);
+    span.Arg("a", a.size()).Arg("b", b.size()).Arg("result", result.size());
+    return out;
+}
+
+// `a` is filtered in place: the write position never passes the read position
+DomainSet DomainSet::Intersection(DomainSet a, const DomainSet& b) {
+    Trace::Span span("DomainSet::Intersection");
+    span.Arg("a", a.size()).Arg("b", b.size());
+    Element* out = a.m_elements.data();
+    const Element* x = out;
+    const Element* xEnd = x + a.size();
+    const Element* y = b.m_elements.data();
+    const Element* yEnd = y + b.size();
+    if (a.size() * GALLOP_RATIO < b.size()) {
+        for (; x != xEnd && y != yEnd; ++x) {
+            y = Gallop(y, yEnd, *x, Compare);
+            if (y != yEnd && Compare(*y, *x) == 0) *out++ = *x;
+        }
+    } else if (b.size() * GALLOP_RATIO < a.size()) {
+        for (; y != yEnd && x != xEnd; ++y) {
+            x = Gallop(x, xEnd, *y, Compare);
+            if (x != xEnd && Compare(*x, *y) == 0) *out++ = *x++;
+        }
+    } else {
+        while (x != xEnd && y != yEnd) {
+            const int order = Compare(*x, *y);
+            if (order == 0) *out++ = *x;
+            x += order <= 0;
+            y += order >= 0;
+        }
+    }
+    a.m_elements.resize(static_cast<size_t>(out - a.m_elements.data()));
+    span.Arg("result", a.size());
+    return a;
+}
+
+DomainSet DomainSet::Difference(DomainSet a, const DomainSet& b) {
+    Trace::Span span("DomainSet::Difference");
+    span.Arg("a", a.size()).Arg("b", b.size());
+    Element* out = a.m_elements.data();
+    const Element* x = out;
+    const Element* xEnd = x + a.size();
+    const Element* y = b.m_elements.data();
+    const Element* yEnd = y + b.size();
+    if (b.size() * GALLOP_RATIO < a.size()) {
+        // Few removals: move the runs of `a` between them down in bulk
+        for (; y != yEnd && x != xEnd; ++y) {
+            const Element* found = Gallop(x, xEnd, *y, Compare);
+            out = MoveRun(out, x, found);
+            x = found;
+            if (x != xEnd && Compare(*x, *y) == 0) ++x;
+        }
+    } else if (a.size() * GALLOP_RATIO < b.size()) {
+        for (; x != xEnd && y != yEnd; ++x) {
+            y = Gallop(y, yEnd, *x, Compare);
+            if (y == yEnd || Compare(*y, *x) != 0) *out++ = *x;
+        }
+    } else {
+        while (x != xEnd && y != yEnd) {
+            const int order = Compare(*x, *y);
+            if (order < 0) *out++ = *x;
+            x += order <= 0;
+            y += order >= 0;
+        }
+    }
+    out = MoveRun(out, x, xEnd);
+    a.m_elements.resize(static_cast<size_t>(out - a.m_elements.data()));
+    span.Arg("result", a.size());
+    return a;
+}
+
+// ----- Queries -----
+bool DomainSet::Contains(std::string_view domain) const noexcept {
+    const uint64_t key = Key(domain);
+    auto it = std::lower_bound(m_elements.begin(), m_elements.end(), key,
+                               [](const Element& e, uint64_t k) { return e.key < k; });
+    for (; it != m_elements.end() && it->key == key; ++it) {
+        if ((key & 0xFF) == 0 || domain.substr(8) == std::string_view(it->name + 8)) return true;
+    }
+    return false;
+}
+
+void DomainSet::ToPool(DomainPool& out) const {
+    // Each arena is walked front to back, so both passes stream
+    std::vector<uint32_t> sizes(m_elements.size());
+    size_t bytes = 0;
+    for (size_t i = 0; i < m_elements.size(); ++i) {
+        sizes[i] = static_cast<uint32_t>(std::strlen(m_elements[i].name));
+        bytes += sizes[i];
+    }
+    out.Reserve(out.size() + m_elements.size(), out.ArenaBytes() + bytes);
+    for (size_t i = 0; i < m_elements.size(); ++i) out.Add(std::string_view(m_elements[i].name, sizes[i]));
+}
+
+size_t DomainSet::MemoryUsage() const noexcept {
+    size_t bytes = m_elements.capacity() * sizeof(Element);
+    for (const auto& arena : m_arenas) bytes += arena->capacity();
+    return bytes;
+}
+
+// ----- Expressions -----
+namespace {
+
+class ExpressionParser {
+public:
+    ExpressionParser(std::string_view text, std::string& error) : m_text(text), m_error(error) {}
+
+    template <typename Emit>
+    bool Parse(Emit&& emit) {
+        if (!ParseUnion(emit)) return false;
+        SkipBlanks();
+        if (m_pos != m_text.size()) return Fail("unexpected '" + std::string(1, m_text[m_pos]) + "'");
+        return true;
+    }
+
+private:
+    void SkipBlanks() noexcept {
+        while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' ||
+                                         m_text[m_pos] == '\r' || m_text[m_pos] == '\n')) {
+            ++m_pos;
+        }
+    }
+
+    bool Accept(char c) noexcept {
+        SkipBlanks();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool Fail(const std::string& message) {
+        m_error = message + " at offset " + std::to_string(m_pos);
+        return false;
+    }
+
+    // union := intersection (('|' | '+' | '-') intersection)*
+    template <typename Emit>
+    bool ParseUnion(Emit& emit) {
+        if (!ParseIntersection(emit)) return false;
+        for (;;) {
+            if (Accept('|') || Accept('+')) {
+                if (!ParseIntersection(emit)) return false;
+                emit('|', std::string());
+            } else if (Accept('-')) {
+                if (!ParseIntersection(emit)) return false;
+                emit('-', std::string());
+            } else {
+                return true;
+            }
+        }
+    }
+
+    // intersection := operand ('&' operand)*
+    template <typename Emit>
+    bool ParseIntersection(Emit& emit) {
+        if (!ParseOperand(emit)) return false;
+        while (Accept('&')) {
+            if (!ParseOperand(emit)) return false;
+            emit('&', std::string());
+        }
+        return true;
+    }
+
+    // operand := name | '"' text '"' | '(' union ')'
+    template <typename Emit>
+    bool ParseOperand(Emit& emit) {
+        if (Accept('(')) {
+            if (!ParseUnion(emit)) return false;
+            return Accept(')') || Fail("expected ')'");
+        }
+        SkipBlanks();
+        if (Accept('"')) {
+            const size_t close = m_text.find('"', m_pos);
+            if (close == std::string_view::npos) return Fail("unterminated quote");
+            if (close == m_pos) return Fail("empty name");
+            emit('\0', std::string(m_text.substr(m_pos, close - m_pos)));
+            m_pos = close + 1;
+            return true;
+        }
+        const size_t start = m_pos;
+        while (m_pos < m_text.size() && IsNameChar(m_text[m_pos])) ++m_pos;
+        if (m_pos == start) return Fail(m_pos < m_text.size() ? "expected a name" : "unexpected end");
+        emit('\0', std::string(m_text.substr(start, m_pos - start)));
+        return true;
+    }
+
+    std::string_view m_text;
+    std::string& m_error;
+    size_t m_pos = 0;
+};
+
+} // anonymous namespace
+
+bool SetExpression::Parse(std::string_view text) {
+    m_program.clear();
+    m_error.clear();
+    ExpressionParser parser(text, m_error);
+    const bool ok = parser.Parse([this](char op, std::string name) {
+        switch (op) {
+            case '|': m_program.push_back({ Op::Union, std::string() }); break;
+            case '&': m_program.push_back({ Op::Intersection, std::string() }); break;
+            case '-': m_program.push_back({ Op::Difference, std::string() }); break;
+            default:  m_program.push_back({ Op::Push, std::move(name) }); break;
+        }
+    });
+    if (!ok) {
+        m_program.clear();
+        CJ_LOG_ERROR("SetExpression", "Can't parse \"" << text << "\": " << m_error);
+    }
+    return ok;
+}
+
+bool SetExpression::Evaluate(const Resolver& resolve, DomainSet& result) const {
+    Trace::Span span("SetExpression::Evaluate");
+    if (m_program.empty()) {
+        m_error = "nothing to evaluate";
+        return false;
+    }
+    // Operands are referenced, not copied; a name used twice is loaded once
+    std::map<std::string, DomainSet, std::less<>> resolved;
+    std::deque<DomainSet> temporaries;
+    std::vector<const DomainSet*> stack;
+    for (const Step& step : m_program) {
+        if (step.op == Op::Push) {
+            auto it = resolved.find(step.name);
+            if (it == resolved.end()) {
+                DomainSet set;
+                if (!resolve(step.name, set)) {
+                    m_error = "unknown or unreadable list \"" + step.name + "\"";
+                    CJ_LOG_ERROR("SetExpression", m_error);
+                    return false;
+                }
+                it = resolved.emplace(step.name, std::move(set)).first;
+            }
+            stack.push_back(&it->second);
+            continue;
+        }
+        const DomainSet& right = *stack.back();
+        stack.pop_back();
+        const DomainSet* left = stack.back();
+        // A temporary left operand is the newest one; filters reuse its storage
+        const bool owned = !temporaries.empty() && left == &temporaries.back();
+        DomainSet combined;
+        switch (step.op) {
+            case Op::Union:
+                combined = DomainSet::Union(*left, right);
+                break;
+            case Op::Intersection:
+                combined = owned ? DomainSet::Intersection(std::move(temporaries.back()), right)
+                                 : DomainSet::Intersection(*left, right);
+                break;
+            case Op::Difference:
+                combined = owned ? DomainSet::Difference(std::move(temporaries.back()), right)
+                                 : DomainSet::Difference(*left, right);
+                break;
+            default:
+                break;
+        }
+        temporaries.push_back(std::move(combined));
+        stack.back() = &temporaries.back();
+    }
+    if (!temporaries.empty() && stack.back() == &temporaries.back()) {
+        result = std::move(temporaries.back());
+    } else {
+        result = *stack.back();
+    }
+    span.Arg("result", result.size());
+    return true;
+}
+
+std::vector<std::string> SetExpression::Names() const {
+    std::vector<std::string> names;
+    for (const Step& step : m_program) {
+        if (step.op == Op::Push && std::find(names.begin(), names.end(), step.name) == names.end()) {
+            names.push_back(step.name);
+        }
+    }
+    return names;
+}
+
+} // namespace utils
@@ -0,0 +1,106 @@
+// domainset.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "domainpool.h"
+
+namespace utils {
+
+// Sorted, deduplicated, immutable set of domains with set-algebra operators.
+// Elements are 16 bytes: the name's first eight bytes as a big-endian key,
+// and a pointer to the NUL-terminated name in a shared arena. Ordering and
+// equality are settled by the key alone unless two names share their first
+// eight bytes, so the merge kernels mostly compare integers and never touch
+// the names.
+//
+// Results share their operands' arenas instead of copying names, so an
+// operation costs 16 bytes per output element. When one operand is much
+// smaller (an allowlist against a community list), the kernels gallop
+// through the larger one and copy the runs between matches in bulk, so the
+// cost follows the smaller side.
+//
+// Names are compared bytewise and are expected to be normalized already
+// (lowercase, no trailing dot), as ListImporter emits them.
+class DomainSet {
+public:
+    DomainSet() = default;
+
+    // Sorts (radix over the keys) and drops duplicates
+    static DomainSet FromPool(const DomainPool& domains);
+
+    static DomainSet Union(const DomainSet& a, const DomainSet& b);
+    // These keep a subset of `a`; pass an rvalue to filter it in place
+    static DomainSet Intersection(DomainSet a, const DomainSet& b);
+    static DomainSet Difference(DomainSet a, const DomainSet& b);  // a - b
+
+    bool Contains(std::string_view domain) const noexcept;
+
+    // Appends every name, in sorted order
+    void ToPool(DomainPool& out) const;
+
+    size_t size() const noexcept { return m_elements.size(); }
+    bool empty() const noexcept { return m_elements.empty(); }
+    std::string_view operator[](size_t i) const noexcept { return m_elements[i].name; }
+
+    size_t MemoryUsage() const noexcept;
+
+private:
+    struct Element {
+        uint64_t key;
+        const char* name;   // NUL-terminated, in one of m_arenas
+    };
+
+    struct KeyedElement {
+        uint64_t key;
+        Element element;
+    };
+
+    static uint64_t Key(std::string_view domain) noexcept;
+    static void SortTies(Element* first, Element* last, size_t offset, std::vector<KeyedElement>& scratch);
+    static int Compare(const Element& a, const Element& b) noexcept;
+    static void ShareArenas(DomainSet& out, const DomainSet& a, const DomainSet& b);
+
+    std::vector<std::shared_ptr<const std::string>> m_arenas;
+    std::vector<Element> m_elements;
+};
+
+// Parser and evaluator for set expressions over named lists:
+//
+//   (community | corporate) - allowlist - "C:\lists\exceptions.txt"
+//
+// `|` (or `+`) is union, `&` intersection and `-` difference. `&` binds
+// tighter than `|` and `-`, which are left-associative at equal precedence.
+// Names are letters, digits, `_` and `.`; anything else can be quoted.
+class SetExpression {
+public:
+    // Looks a name up; false if it is unknown or can't be loaded
+    using Resolver = std::function<bool(std::string_view name, DomainSet& out)>;
+
+    bool Parse(std::string_view text);
+    bool Evaluate(const Resolver& resolve, DomainSet& result) const;
+
+    const std::string& GetError() const noexcept { return m_error; }
+
+    // Distinct names in order of first appearance
+    std::vector<std::string> Names() const;
+
+private:
+    enum class Op : uint8_t { Push, Union, Intersection, Difference };
+
+    struct Step {
+        Op op;
+        std::string name;   // Push only
+    };
+
+    std::vector<Step> m_program;   // Postfix
+    mutable std::string m_error;
+};
+
+} // namespace utils
@@ -0,0 +1,268 @@
+// dropdir.cpp
+#include "dropdir.h"
+#include "domainset.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace utils {
+
+namespace {
+
+constexpr size_t HASH_CHUNK = 64 * 1024;
+constexpr const char* UNION_DIRNAME = "union";
+
+bool EndsWith(std::string_view text, std::string_view suffix) {
+    return text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix;
+}
+
+// Files a writer is still staging
+bool IsIgnored(std::string_view name) {
+    return name.empty() || name.front() == '.' || EndsWith(name, ".tmp") || EndsWith(name, ".part") ||
+           EndsWith(name, "~");
+}
+
+bool HashFile(const fs::path& path, crypto::Digest& digest) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+    crypto::Sha256Stream hasher;
+    std::vector<char> chunk(HASH_CHUNK);
+    while (ifs) {
+        ifs.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        const std::streamsize got = ifs.gcount();
+        if (got > 0 && !hasher.Update(chunk.data(), static_cast<size_t>(got))) return false;
+    }
+    return ifs.eof() && hasher.Final(digest);
+}
+
+// Cache subdirectory for a list file; any file name maps to a valid one
+fs::path CacheName(const fs::path& path) {
+    const std::string name = path.filename().u8string();
+    crypto::Digest digest{};
+    crypto::Sha256(name.data(), name.size(), digest);
+    return fs::u8path(crypto::ToHex(digest).substr(0, 16));
+}
+
+// First position at or after `from` whose name isn't below `name`
+size_t Gallop(const CompiledBlocklist& list, size_t from, std::string_view name) {
+    size_t step = 1, last = from;
+    while (last < list.size() && list[last] < name) {
+        from = last + 1;
+        last = from + step;
+        step *= 2;
+    }
+    last = std::min(last, list.size());
+    while (from < last) {
+        const size_t middle = from + (last - from) / 2;
+        if (list[middle] < name) {
+            from = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return from;
+}
+
+} // anonymous namespace
+
+bool DropDirectory::Refresh(const ListImporter::Options& options, Changes* changes) {
+    Trace::Span span("DropDirectory::Refresh");
+    Changes local;
+    std::vector<fs::path> present;
+    try {
+        std::error_code ec;
+        if (!fs::is_directory(m_directory, ec)) return false;
+        if (!m_cacheCleared) {
+            // Whatever an earlier process left there describes files that may have changed since
+            fs::remove_all(m_cache, ec);
+            m_cacheCleared = true;
+        }
+
+        DomainPool added, removed;
+        for (fs::directory_iterator it(m_directory, ec), end; it != end; it.increment(ec)) {
+            if (ec) break;
+            const fs::path& path = it->path();
+            if (!it->is_regular_file(ec) || IsIgnored(path.filename().u8string())) continue;
+            ++local.scanned;
+            present.push_back(path);
+
+            const uint64_t size = it->file_size(ec);
+            if (ec) continue;
+            const fs::file_time_type writeTime = it->last_write_time(ec);
+            if (ec) continue;
+            auto found = m_sources.find(path);
+            if (found != m_sources.end() && found->second.size == size && found->second.writeTime == writeTime) {
+                continue;
+            }
+
+            crypto::Digest digest{};
+            if (!HashFile(path, digest)) {
+                CJ_LOG_WARN("DropDirectory", "Can't read " << path << "; keeping its previous contents");
+                continue;
+            }
+            if (found != m_sources.end() && found->second.digest == digest) {
+                // Touched or rewritten with the same content
+                found->second.size = size;
+                found->second.writeTime = writeTime;
+                continue;
+            }
+
+            DomainPool pool;
+            ListImporter::Stats stats;
+            if (!ListImporter::ImportFile(path, options, pool, &stats)) {
+                CJ_LOG_WARN("DropDirectory", "Failed to import " << path << "; keeping its previous contents");
+                continue;
+            }
+            Source& source = m_sources.try_emplace(path).first->second;
+            if (source.cache.empty()) source.cache = m_cache / CacheName(path);
+            if (!Update(source, pool, added, removed)) {
+                CJ_LOG_WARN("DropDirectory", "Can't cache " << path << "; keeping its previous contents");
+                if (!source.domains.IsAttached()) m_sources.erase(path);
+                continue;
+            }
+            source.size = size;
+            source.writeTime = writeTime;
+            source.digest = digest;
+            ++local.reparsed;
+            CJ_LOG_INFO("DropDirectory", "Imported " << path << ": " << source.domains.size() << " domain(s)");
+        }
+        if (ec) {
+            CJ_LOG_WARN("DropDirectory", "Can't list " << m_directory << ": " << ec.message());
+            return false;
+        }
+
+        std::sort(present.begin(), present.end());
+        for (auto it = m_sources.begin(); it != m_sources.end();) {
+            if (std::binary_search(present.begin(), present.end(), it->first)) {
+                ++it;
+                continue;
+            }
+            CJ_LOG_INFO("DropDirectory", "List removed: " << it->first);
+            it->second.domains.ToPool(removed);
+            const fs::path cache = it->second.cache;
+            it = m_sources.erase(it);   // Unmapped before its files go
+            fs::remove_all(cache, ec);
+            ++local.removed;
+        }
+        if (!ApplyDelta(std::move(added), std::move(removed), local)) {
+            Forget();
+            return false;
+        }
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("DropDirectory", "Refresh failed: " << e.what());
+        Forget();
+        return false;
+    }
+
+    span.Arg("scanned", local.scanned).Arg("reparsed", local.reparsed).Arg("removed", local.removed)
+        .Arg("added", local.added).Arg("dropped", local.dropped);
+    if (local.Any()) {
+        CJ_LOG_INFO("DropDirectory", "Union now " << m_merged.size() << " domain(s): +" << local.added
+                    << " -" << local.dropped << " from " << local.reparsed << " changed and "
+                    << local.removed << " removed file(s)");
+    }
+    if (changes) *changes = local;
+    return true;
+}
+
+// The file's new contents are published first; its previous and current
+// mappings, sorted alike, are then compared in one pass
+bool DropDirectory::Update(Source& source, const DomainPool& pool, DomainPool& added, DomainPool& removed) {
+    CompiledBlocklist current;
+    if (!CompiledBlocklist::Publish(source.cache, pool, std::string_view(), 0, false) ||
+        !current.Attach(source.cache)) {
+        return false;
+    }
+    const CompiledBlocklist& previous = source.domains;
+    size_t i = 0, j = 0;
+    while (i < previous.size() || j < current.size()) {
+        if (j == current.size() || (i < previous.size() && previous[i] < current[j])) {
+            removed.Add(previous[i++]);
+        } else if (i == previous.size() || current[j] < previous[i]) {
+            added.Add(current[j++]);
+        } else {
+            ++i;
+            ++j;
+        }
+    }
+    source.domains.Attach(source.cache);
+    return true;
+}
+
+// Cost follows the size of the change, apart from the one pass that writes
+// the new union. Every file is already at its new contents, so a removed
+// name another file still lists (or now lists) stays.
+bool DropDirectory::ApplyDelta(DomainPool added, DomainPool removed, Changes& changes) {
+    if (added.empty() && removed.empty()) return true;
+    Trace::Span span("DropDirectory::ApplyDelta");
+    // Several files may add or drop the same name
+    const DomainSet adds = DomainSet::FromPool(added);
+    const DomainSet drops = DomainSet::FromPool(removed);
+    added = DomainPool();
+    removed = DomainPool();
+
+    // Both sides are sorted, so each file is searched onward from the previous
+    // name's position: the check costs the gaps between names, not a full
+    // search per name
+    std::vector<bool> listed(drops.size());
+    for (const auto& [path, source] : m_sources) {
+        size_t position = 0;
+        for (size_t i = 0; i < drops.size() && position < source.domains.size(); ++i) {
+            if (listed[i]) continue;
+            position = Gallop(source.domains, position, drops[i]);
+            listed[i] = position < source.domains.size() && source.domains[position] == drops[i];
+        }
+    }
+    DomainPool gone;
+    for (size_t i = 0; i < drops.size(); ++i) {
+        if (!listed[i]) gone.Add(drops[i]);
+    }
+
+    DomainPool merged;
+    merged.Reserve(m_merged.size() + adds.size(), 0);
+    size_t i = 0, j = 0, k = 0, addedCount = 0, droppedCount = 0;
+    while (i < m_merged.size() || j < adds.size()) {
+        std::string_view name;
+        if (j == adds.size() || (i < m_merged.size() && m_merged[i] <= adds[j])) {
+            name = m_merged[i++];
+            if (j < adds.size() && adds[j] == name) ++j;
+        } else {
+            name = adds[j++];
+            ++addedCount;
+        }
+        while (k < gone.size() && gone[k] < name) ++k;
+        if (k < gone.size() && gone[k] == name) {
+            ++droppedCount;
+            continue;
+        }
+        merged.Add(name);
+    }
+    span.Arg("added", addedCount).Arg("dropped", droppedCount);
+    if (addedCount == 0 && droppedCount == 0) return true;
+
+    const fs::path unionPath = m_cache / UNION_DIRNAME;
+    if (!CompiledBlocklist::Publish(unionPath, merged, std::string_view(), 0, false) ||
+        !m_merged.Attach(unionPath)) {
+        CJ_LOG_ERROR("DropDirectory", "Can't publish the union to " << unionPath);
+        return false;
+    }
+    changes.added += addedCount;
+    changes.dropped += droppedCount;
+    return true;
+}
+
+// After a failure the union no longer follows from the files' contents; the
+// next scan imports every file again
+void DropDirectory::Forget() noexcept {
+    m_sources.clear();
+    m_merged.Detach();
+    m_cacheCleared = false;
+}
+
+} // namespace utils
@@ -0,0 +1,91 @@
+// dropdir.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+
+#include "compiled.h"
+#include "crypto.h"
+#include "domainpool.h"
+#include "importer.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Directory that configuration management drops blocklist files into; the
+// enforced list is the union of every file in it. Refresh() rescans it and
+// does work only for what changed:
+//
+//   - a file whose size and timestamp are unchanged is skipped unread;
+//   - otherwise it is hashed, and re-imported only when its digest changed;
+//   - the change is reduced to the domains it added and removed, and only
+//     those are merged into, or taken out of, the union. A removed domain
+//     stays while another file still lists it, which is a lookup per other
+//     file and removed name rather than a reference count per domain.
+//
+// Neither the files' domains nor the union are held on the heap between
+// scans: each is a CompiledBlocklist published under lists.cache beside the
+// directory (one subdirectory per file, plus "union") and mapped, so they
+// cost page cache rather than the watchdog's private memory. The first scan
+// clears the cache and rebuilds it; nothing an earlier process left is trusted.
+//
+// Dotfiles and names ending in .tmp, .part or ~ are ignored, so a writer can
+// stage a file beside its final name. A file that can't be read or imported
+// keeps contributing its previous contents until a good version arrives.
+class DropDirectory {
+public:
+    static constexpr const char* DIRNAME = "lists.d";
+    static constexpr const char* CACHE_DIRNAME = "lists.cache";
+
+    struct Changes {
+        size_t scanned = 0;    // List files seen
+        size_t reparsed = 0;   // New files and files whose content changed
+        size_t removed = 0;    // Files that disappeared
+        size_t added = 0;      // Domains newly in the union
+        size_t dropped = 0;    // Domains no longer in any file
+
+        bool Any() const noexcept { return added != 0 || dropped != 0; }
+    };
+
+    explicit DropDirectory(fs::path directory)
+        : m_directory(std::move(directory)), m_cache(m_directory.parent_path() / CACHE_DIRNAME) {}
+    DropDirectory(const DropDirectory&) = delete;
+    DropDirectory& operator=(const DropDirectory&) = delete;
+
+    // False (with nothing changed) if the directory doesn't exist or can't be
+    // listed; also false if the cache can't be written, and the next scan
+    // then imports every file again
+    bool Refresh(const ListImporter::Options& options, Changes* changes = nullptr);
+
+    // Sorted and normalized; empty until a scan found a list
+    const CompiledBlocklist& GetDomains() const noexcept { return m_merged; }
+    const fs::path& GetDirectory() const noexcept { return m_directory; }
+    size_t FileCount() const noexcept { return m_sources.size(); }
+
+private:
+    // Built in place in m_sources and never moved: `domains` maps its cache
+    struct Source {
+        uint64_t size = 0;
+        fs::file_time_type writeTime{};
+        crypto::Digest digest{};
+        fs::path cache;
+        CompiledBlocklist domains;
+    };
+
+    // Publishes `pool` as the file's new contents and appends what that
+    // added and removed to the scan's totals
+    bool Update(Source& source, const DomainPool& pool, DomainPool& added, DomainPool& removed);
+    bool ApplyDelta(DomainPool added, DomainPool removed, Changes& changes);
+    void Forget() noexcept;
+
+    fs::path m_directory;
+    fs::path m_cache;
+    std::map<fs::path, Source> m_sources;
+    CompiledBlocklist m_merged;
+    bool m_cacheCleared = false;
+};
+
+} // namespace utils
@@ -0,0 +1,113 @@
+// executor.cpp
+#include "executor.h"
+#include "log.h"
+#include "memtrack.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace utils {
+
+namespace {
+
+// Which executor, if any, owns the current thread, and its deque
+thread_local const Executor* t_executor = nullptr;
+thread_local size_t t_worker = 0;
+
+} // anonymous namespace
+
+Executor::Executor(size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) m_workers.push_back(std::make_unique<Worker>());
+    m_threads.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) m_threads.emplace_back([this, i] { Run(i); });
+    CJ_LOG_DEBUG("Executor", "Started " << threads << " worker(s)");
+}
+
+Executor::~Executor() {
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_stopping = true;
+    }
+    m_idle.notify_all();
+    for (std::thread& thread : m_threads) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+Executor& Executor::Shared() {
+    static Executor executor;
+    return executor;
+}
+
+void Executor::Post(std::function<void()> task) {
+    // Whatever the task allocates is charged to the operation that queued it
+    if (MemTrack::Scope* scope = MemTrack::Scope::Current()) {
+        task = [scope, inner = std::move(task)] {
+            MemTrack::Adopt adopt(scope);
+            inner();
+        };
+    }
+    const size_t home = t_executor == this ? t_worker
+                                           : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+    {
+        std::lock_guard<std::mutex> lock(m_workers[home]->mutex);
+        m_workers[home]->tasks.push_back(std::move(task));
+    }
+    m_queued.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders this with a worker that just found nothing and is about to wait
+    { std::lock_guard<std::mutex> lock(m_idleMutex); }
+    m_idle.notify_one();
+}
+
+// Own deque from the back, then the others from the front
+bool Executor::Take(size_t home, std::function<void()>& task) {
+    if (m_queued.load(std::memory_order_acquire) == 0) return false;
+    {
+        Worker& own = *m_workers[home];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < m_workers.size(); ++offset) {
+        Worker& victim = *m_workers[(home + offset) % m_workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Executor::RunPending() {
+    std::function<void()> task;
+    const size_t home = t_executor == this ? t_worker : 0;
+    if (!Take(home, task)) return false;
+    try {
+        task();
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Executor", "Task failed: " << e.what());
+    }
+    return true;
+}
+
+void Executor::Run(size_t index) {
+    t_executor = this;
+    t_worker = index;
+    while (true) {
+        if (RunPending()) continue;
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idle.wait(lock, [this] { return m_stopping || m_queued.load(std::memory_order_acquire) > 0; });
+        if (m_stopping && m_queued.load(std::memory_order_acquire) == 0) return;
+    }
+}
+
+} // namespace utils
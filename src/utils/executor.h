@@ -0,0 +1,86 @@
+// executor.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace utils {
+
+// Small work-stealing task pool. Each worker owns a deque: tasks a worker
+// posts go on the back of its own deque and it takes from the back (newest
+// first, still warm in cache); an idle worker steals from the front of the
+// others' (oldest first, the biggest remaining pieces). Tasks posted from
+// outside the pool are dealt round-robin.
+//
+// A thread waiting on a result should use Await(), which runs queued tasks
+// until the result is ready. A task can then wait on tasks it spawned, and a
+// pool with a single worker (or none free) still makes progress.
+//
+// A task posted inside a MemTrack::Scope is charged to that scope, which
+// must outlive it.
+class Executor {
+public:
+    explicit Executor(size_t threads = 0);  // 0: one per hardware thread
+    ~Executor();                            // Runs what is queued, then joins
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // Process-wide pool, started on first use
+    static Executor& Shared();
+
+    void Post(std::function<void()> task);
+
+    template <typename Function>
+    auto Submit(Function&& function) -> std::future<std::invoke_result_t<std::decay_t<Function>>> {
+        using Result = std::invoke_result_t<std::decay_t<Function>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> future = task->get_future();
+        Post([task] { (*task)(); });
+        return future;
+    }
+
+    template <typename T>
+    T Await(std::future<T>& future) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!RunPending()) future.wait_for(IDLE_WAIT);
+        }
+        return future.get();
+    }
+
+    // Runs one queued task on the calling thread; false if there was none
+    bool RunPending();
+
+    size_t ThreadCount() const noexcept { return m_threads.size(); }
+
+private:
+    // How long Await() sleeps when there is nothing to help with
+    static constexpr std::chrono::microseconds IDLE_WAIT{200};
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool Take(size_t home, std::function<void()>& task);
+    void Run(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_queued{0};
+    std::atomic<size_t> m_nextWorker{0};
+    std::mutex m_idleMutex;
+    std::condition_variable m_idle;
+    bool m_stopping = false;  // Guarded by m_idleMutex
+};
+
+} // namespace utils
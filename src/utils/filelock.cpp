@@ -0,0 +1,106 @@
+// filelock.cpp
+#include "filelock.h"
+#include "log.h"
+#include "trace.h"
+
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+FileLock::~FileLock() {
+    Release();
+}
+
+FileLock::FileLock(FileLock&& other) noexcept {
+    *this = std::move(other);
+}
+
+FileLock& FileLock::operator=(FileLock&& other) noexcept {
+    if (this != &other) {
+        Release();
+#ifdef _WIN32
+        m_handle = std::exchange(other.m_handle, nullptr);
+#else
+        m_fd = std::exchange(other.m_fd, -1);
+#endif
+    }
+    return *this;
+}
+
+bool FileLock::IsHeld() const noexcept {
+#ifdef _WIN32
+    return m_handle != nullptr;
+#else
+    return m_fd >= 0;
+#endif
+}
+
+bool FileLock::Acquire(const fs::path& path) noexcept {
+    Trace::Span span("FileLock::Acquire");
+    Release();
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        CJ_LOG_ERROR("FileLock", "Can't open lock file " << path << ". Error: " << GetLastError());
+        return false;
+    }
+    OVERLAPPED overlapped{};
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)) {
+        const DWORD error = GetLastError();
+        CloseHandle(file);
+        CJ_LOG_ERROR("FileLock", "Can't lock " << path << ". Error: " << error);
+        return false;
+    }
+    m_handle = file;
+#else
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        CJ_LOG_ERROR("FileLock", "Can't open lock file " << path << ": " << std::strerror(errno));
+        return false;
+    }
+    int rc;
+    do {
+        rc = ::flock(fd, LOCK_EX);
+    } while (rc != 0 && errno == EINTR);
+    if (rc != 0) {
+        CJ_LOG_ERROR("FileLock", "Can't lock " << path << ": " << std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+#endif
+    return true;
+}
+
+// Closing the handle drops the lock
+void FileLock::Release() noexcept {
+#ifdef _WIN32
+    if (m_handle) {
+        CloseHandle(m_handle);
+        m_handle = nullptr;
+    }
+#else
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+} // namespace utils
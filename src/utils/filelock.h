@@ -0,0 +1,39 @@
+// filelock.h
+#pragma once
+
+#include <filesystem>
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// An exclusive advisory lock on a lock file, shared by every process that
+// opens the same path (flock on POSIX, LockFileEx on Windows). The operating
+// system drops it when the holder exits, so a crashed holder never leaves a
+// stale lock behind. Locks conflict per open, so two FileLocks on one path
+// exclude each other even within a process; don't nest them.
+class FileLock {
+public:
+    FileLock() = default;
+    ~FileLock();
+    FileLock(FileLock&& other) noexcept;
+    FileLock& operator=(FileLock&& other) noexcept;
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    // Blocks until the lock is ours. Creates the file (and its directory) as
+    // needed; false if it can't be opened or locked.
+    bool Acquire(const fs::path& path) noexcept;
+    void Release() noexcept;
+
+    bool IsHeld() const noexcept;
+
+private:
+#ifdef _WIN32
+    void* m_handle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+} // namespace utils
@@ -0,0 +1,382 @@
+// fusefilter.cpp
+#include "fusefilter.h"
+#include "domainpool.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace utils {
+
+// ----- Hashing -----
+namespace {
+    constexpr char FILTER_MAGIC[4] = { 'C', 'J', 'B', 'F' };
+    constexpr uint32_t FILTER_VERSION = 1;
+    constexpr int MAX_ITERATIONS = 100;
+    constexpr uint32_t MAX_SEGMENT_LENGTH = 262144;
+
+    uint64_t Murmur64(uint64_t h) noexcept {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t SplitMix64(uint64_t& state) noexcept {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t MulHi(uint64_t a, uint64_t b) noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+        return __umulh(a, b);
+#elif defined(__SIZEOF_INT128__)
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#else
+        const uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+        const uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+        const uint64_t mid1 = aHi * bLo + ((aLo * bLo) >> 32);
+        const uint64_t mid2 = aLo * bHi + (mid1 & 0xffffffff);
+        return aHi * bHi + (mid1 >> 32) + (mid2 >> 32);
+#endif
+    }
+
+    uint8_t Fingerprint(uint64_t hash) noexcept {
+        return static_cast<uint8_t>(hash ^ (hash >> 32));
+    }
+
+    uint32_t Mod3(uint32_t x) noexcept {
+        return x > 2 ? x - 3 : x;
+    }
+}
+
+uint64_t FuseFilter::DomainKey(std::string_view domain) noexcept {
+    if (!domain.empty() && domain.back() == '.') domain.remove_suffix(1);
+
+    // FNV-1a over the lowercased name; the filter remixes it with its seed
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : domain) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (byte >= 'A' && byte <= 'Z') byte = static_cast<unsigned char>(byte - 'A' + 'a');
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint32_t FuseFilter::Hash(int index, uint64_t hash) const noexcept {
+    uint64_t h = MulHi(hash, m_header.segmentCountLength);
+    h += static_cast<uint64_t>(index) * m_header.segmentLength;
+    const uint64_t hh = hash & ((uint64_t{1} << 36) - 1);
+    h ^= (hh >> (36 - 18 * index)) & m_header.segmentLengthMask;
+    return static_cast<uint32_t>(h);
+}
+
+void FuseFilter::Hashes(uint64_t hash, uint32_t& h0, uint32_t& h1, uint32_t& h2) const noexcept {
+    const uint64_t hl = MulHi(hash, m_header.segmentCountLength);
+    h0 = static_cast<uint32_t>(hl);
+    h1 = h0 + m_header.segmentLength;
+    h2 = h1 + m_header.segmentLength;
+    h1 ^= static_cast<uint32_t>(hash >> 18) & m_header.segmentLengthMask;
+    h2 ^= static_cast<uint32_t>(hash) & m_header.segmentLengthMask;
+}
+
+// ----- Lifetime -----
+FuseFilter::~FuseFilter() {
+    Reset();
+}
+
+FuseFilter::FuseFilter(FuseFilter&& other) noexcept {
+    *this = std::move(other);
+}
+
+FuseFilter& FuseFilter::operator=(FuseFilter&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        m_header = other.m_header;
+        m_storage = std::move(other.m_storage);
+        m_fingerprints = other.m_mapping.IsOpen() ? other.m_fingerprints
+                                                  : (m_storage.empty() ? nullptr : m_storage.data());
+        m_mapping = std::move(other.m_mapping);
+        other.m_fingerprints = nullptr;
+        other.m_header = Header{};
+    }
+    return *this;
+}
+
+void FuseFilter::Reset() noexcept {
+    m_mapping.Close();
+    m_storage.clear();
+    m_storage.shrink_to_fit();
+    m_fingerprints = nullptr;
+    m_header = Header{};
+}
+
+// ----- Construction -----
+bool FuseFilter::Build(const DomainPool& domains) {
+    std::vector<uint64_t> keys;
+    try {
+        keys.reserve(domains.size());
+        for (std::string_view domain : domains) keys.push_back(DomainKey(domain));
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("FuseFilter", "Build failed: " << e.what());
+        Reset();
+        return false;
+    }
+    return BuildFromKeys(std::move(keys));
+}
+
+bool FuseFilter::BuildFromKeys(std::vector<uint64_t> keys) {
+    Trace::Span span("FuseFilter::Build");
+    span.Arg("keys", keys.size());
+    Reset();
+
+    try {
+        // Peeling cannot succeed with repeated keys, so drop them up front
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        if (!Populate(keys)) {
+            Reset();
+            return false;
+        }
+        span.Arg("bytes", m_header.arrayLength);
+        CJ_LOG_DEBUG("FuseFilter", "Built filter: " << m_header.entryCount << " key(s), "
+                     << m_header.arrayLength << " bytes");
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("FuseFilter", "Build failed: " << e.what());
+        Reset();
+        return false;
+    }
+}
+
+bool FuseFilter::Populate(std::vector<uint64_t>& keys) {
+    const uint32_t size = static_cast<uint32_t>(keys.size());
+    constexpr uint32_t arity = 3;
+
+    // Geometry from the reference implementation: segments shrink relative to
+    // the key count as it grows, which keeps construction cache-friendly
+    uint32_t segmentLength = size == 0 ? 4
+        : uint32_t{1} << static_cast<int>(std::floor(std::log(static_cast<double>(size)) / std::log(3.33) + 2.25));
+    if (segmentLength > MAX_SEGMENT_LENGTH) segmentLength = MAX_SEGMENT_LENGTH;
+    const double sizeFactor = size <= 1 ? 0.0
+        : std::max(1.125, 0.875 + 0.25 * std::log(1000000.0) / std::log(static_cast<double>(size)));
+    const uint32_t capacity = size <= 1 ? 0 : static_cast<uint32_t>(std::round(size * sizeFactor));
+    // For tiny sets this wraps around and the clamp below restores one segment
+    const uint32_t initSegmentCount = (capacity + segmentLength - 1) / segmentLength - (arity - 1);
+    uint32_t arrayLength = (initSegmentCount + arity - 1) * segmentLength;
+    uint32_t segmentCount = (arrayLength + segmentLength - 1) / segmentLength;
+    segmentCount = segmentCount <= arity - 1 ? 1 : segmentCount - (arity - 1);
+    arrayLength = (segmentCount + arity - 1) * segmentLength;
+
+    std::memcpy(m_header.magic, FILTER_MAGIC, sizeof(FILTER_MAGIC));
+    m_header.version = FILTER_VERSION;
+    m_header.segmentLength = segmentLength;
+    m_header.segmentLengthMask = segmentLength - 1;
+    m_header.segmentCount = segmentCount;
+    m_header.segmentCountLength = segmentCount * segmentLength;
+    m_header.arrayLength = arrayLength;
+    m_header.entryCount = size;
+    m_storage.assign(arrayLength, 0);
+    m_fingerprints = m_storage.data();
+
+    std::vector<uint64_t> reverseOrder(size + 1, 0);
+    std::vector<uint32_t> alone(arrayLength);
+    std::vector<uint8_t> t2count(arrayLength, 0);
+    std::vector<uint64_t> t2hash(arrayLength, 0);
+    std::vector<uint8_t> reverseH(size);
+
+    uint32_t blockBits = 1;
+    while ((uint32_t{1} << blockBits) < segmentCount) ++blockBits;
+    const uint32_t block = uint32_t{1} << blockBits;
+    std::vector<uint32_t> startPos(block);
+
+    uint64_t rngState = 0x726b2b9d438b9d4dULL;
+    m_header.seed = SplitMix64(rngState);
+    reverseOrder[size] = 1;  // Sentinel for the bucketing scan below
+
+    uint32_t h012[5];
+    for (int iteration = 0; ; ++iteration) {
+        if (iteration >= MAX_ITERATIONS) {
+            CJ_LOG_ERROR("FuseFilter", "Construction did not converge");
+            return false;
+        }
+
+        // Bucket hashes by segment so the counting pass walks memory in order
+        for (uint32_t i = 0; i < block; ++i) {
+            startPos[i] = static_cast<uint32_t>((static_cast<uint64_t>(i) * size) >> blockBits);
+        }
+        const uint32_t maskBlock = block - 1;
+        for (uint32_t i = 0; i < size; ++i) {
+            const uint64_t hash = Murmur64(keys[i] + m_header.seed);
+            uint32_t segment = static_cast<uint32_t>(hash >> (64 - blockBits));
+            while (reverseOrder[startPos[segment]] != 0) {
+                segment = (segment + 1) & maskBlock;
+            }
+            reverseOrder[startPos[segment]] = hash;
+            ++startPos[segment];
+        }
+
+        bool overflow = false;
+        for (uint32_t i = 0; i < size; ++i) {
+            const uint64_t hash = reverseOrder[i];
+            const uint32_t h0 = Hash(0, hash), h1 = Hash(1, hash), h2 = Hash(2, hash);
+            t2count[h0] += 4;
+            t2hash[h0] ^= hash;
+            t2count[h1] += 4;
+            t2count[h1] ^= 1;
+            t2hash[h1] ^= hash;
+            t2count[h2] += 4;
+            t2count[h2] ^= 2;
+            t2hash[h2] ^= hash;
+            // The 6-bit slot counter wrapped around; retry with another seed
+            overflow |= t2count[h0] < 4 || t2count[h1] < 4 || t2count[h2] < 4;
+        }
+
+        uint32_t stackSize = 0;
+        if (!overflow) {
+            // Peel: repeatedly take a slot touched by exactly one key
+            uint32_t queueSize = 0;
+            for (uint32_t i = 0; i < arrayLength; ++i) {
+                alone[queueSize] = i;
+                queueSize += (t2count[i] >> 2) == 1 ? 1 : 0;
+            }
+
+            while (queueSize > 0) {
+                const uint32_t index = alone[--queueSize];
+                if ((t2count[index] >> 2) != 1) continue;
+
+                const uint64_t hash = t2hash[index];
+                h012[1] = Hash(1, hash);
+                h012[2] = Hash(2, hash);
+                h012[3] = Hash(0, hash);
+                h012[4] = h012[1];
+                const uint8_t found = t2count[index] & 3;
+                reverseH[stackSize] = found;
+                reverseOrder[stackSize] = hash;
+                ++stackSize;
+
+                const uint32_t other1 = h012[found + 1];
+                alone[queueSize] = other1;
+                queueSize += (t2count[other1] >> 2) == 2 ? 1 : 0;
+                t2count[other1] -= 4;
+                t2count[other1] ^= static_cast<uint8_t>(Mod3(found + 1));
+                t2hash[other1] ^= hash;
+
+                const uint32_t other2 = h012[found + 2];
+                alone[queueSize] = other2;
+                queueSize += (t2count[other2] >> 2) == 2 ? 1 : 0;
+                t2count[other2] -= 4;
+                t2count[other2] ^= static_cast<uint8_t>(Mod3(found + 2));
+                t2hash[other2] ^= hash;
+            }
+        }
+
+        if (!overflow && stackSize == size) break;
+
+        std::fill(reverseOrder.begin(), reverseOrder.end() - 1, 0);
+        std::fill(t2count.begin(), t2count.end(), 0);
+        std::fill(t2hash.begin(), t2hash.end(), 0);
+        m_header.seed = SplitMix64(rngState);
+    }
+
+    // Assign fingerprints in reverse peeling order
+    for (uint32_t i = size; i-- > 0;) {
+        const uint64_t hash = reverseOrder[i];
+        const uint8_t found = reverseH[i];
+        h012[0] = Hash(0, hash);
+        h012[1] = Hash(1, hash);
+        h012[2] = Hash(2, hash);
+        h012[3] = h012[0];
+        h012[4] = h012[1];
+        m_storage[h012[found]] = Fingerprint(hash) ^ m_storage[h012[found + 1]] ^ m_storage[h012[found + 2]];
+    }
+    return true;
+}
+
+// ----- Query -----
+bool FuseFilter::MayContain(std::string_view domain) const noexcept {
+    if (!m_fingerprints) return false;
+
+    const uint64_t hash = Murmur64(DomainKey(domain) + m_header.seed);
+    uint32_t h0, h1, h2;
+    Hashes(hash, h0, h1, h2);
+    return (Fingerprint(hash) ^ m_fingerprints[h0] ^ m_fingerprints[h1] ^ m_fingerprints[h2]) == 0;
+}
+
+// ----- Persistence -----
+bool FuseFilter::Save(const fs::path& path) const noexcept {
+    if (!m_fingerprints) return false;
+
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    try {
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        {
+            std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+            if (!ofs) return false;
+            ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            ofs.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+            ofs.write(reinterpret_cast<const char*>(m_fingerprints), m_header.arrayLength);
+        }
+        fs::rename(tempPath, path);
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("FuseFilter", "Save failed: " << e.what());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+}
+
+bool FuseFilter::Map(const fs::path& path) noexcept {
+    Trace::Span span("FuseFilter::Map");
+    Reset();
+
+    // Mapped however small, so queries read straight from the page cache
+    if (!m_mapping.Open(path, MappedFile::Access::Random, 0) || m_mapping.size() < sizeof(Header)) {
+        Reset();
+        return false;
+    }
+
+    // Every index a query derives from the header must land inside the array,
+    // so the geometry is checked in 64 bits where a crafted header can't wrap
+    Header header;
+    std::memcpy(&header, m_mapping.data(), sizeof(header));
+    const uint64_t segmentLength = header.segmentLength;
+    const uint64_t segmentCount = header.segmentCount;
+    if (std::memcmp(header.magic, FILTER_MAGIC, sizeof(FILTER_MAGIC)) != 0 ||
+        header.version != FILTER_VERSION ||
+        segmentLength == 0 || segmentLength > MAX_SEGMENT_LENGTH ||
+        (segmentLength & (segmentLength - 1)) != 0 ||
+        header.segmentLengthMask != segmentLength - 1 ||
+        segmentCount == 0 ||
+        header.segmentCountLength != segmentCount * segmentLength ||
+        header.arrayLength != (segmentCount + 2) * segmentLength ||
+        static_cast<uint64_t>(m_mapping.size()) != sizeof(Header) + static_cast<uint64_t>(header.arrayLength)) {
+        CJ_LOG_WARN("FuseFilter", "Ignoring malformed filter file " << path);
+        Reset();
+        return false;
+    }
+
+    m_header = header;
+    m_fingerprints = m_mapping.data() + sizeof(Header);
+    span.Arg("bytes", header.arrayLength);
+    return true;
+}
+
+} // namespace utils
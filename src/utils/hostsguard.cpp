@@ -0,0 +1,101 @@
+// hostsguard.cpp
+#include "hostsguard.h"
+#include "blocker.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <system_error>
+#include <thread>
+
+namespace utils {
+
+namespace {
+
+constexpr std::chrono::milliseconds GUARD_SLICE(50);
+
+// Repair metrics, registered on first use
+struct RepairMetrics {
+    Metrics::Counter& detections = Metrics::GetCounter(
+        "cj_watchdog_detections_total", "Hosts file modifications detected");
+    Metrics::Counter& repairs = Metrics::GetCounter(
+        "cj_watchdog_repairs_total", "Managed block rewrites after a detected modification");
+    Metrics::Counter& repairFailures = Metrics::GetCounter(
+        "cj_watchdog_repair_failures_total", "Detected modifications the watchdog failed to repair");
+    Metrics::Histogram& repairLatency = Metrics::GetHistogram(
+        "cj_watchdog_repair_latency_seconds", "Time from the tampering write to the restored hosts file");
+    Metrics::Histogram& repairDuration = Metrics::GetHistogram(
+        "cj_watchdog_repair_duration_seconds", "Time spent verifying and rewriting the hosts file");
+};
+
+RepairMetrics& GetMetrics() {
+    static RepairMetrics metrics;
+    return metrics;
+}
+
+} // anonymous namespace
+
+bool HostsGuard::Reset() {
+    std::error_code ec;
+    const fs::file_time_type writeTime = fs::last_write_time(m_blocker.getHostsPath(), ec);
+    if (ec) {
+        CJ_LOG_ERROR("HostsGuard", "Can't read the hosts file's timestamp: " << ec.message());
+        return false;
+    }
+    m_lastWriteTime = writeTime;
+    return true;
+}
+
+bool HostsGuard::Check() {
+    Trace::Span span("HostsGuard::Check");
+    std::error_code ec;
+    const fs::file_time_type tamperTime = fs::last_write_time(m_blocker.getHostsPath(), ec);
+    if (ec) {
+        CJ_LOG_ERROR("HostsGuard", "Can't read the hosts file's timestamp: " << ec.message());
+        return false;
+    }
+    if (tamperTime == m_lastWriteTime) return true;
+
+    Trace::Span repairSpan("HostsGuard::repair");
+    RepairMetrics& metrics = GetMetrics();
+    const auto repairStart = std::chrono::steady_clock::now();
+    metrics.detections.Add();
+    CJ_LOG_INFO("HostsGuard", "Hosts file modification detected");
+
+    if (!m_blocker.isBlocked()) {
+        if (!m_blocker.reapplyBlock()) {
+            metrics.repairFailures.Add();
+            CJ_LOG_ERROR("HostsGuard", "Failed to restore block");
+            return false;
+        }
+        metrics.repairs.Add();
+        // Negative when the tampering write was stamped ahead of our clock; Record() takes that as 0
+        metrics.repairLatency.Record(fs::file_time_type::clock::now() - tamperTime);
+    } else {
+        // Our own apply rewrote the block; follow its domains and mode
+        m_blocker.loadManagedDomains();
+    }
+    metrics.repairDuration.Record(std::chrono::steady_clock::now() - repairStart);
+
+    return Reset();
+}
+
+bool HostsGuard::Run(const std::atomic<bool>& stop, std::chrono::milliseconds interval) {
+    if (!Reset()) return false;
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (!Check()) return false;
+
+        // Sleep in short slices so a stop request is honored promptly
+        const auto wake = std::chrono::steady_clock::now() + interval;
+        while (!stop.load(std::memory_order_relaxed)) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= wake) break;
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(GUARD_SLICE, wake - now));
+        }
+    }
+    return true;
+}
+
+} // namespace utils
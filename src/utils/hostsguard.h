@@ -0,0 +1,39 @@
+// hostsguard.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+
+class Blocker;
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// The hosts-file half of a watchdog: notices writes to the hosts file by its
+// timestamp and rewrites the block when it is no longer intact. Kept apart
+// from the Win32 process handling so the tamper simulator drives the same
+// repair path on any platform.
+class HostsGuard {
+public:
+    explicit HostsGuard(Blocker& blocker) noexcept : m_blocker(blocker) {}
+
+    // Takes the hosts file's current timestamp as seen, e.g. after our own
+    // write. False when it can't be read.
+    bool Reset();
+
+    // Repairs the block if the hosts file was written since the last check.
+    // False when the file can't be read or the repair failed.
+    bool Check();
+
+    // Reset(), then Check() every `interval` until `stop` is set. Returns
+    // false as soon as a check fails, where a watchdog would exit.
+    bool Run(const std::atomic<bool>& stop, std::chrono::milliseconds interval);
+
+private:
+    Blocker& m_blocker;
+    fs::file_time_type m_lastWriteTime{};
+};
+
+} // namespace utils
@@ -1,21 +1,26 @@
 #include <windows.h>
-#include <fstream>
 #include <string>
 
+#include "log.h"
+
 int wmain(int argc, wchar_t* argv[]) {
-    std::wofstream log(L"C:\\hostswriter.log", std::ios::app);
-    log << L"=== hostswriter.exe START ===\n";
+    Logging::Config logConfig;
+    logConfig.file = L"C:\\ProgramData\\ChickenJockey\\logs\\hostswriter.log";
+    logConfig.consoleLevel = Logging::Level::Off;
+    Logging::Session logSession(logConfig);
+
+    CJ_LOG_INFO("hostswriter", "=== hostswriter.exe START ===");
 
     if (argc != 3) {
-        log << L"[hostswriter] Invalid arguments.\n";
+        CJ_LOG_ERROR("hostswriter", "Invalid arguments.");
         return 1;
     }
 
     const std::wstring source = argv[1];
     const std::wstring target = argv[2];
 
-    log << L"[hostswriter] Copying from: " << source << L"\n";
-    log << L"[hostswriter] Copying to:   " << target << L"\n";
+    CJ_LOG_INFO("hostswriter", "Copying from: " << source);
+    CJ_LOG_INFO("hostswriter", "Copying to:   " << target);
 
     // Disable file system redirection if 32-bit
     void* oldValue = nullptr;
@@ -28,10 +33,10 @@ int wmain(int argc, wchar_t* argv[]) {
 
     if (!result) {
         DWORD err = GetLastError();
-        log << L"[hostswriter] Copy failed. WinError: " << err << L"\n";
+        CJ_LOG_ERROR("hostswriter", "Copy failed. WinError: " << err);
         return 2;
     }
 
-    log << L"[hostswriter] Copy successful.\n";
+    CJ_LOG_INFO("hostswriter", "Copy successful.");
     return 0;
 }
@@ -0,0 +1,356 @@
+// idna.cpp
+#include "idna.h"
+#include "transcode.h"
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef CJ_HAVE_ICU
+#include <unicode/uidna.h>
+#endif
+
+namespace Idna {
+    namespace {
+        constexpr size_t MAX_LABEL_LENGTH = 63;
+        constexpr size_t MAX_NAME_LENGTH = 255;   // Longest encoded name a backend may produce
+
+        // ----- Punycode (RFC 3492 section 5) -----
+        constexpr uint32_t BASE = 36, TMIN = 1, TMAX = 26, SKEW = 38, DAMP = 700;
+        constexpr uint32_t INITIAL_BIAS = 72, INITIAL_N = 0x80;
+
+        char EncodeDigit(uint32_t digit) noexcept {
+            return static_cast<char>(digit < 26 ? 'a' + digit : '0' + digit - 26);
+        }
+
+        uint32_t Adapt(uint32_t delta, uint32_t points, bool first) noexcept {
+            delta = first ? delta / DAMP : delta / 2;
+            delta += delta / points;
+            uint32_t k = 0;
+            while (delta > ((BASE - TMIN) * TMAX) / 2) {
+                delta /= BASE - TMIN;
+                k += BASE;
+            }
+            return k + (BASE - TMIN + 1) * delta / (delta + SKEW);
+        }
+
+        void ToLowerAscii(std::string& text) noexcept {
+            for (char& c : text) {
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+
+        // ----- Built-in Mapping -----
+        // Strict: overlongs, surrogates and truncated sequences fail
+        bool DecodeUtf8(std::string_view in, std::u32string& out) {
+            out.clear();
+            for (size_t i = 0; i < in.size();) {
+                const uint8_t lead = static_cast<uint8_t>(in[i]);
+                size_t need;
+                char32_t cp;
+                if (lead < 0x80) {
+                    out.push_back(lead);
+                    ++i;
+                    continue;
+                } else if (lead >= 0xC2 && lead <= 0xDF) {
+                    need = 1;
+                    cp = lead & 0x1F;
+                } else if (lead >= 0xE0 && lead <= 0xEF) {
+                    need = 2;
+                    cp = lead & 0x0F;
+                } else if (lead >= 0xF0 && lead <= 0xF4) {
+                    need = 3;
+                    cp = lead & 0x07;
+                } else {
+                    return false;
+                }
+                if (in.size() - i <= need) return false;
+                for (size_t k = 1; k <= need; ++k) {
+                    const uint8_t trail = static_cast<uint8_t>(in[i + k]);
+                    if ((trail & 0xC0) != 0x80) return false;
+                    cp = (cp << 6) | (trail & 0x3F);
+                }
+                if ((need == 2 && cp < 0x800) || (need == 3 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+                    (cp >= 0xD800 && cp <= 0xDFFF)) {
+                    return false;
+                }
+                out.push_back(cp);
+                i += need + 1;
+            }
+            return true;
+        }
+
+        // Case pairs laid out as alternating upper/lower code points
+        char32_t FoldPair(char32_t c, bool upperIsEven) noexcept {
+            return (c % 2 == 0) == upperIsEven ? c + 1 : c;
+        }
+
+        // Appends the UTS #46 mapping of `c`. False if it is disallowed, maps
+        // to a sequence this table leaves out, or isn't covered at all.
+        bool MapBuiltin(char32_t c, std::u32string& out) {
+            if (c < 0x80) {
+                if (c >= 'A' && c <= 'Z') {
+                    c += 'a' - 'A';
+                } else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.')) {
+                    return false;
+                }
+                out.push_back(c);
+                return true;
+            }
+
+            // Ignored: soft hyphen, joiners and variation selectors
+            if (c == 0x00AD || c == 0x034F || c == 0x200B || c == 0x2060 || c == 0xFEFF ||
+                (c >= 0x180B && c <= 0x180D) || (c >= 0xFE00 && c <= 0xFE0F)) {
+                return true;
+            }
+            if (c == 0x3002 || c == 0xFF0E || c == 0xFF61) {
+                out.push_back(U'.');                    // Ideographic and fullwidth full stops
+                return true;
+            }
+            if (c >= 0xFF01 && c <= 0xFF5E) return MapBuiltin(c - 0xFEE0, out);  // Fullwidth ASCII
+
+            // Latin-1, Latin Extended-A and the Vietnamese letters
+            if (c == 0x00AA) c = U'a';
+            else if (c == 0x00BA) c = U'o';
+            else if (c == 0x00B5) c = 0x03BC;
+            else if (c >= 0x00C0 && c <= 0x00DE && c != 0x00D7) c += 0x20;
+            else if (c == 0x0130 || c == 0x0132 || c == 0x0133 || c == 0x013F || c == 0x0140 || c == 0x0149) {
+                return false;                           // Map to two code points
+            }
+            else if (c == 0x0178) c = 0x00FF;
+            else if (c == 0x017F) c = U's';
+            else if ((c >= 0x0100 && c <= 0x0137) || (c >= 0x014A && c <= 0x0177)) c = FoldPair(c, true);
+            else if ((c >= 0x0139 && c <= 0x0148) || (c >= 0x0179 && c <= 0x017E)) c = FoldPair(c, false);
+            else if (c == 0x01A0 || c == 0x01AF) c += 1;
+            else if ((c >= 0x1E00 && c <= 0x1E95) || (c >= 0x1EA0 && c <= 0x1EFF)) c = FoldPair(c, true);
+            else if (c == 0x1E9E) {
+                out.append(U"ss");
+                return true;
+            }
+            // Greek and Cyrillic
+            else if (c == 0x0386) c = 0x03AC;
+            else if (c >= 0x0388 && c <= 0x038A) c += 0x25;
+            else if (c == 0x038C) c = 0x03CC;
+            else if (c == 0x038E || c == 0x038F) c += 0x3F;
+            else if (c >= 0x0391 && c <= 0x03AB && c != 0x03A2) c += 0x20;
+            else if (c >= 0x0400 && c <= 0x040F) c += 0x50;
+            else if (c >= 0x0410 && c <= 0x042F) c += 0x20;
+            else if ((c >= 0x0460 && c <= 0x0481) || (c >= 0x048A && c <= 0x04BF) || (c >= 0x04D0 && c <= 0x04FF)) {
+                c = FoldPair(c, true);
+            }
+            else if (c >= 0x04C1 && c <= 0x04CE) c = FoldPair(c, false);
+            else if (c == 0x0E33) {
+                out.append(U"\u0E4D\u0E32");  // Thai SARA AM decomposes under NFKC
+                return true;
+            }
+
+            if (c < 0x80) {
+                out.push_back(c);                       // ª, º and ſ
+                return true;
+            }
+            const bool valid =
+                (c >= 0x00DF && c <= 0x00FF && c != 0x00F7) || (c >= 0x0101 && c <= 0x017E) ||
+                c == 0x01A1 || c == 0x01B0 || (c >= 0x1E01 && c <= 0x1E99) || c == 0x1E9C || c == 0x1E9D ||
+                c == 0x1E9F || (c >= 0x1EA1 && c <= 0x1EFF) ||
+                c == 0x0390 || (c >= 0x03AC && c <= 0x03CE) ||
+                (c >= 0x0430 && c <= 0x045F) || (c >= 0x0461 && c <= 0x0481) ||
+                (c >= 0x048B && c <= 0x04FF && c != 0x04C0) ||
+                (c >= 0x0E01 && c <= 0x0E3A) || (c >= 0x0E40 && c <= 0x0E4E) || (c >= 0x0E50 && c <= 0x0E59) ||
+                (c >= 0x3005 && c <= 0x3007) || (c >= 0x3041 && c <= 0x3096) || c == 0x309D || c == 0x309E ||
+                (c >= 0x30A1 && c <= 0x30FA) || (c >= 0x30FC && c <= 0x30FE) ||
+                (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x4E00 && c <= 0x9FFF) || (c >= 0xAC00 && c <= 0xD7A3);
+            if (!valid) return false;
+            out.push_back(c);
+            return true;
+        }
+
+        // The only combining marks MapBuiltin lets through
+        bool IsThaiMark(char32_t c) noexcept {
+            return c == 0x0E31 || (c >= 0x0E34 && c <= 0x0E3A) || (c >= 0x0E47 && c <= 0x0E4E);
+        }
+
+        bool AppendLabel(std::u32string_view label, std::string& out, std::string& encoded) {
+            if (label.front() == U'-' || label.back() == U'-') return false;
+            bool ascii = true;
+            for (char32_t c : label) ascii = ascii && c < 0x80;
+            if (ascii) {
+                if (label.size() > MAX_LABEL_LENGTH) return false;
+                for (char32_t c : label) out.push_back(static_cast<char>(c));
+                return true;
+            }
+            if (IsThaiMark(label.front())) return false;
+            if (!EncodePunycode(label, encoded) || encoded.size() + 4 > MAX_LABEL_LENGTH) return false;
+            out.append("xn--").append(encoded);
+            return true;
+        }
+
+        bool ToAsciiBuiltin(std::string_view name, std::string& out) {
+            std::u32string decoded, mapped;
+            if (!DecodeUtf8(name, decoded)) return false;
+            for (char32_t c : decoded) {
+                if (!MapBuiltin(c, mapped)) return false;
+            }
+
+            out.clear();
+            std::string encoded;
+            const std::u32string_view labels = mapped;
+            size_t start = 0;
+            while (true) {
+                const size_t dot = labels.find(U'.', start);
+                const size_t length = dot == std::u32string_view::npos ? dot : dot - start;
+                const std::u32string_view label = labels.substr(start, length);
+                if (dot == std::u32string_view::npos && label.empty() && start > 0) return true;  // Root
+                if (label.empty() || !AppendLabel(label, out, encoded)) return false;
+                if (dot == std::u32string_view::npos) return true;
+                out.push_back('.');
+                start = dot + 1;
+            }
+        }
+
+        // ----- ICU -----
+#ifdef CJ_HAVE_ICU
+        // A UIDNA is immutable once opened and safe to share between threads
+        const UIDNA* IcuInstance() noexcept {
+            static const UIDNA* const instance = [] {
+                UErrorCode error = U_ZERO_ERROR;
+                UIDNA* idna = uidna_openUTS46(UIDNA_NONTRANSITIONAL_TO_ASCII | UIDNA_CHECK_BIDI |
+                                              UIDNA_CHECK_CONTEXTJ, &error);
+                return U_SUCCESS(error) ? idna : nullptr;
+            }();
+            return instance;
+        }
+
+        bool ToAsciiIcu(std::string_view name, std::string& out) {
+            const UIDNA* idna = IcuInstance();
+            if (!idna || name.size() > INT32_MAX) return false;
+            char buffer[MAX_NAME_LENGTH + 1];
+            UIDNAInfo info = UIDNA_INFO_INITIALIZER;
+            UErrorCode error = U_ZERO_ERROR;
+            const int32_t length = uidna_nameToASCII_UTF8(idna, name.data(), static_cast<int32_t>(name.size()),
+                                                          buffer, sizeof(buffer), &info, &error);
+            if (U_FAILURE(error) || info.errors != 0) return false;
+            out.assign(buffer, static_cast<size_t>(length));
+            return true;
+        }
+#endif
+
+        // ----- Windows -----
+#ifdef _WIN32
+        // Flags 0: no IDN_USE_STD3_ASCII_RULES, which would refuse underscores
+        bool ToAsciiWindows(std::string_view name, std::string& out) {
+            const std::u16string wide = Transcode::Utf8ToUtf16(name);
+            if (wide.size() > INT_MAX) return false;
+            wchar_t buffer[MAX_NAME_LENGTH + 1];
+            const int length = IdnToAscii(0, reinterpret_cast<LPCWSTR>(wide.data()), static_cast<int>(wide.size()),
+                                          buffer, static_cast<int>(MAX_NAME_LENGTH + 1));
+            if (length <= 0) return false;   // Also U+FFFD from ill-formed UTF-8: it is disallowed
+            out.resize(static_cast<size_t>(length));
+            for (int i = 0; i < length; ++i) {
+                if (buffer[i] >= 0x80) return false;
+                out[i] = static_cast<char>(buffer[i]);
+            }
+            ToLowerAscii(out);
+            return true;
+        }
+#endif
+
+        constexpr Backend DefaultBackend() noexcept {
+#if defined(_WIN32)
+            return Backend::Windows;
+#elif defined(CJ_HAVE_ICU)
+            return Backend::Icu;
+#else
+            return Backend::Builtin;
+#endif
+        }
+
+        std::atomic<Backend> g_backend{DefaultBackend()};
+    } // anonymous namespace
+
+    Backend ActiveBackend() noexcept {
+        return g_backend.load(std::memory_order_relaxed);
+    }
+
+    Backend ForceBackend(Backend backend) noexcept {
+        bool available = backend == Backend::Builtin;
+#ifdef CJ_HAVE_ICU
+        available = available || backend == Backend::Icu;
+#endif
+#ifdef _WIN32
+        available = available || backend == Backend::Windows;
+#endif
+        if (!available) backend = DefaultBackend();
+        g_backend.store(backend, std::memory_order_relaxed);
+        return backend;
+    }
+
+    const char* BackendName(Backend backend) noexcept {
+        switch (backend) {
+            case Backend::Builtin: return "builtin";
+            case Backend::Icu:     return "icu";
+            case Backend::Windows: return "windows";
+            default:               return "unknown";
+        }
+    }
+
+    bool ToAscii(std::string_view name, std::string& out) {
+        if (Transcode::AsciiLength(name.data(), name.size()) == name.size()) {
+            out.assign(name.data(), name.size());
+            ToLowerAscii(out);
+            return true;
+        }
+
+        switch (ActiveBackend()) {
+#ifdef CJ_HAVE_ICU
+            case Backend::Icu:     return ToAsciiIcu(name, out);
+#endif
+#ifdef _WIN32
+            case Backend::Windows: return ToAsciiWindows(name, out);
+#endif
+            default:               return ToAsciiBuiltin(name, out);
+        }
+    }
+
+    bool EncodePunycode(std::u32string_view label, std::string& out) {
+        out.clear();
+        for (char32_t c : label) {
+            if (c < 0x80) out.push_back(static_cast<char>(c));
+        }
+        const size_t basic = out.size();
+        if (basic > 0) out.push_back('-');
+
+        uint32_t n = INITIAL_N, delta = 0, bias = INITIAL_BIAS;
+        size_t handled = basic;
+        while (handled < label.size()) {
+            uint32_t next = UINT32_MAX;
+            for (char32_t c : label) {
+                if (c >= n && c < next) next = c;
+            }
+            if (next - n > (UINT32_MAX - delta) / (handled + 1)) return false;
+            delta += (next - n) * static_cast<uint32_t>(handled + 1);
+            n = next;
+
+            for (char32_t c : label) {
+                if (c < n && ++delta == 0) return false;
+                if (c != n) continue;
+                uint32_t q = delta;
+                for (uint32_t k = BASE;; k += BASE) {
+                    const uint32_t t = k <= bias ? TMIN : k >= bias + TMAX ? TMAX : k - bias;
+                    if (q < t) break;
+                    out.push_back(EncodeDigit(t + (q - t) % (BASE - t)));
+                    q = (q - t) / (BASE - t);
+                }
+                out.push_back(EncodeDigit(q));
+                bias = Adapt(delta, static_cast<uint32_t>(handled + 1), handled == basic);
+                delta = 0;
+                ++handled;
+            }
+            ++delta;
+            ++n;
+        }
+        return true;
+    }
+} // namespace Idna
@@ -0,0 +1,35 @@
+// idna.h
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Internationalized domain names to the ASCII form resolvers and the hosts
+// file match ("Bücher.example" -> "xn--bcher-kva.example"): UTS #46
+// nontransitional processing without the STD3 rules, so the underscores
+// blocklists are full of still pass.
+//
+// Backends: IdnToAscii on Windows, ICU's UTS #46 implementation elsewhere when
+// built with it (CJ_HAVE_ICU). The built-in mapping is the fallback. It folds
+// case for Latin, Greek and Cyrillic, maps fullwidth forms and ideographic
+// full stops, and passes uncased scripts (CJK, kana, Hangul, Thai). It cannot
+// normalize, so it rejects combining marks, right-to-left scripts and anything
+// else it doesn't know instead of encoding a name the resolver would never see.
+namespace Idna {
+    enum class Backend { Builtin, Icu, Windows };
+
+    Backend ActiveBackend() noexcept;
+    // Switches to `backend` if it was compiled in (benchmarks and cross-checks).
+    // Returns the backend actually selected.
+    Backend ForceBackend(Backend backend) noexcept;
+    const char* BackendName(Backend backend) noexcept;
+
+    // Maps and encodes each label of a UTF-8 name. Pure-ASCII names, found by
+    // a vectorized scan, are only lowercased: validating them is the caller's
+    // job. Returns false for ill-formed UTF-8, disallowed code points and
+    // labels over 63 bytes once encoded.
+    bool ToAscii(std::string_view name, std::string& out);
+
+    // RFC 3492 Punycode of one label, without the "xn--" prefix
+    bool EncodePunycode(std::u32string_view label, std::string& out);
+} // namespace Idna
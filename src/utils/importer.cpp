@@ -0,0 +1,650 @@
+// importer.cpp
+#include "importer.h"
+#include "decompress.h"
+#include "idna.h"
+#include "log.h"
+#include "memtrack.h"
+#include "trace.h"
+#include "transcode.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace utils {
+
+namespace {
+
+constexpr size_t SNIFF_LINES = 32;
+constexpr size_t MAX_DOMAIN_LENGTH = 253;
+
+bool IsBlank(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+std::string_view Trim(std::string_view text) noexcept {
+    size_t first = 0;
+    size_t last = text.size();
+    while (first < last && IsBlank(text[first])) ++first;
+    while (last > first && IsBlank(text[last - 1])) --last;
+    return text.substr(first, last - first);
+}
+
+// Splits off the next blank-separated token; empty when none is left
+std::string_view NextToken(std::string_view& rest) noexcept {
+    size_t start = 0;
+    while (start < rest.size() && IsBlank(rest[start])) ++start;
+    size_t end = start;
+    while (end < rest.size() && !IsBlank(rest[end])) ++end;
+    const std::string_view token = rest.substr(start, end - start);
+    rest.remove_prefix(end);
+    return token;
+}
+
+bool StartsWith(std::string_view text, std::string_view prefix) noexcept {
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char c = a[i];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != b[i]) return false;  // `b` is always a lowercase literal
+    }
+    return true;
+}
+
+bool IsAddress(std::string_view token) noexcept {
+    if (token.find(':') != std::string_view::npos) return true;  // IPv6
+    size_t dots = 0;
+    for (char c : token) {
+        if (c == '.') ++dots;
+        else if (c < '0' || c > '9') return false;
+    }
+    return dots == 3;
+}
+
+// Addresses a blocklist points names at to make them unreachable
+bool IsSinkAddress(std::string_view token) noexcept {
+    return token == "0.0.0.0" || token == "127.0.0.1" || token == "::" || token == "::1";
+}
+
+bool IsPlaceholder(std::string_view name) noexcept {
+    return name == "localhost" || name == "localhost.localdomain" || name == "local" ||
+           name == "broadcasthost" || name == "ip6-localhost" || name == "ip6-loopback" ||
+           name == "0.0.0.0";
+}
+
+constexpr uint8_t NAME_DIGIT = 1, NAME_LETTER = 2, NAME_UPPER = 4, NAME_UTF8 = 8;
+
+struct NameCharTable {
+    uint8_t cls[256] = {};
+    constexpr NameCharTable() {
+        for (int c = 0x80; c <= 0xFF; ++c) cls[c] = NAME_UTF8;
+        for (int c = '0'; c <= '9'; ++c) cls[c] = NAME_DIGIT;
+        for (int c = 'a'; c <= 'z'; ++c) cls[c] = NAME_LETTER;
+        for (int c = 'A'; c <= 'Z'; ++c) cls[c] = NAME_UPPER;
+        cls[static_cast<unsigned char>('.')] = NAME_DIGIT;
+        cls[static_cast<unsigned char>('-')] = NAME_LETTER;
+        cls[static_cast<unsigned char>('_')] = NAME_LETTER;
+    }
+};
+constexpr NameCharTable NAME_CHARS;
+
+std::string_view Unquote(std::string_view text) noexcept {
+    text = Trim(text);
+    if (text.size() >= 2 && text.front() == '"') {
+        const size_t close = text.find('"', 1);
+        if (close != std::string_view::npos) return text.substr(1, close - 1);
+    }
+    return text;
+}
+
+// ----- Hosts / Plain -----
+class HostsImporter : public ListImporter {
+public:
+    using ListImporter::ListImporter;
+
+protected:
+    void ParseLine(std::string_view line) override {
+        ParseHostsLine(line);
+    }
+};
+
+// ----- Adblock -----
+// Only "||domain^" rules block a whole name. Options that merely change
+// priority or request type keep the rule; anything that scopes it (domain=,
+// denyallow=, client=, badfilter, ...) means we can't enforce it faithfully.
+class AdblockImporter : public ListImporter {
+public:
+    using ListImporter::ListImporter;
+
+protected:
+    void ParseLine(std::string_view line) override {
+        if (line[0] == '!' || line[0] == '[') return;  // Comment or "[Adblock Plus 2.0]"
+        if (IsCosmetic(line)) {
+            Skip();
+            return;
+        }
+        if (line[0] == '#') return;                     // AdGuard-style comment
+        if (StartsWith(line, "@@")) {
+            Skip();                                     // Exception rule
+            return;
+        }
+
+        if (StartsWith(line, "||")) {
+            std::string_view rest = line.substr(2);
+            const size_t end = rest.find_first_of("^/$|*:?");
+            const std::string_view domain = rest.substr(0, end);
+            std::string_view tail = end == std::string_view::npos ? std::string_view() : rest.substr(end);
+
+            if (!tail.empty() && tail[0] == '^') {
+                tail.remove_prefix(1);
+                if (!tail.empty() && tail[0] == '|') tail.remove_prefix(1);
+            }
+            if (!tail.empty() && (tail[0] != '$' || !AcceptableOptions(tail.substr(1)))) {
+                Skip();                                 // Path, wildcard or scoped rule
+                return;
+            }
+            Emit(domain, Coverage::ExactAndSubdomains);
+            return;
+        }
+
+        // AdGuard DNS lists may carry plain hosts lines
+        std::string_view rest = line;
+        if (IsAddress(NextToken(rest))) {
+            ParseHostsLine(line);
+        } else {
+            Skip();                                     // URL pattern or regex rule
+        }
+    }
+
+private:
+    static bool IsCosmetic(std::string_view line) noexcept {
+        if (line.find('#') == std::string_view::npos) return false;  // Nearly every rule
+        return line.find("##") != std::string_view::npos || line.find("#@#") != std::string_view::npos ||
+               line.find("#?#") != std::string_view::npos || line.find("#$#") != std::string_view::npos;
+    }
+
+    // Only modifiers that leave the whole domain blocked. third-party and
+    // popup narrow the rule to some requests, so a hosts entry would also
+    // block the first-party and non-popup traffic the list allows.
+    static bool AcceptableOptions(std::string_view options) noexcept {
+        while (!options.empty()) {
+            const size_t comma = options.find(',');
+            const std::string_view option = Trim(options.substr(0, comma));
+            if (!(option == "important" || option == "all" || option == "document" || option == "doc")) {
+                return false;
+            }
+            options = comma == std::string_view::npos ? std::string_view() : options.substr(comma + 1);
+        }
+        return true;
+    }
+};
+
+// ----- dnsmasq -----
+class DnsmasqImporter : public ListImporter {
+public:
+    using ListImporter::ListImporter;
+
+protected:
+    void ParseLine(std::string_view line) override {
+        if (line[0] == '#') return;
+
+        const size_t eq = line.find('=');
+        if (eq == std::string_view::npos) return;       // Flag-style directive
+        const std::string_view key = Trim(line.substr(0, eq));
+        const std::string_view value = Trim(line.substr(eq + 1));
+        const bool isAddress = key == "address";
+        if (!isAddress && key != "server" && key != "local") return;
+
+        // "/a.com/b.com/target"; the target is the text after the last slash
+        const size_t last = value.rfind('/');
+        if (value.empty() || value[0] != '/' || last == 0) {
+            Invalid();
+            return;
+        }
+        const std::string_view target = value.substr(last + 1);
+        const bool blocks = isAddress ? (target.empty() || target == "#" || IsSinkAddress(target))
+                                      : target.empty();   // server=/a.com/ answers locally, i.e. NXDOMAIN
+        if (!blocks) {
+            Skip();                                     // Redirect or forwarding rule
+            return;
+        }
+
+        std::string_view domains = value.substr(1, last - 1);
+        while (!domains.empty()) {
+            const size_t slash = domains.find('/');
+            const std::string_view domain = domains.substr(0, slash);
+            if (domain == "#" || domain.empty()) Skip();  // "#" means every domain
+            else Emit(domain, Coverage::ExactAndSubdomains);
+            domains = slash == std::string_view::npos ? std::string_view() : domains.substr(slash + 1);
+        }
+    }
+};
+
+// ----- Unbound -----
+class UnboundImporter : public ListImporter {
+public:
+    using ListImporter::ListImporter;
+
+protected:
+    void ParseLine(std::string_view line) override {
+        const size_t comment = line.find('#');
+        if (comment != std::string_view::npos) line = Trim(line.substr(0, comment));
+        if (line.empty()) return;
+
+        if (StartsWith(line, "local-zone:")) {
+            // "a.com" static, or a.com static
+            std::string_view rest = Trim(line.substr(11));
+            const size_t close = rest.empty() || rest.front() != '"' ? std::string_view::npos : rest.find('"', 1);
+            const std::string_view name = close == std::string_view::npos ? NextToken(rest) : rest.substr(1, close - 1);
+            if (close != std::string_view::npos) rest.remove_prefix(close + 1);
+            const std::string_view type = NextToken(rest);
+
+            if (type == "deny" || type == "refuse" || type == "static" || type == "always_refuse" ||
+                type == "always_nxdomain" || type == "always_null" || type == "inform_deny") {
+                Emit(name, Coverage::ExactAndSubdomains);
+            } else if (type.empty()) {
+                Invalid();
+            } else {
+                Skip();                                 // transparent, redirect, nodefault, ...
+            }
+        } else if (StartsWith(line, "local-data:")) {
+            // "a.com [ttl] [IN] A 0.0.0.0"
+            std::string_view record = Unquote(line.substr(11));
+            const std::string_view name = NextToken(record);
+            std::string_view type = NextToken(record);
+            while (!type.empty() && !EqualsIgnoreCase(type, "a") && !EqualsIgnoreCase(type, "aaaa") &&
+                   (EqualsIgnoreCase(type, "in") || (type[0] >= '0' && type[0] <= '9'))) {
+                type = NextToken(record);
+            }
+            const std::string_view address = NextToken(record);
+            if ((EqualsIgnoreCase(type, "a") || EqualsIgnoreCase(type, "aaaa")) && IsSinkAddress(address)) {
+                Emit(name);
+            } else {
+                Skip();
+            }
+        }
+    }
+};
+
+// ----- RPZ -----
+// A zone file whose owner names are triggers, relative to $ORIGIN. "CNAME ."
+// (NXDOMAIN), "CNAME *." (NODATA), "CNAME rpz-drop." and sinkhole A/AAAA
+// records block; passthru and walled-garden redirects are skipped.
+class RpzImporter : public ListImporter {
+public:
+    using ListImporter::ListImporter;
+
+protected:
+    void ParseLine(std::string_view line) override {
+        const size_t comment = line.find(';');
+        if (comment != std::string_view::npos) line = Trim(line.substr(0, comment));
+        if (line.empty()) return;
+
+        // Multi-line records (the SOA) are wrapped in parentheses
+        if (m_inParens) {
+            if (line.find(')') != std::string_view::npos) m_inParens = false;
+            return;
+        }
+        if (line.find('(') != std::string_view::npos && line.find(')') == std::string_view::npos) {
+            m_inParens = true;
+            return;
+        }
+
+        std::string_view rest = line;
+        std::string_view owner = NextToken(rest);
+        if (owner[0] == '$') {
+            if (EqualsIgnoreCase(owner, "$origin")) {
+                m_origin.assign(NextToken(rest));
+                if (!m_origin.empty() && m_origin.back() == '.') m_origin.pop_back();
+            }
+            return;
+        }
+
+        // Owner omitted: the record continues the previous owner
+        std::string_view type = owner;
+        if (IsTtlClassOrType(owner)) {
+            owner = m_lastOwner;
+        } else {
+            m_lastOwner.assign(owner);
+            owner = m_lastOwner;
+            type = NextToken(rest);
+        }
+        while (!type.empty() && (EqualsIgnoreCase(type, "in") || (type[0] >= '0' && type[0] <= '9'))) {
+            type = NextToken(rest);
+        }
+        const std::string_view data = NextToken(rest);
+
+        if (EqualsIgnoreCase(type, "soa") || EqualsIgnoreCase(type, "ns") || owner.empty() || owner == "@") return;
+
+        bool blocks = false;
+        if (EqualsIgnoreCase(type, "cname")) {
+            blocks = data == "." || data == "*." || EqualsIgnoreCase(data, "rpz-drop.");
+        } else if (EqualsIgnoreCase(type, "a") || EqualsIgnoreCase(type, "aaaa")) {
+            blocks = IsSinkAddress(data);
+        } else if (type.empty()) {
+            Invalid();
+            return;
+        }
+        if (!blocks) {
+            Skip();
+            return;
+        }
+
+        const std::string_view trigger = Trigger(owner);
+        if (trigger.empty()) {
+            Skip();                                     // IP, NSDNAME or client triggers
+        } else if (StartsWith(trigger, "*.")) {
+            Emit(trigger.substr(2), Coverage::Subdomains);
+        } else {
+            Emit(trigger);
+        }
+    }
+
+private:
+    // TTLs ("3600", "1h") start with a digit but, unlike owners such as
+    // "32.1.0.0.10.rpz-ip", never contain a dot
+    static bool IsTtlClassOrType(std::string_view token) noexcept {
+        if (token[0] >= '0' && token[0] <= '9') return token.find('.') == std::string_view::npos;
+        for (const char* keyword : { "in", "a", "aaaa", "cname", "txt", "ns", "soa" }) {
+            if (EqualsIgnoreCase(token, keyword)) return true;
+        }
+        return false;
+    }
+
+    // Owner name relative to the zone origin; empty for non-QNAME triggers
+    std::string_view Trigger(std::string_view owner) const noexcept {
+        if (!owner.empty() && owner.back() == '.') {
+            owner.remove_suffix(1);
+            if (!m_origin.empty() && owner.size() > m_origin.size() &&
+                owner[owner.size() - m_origin.size() - 1] == '.' &&
+                EqualsIgnoreCase(owner.substr(owner.size() - m_origin.size()), m_origin)) {
+                owner.remove_suffix(m_origin.size() + 1);
+            }
+        }
+        for (const char* special : { ".rpz-ip", ".rpz-nsip", ".rpz-nsdname", ".rpz-client-ip" }) {
+            const std::string_view suffix = special;
+            if (owner.size() >= suffix.size() && owner.substr(owner.size() - suffix.size()) == suffix) return {};
+        }
+        return owner;
+    }
+
+    std::string m_origin;
+    std::string m_lastOwner;
+    bool m_inParens = false;
+};
+
+} // anonymous namespace
+
+// ----- Factory -----
+std::unique_ptr<ListImporter> ListImporter::Create(Format format, const Options& options, DomainPool& out) {
+    switch (format) {
+        case Format::Hosts:
+        case Format::Plain:   return std::unique_ptr<ListImporter>(new HostsImporter(format, options, out));
+        case Format::Adblock: return std::unique_ptr<ListImporter>(new AdblockImporter(format, options, out));
+        case Format::Dnsmasq: return std::unique_ptr<ListImporter>(new DnsmasqImporter(format, options, out));
+        case Format::Unbound: return std::unique_ptr<ListImporter>(new UnboundImporter(format, options, out));
+        case Format::Rpz:     return std::unique_ptr<ListImporter>(new RpzImporter(format, options, out));
+        default:              return nullptr;
+    }
+}
+
+const char* ListImporter::FormatName(Format format) noexcept {
+    switch (format) {
+        case Format::Auto:    return "auto";
+        case Format::Hosts:   return "hosts";
+        case Format::Plain:   return "plain";
+        case Format::Adblock: return "adblock";
+        case Format::Dnsmasq: return "dnsmasq";
+        case Format::Unbound: return "unbound";
+        case Format::Rpz:     return "rpz";
+        default:              return "unknown";
+    }
+}
+
+// The first line that only one format would contain decides. '#' comments are
+// shared by most formats and don't count; a list of bare names is Plain.
+ListImporter::Format ListImporter::Sniff(std::string_view prefix) noexcept {
+    prefix = Transcode::StripBom(prefix);
+    size_t examined = 0;
+    bool sawAddress = false;
+
+    while (!prefix.empty() && examined < SNIFF_LINES) {
+        const size_t eol = prefix.find('\n');
+        const std::string_view line = Trim(prefix.substr(0, eol));
+        prefix = eol == std::string_view::npos ? std::string_view() : prefix.substr(eol + 1);
+        if (line.empty()) continue;
+
+        if (line[0] == '!' || StartsWith(line, "[Adblock") || StartsWith(line, "||") || StartsWith(line, "@@")) {
+            return Format::Adblock;
+        }
+        if (StartsWith(line, "address=/") || StartsWith(line, "server=/") || StartsWith(line, "local=/")) {
+            return Format::Dnsmasq;
+        }
+        if (StartsWith(line, "server:") || StartsWith(line, "local-zone:") || StartsWith(line, "local-data:")) {
+            return Format::Unbound;
+        }
+        if (line[0] == ';' || line[0] == '$' || line.find(" SOA ") != std::string_view::npos ||
+            line.find(" CNAME ") != std::string_view::npos || line.find("\tCNAME\t") != std::string_view::npos) {
+            return Format::Rpz;
+        }
+        if (line[0] == '#') continue;
+
+        std::string_view rest = line;
+        if (IsAddress(NextToken(rest))) sawAddress = true;
+        ++examined;
+    }
+    return sawAddress ? Format::Hosts : Format::Plain;
+}
+
+// ----- Streaming -----
+void ListImporter::Feed(std::string_view chunk) {
+    m_stats.bytes += chunk.size();
+    while (!chunk.empty()) {
+        const void* newline = std::memchr(chunk.data(), '\n', chunk.size());
+        if (!newline) {
+            if (m_carryTooLong || m_carry.size() + chunk.size() > MAX_LINE_LENGTH) {
+                m_carryTooLong = true;
+                m_carry.clear();
+            } else {
+                m_carry.append(chunk.data(), chunk.size());
+            }
+            return;
+        }
+
+        const size_t length = static_cast<size_t>(static_cast<const char*>(newline) - chunk.data());
+        if (m_carry.empty() && !m_carryTooLong) {
+            ProcessLine(chunk.substr(0, length));
+        } else if (!m_carryTooLong && m_carry.size() + length <= MAX_LINE_LENGTH) {
+            m_carry.append(chunk.data(), length);
+            ProcessLine(m_carry);
+            m_carry.clear();
+        } else {
+            ++m_stats.lines;
+            Invalid();
+            m_carry.clear();
+            m_carryTooLong = false;
+        }
+        chunk.remove_prefix(length + 1);
+    }
+}
+
+void ListImporter::Finish() {
+    if (m_carryTooLong) {
+        ++m_stats.lines;
+        Invalid();
+    } else if (!m_carry.empty()) {
+        ProcessLine(m_carry);
+    }
+    m_carry.clear();
+    m_carryTooLong = false;
+}
+
+void ListImporter::ProcessLine(std::string_view line) {
+    ++m_stats.lines;
+    if (line.size() > MAX_LINE_LENGTH) {
+        Invalid();
+        return;
+    }
+    line = Trim(line);
+    if (!line.empty()) ParseLine(line);
+}
+
+void ListImporter::ParseHostsLine(std::string_view line) {
+    const size_t comment = line.find('#');
+    if (comment != std::string_view::npos) line = line.substr(0, comment);
+
+    std::string_view rest = line;
+    const std::string_view first = NextToken(rest);
+    if (first.empty()) return;
+
+    if (!IsAddress(first)) {
+        Emit(first);                                    // Bare domain
+        return;
+    }
+    if (!IsSinkAddress(first)) {
+        Skip();                                         // Points somewhere real
+        return;
+    }
+    for (std::string_view name = NextToken(rest); !name.empty(); name = NextToken(rest)) {
+        Emit(name);
+    }
+}
+
+void ListImporter::Emit(std::string_view name, Coverage coverage) {
+    if (!name.empty() && name.back() == '.') name.remove_suffix(1);
+    if (name.empty() || name.size() > MAX_DOMAIN_LENGTH || name.front() == '.' || name.front() == '-') {
+        Invalid();
+        return;
+    }
+
+    // One table lookup per byte: lowercase, reject foreign characters, and
+    // track whether every byte so far was a digit or dot (an address). A byte
+    // above 0x7F only sets a class bit, so ASCII names pay nothing for IDNs.
+    m_scratch.resize(name.size());
+    char* out = m_scratch.data();   // Locals, so char stores can't alias the loop state
+    const char* in = name.data();
+    const size_t length = name.size();
+    unsigned seen = 0;
+    unsigned char previous = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = static_cast<unsigned char>(in[i]);
+        const uint8_t cls = NAME_CHARS.cls[c];
+        if (cls == 0 || (c == '.' && previous == '.')) {
+            Invalid();
+            return;
+        }
+        seen |= cls;
+        previous = c;
+        out[i] = static_cast<char>(cls & NAME_UPPER ? c - 'A' + 'a' : c);
+    }
+    if (seen & NAME_UTF8) {
+        // Internationalized: emit the xn-- form, which takes the ASCII path above
+        if (!Idna::ToAscii(name, m_idn)) {
+            Invalid();
+            return;
+        }
+        ++m_stats.converted;
+        Emit(m_idn, coverage);
+        return;
+    }
+    if (!(seen & (NAME_LETTER | NAME_UPPER))) {
+        Invalid();                                      // An address, not a name
+        return;
+    }
+    if (IsPlaceholder(m_scratch)) return;
+
+    if (coverage != Coverage::Subdomains) {
+        m_out.Add(m_scratch);
+        ++m_stats.domains;
+    }
+    if (coverage != Coverage::Exact) {
+        if (!m_options.wildcards) {
+            if (coverage == Coverage::Subdomains) Skip();
+            return;
+        }
+        m_scratch.insert(0, "*.");
+        m_out.Add(m_scratch);
+        ++m_stats.domains;
+    }
+}
+
+// ----- Entry Points -----
+bool ListImporter::ImportFile(const fs::path& path, const Options& options, DomainPool& out,
+                              Stats* stats, Format* detected) {
+    Trace::Span span("ListImporter::ImportFile");
+    MemTrack::Scope memory("import");
+    DecompressingReader reader;
+    if (!reader.Open(path)) {
+        CJ_LOG_ERROR("Importer", "Can't open list: " << path);
+        return false;
+    }
+    return ImportFrom(reader, path.u8string(), options, out, stats, detected, span);
+}
+
+bool ListImporter::ImportStream(std::istream& stream, const std::string& name, const Options& options,
+                                DomainPool& out, Stats* stats, Format* detected) {
+    Trace::Span span("ListImporter::ImportStream");
+    MemTrack::Scope memory("import");
+    DecompressingReader reader;
+    if (!reader.Open(stream, name)) {
+        CJ_LOG_ERROR("Importer", "Can't read list: " << name);
+        return false;
+    }
+    return ImportFrom(reader, name, options, out, stats, detected, span);
+}
+
+// The reader inflates on its own thread while this one parses
+bool ListImporter::ImportFrom(DecompressingReader& reader, const std::string& name, const Options& options,
+                              DomainPool& out, Stats* stats, Format* detected, Trace::Span& span) {
+    std::unique_ptr<ListImporter> importer;
+    size_t bytes = 0;
+    std::string_view chunk;
+    while (reader.Next(chunk)) {
+        bytes += chunk.size();
+        if (!importer) {
+            chunk = Transcode::StripBom(chunk);
+            const Format format = options.format == Format::Auto ? Sniff(chunk) : options.format;
+            importer = Create(format, options, out);
+            if (!importer) return false;
+        }
+        importer->Feed(chunk);
+    }
+    if (reader.Failed()) {
+        CJ_LOG_ERROR("Importer", "Read error in " << name);
+        return false;
+    }
+    if (!importer) importer = Create(options.format == Format::Auto ? Format::Plain : options.format, options, out);
+    if (!importer) return false;
+    importer->Finish();
+
+    const Stats& result = importer->GetStats();
+    span.Arg("bytes", bytes).Arg("compressed", reader.CompressedBytes())
+        .Arg("lines", result.lines).Arg("domains", result.domains);
+    CJ_LOG_DEBUG("Importer", name << ": " << FormatName(importer->GetFormat()) << " ("
+                 << DecompressingReader::CodecName(reader.GetCodec()) << "), " << result.lines
+                 << " line(s), " << result.domains << " domain(s), " << result.converted << " IDN(s), "
+                 << result.skipped << " skipped, " << result.invalid << " invalid");
+    if (stats) *stats = result;
+    if (detected) *detected = importer->GetFormat();
+    return true;
+}
+
+void ListImporter::ImportText(std::string_view text, const Options& options, DomainPool& out,
+                              Stats* stats, Format* detected) {
+    Trace::Span span("ListImporter::ImportText");
+    text = Transcode::StripBom(text);
+    const Format format = options.format == Format::Auto ? Sniff(text) : options.format;
+    std::unique_ptr<ListImporter> importer = Create(format, options, out);
+    if (!importer) return;
+    importer->Feed(text);
+    importer->Finish();
+
+    span.Arg("bytes", text.size()).Arg("domains", importer->GetStats().domains);
+    if (stats) *stats = importer->GetStats();
+    if (detected) *detected = importer->GetFormat();
+}
+
+} // namespace utils
@@ -0,0 +1,117 @@
+// importer.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "domainpool.h"
+
+namespace Trace { class Span; }
+
+namespace utils {
+
+class DecompressingReader;
+
+namespace fs = std::filesystem;
+
+// Streaming blocklist parser. Text is fed in arbitrary chunks and parsed line
+// by line in a single pass; only a partial trailing line is buffered, so
+// memory is bounded by the output pool. One subclass per list format; Create()
+// picks it, Sniff() guesses the format from the first bytes of a list.
+//
+// Rules that block a name and everything below it (Adblock "||a.com^",
+// dnsmasq "address=/a.com/", Unbound zones, RPZ "*.a.com") emit the name, and
+// additionally "*.a.com" when Options::wildcards is set. Only the DNS sinkhole
+// can enforce wildcards; the hosts file gets the exact name.
+class ListImporter {
+public:
+    enum class Format {
+        Auto,      // Sniff from the first chunk
+        Hosts,     // "0.0.0.0 a.com b.com"
+        Plain,     // One domain per line
+        Adblock,   // "||a.com^", with $options limited to ones that don't narrow the rule
+        Dnsmasq,   // "address=/a.com/b.com/0.0.0.0", "server=/a.com/", "local=/a.com/"
+        Unbound,   // "local-zone: \"a.com\" always_nxdomain", "local-data: \"a.com A 0.0.0.0\""
+        Rpz        // Response policy zone file ("a.com CNAME .")
+    };
+
+    struct Options {
+        Format format = Format::Auto;
+        bool wildcards = false;
+    };
+
+    struct Stats {
+        size_t lines = 0;
+        size_t domains = 0;   // Entries emitted (a rule with a wildcard counts twice)
+        size_t skipped = 0;   // Understood, but not a block we can express (exceptions, paths, redirects)
+        size_t invalid = 0;   // Malformed lines or names
+        size_t converted = 0; // Internationalized names emitted in their xn-- form
+        uint64_t bytes = 0;   // Text parsed, after decompression
+    };
+
+    static constexpr size_t MAX_LINE_LENGTH = 64 * 1024;  // Longer lines are dropped as invalid
+
+    virtual ~ListImporter() = default;
+    ListImporter(const ListImporter&) = delete;
+    ListImporter& operator=(const ListImporter&) = delete;
+
+    // `format` must not be Auto
+    static std::unique_ptr<ListImporter> Create(Format format, const Options& options, DomainPool& out);
+    static Format Sniff(std::string_view prefix) noexcept;
+    static const char* FormatName(Format format) noexcept;
+
+    // Streams the file through DecompressingReader, so gzip and zstd lists are
+    // inflated on the fly. Returns false if it can't be read or is corrupt.
+    static bool ImportFile(const fs::path& path, const Options& options, DomainPool& out,
+                           Stats* stats = nullptr, Format* detected = nullptr);
+    // ImportFile() over an open stream, e.g. standard input; `name` is only for messages
+    static bool ImportStream(std::istream& stream, const std::string& name, const Options& options,
+                             DomainPool& out, Stats* stats = nullptr, Format* detected = nullptr);
+    static void ImportText(std::string_view text, const Options& options, DomainPool& out,
+                           Stats* stats = nullptr, Format* detected = nullptr);
+
+    void Feed(std::string_view chunk);
+    void Finish();  // Parses a final line without a newline
+
+    Format GetFormat() const noexcept { return m_format; }
+    const Stats& GetStats() const noexcept { return m_stats; }
+
+protected:
+    enum class Coverage { Exact, Subdomains, ExactAndSubdomains };
+
+    ListImporter(Format format, const Options& options, DomainPool& out)
+        : m_format(format), m_options(options), m_out(out) {}
+
+    // `line` has no line terminator and no surrounding blanks, and is never empty
+    virtual void ParseLine(std::string_view line) = 0;
+
+    // Validates and lowercases `name` (a trailing root dot is dropped) and appends it.
+    // UTF-8 names are converted to punycode first (see idna.h).
+    void Emit(std::string_view name, Coverage coverage = Coverage::Exact);
+    void Skip() noexcept { ++m_stats.skipped; }
+    void Invalid() noexcept { ++m_stats.invalid; }
+
+    // "0.0.0.0 a.com b.com" or a bare "a.com"; shared by formats that accept hosts lines
+    void ParseHostsLine(std::string_view line);
+
+private:
+    static bool ImportFrom(DecompressingReader& reader, const std::string& name, const Options& options,
+                           DomainPool& out, Stats* stats, Format* detected, Trace::Span& span);
+    void ProcessLine(std::string_view line);
+
+    Format m_format;
+    Options m_options;
+    DomainPool& m_out;
+    Stats m_stats;
+    std::string m_carry;     // Partial line from the previous chunk
+    std::string m_scratch;   // Normalized name being emitted
+    std::string m_idn;       // ASCII form of an internationalized name
+    bool m_carryTooLong = false;
+};
+
+} // namespace utils
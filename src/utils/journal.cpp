@@ -0,0 +1,352 @@
+// journal.cpp
+#include "journal.h"
+#include "log.h"
+#include "mappedfile.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+#include <vector>
+
+#include <zlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+// ----- On-disk Format -----
+constexpr char RECORD_MAGIC[4] = { 'C', 'J', 'W', 'L' };
+constexpr const char* PENDING_PREFIX = "pending-";
+constexpr const char* PENDING_EXTENSION = ".hosts";
+
+enum RecordType : uint32_t { BEGIN = 1, COMMIT = 2, ABORT = 3 };
+
+// Fixed-size record; written and read as raw bytes on the same machine
+struct Record {
+    char magic[4];
+    uint32_t type;
+    uint64_t transaction;
+    int64_t timestamp;
+    uint64_t snapshotId;
+    uint64_t newSize;
+    uint8_t hasOld;
+    uint8_t reserved[7];
+    unsigned char oldDigest[32];
+    unsigned char newDigest[32];
+    uint32_t crc;         // CRC-32 of everything above
+    uint32_t reserved2;
+};
+
+uint32_t RecordCrc(const Record& record) noexcept {
+    return static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(&record), offsetof(Record, crc)));
+}
+
+Record MakeRecord(RecordType type, uint64_t transaction) {
+    Record record{};
+    std::memcpy(record.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    record.type = type;
+    record.transaction = transaction;
+    record.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return record;
+}
+
+std::string TransactionName(uint64_t transaction) {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(transaction));
+    return name;
+}
+
+uint64_t NewTransactionId() {
+    std::random_device device;
+    uint64_t id = 0;
+    while (id == 0) id = (static_cast<uint64_t>(device()) << 32) ^ device();
+    return id;
+}
+
+// Forces file contents to stable storage; the journal is useless without it
+bool SyncFile(const fs::path& path) noexcept {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    const BOOL ok = FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok != FALSE;
+#else
+    const int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    const int rc = ::fsync(fd);
+    ::close(fd);
+    return rc == 0;
+#endif
+}
+
+bool ReadWhole(const fs::path& path, std::string& out) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+    out.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return !ifs.bad();
+}
+
+bool HashFile(const fs::path& path, crypto::Digest& digest) {
+    // Only ever the hosts file, which is rewritten in place: never mapped
+    MappedFile content;
+    return content.Open(path, MappedFile::Access::Sequential, MappedFile::BUFFERED) &&
+           crypto::Sha256(content.data(), content.size(), digest);
+}
+
+bool Matches(const crypto::Digest& digest, const unsigned char (&recorded)[32]) noexcept {
+    return std::memcmp(digest.data(), recorded, sizeof(recorded)) == 0;
+}
+
+// Valid records in order; reading stops at the first torn or foreign record
+std::vector<Record> ReadRecords(const fs::path& path) {
+    std::vector<Record> records;
+    std::ifstream ifs(path, std::ios::binary);
+    Record record{};
+    while (ifs.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        if (std::memcmp(record.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0 || record.crc != RecordCrc(record)) {
+            break;
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
+// Cuts a torn tail off so records appended after it stay readable
+void DropTornTail(const fs::path& path, const std::vector<Record>& records) {
+    const uint64_t valid = records.size() * sizeof(Record);
+    std::error_code ec;
+    const uint64_t size = fs::file_size(path, ec);
+    if (ec || size == valid) return;
+    CJ_LOG_WARN("Journal", "Dropping " << (size - valid) << " byte(s) of torn journal tail");
+    fs::resize_file(path, valid, ec);
+}
+
+// The newest BEGIN, if nothing resolved it
+const Record* OpenTransaction(const std::vector<Record>& records) noexcept {
+    for (auto it = records.rbegin(); it != records.rend(); ++it) {
+        if (it->type != BEGIN) continue;
+        for (auto later = it.base(); later != records.end(); ++later) {
+            if (later->transaction == it->transaction) return nullptr;
+        }
+        return &*it;
+    }
+    return nullptr;
+}
+
+} // anonymous namespace
+
+HostsJournal::HostsJournal(const fs::path& directory)
+    : m_directory(directory), m_path(directory / FILENAME) {}
+
+fs::path HostsJournal::PendingPath(uint64_t transaction) const {
+    return m_directory / (PENDING_PREFIX + TransactionName(transaction) + PENDING_EXTENSION);
+}
+
+bool HostsJournal::Append(const void* record, size_t size, bool truncate) const {
+    try {
+        {
+            std::ofstream ofs(m_path, std::ios::binary | (truncate ? std::ios::trunc : std::ios::app));
+            if (!ofs) return false;
+            ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            ofs.write(static_cast<const char*>(record), static_cast<std::streamsize>(size));
+        }
+        return SyncFile(m_path);
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Journal", "Append failed: " << e.what());
+        return false;
+    }
+}
+
+// ----- Transitions -----
+bool HostsJournal::Begin(const fs::path& hostsPath, const std::string& content, uint64_t snapshotId,
+                         uint64_t& transaction) {
+    Trace::Span span("HostsJournal::Begin");
+    span.Arg("bytes", content.size());
+    crypto::Digest oldDigest{}, newDigest{};
+    const bool hasOld = HashFile(hostsPath, oldDigest);
+    if (!crypto::Sha256(content.data(), content.size(), newDigest)) return false;
+
+    fs::path stagingPath;
+    if (!Stage(transaction, stagingPath)) return false;
+    try {
+        std::ofstream ofs(stagingPath, std::ios::binary | std::ios::trunc);
+        if (!ofs) return false;
+        ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        ofs.write(content.data(), static_cast<std::streamsize>(content.size()));
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Journal", "Staging failed: " << e.what());
+        std::error_code ec;
+        fs::remove(stagingPath, ec);
+        return false;
+    }
+    if (BeginStaged(transaction, hasOld ? &oldDigest : nullptr, newDigest, content.size(), snapshotId)) return true;
+    std::error_code ec;
+    fs::remove(stagingPath, ec);
+    return false;
+}
+
+bool HostsJournal::Stage(uint64_t& transaction, fs::path& stagingPath) {
+    transaction = NewTransactionId();
+    stagingPath = PendingPath(transaction);
+    stagingPath += ".tmp";
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    return !ec || fs::is_directory(m_directory);
+}
+
+bool HostsJournal::BeginStaged(uint64_t transaction, const crypto::Digest* oldDigest, const crypto::Digest& newDigest,
+                               uint64_t newSize, uint64_t snapshotId) {
+    Trace::Span span("HostsJournal::BeginStaged");
+    span.Arg("bytes", newSize);
+    Record record = MakeRecord(BEGIN, transaction);
+    record.snapshotId = snapshotId;
+    record.newSize = newSize;
+    if (oldDigest) {
+        record.hasOld = 1;
+        std::memcpy(record.oldDigest, oldDigest->data(), oldDigest->size());
+    }
+    std::memcpy(record.newDigest, newDigest.data(), newDigest.size());
+    record.crc = RecordCrc(record);
+
+    // Stage first: a BEGIN on disk always has its content beside it. On
+    // failure the content is left at the staging path for the caller.
+    const fs::path pendingPath = PendingPath(transaction);
+    fs::path tempPath = pendingPath;
+    tempPath += ".tmp";
+    std::error_code ec;
+    if (!SyncFile(tempPath)) return false;
+    fs::rename(tempPath, pendingPath, ec);
+    if (ec) {
+        CJ_LOG_ERROR("Journal", "Staging failed: " << ec.message());
+        return false;
+    }
+
+    // Start the journal over once it has grown and nothing is in flight
+    const std::vector<Record> records = ReadRecords(m_path);
+    DropTornTail(m_path, records);
+    const bool compact = records.size() * sizeof(Record) > COMPACT_BYTES && !OpenTransaction(records);
+    if (!Append(&record, sizeof(record), compact)) {
+        fs::rename(pendingPath, tempPath, ec);
+        return false;
+    }
+    CJ_LOG_DEBUG("Journal", "BEGIN " << TransactionName(transaction) << " (" << newSize
+                 << " bytes, snapshot " << snapshotId << ")");
+    return true;
+}
+
+bool HostsJournal::Commit(uint64_t transaction) {
+    Trace::Span span("HostsJournal::Commit");
+    Record record = MakeRecord(COMMIT, transaction);
+    record.crc = RecordCrc(record);
+    if (!Append(&record, sizeof(record), false)) return false;
+
+    std::error_code ec;
+    fs::remove(PendingPath(transaction), ec);
+    CJ_LOG_DEBUG("Journal", "COMMIT " << TransactionName(transaction));
+    return true;
+}
+
+// ----- Recovery -----
+HostsJournal::Outcome HostsJournal::Recover(const fs::path& hostsPath, const SnapshotStore& snapshots,
+                                            const Writer& write) {
+    Trace::Span span("HostsJournal::Recover");
+    const auto start = std::chrono::steady_clock::now();
+
+    // Waits out a writer in another process, whose open BEGIN and staged
+    // file are still live; once the lock is ours, nothing is
+    FileLock lock;
+    if (!Lock(lock)) {
+        std::error_code ec;
+        if (!fs::exists(m_path, ec)) return Outcome::Clean;
+        CJ_LOG_ERROR("Journal", "Can't lock the journal; recovery skipped");
+        return Outcome::Failed;
+    }
+
+    const std::vector<Record> records = ReadRecords(m_path);
+    DropTornTail(m_path, records);
+    const Record* open = OpenTransaction(records);
+    Outcome outcome = Outcome::Clean;
+
+    if (open) {
+        const uint64_t transaction = open->transaction;
+        CJ_LOG_WARN("Journal", "Interrupted hosts update " << TransactionName(transaction) << " found");
+        auto resolve = [&](RecordType type) {
+            Record record = MakeRecord(type, transaction);
+            record.crc = RecordCrc(record);
+            Append(&record, sizeof(record), false);
+        };
+
+        crypto::Digest current{};
+        const bool hasCurrent = HashFile(hostsPath, current);
+        std::string content;
+        crypto::Digest staged{};
+
+        if (hasCurrent && Matches(current, open->newDigest)) {
+            resolve(COMMIT);
+            outcome = Outcome::Completed;
+        } else if (ReadWhole(PendingPath(transaction), content) && content.size() == open->newSize &&
+                   crypto::Sha256(content.data(), content.size(), staged) && Matches(staged, open->newDigest) &&
+                   write(content)) {
+            resolve(COMMIT);
+            outcome = Outcome::RolledForward;
+        } else if (hasCurrent && open->hasOld && Matches(current, open->oldDigest)) {
+            resolve(ABORT);  // Never written and nothing to redo it with
+            outcome = Outcome::RolledBack;
+        } else if (open->snapshotId != 0 && snapshots.Load(open->snapshotId, content) && write(content)) {
+            resolve(ABORT);
+            outcome = Outcome::RolledBack;
+        } else {
+            CJ_LOG_ERROR("Journal", "Can't recover hosts update " << TransactionName(transaction)
+                         << ": staged content and snapshot " << open->snapshotId << " are both unusable");
+            outcome = Outcome::Failed;
+        }
+    }
+
+    // Staged files of resolved or superseded transitions; under the lock none
+    // belongs to a live writer
+    std::error_code ec;
+    const fs::path keep = outcome == Outcome::Failed ? PendingPath(open->transaction) : fs::path();
+    for (fs::directory_iterator it(m_directory, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.rfind(PENDING_PREFIX, 0) != 0 || it->path() == keep) continue;
+        std::error_code removeError;
+        fs::remove(it->path(), removeError);
+    }
+
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    span.Arg("records", records.size()).Arg("outcome", static_cast<uint64_t>(outcome));
+    if (outcome != Outcome::Clean) {
+        CJ_LOG_INFO("Journal", "Recovery: " << OutcomeName(outcome) << " in " << micros << " us");
+    }
+    return outcome;
+}
+
+const char* HostsJournal::OutcomeName(Outcome outcome) noexcept {
+    switch (outcome) {
+        case Outcome::Clean:         return "clean";
+        case Outcome::Completed:     return "completed";
+        case Outcome::RolledForward: return "rolled forward";
+        case Outcome::RolledBack:    return "rolled back";
+        case Outcome::Failed:        return "failed";
+        default:                     return "unknown";
+    }
+}
+
+} // namespace utils
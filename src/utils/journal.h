@@ -0,0 +1,83 @@
+// journal.h
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+#include "crypto.h"
+#include "filelock.h"
+#include "snapshot.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Write-ahead intent journal for hosts file transitions. Before the hosts file
+// is replaced, the new content is staged beside the journal and a BEGIN record
+// (old digest, new digest, snapshot of the old content) is appended and
+// flushed; COMMIT follows once the write landed. Records carry a CRC, so a
+// torn tail from a power cut is simply ignored.
+//
+// Recover() looks only at the newest transition. If it never committed, the
+// hosts file is hashed once and compared with the two digests: the staged
+// content is written again when it is intact (roll forward), otherwise the
+// old content comes back from the snapshot store (roll back). Older unresolved
+// transitions were superseded by whatever ran after them.
+//
+// Transitions are serialized across processes by the journal lock: a writer
+// holds it from Stage() or Begin() through Commit(), and Recover() takes it
+// itself, so recovery never settles or cleans up a live writer's transition.
+class HostsJournal {
+public:
+    static constexpr const char* FILENAME = "hosts.journal";
+    static constexpr const char* LOCK_FILENAME = "hosts.journal.lock";
+    static constexpr uint64_t COMPACT_BYTES = 64 * 1024;  // Journal restarts past this once idle
+
+    enum class Outcome {
+        Clean,          // Nothing in flight
+        Completed,      // The write had landed; only the COMMIT was missing
+        RolledForward,  // Staged content written
+        RolledBack,     // Old content restored from its snapshot
+        Failed
+    };
+
+    using Writer = std::function<bool(const std::string& content)>;
+
+    explicit HostsJournal(const fs::path& directory);
+
+    // Waits for the journal lock; hold it across a whole transition
+    bool Lock(FileLock& lock) const { return lock.Acquire(m_directory / LOCK_FILENAME); }
+
+    // Records the intent to replace `hostsPath` with `content`. `snapshotId`
+    // names the snapshot holding the current content (0 if there is none).
+    bool Begin(const fs::path& hostsPath, const std::string& content, uint64_t snapshotId, uint64_t& transaction);
+
+    // Begin() for content the caller streams out itself: write it to the
+    // `stagingPath` Stage() returns, then BeginStaged() syncs it into place and
+    // appends BEGIN with the digests computed on the way (`oldDigest` null if
+    // there was no hosts file). The staged copy stays until Commit(), so the
+    // hosts writer can copy from GetStagedPath() rather than another temp file.
+    // If BeginStaged() fails the content is left at `stagingPath`.
+    bool Stage(uint64_t& transaction, fs::path& stagingPath);
+    bool BeginStaged(uint64_t transaction, const crypto::Digest* oldDigest, const crypto::Digest& newDigest,
+                     uint64_t newSize, uint64_t snapshotId);
+    fs::path GetStagedPath(uint64_t transaction) const { return PendingPath(transaction); }
+    bool Commit(uint64_t transaction);
+
+    // Takes the journal lock; don't call it while holding one
+    Outcome Recover(const fs::path& hostsPath, const SnapshotStore& snapshots, const Writer& write);
+    static const char* OutcomeName(Outcome outcome) noexcept;
+
+    const fs::path& GetPath() const noexcept { return m_path; }
+
+private:
+    fs::path PendingPath(uint64_t transaction) const;
+    bool Append(const void* record, size_t size, bool truncate) const;
+
+    fs::path m_directory;
+    fs::path m_path;
+};
+
+} // namespace utils
@@ -0,0 +1,264 @@
+// listgen.cpp
+// Build-time generator for the built-in blocklist tables (see builtinlists.h).
+//
+//   listgen <output.inc> [category=list.txt ...]
+//
+// Lists may be plain domain-per-line files or hosts files; '#' starts a
+// comment. Domains are lowercased and merged across categories. The output is
+// only rewritten when its content changes, so unchanged lists don't trigger a
+// rebuild.
+
+#include "builtinlists.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t MAX_SEED = 1u << 24;
+constexpr size_t KEYS_PER_BUCKET = 4;
+constexpr size_t MAX_DOMAIN_LENGTH = 253;
+
+struct Category {
+    std::string name;
+    std::string path;
+    size_t domains = 0;
+};
+
+bool IsAddress(const std::string& token) {
+    return token == "0.0.0.0" || token == "127.0.0.1" || token == "::" || token == "::1";
+}
+
+bool IsPlaceholder(const std::string& name) {
+    return name == "localhost" || name == "localhost.localdomain" || name == "local" ||
+           name == "broadcasthost" || name == "ip6-localhost" || name == "ip6-loopback";
+}
+
+bool NormalizeDomain(std::string& domain) {
+    if (!domain.empty() && domain.back() == '.') domain.pop_back();
+    if (domain.empty() || domain.size() > MAX_DOMAIN_LENGTH) return false;
+
+    for (char& c : domain) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        const bool valid = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_';
+        if (!valid) return false;
+    }
+    return domain.front() != '.' && domain.find("..") == std::string::npos && !IsPlaceholder(domain);
+}
+
+bool ReadList(Category& category, uint32_t bit, std::map<std::string, uint32_t>& domains) {
+    std::ifstream in(category.path);
+    if (!in) {
+        std::cerr << "listgen: can't read " << category.path << "\n";
+        return false;
+    }
+
+    std::string line;
+    size_t lineNumber = 0, rejected = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::istringstream tokens(line);
+        std::vector<std::string> fields;
+        for (std::string token; tokens >> token;) fields.push_back(token);
+        if (fields.empty()) continue;
+
+        // "0.0.0.0 a.com b.com" lists every name after the address
+        const size_t first = IsAddress(fields[0]) ? 1 : 0;
+        for (size_t i = first; i < fields.size(); ++i) {
+            std::string domain = fields[i];
+            if (!NormalizeDomain(domain)) {
+                if (!IsPlaceholder(domain) && !IsAddress(domain) && rejected++ < 5) {
+                    std::cerr << "listgen: " << category.path << ":" << lineNumber
+                              << ": skipping '" << fields[i] << "'\n";
+                }
+                continue;
+            }
+            uint32_t& mask = domains[domain];
+            if (!(mask & bit)) ++category.domains;
+            mask |= bit;
+        }
+    }
+    if (rejected > 5) {
+        std::cerr << "listgen: " << category.path << ": " << rejected << " invalid entries skipped\n";
+    }
+    return true;
+}
+
+// Hash and displace: keys are split into buckets by one hash, and each bucket
+// (largest first) searches for a seed that sends all of its keys to free slots.
+// The result maps the n keys onto exactly n slots.
+bool BuildPerfectHash(const std::vector<uint64_t>& keys, std::vector<uint32_t>& seeds,
+                      std::vector<uint32_t>& slots) {
+    const size_t n = keys.size();
+    const size_t bucketCount = std::max<size_t>(1, (n + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET);
+
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    for (uint32_t i = 0; i < n; ++i) {
+        buckets[BuiltinLists::Mix(keys[i], 0) % bucketCount].push_back(i);
+    }
+
+    std::vector<uint32_t> order(bucketCount);
+    for (uint32_t b = 0; b < bucketCount; ++b) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    seeds.assign(bucketCount, 0);
+    slots.assign(n, 0);
+    std::vector<bool> taken(n, false);
+    std::vector<size_t> candidate;
+
+    for (uint32_t b : order) {
+        const auto& bucket = buckets[b];
+        if (bucket.empty()) break;
+
+        bool placed = false;
+        for (uint32_t seed = 1; seed < MAX_SEED && !placed; ++seed) {
+            candidate.clear();
+            placed = true;
+            for (uint32_t key : bucket) {
+                const size_t slot = BuiltinLists::Mix(keys[key], seed) % n;
+                if (taken[slot] || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                    placed = false;
+                    break;
+                }
+                candidate.push_back(slot);
+            }
+            if (placed) {
+                seeds[b] = seed;
+                for (size_t i = 0; i < bucket.size(); ++i) {
+                    taken[candidate[i]] = true;
+                    slots[candidate[i]] = bucket[i];
+                }
+            }
+        }
+        if (!placed) {
+            std::cerr << "listgen: no perfect hash seed found for a bucket of " << bucket.size() << " keys\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string Render(const std::vector<Category>& categories, const std::vector<std::string>& names,
+                   const std::vector<uint32_t>& masks, const std::vector<uint32_t>& seeds,
+                   const std::vector<uint32_t>& slots) {
+    std::ostringstream out;
+    out << "// Generated by listgen from CJ_BUILTIN_LISTS. Do not edit.\n"
+        << "// Each array carries one trailing placeholder so that empty tables stay valid C++.\n\n"
+        << "constexpr size_t CATEGORY_COUNT = " << categories.size() << ";\n"
+        << "constexpr Category CATEGORIES[] = {\n";
+    for (const auto& category : categories) {
+        out << "    { \"" << category.name << "\", " << category.domains << " },\n";
+    }
+    out << "    { \"\", 0 },\n};\n\n";
+
+    out << "constexpr size_t ENTRY_COUNT = " << names.size() << ";\n"
+        << "constexpr Entry ENTRIES[] = {\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        out << "    { \"" << names[i] << "\", " << names[i].size() << ", 0x" << std::hex << masks[i] << std::dec << "u },\n";
+    }
+    out << "    { \"\", 0, 0 },\n};\n\n";
+
+    out << "constexpr size_t BUCKET_COUNT = " << seeds.size() << ";\n"
+        << "constexpr uint32_t BUCKET_SEEDS[] = {";
+    for (size_t i = 0; i < seeds.size(); ++i) out << (i % 16 ? " " : "\n    ") << seeds[i] << ",";
+    out << "\n    0,\n};\n\n";
+
+    out << "constexpr uint32_t SLOTS[] = {";
+    for (size_t i = 0; i < slots.size(); ++i) out << (i % 16 ? " " : "\n    ") << slots[i] << ",";
+    out << "\n    0,\n};\n";
+    return out.str();
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: listgen <output.inc> [category=list.txt ...]\n";
+        return 1;
+    }
+
+    std::vector<Category> categories;
+    for (int i = 2; i < argc; ++i) {
+        const std::string spec = argv[i];
+        const size_t eq = spec.find('=');
+        if (eq == 0 || eq == std::string::npos || eq + 1 == spec.size()) {
+            std::cerr << "listgen: expected category=path, got '" << spec << "'\n";
+            return 1;
+        }
+        Category category;
+        category.name = spec.substr(0, eq);
+        category.path = spec.substr(eq + 1);
+        if (!NormalizeDomain(category.name) || category.name.find('.') != std::string::npos) {
+            std::cerr << "listgen: invalid category name '" << spec.substr(0, eq) << "'\n";
+            return 1;
+        }
+        for (const auto& existing : categories) {
+            if (existing.name == category.name) {
+                std::cerr << "listgen: duplicate category '" << category.name << "'\n";
+                return 1;
+            }
+        }
+        categories.push_back(category);
+    }
+    if (categories.size() > BuiltinLists::MAX_CATEGORIES) {
+        std::cerr << "listgen: at most " << BuiltinLists::MAX_CATEGORIES << " categories are supported\n";
+        return 1;
+    }
+
+    std::map<std::string, uint32_t> domains;
+    for (size_t i = 0; i < categories.size(); ++i) {
+        if (!ReadList(categories[i], 1u << i, domains)) return 1;
+    }
+
+    std::vector<std::string> names;
+    std::vector<uint32_t> masks;
+    std::vector<uint64_t> keys;
+    names.reserve(domains.size());
+    masks.reserve(domains.size());
+    keys.reserve(domains.size());
+    for (const auto& [name, mask] : domains) {
+        names.push_back(name);
+        masks.push_back(mask);
+        keys.push_back(BuiltinLists::KeyHash(name));
+    }
+
+    std::vector<uint64_t> sortedKeys = keys;
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    if (std::adjacent_find(sortedKeys.begin(), sortedKeys.end()) != sortedKeys.end()) {
+        std::cerr << "listgen: 64-bit key collision between two domains\n";
+        return 1;
+    }
+
+    std::vector<uint32_t> seeds, slots;
+    if (!keys.empty() && !BuildPerfectHash(keys, seeds, slots)) return 1;
+    if (seeds.empty()) seeds.push_back(0);
+
+    const std::string rendered = Render(categories, names, masks, seeds, slots);
+
+    std::ifstream existing(argv[1], std::ios::binary);
+    if (existing) {
+        std::ostringstream current;
+        current << existing.rdbuf();
+        if (current.str() == rendered) return 0;
+    }
+
+    std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+    if (!out || !(out << rendered)) {
+        std::cerr << "listgen: can't write " << argv[1] << "\n";
+        return 1;
+    }
+    std::cout << "listgen: " << names.size() << " domain(s) in " << categories.size() << " categor"
+              << (categories.size() == 1 ? "y" : "ies") << "\n";
+    return 0;
+}
@@ -0,0 +1,362 @@
+// log.cpp
+#include "log.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace Logging {
+    namespace fs = std::filesystem;
+
+    namespace detail {
+        std::atomic<int> runtimeLevel{ static_cast<int>(Level::Info) };
+    }
+
+    // ----- Ring Buffer -----
+    // Bounded multi-producer queue (per-slot sequence numbers, after Vyukov).
+    // Producers never block: a full ring drops the record and counts it.
+    namespace {
+        constexpr size_t RING_SIZE = 1024;  // Must be a power of two
+        constexpr size_t RING_MASK = RING_SIZE - 1;
+        constexpr size_t WAKE_BACKLOG = RING_SIZE / 4;  // Producers wake the drain thread past this
+        constexpr std::chrono::milliseconds DRAIN_IDLE(50);
+
+        struct Record {
+            Level level;
+            const char* component;
+            int64_t timestampMs;
+            uint32_t thread;
+            uint16_t length;
+            char text[Formatter::CAPACITY];
+        };
+
+        struct Slot {
+            std::atomic<size_t> sequence;
+            Record record;
+        };
+
+        struct Ring {
+            Slot slots[RING_SIZE];
+            std::atomic<size_t> enqueuePos{0};
+            std::atomic<size_t> dequeuePos{0};  // Written by the drain thread only
+
+            Ring() {
+                for (size_t i = 0; i < RING_SIZE; ++i) {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            // Returns the backlog after the push, or 0 when the ring is full
+            size_t TryPush(const Record& record) noexcept {
+                size_t pos = enqueuePos.load(std::memory_order_relaxed);
+                for (;;) {
+                    Slot& slot = slots[pos & RING_MASK];
+                    const size_t seq = slot.sequence.load(std::memory_order_acquire);
+                    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                    if (diff == 0) {
+                        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            slot.record = record;
+                            slot.sequence.store(pos + 1, std::memory_order_release);
+                            return pos + 1 - dequeuePos.load(std::memory_order_relaxed);
+                        }
+                    } else if (diff < 0) {
+                        return 0;  // Full
+                    } else {
+                        pos = enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool TryPop(Record& record) noexcept {
+                const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+                Slot& slot = slots[pos & RING_MASK];
+                const size_t seq = slot.sequence.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+                    return false;  // Empty (or producer still writing)
+                }
+                record = slot.record;
+                slot.sequence.store(pos + RING_SIZE, std::memory_order_release);
+                dequeuePos.store(pos + 1, std::memory_order_relaxed);
+                return true;
+            }
+        };
+
+        Ring g_ring;
+        std::atomic<bool> g_running{false};
+        std::atomic<bool> g_stopRequested{false};
+        std::atomic<uint64_t> g_dropped{0};
+        std::atomic<uint32_t> g_nextThreadId{1};
+        std::mutex g_lifecycleMutex;  // Start/Stop only, never on the logging path
+        std::thread g_drainThread;
+        std::mutex g_wakeMutex;  // Drain thread's wait only; producers notify without it
+        std::condition_variable g_wake;
+        Config g_config;
+        std::ofstream g_file;
+        uintmax_t g_fileBytes = 0;
+
+        uint32_t CurrentThreadTag() noexcept {
+            thread_local const uint32_t tag = g_nextThreadId.fetch_add(1, std::memory_order_relaxed);
+            return tag;
+        }
+
+        int64_t NowMs() noexcept {
+            using namespace std::chrono;
+            return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+        // ----- Sinks -----
+        void WriteConsole(const Record& record) {
+            if (static_cast<int>(record.level) < static_cast<int>(g_config.consoleLevel)) return;
+            std::ostream& out = g_config.consoleStderr || record.level >= Level::Warn ? std::cerr : std::cout;
+            out << '[' << LevelName(record.level) << "] [" << record.component << "] ";
+            out.write(record.text, record.length);
+            out << '\n';
+        }
+
+        void RotateFile() {
+            g_file.close();
+            std::error_code ec;
+            for (int i = g_config.maxFiles - 1; i >= 1; --i) {
+                fs::path from = g_config.file;
+                from += "." + std::to_string(i);
+                fs::path to = g_config.file;
+                to += "." + std::to_string(i + 1);
+                fs::rename(from, to, ec);
+            }
+            fs::path first = g_config.file;
+            first += ".1";
+            fs::rename(g_config.file, first, ec);
+            g_file.open(g_config.file, std::ios::binary | std::ios::trunc);
+            g_fileBytes = 0;
+        }
+
+        void WriteFile(const Record& record) {
+            if (!g_file.is_open()) return;
+
+            const std::time_t seconds = static_cast<std::time_t>(record.timestampMs / 1000);
+            std::tm utc{};
+#ifdef _WIN32
+            gmtime_s(&utc, &seconds);
+#else
+            gmtime_r(&seconds, &utc);
+#endif
+            char prefix[64];
+            const int prefixLength = std::snprintf(prefix, sizeof(prefix),
+                "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ %5u %-5s ",
+                utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+                utc.tm_hour, utc.tm_min, utc.tm_sec,
+                static_cast<int>(record.timestampMs % 1000),
+                record.thread, LevelName(record.level));
+
+            g_file.write(prefix, prefixLength);
+            g_file << record.component << ": ";
+            g_file.write(record.text, record.length);
+            g_file << '\n';
+            g_fileBytes += prefixLength + std::char_traits<char>::length(record.component) + 3 + record.length;
+
+            if (g_config.maxFiles > 0 && g_fileBytes >= g_config.maxFileBytes) {
+                RotateFile();
+            }
+        }
+
+        void Emit(const Record& record) {
+            WriteConsole(record);
+            WriteFile(record);
+        }
+
+        void DrainAvailable() {
+            Record record;
+            bool wrote = false;
+            while (g_ring.TryPop(record)) {
+                Emit(record);
+                wrote = true;
+            }
+            if (wrote && g_file.is_open()) g_file.flush();
+        }
+
+        void DrainLoop() {
+            while (!g_stopRequested.load(std::memory_order_acquire)) {
+                DrainAvailable();
+                std::unique_lock<std::mutex> lock(g_wakeMutex);
+                g_wake.wait_for(lock, DRAIN_IDLE);
+            }
+            DrainAvailable();
+        }
+    }
+
+    // ----- Lifecycle -----
+    bool Start(const Config& config) {
+        std::lock_guard<std::mutex> lock(g_lifecycleMutex);
+        if (g_running.load()) return true;
+
+        g_config = config;
+        SetLevel(config.level);
+
+        if (!config.file.empty()) {
+            std::error_code ec;
+            fs::create_directories(config.file.parent_path(), ec);
+            g_file.open(config.file, std::ios::binary | std::ios::app);
+            g_fileBytes = fs::file_size(config.file, ec);
+            if (ec) g_fileBytes = 0;
+        }
+
+        g_stopRequested.store(false);
+        try {
+            g_drainThread = std::thread(DrainLoop);
+        } catch (const std::system_error&) {
+            g_file.close();
+            return false;
+        }
+        g_running.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(g_lifecycleMutex);
+        if (!g_running.exchange(false)) return;
+
+        g_stopRequested.store(true, std::memory_order_release);
+        g_wake.notify_one();
+        g_drainThread.join();
+
+        // Producers that raced the shutdown may still have queued records
+        DrainAvailable();
+
+        const uint64_t dropped = g_dropped.exchange(0);
+        if (dropped > 0) {
+            Formatter note;
+            note << "Dropped " << dropped << " record(s): ring buffer full";
+            Record record{ Level::Warn, "Logging", NowMs(), CurrentThreadTag(),
+                           static_cast<uint16_t>(note.view().size()), {} };
+            note.view().copy(record.text, record.length);
+            Emit(record);
+        }
+        g_file.close();
+    }
+
+    void SetLevel(Level level) noexcept {
+        detail::runtimeLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    const char* LevelName(Level level) noexcept {
+        switch (level) {
+            case Level::Trace: return "TRACE";
+            case Level::Debug: return "DEBUG";
+            case Level::Info:  return "Info";
+            case Level::Warn:  return "Warning";
+            case Level::Error: return "Error";
+            default:           return "Off";
+        }
+    }
+
+    // ----- Submission -----
+    void Submit(Level level, const char* component, const Formatter& message) noexcept {
+        Record record;
+        record.level = level;
+        record.component = component;  // Always a string literal
+        record.timestampMs = NowMs();
+        record.thread = CurrentThreadTag();
+        record.length = static_cast<uint16_t>(message.view().size());
+        message.view().copy(record.text, record.length);
+
+        if (!g_running.load(std::memory_order_acquire)) {
+            // No drain thread yet (or any more): keep console output flowing
+            try {
+                WriteConsole(record);
+            } catch (...) {
+            }
+            return;
+        }
+
+        const size_t backlog = g_ring.TryPush(record);
+        if (backlog == 0) {
+            g_dropped.fetch_add(1, std::memory_order_relaxed);
+        } else if (backlog >= WAKE_BACKLOG || level >= Level::Warn) {
+            g_wake.notify_one();
+        }
+    }
+
+    // ----- Formatter -----
+    Formatter& Formatter::operator<<(std::string_view text) noexcept {
+        const size_t n = std::min(text.size(), CAPACITY - m_length);
+        text.copy(m_buffer + m_length, n);
+        m_length += n;
+        return *this;
+    }
+
+    Formatter& Formatter::operator<<(std::wstring_view text) noexcept {
+        for (size_t i = 0; i < text.size(); ++i) {
+            uint32_t cp = static_cast<uint32_t>(text[i]);
+            // UTF-16 surrogate pair (wchar_t is 16 bits on Windows)
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < text.size()) {
+                const uint32_t low = static_cast<uint32_t>(text[i + 1]);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            appendCodePoint(cp);
+        }
+        return *this;
+    }
+
+    void Formatter::appendCodePoint(uint32_t cp) noexcept {
+        char utf8[4];
+        size_t n;
+        if (cp < 0x80) {
+            utf8[0] = static_cast<char>(cp);
+            n = 1;
+        } else if (cp < 0x800) {
+            utf8[0] = static_cast<char>(0xC0 | (cp >> 6));
+            utf8[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            n = 2;
+        } else if (cp < 0x10000) {
+            utf8[0] = static_cast<char>(0xE0 | (cp >> 12));
+            utf8[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            utf8[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            n = 3;
+        } else {
+            utf8[0] = static_cast<char>(0xF0 | (cp >> 18));
+            utf8[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            utf8[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            utf8[3] = static_cast<char>(0x80 | (cp & 0x3F));
+            n = 4;
+        }
+        if (m_length + n <= CAPACITY) {
+            std::char_traits<char>::copy(m_buffer + m_length, utf8, n);
+            m_length += n;
+        }
+    }
+
+    Formatter& Formatter::appendSigned(long long value) noexcept {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        return *this << std::string_view(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    Formatter& Formatter::appendUnsigned(unsigned long long value) noexcept {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        return *this << std::string_view(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    Formatter& Formatter::operator<<(double value) noexcept {
+        char digits[32];
+        const int n = std::snprintf(digits, sizeof(digits), "%.3f", value);
+        return *this << std::string_view(digits, n > 0 ? static_cast<size_t>(n) : 0);
+    }
+
+    Formatter& Formatter::operator<<(const void* pointer) noexcept {
+        char digits[24];
+        const int n = std::snprintf(digits, sizeof(digits), "%p", pointer);
+        return *this << std::string_view(digits, n > 0 ? static_cast<size_t>(n) : 0);
+    }
+} // namespace Logging
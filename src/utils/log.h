@@ -0,0 +1,124 @@
+// log.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// ----- Compile-time Level -----
+// Statements below this level are discarded by the compiler, arguments and all.
+// 0 = Trace, 1 = Debug, 2 = Info, 3 = Warn, 4 = Error, 5 = Off (set via CJ_LOG_LEVEL in CMake)
+#ifndef CJ_LOG_COMPILE_LEVEL
+#define CJ_LOG_COMPILE_LEVEL 1
+#endif
+
+namespace Logging {
+    namespace fs = std::filesystem;
+
+    enum class Level : int { Trace = 0, Debug, Info, Warn, Error, Off };
+
+    // ----- Configuration -----
+    struct Config {
+        fs::path file;                        // Empty: no file sink
+        Level level = Level::Info;            // Runtime threshold for all sinks
+        Level consoleLevel = Level::Info;     // Threshold for the stdout/stderr echo
+        bool consoleStderr = false;           // Echo everything to stderr (stdout carries data)
+        size_t maxFileBytes = 1024 * 1024;    // Rotate once the file grows past this
+        int maxFiles = 3;                     // Rotated generations kept (.1 ... .N)
+    };
+
+    // Starts the background drain thread. Until Start() is called (and after
+    // Stop()), records are written synchronously to the console only.
+    bool Start(const Config& config);
+
+    // Drains everything queued, reports dropped records and joins the thread.
+    void Stop();
+
+    // RAII wrapper for Start()/Stop()
+    class Session {
+    public:
+        explicit Session(const Config& config) { Start(config); }
+        ~Session() { Stop(); }
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+    };
+
+    // ----- Runtime Level -----
+    namespace detail {
+        extern std::atomic<int> runtimeLevel;
+    }
+
+    inline bool IsEnabled(Level level) noexcept {
+        return static_cast<int>(level) >= detail::runtimeLevel.load(std::memory_order_relaxed);
+    }
+
+    inline Level GetLevel() noexcept {
+        return static_cast<Level>(detail::runtimeLevel.load(std::memory_order_relaxed));
+    }
+
+    void SetLevel(Level level) noexcept;
+    const char* LevelName(Level level) noexcept;
+
+    // ----- Message Formatting -----
+    // Fixed-capacity, allocation-free message builder. Long messages are
+    // truncated rather than grown.
+    class Formatter {
+    public:
+        static constexpr size_t CAPACITY = 232;
+
+        Formatter& operator<<(std::string_view text) noexcept;
+        Formatter& operator<<(const char* text) noexcept { return *this << std::string_view(text ? text : "(null)"); }
+        Formatter& operator<<(const std::string& text) noexcept { return *this << std::string_view(text); }
+        Formatter& operator<<(std::wstring_view text) noexcept;
+        Formatter& operator<<(const wchar_t* text) noexcept { return *this << std::wstring_view(text ? text : L"(null)"); }
+        Formatter& operator<<(const std::wstring& text) noexcept { return *this << std::wstring_view(text); }
+        Formatter& operator<<(const fs::path& path) noexcept { return *this << path.native(); }
+        Formatter& operator<<(char c) noexcept { return *this << std::string_view(&c, 1); }
+        Formatter& operator<<(bool value) noexcept { return *this << (value ? "true" : "false"); }
+        Formatter& operator<<(double value) noexcept;
+        Formatter& operator<<(const void* pointer) noexcept;
+
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+        Formatter& operator<<(T value) noexcept {
+            if constexpr (std::is_signed_v<T>) return appendSigned(static_cast<long long>(value));
+            else return appendUnsigned(static_cast<unsigned long long>(value));
+        }
+
+        std::string_view view() const noexcept { return std::string_view(m_buffer, m_length); }
+
+    private:
+        Formatter& appendSigned(long long value) noexcept;
+        Formatter& appendUnsigned(unsigned long long value) noexcept;
+        void appendCodePoint(uint32_t cp) noexcept;
+
+        char m_buffer[CAPACITY];
+        size_t m_length = 0;
+    };
+
+    // Queues a formatted record for the drain thread (lock-free; drops when full)
+    void Submit(Level level, const char* component, const Formatter& message) noexcept;
+} // namespace Logging
+
+// ----- Logging Macros -----
+// `expr` is a << chain, evaluated only when the level is compiled in and enabled:
+//   CJ_LOG_INFO("Blocker", "Loaded " << count << " domain(s)");
+#define CJ_LOG(level, component, expr)                                              \
+    do {                                                                            \
+        if constexpr (static_cast<int>(level) >= CJ_LOG_COMPILE_LEVEL) {            \
+            if (::Logging::IsEnabled(level)) {                                      \
+                ::Logging::Formatter cjLogMessage_;                                 \
+                cjLogMessage_ << expr;                                              \
+                ::Logging::Submit(level, component, cjLogMessage_);                 \
+            }                                                                       \
+        }                                                                           \
+    } while (0)
+
+#define CJ_LOG_TRACE(component, expr) CJ_LOG(::Logging::Level::Trace, component, expr)
+#define CJ_LOG_DEBUG(component, expr) CJ_LOG(::Logging::Level::Debug, component, expr)
+#define CJ_LOG_INFO(component, expr)  CJ_LOG(::Logging::Level::Info,  component, expr)
+#define CJ_LOG_WARN(component, expr)  CJ_LOG(::Logging::Level::Warn,  component, expr)
+#define CJ_LOG_ERROR(component, expr) CJ_LOG(::Logging::Level::Error, component, expr)
@@ -0,0 +1,155 @@
+// mappedfile.cpp
+#include "mappedfile.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_open = std::exchange(other.m_open, false);
+        m_view = std::exchange(other.m_view, nullptr);
+        m_buffer = std::move(other.m_buffer);
+    }
+    return *this;
+}
+
+void MappedFile::Close() noexcept {
+    if (m_view) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_view);
+#else
+        munmap(m_view, m_size);
+#endif
+        m_view = nullptr;
+    }
+    m_buffer.reset();
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+// The view keeps the file alive, so no handle is held once it is mapped
+bool MappedFile::Open(const fs::path& path, Access access, size_t minMapped) noexcept {
+    Trace::Span span("MappedFile::Open");
+    Close();
+
+#ifdef _WIN32
+    const DWORD hint = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, hint, nullptr);
+    LARGE_INTEGER fileSize{};
+    if (file == INVALID_HANDLE_VALUE) return false;
+    if (!GetFileSizeEx(file, &fileSize) ||
+        static_cast<uint64_t>(fileSize.QuadPart) > std::numeric_limits<size_t>::max()) {
+        CloseHandle(file);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(fileSize.QuadPart);
+
+    if (size > 0 && size >= minMapped) {
+        const HANDLE section = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        m_view = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        const DWORD error = m_view ? ERROR_SUCCESS : GetLastError();
+        if (section) CloseHandle(section);
+        CloseHandle(file);
+        if (!m_view) {
+            CJ_LOG_ERROR("MappedFile", "Can't map " << path << ". Error: " << error);
+            return false;
+        }
+        m_data = static_cast<const unsigned char*>(m_view);
+    } else {
+        m_buffer.reset(new (std::nothrow) unsigned char[size > 0 ? size : 1]);
+        size_t done = 0;
+        while (m_buffer && done < size) {
+            DWORD read = 0;
+            const DWORD want = static_cast<DWORD>(std::min<size_t>(size - done, 1u << 30));
+            if (!::ReadFile(file, m_buffer.get() + done, want, &read, nullptr) || read == 0) break;
+            done += read;
+        }
+        CloseHandle(file);
+        if (!m_buffer || done != size) {
+            m_buffer.reset();
+            return false;
+        }
+        m_data = m_buffer.get();
+    }
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+        ::close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+
+    if (size > 0 && size >= minMapped) {
+        void* view = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            CJ_LOG_ERROR("MappedFile", "Can't map " << path << ": " << std::strerror(errno));
+            return false;
+        }
+        if (access == Access::Sequential) {
+            ::madvise(view, size, MADV_SEQUENTIAL);
+            ::madvise(view, size, MADV_WILLNEED);
+        } else {
+            ::madvise(view, size, MADV_RANDOM);
+        }
+        m_view = view;
+        m_data = static_cast<const unsigned char*>(view);
+    } else {
+        m_buffer.reset(new (std::nothrow) unsigned char[size > 0 ? size : 1]);
+        size_t done = 0;
+        while (m_buffer && done < size) {
+            const ssize_t read = ::read(fd, m_buffer.get() + done, size - done);
+            if (read < 0 && errno == EINTR) continue;
+            if (read <= 0) break;  // Shrank under us
+            done += static_cast<size_t>(read);
+        }
+        ::close(fd);
+        if (!m_buffer || done != size) {
+            m_buffer.reset();
+            return false;
+        }
+        m_data = m_buffer.get();
+    }
+#endif
+
+    m_size = size;
+    m_open = true;
+    span.Arg("bytes", size).Arg("mapped", m_view ? 1 : 0);
+    return true;
+}
+
+} // namespace utils
@@ -0,0 +1,62 @@
+// mappedfile.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// A whole file as read-only bytes. Files of `minMapped` bytes and up are
+// mapped, so reading one costs no copy and no heap; smaller ones, where the
+// mapping costs more than it saves, are read into a buffer. The bytes stay
+// valid until Close() or destruction.
+//
+// Only map files that are replaced by renaming over them, which leaves a
+// mapping of the old file intact. A file rewritten in place while mapped
+// faults on access on POSIX, and on Windows the writer's truncation fails
+// instead. The hosts file is such a file: the hosts writer copies over it in
+// place. Open those with BUFFERED.
+class MappedFile {
+public:
+    static constexpr size_t MIN_MAPPED_SIZE = 64 * 1024;
+    static constexpr size_t BUFFERED = SIZE_MAX;   // `minMapped` that never maps
+
+    enum class Access {
+        Sequential,  // Read front to back, once: aggressive read-ahead
+        Random       // Probed in place (lookup tables): no read-ahead
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // `minMapped` 0 maps the file whatever its size, e.g. one other
+    // processes map too
+    bool Open(const fs::path& path, Access access = Access::Sequential, size_t minMapped = MIN_MAPPED_SIZE) noexcept;
+    void Close() noexcept;
+
+    bool IsOpen() const noexcept { return m_open; }
+    bool IsMapped() const noexcept { return m_view != nullptr; }
+
+    const unsigned char* data() const noexcept { return m_data; }
+    size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    std::string_view View() const noexcept { return std::string_view(reinterpret_cast<const char*>(m_data), m_size); }
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+    void* m_view = nullptr;                       // The mapping, when mapped
+    std::unique_ptr<unsigned char[]> m_buffer;    // Small files
+};
+
+} // namespace utils
@@ -0,0 +1,260 @@
+// memtrack.cpp
+#include "memtrack.h"
+#include "log.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+
+namespace MemTrack {
+    namespace {
+        // Constant-initialized: the hooks may run before any dynamic initializer
+        thread_local Scope* t_current = nullptr;
+        std::atomic<uint64_t> g_allocations{0};
+        std::atomic<uint64_t> g_totalBytes{0};
+        std::atomic<int64_t> g_liveBytes{0};
+        std::atomic<int64_t> g_peakBytes{0};
+
+        void RaisePeak(std::atomic<int64_t>& peak, int64_t live) noexcept {
+            int64_t seen = peak.load(std::memory_order_relaxed);
+            while (live > seen && !peak.compare_exchange_weak(seen, live, std::memory_order_relaxed)) {
+            }
+        }
+
+        // Shared by Scope and TrackingResource
+        void Count(std::atomic<uint64_t>& allocations, std::atomic<uint64_t>& totalBytes,
+                   std::atomic<int64_t>& liveBytes, std::atomic<int64_t>& peakBytes, int64_t bytes) noexcept {
+            if (bytes > 0) {
+                allocations.fetch_add(1, std::memory_order_relaxed);
+                totalBytes.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+            }
+            const int64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            if (bytes > 0) RaisePeak(peakBytes, live);
+        }
+
+        Usage MakeUsage(const std::atomic<uint64_t>& allocations, const std::atomic<uint64_t>& totalBytes,
+                        const std::atomic<int64_t>& peakBytes) noexcept {
+            Usage usage;
+            usage.allocations = allocations.load(std::memory_order_relaxed);
+            usage.totalBytes = totalBytes.load(std::memory_order_relaxed);
+            usage.peakBytes = static_cast<uint64_t>(std::max<int64_t>(0, peakBytes.load(std::memory_order_relaxed)));
+            return usage;
+        }
+
+        struct Registry {
+            std::mutex mutex;
+            std::map<std::string, uint64_t, std::less<>> budgets;
+            std::map<std::string, Report, std::less<>> reports;
+        };
+
+        Registry& GetRegistry() {
+            static Registry registry;
+            return registry;
+        }
+    }
+
+    Usage GetProcessUsage() noexcept {
+        return MakeUsage(g_allocations, g_totalBytes, g_peakBytes);
+    }
+
+    // ----- Budgets -----
+    void SetBudget(std::string_view operation, uint64_t peakBytes) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (peakBytes == 0) {
+            auto it = registry.budgets.find(operation);
+            if (it != registry.budgets.end()) registry.budgets.erase(it);
+        } else {
+            registry.budgets[std::string(operation)] = peakBytes;
+        }
+    }
+
+    uint64_t GetBudget(std::string_view operation) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.budgets.find(operation);
+        return it == registry.budgets.end() ? 0 : it->second;
+    }
+
+    bool ParseBudget(std::string_view spec) {
+        const size_t eq = spec.find('=');
+        if (eq == 0 || eq == std::string_view::npos || eq + 1 == spec.size()) return false;
+        uint64_t mebibytes = 0;
+        for (char c : spec.substr(eq + 1)) {
+            if (c < '0' || c > '9' || mebibytes > (UINT64_MAX >> 20) / 10) return false;
+            mebibytes = mebibytes * 10 + static_cast<uint64_t>(c - '0');
+        }
+        SetBudget(spec.substr(0, eq), mebibytes << 20);
+        return true;
+    }
+
+    // ----- Scope -----
+    Scope::Scope(const char* operation) noexcept
+        : m_operation(operation), m_parent(t_current), m_budget(0) {
+        try {
+            m_budget = GetBudget(operation);
+        } catch (const std::exception&) {
+        }
+        t_current = this;
+    }
+
+    Scope::~Scope() {
+        t_current = m_parent;
+        const Usage usage = Get();
+        const bool over = m_budget != 0 && usage.peakBytes > m_budget;
+        try {
+            Registry& registry = GetRegistry();
+            {
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                auto it = registry.reports.find(m_operation);
+                if (it == registry.reports.end()) {
+                    it = registry.reports.emplace(m_operation, Report()).first;
+                    it->second.operation = m_operation;
+                }
+                Report& report = it->second;
+                ++report.runs;
+                report.allocations += usage.allocations;
+                report.totalBytes += usage.totalBytes;
+                report.peakBytes = std::max(report.peakBytes, usage.peakBytes);
+                report.budgetBytes = m_budget;
+                if (over) ++report.overBudget;
+            }
+            CJ_LOG_DEBUG("MemTrack", m_operation << ": peak " << usage.peakBytes << " bytes, "
+                         << usage.totalBytes << " allocated in " << usage.allocations << " allocation(s)");
+            if (over) {
+                static Metrics::Counter& exceeded = Metrics::GetCounter(
+                    "cj_memory_budget_exceeded_total", "Operations whose peak memory exceeded their budget");
+                exceeded.Add();
+                CJ_LOG_WARN("MemTrack", m_operation << " peaked at " << usage.peakBytes
+                            << " bytes, over its budget of " << m_budget);
+            }
+        } catch (const std::exception&) {
+        }
+    }
+
+    Usage Scope::Get() const noexcept {
+        return MakeUsage(m_allocations, m_totalBytes, m_peakBytes);
+    }
+
+    Scope* Scope::Current() noexcept {
+        return t_current;
+    }
+
+    void Scope::Charge(int64_t bytes) noexcept {
+        for (Scope* scope = this; scope; scope = scope->m_parent) {
+            Count(scope->m_allocations, scope->m_totalBytes, scope->m_liveBytes, scope->m_peakBytes, bytes);
+        }
+    }
+
+    void Scope::Allocated(size_t bytes) noexcept {
+        if (t_current) t_current->Charge(static_cast<int64_t>(bytes));
+    }
+
+    void Scope::Freed(size_t bytes) noexcept {
+        if (t_current) t_current->Charge(-static_cast<int64_t>(bytes));
+    }
+
+    Adopt::Adopt(Scope* scope) noexcept : m_previous(t_current) {
+        t_current = scope;
+    }
+
+    Adopt::~Adopt() {
+        t_current = m_previous;
+    }
+
+    // ----- Reports -----
+    std::vector<Report> GetReports() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<Report> reports;
+        reports.reserve(registry.reports.size());
+        for (const auto& [operation, report] : registry.reports) reports.push_back(report);
+        return reports;
+    }
+
+    void LogReports() {
+        for (const Report& report : GetReports()) {
+            CJ_LOG_INFO("MemTrack", report.operation << ": " << report.runs << " run(s), peak "
+                        << report.peakBytes << " bytes, " << report.totalBytes << " allocated in "
+                        << report.allocations << " allocation(s)"
+                        << (report.overBudget ? ", OVER BUDGET" : ""));
+        }
+    }
+
+    // ----- Tracking Resource -----
+    Usage TrackingResource::Get() const noexcept {
+        return MakeUsage(m_allocations, m_totalBytes, m_peakBytes);
+    }
+
+    void* TrackingResource::do_allocate(size_t bytes, size_t alignment) {
+        void* p = m_upstream->allocate(bytes, alignment);
+        Count(m_allocations, m_totalBytes, m_liveBytes, m_peakBytes, static_cast<int64_t>(bytes));
+        // With the hooks in, the upstream's operator new has charged the scope already
+        if (!GLOBAL_HOOKS) {
+            Count(g_allocations, g_totalBytes, g_liveBytes, g_peakBytes, static_cast<int64_t>(bytes));
+            Scope::Allocated(bytes);
+        }
+        return p;
+    }
+
+    void TrackingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+        m_upstream->deallocate(p, bytes, alignment);
+        Count(m_allocations, m_totalBytes, m_liveBytes, m_peakBytes, -static_cast<int64_t>(bytes));
+        if (!GLOBAL_HOOKS) {
+            Count(g_allocations, g_totalBytes, g_liveBytes, g_peakBytes, -static_cast<int64_t>(bytes));
+            Scope::Freed(bytes);
+        }
+    }
+} // namespace MemTrack
+
+#ifdef CJ_TRACK_ALLOCATIONS
+// ----- Global Hooks -----
+// Each block carries its size in a header so unsized deletes can be charged.
+// Over-aligned new/delete are left to the runtime and not counted.
+namespace {
+    constexpr size_t HOOK_HEADER = alignof(std::max_align_t);
+
+    void* TrackedAlloc(size_t bytes) noexcept {
+        void* raw = std::malloc(bytes + HOOK_HEADER);
+        if (!raw) return nullptr;
+        *static_cast<size_t*>(raw) = bytes;
+        MemTrack::Count(MemTrack::g_allocations, MemTrack::g_totalBytes, MemTrack::g_liveBytes,
+                        MemTrack::g_peakBytes, static_cast<int64_t>(bytes));
+        MemTrack::Scope::Allocated(bytes);
+        return static_cast<char*>(raw) + HOOK_HEADER;
+    }
+
+    void* TrackedNew(size_t bytes) {
+        while (true) {
+            if (void* p = TrackedAlloc(bytes)) return p;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    void TrackedFree(void* p) noexcept {
+        if (!p) return;
+        void* raw = static_cast<char*>(p) - HOOK_HEADER;
+        const size_t bytes = *static_cast<size_t*>(raw);
+        MemTrack::Count(MemTrack::g_allocations, MemTrack::g_totalBytes, MemTrack::g_liveBytes,
+                        MemTrack::g_peakBytes, -static_cast<int64_t>(bytes));
+        MemTrack::Scope::Freed(bytes);
+        std::free(raw);
+    }
+}
+
+void* operator new(size_t bytes) { return TrackedNew(bytes); }
+void* operator new[](size_t bytes) { return TrackedNew(bytes); }
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept { return TrackedAlloc(bytes); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept { return TrackedAlloc(bytes); }
+void operator delete(void* p) noexcept { TrackedFree(p); }
+void operator delete[](void* p) noexcept { TrackedFree(p); }
+void operator delete(void* p, size_t) noexcept { TrackedFree(p); }
+void operator delete[](void* p, size_t) noexcept { TrackedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { TrackedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { TrackedFree(p); }
+#endif
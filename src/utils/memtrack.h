@@ -0,0 +1,126 @@
+// memtrack.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MemTrack {
+    // Built with CJ_TRACK_ALLOCATIONS, global operator new/delete are replaced
+    // and every heap allocation is charged to the innermost Scope of the
+    // allocating thread. Without it only TrackingResource allocations are.
+#ifdef CJ_TRACK_ALLOCATIONS
+    constexpr bool GLOBAL_HOOKS = true;
+#else
+    constexpr bool GLOBAL_HOOKS = false;
+#endif
+
+    struct Usage {
+        uint64_t allocations = 0;
+        uint64_t totalBytes = 0;  // Everything allocated, freed or not
+        uint64_t peakBytes = 0;   // Highest live bytes above where the count started
+    };
+
+    // The whole process since startup (hooked and tracked allocations)
+    Usage GetProcessUsage() noexcept;
+
+    // ----- Budgets -----
+    // Peak-byte limit for an operation, 0 (the default) for none. A scope that
+    // goes over logs a warning and counts toward cj_memory_budget_exceeded_total;
+    // a headless command then fails with exit code 4 (see cli.cpp).
+    void SetBudget(std::string_view operation, uint64_t peakBytes);
+    uint64_t GetBudget(std::string_view operation);
+    // "<operation>=<MiB>", as given to --memory-budget
+    bool ParseBudget(std::string_view spec);
+
+    // ----- Scope -----
+    // Charges allocations on this thread to `operation` for its lifetime, and
+    // to every enclosing scope. Frees count against the scope they happen in,
+    // so memory released from an earlier operation lowers the live figure.
+    // Operation names must be string literals.
+    class Scope {
+    public:
+        explicit Scope(const char* operation) noexcept;
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        Usage Get() const noexcept;
+        bool OverBudget() const noexcept { return m_budget != 0 && Get().peakBytes > m_budget; }
+        const char* GetOperation() const noexcept { return m_operation; }
+
+        // Innermost scope on this thread, or null
+        static Scope* Current() noexcept;
+
+        // Called by the hooks and TrackingResource
+        static void Allocated(size_t bytes) noexcept;
+        static void Freed(size_t bytes) noexcept;
+
+    private:
+        friend class Adopt;
+
+        void Charge(int64_t bytes) noexcept;
+
+        const char* m_operation;
+        Scope* m_parent;
+        uint64_t m_budget;
+        std::atomic<uint64_t> m_allocations{0};
+        std::atomic<uint64_t> m_totalBytes{0};
+        std::atomic<int64_t> m_liveBytes{0};
+        std::atomic<int64_t> m_peakBytes{0};
+    };
+
+    // Makes `scope` current on this thread for its lifetime, so a task run on
+    // a worker is charged to the operation that queued it (see Executor)
+    class Adopt {
+    public:
+        explicit Adopt(Scope* scope) noexcept;
+        ~Adopt();
+        Adopt(const Adopt&) = delete;
+        Adopt& operator=(const Adopt&) = delete;
+    private:
+        Scope* m_previous;
+    };
+
+    // ----- Reports -----
+    // One row per operation name, accumulated as its scopes close
+    struct Report {
+        std::string operation;
+        uint64_t runs = 0;
+        uint64_t allocations = 0;
+        uint64_t totalBytes = 0;
+        uint64_t peakBytes = 0;     // Largest single run
+        uint64_t budgetBytes = 0;
+        uint64_t overBudget = 0;    // Runs that exceeded the budget
+    };
+
+    std::vector<Report> GetReports();
+    void LogReports();
+
+    // ----- Tracking Resource -----
+    // Counts what engine containers allocate through it (per resource and to
+    // the current scope) and forwards to `upstream`. Works without the hooks.
+    class TrackingResource : public std::pmr::memory_resource {
+    public:
+        explicit TrackingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+            : m_upstream(upstream) {}
+
+        Usage Get() const noexcept;
+        uint64_t GetLiveBytes() const noexcept { return static_cast<uint64_t>(m_liveBytes.load(std::memory_order_relaxed)); }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+        std::pmr::memory_resource* m_upstream;
+        std::atomic<uint64_t> m_allocations{0};
+        std::atomic<uint64_t> m_totalBytes{0};
+        std::atomic<int64_t> m_liveBytes{0};
+        std::atomic<int64_t> m_peakBytes{0};
+    };
+} // namespace MemTrack
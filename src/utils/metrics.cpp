@@ -0,0 +1,328 @@
+// metrics.cpp
+#include "metrics.h"
+#include "log.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace Metrics {
+    namespace {
+        enum class Kind { Counter, Gauge, SampledCounter, Histogram };
+
+        struct Entry {
+            std::string name;
+            std::string help;
+            Kind kind;
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Gauge> gauge;
+            std::unique_ptr<Histogram> histogram;
+        };
+
+        std::mutex g_registryMutex;
+        std::vector<std::unique_ptr<Entry>> g_entries;
+
+        // Prometheus bucket bounds: powers of two from 1us to ~67s
+        constexpr int EXPORT_OCTAVES = 27;
+
+        // Returns null when `name` is already registered as a different kind
+        Entry* FindOrCreate(std::string_view name, std::string_view help, Kind kind) {
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            for (auto& entry : g_entries) {
+                if (entry->name == name) {
+                    if (entry->kind == kind) return entry.get();
+                    CJ_LOG_ERROR("Metrics", "Metric " << name << " re-registered with a different type");
+                    return nullptr;
+                }
+            }
+
+            auto entry = std::make_unique<Entry>();
+            entry->name = std::string(name);
+            entry->help = std::string(help);
+            entry->kind = kind;
+            switch (kind) {
+            case Kind::Counter: entry->counter = std::make_unique<Counter>(); break;
+            case Kind::Gauge:
+            case Kind::SampledCounter: entry->gauge = std::make_unique<Gauge>(); break;
+            case Kind::Histogram: entry->histogram = std::make_unique<Histogram>(); break;
+            }
+            g_entries.push_back(std::move(entry));
+            return g_entries.back().get();
+        }
+
+        int HighestBit(uint64_t value) noexcept {
+            int bit = 0;
+            while (value >>= 1) ++bit;
+            return bit;
+        }
+
+        std::string JoinLabels(const std::string& labels, const std::string& extra) {
+            if (labels.empty() && extra.empty()) return {};
+            if (labels.empty()) return "{" + extra + "}";
+            if (extra.empty()) return "{" + labels + "}";
+            return "{" + labels + "," + extra + "}";
+        }
+    }
+
+    // ----- Histogram -----
+    // Buckets are closed above, (lower, upper], so every power of two ends
+    // one and an exported `le` bound takes in the values that land on it
+    size_t Histogram::BucketIndex(uint64_t micros) noexcept {
+        const uint64_t below = micros > 0 ? micros - 1 : 0;
+        if (below < SUB_BUCKETS) return static_cast<size_t>(below);
+
+        const int exponent = HighestBit(below);
+        if (exponent > MAX_EXPONENT) return BUCKET_COUNT - 1;
+
+        const size_t sub = static_cast<size_t>(below >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    uint64_t Histogram::BucketUpperBound(size_t index) noexcept {
+        if (index < SUB_BUCKETS) return index + 1;
+
+        const int exponent = static_cast<int>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+        const uint64_t sub = index % SUB_BUCKETS;
+        const uint64_t width = uint64_t{1} << (exponent - SUB_BUCKET_BITS);
+        return (SUB_BUCKETS + sub) * width + width;
+    }
+
+    void Histogram::Record(uint64_t micros) noexcept {
+        m_buckets[BucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(micros, std::memory_order_relaxed);
+
+        uint64_t seen = m_max.load(std::memory_order_relaxed);
+        while (micros > seen && !m_max.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Histogram::Percentile(double q) const noexcept {
+        const uint64_t total = Count();
+        if (total == 0) return 0;
+
+        if (q < 0.0) q = 0.0;
+        if (q > 1.0) q = 1.0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+        if (rank == 0) rank = 1;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                // Highest value the bucket can hold, but never above what was observed
+                const uint64_t bound = BucketUpperBound(i);
+                const uint64_t max = MaxMicros();
+                return bound < max ? bound : max;
+            }
+        }
+        return MaxMicros();
+    }
+
+    uint64_t Histogram::CountAtMost(uint64_t micros) const noexcept {
+        uint64_t atMost = 0;
+        for (size_t i = 0; i < BUCKET_COUNT && BucketUpperBound(i) <= micros; ++i) {
+            atMost += m_buckets[i].load(std::memory_order_relaxed);
+        }
+        return atMost;
+    }
+
+    // ----- Registry -----
+    // A name clash hands out a detached metric so callers never see null
+    Counter& GetCounter(std::string_view name, std::string_view help) {
+        static Counter orphan;
+        Entry* entry = FindOrCreate(name, help, Kind::Counter);
+        return entry ? *entry->counter : orphan;
+    }
+
+    Gauge& GetGauge(std::string_view name, std::string_view help) {
+        static Gauge orphan;
+        Entry* entry = FindOrCreate(name, help, Kind::Gauge);
+        return entry ? *entry->gauge : orphan;
+    }
+
+    Gauge& GetSampledCounter(std::string_view name, std::string_view help) {
+        static Gauge orphan;
+        Entry* entry = FindOrCreate(name, help, Kind::SampledCounter);
+        return entry ? *entry->gauge : orphan;
+    }
+
+    Histogram& GetHistogram(std::string_view name, std::string_view help) {
+        static Histogram orphan;
+        Entry* entry = FindOrCreate(name, help, Kind::Histogram);
+        return entry ? *entry->histogram : orphan;
+    }
+
+    // ----- Process Metrics -----
+    void UpdateProcessMetrics() noexcept {
+        try {
+            static Gauge& rss = GetGauge("cj_process_resident_memory_bytes", "Resident set size of this process");
+            static Gauge& cpu = GetSampledCounter("cj_process_cpu_seconds_total",
+                                                  "User plus kernel CPU time consumed by this process");
+
+#ifdef _WIN32
+            PROCESS_MEMORY_COUNTERS memory{};
+            if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) {
+                rss.Set(static_cast<double>(memory.WorkingSetSize));
+            }
+
+            FILETIME created, exited, kernel, user;
+            if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+                auto ticks = [](const FILETIME& ft) {
+                    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+                };
+                // FILETIME durations are in 100ns units
+                cpu.Set(static_cast<double>(ticks(kernel) + ticks(user)) / 1e7);
+            }
+#else
+            std::ifstream statm("/proc/self/statm");
+            unsigned long long pages = 0, resident = 0;
+            if (statm >> pages >> resident) {
+                rss.Set(static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)));
+            }
+
+            rusage usage{};
+            if (getrusage(RUSAGE_SELF, &usage) == 0) {
+                auto seconds = [](const timeval& tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+                cpu.Set(seconds(usage.ru_utime) + seconds(usage.ru_stime));
+            }
+#endif
+        } catch (...) {
+            // Registration can only fail on allocation; skip this refresh
+        }
+    }
+
+    // ----- Prometheus Export -----
+    std::string RenderPrometheus(const std::string& labels) {
+        std::ostringstream out;
+        out << std::setprecision(9);
+        const std::string plain = JoinLabels(labels, {});
+
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        for (const auto& entry : g_entries) {
+            out << "# HELP " << entry->name << ' ' << entry->help << '\n';
+            switch (entry->kind) {
+            case Kind::Counter:
+                out << "# TYPE " << entry->name << " counter\n"
+                    << entry->name << plain << ' ' << entry->counter->Value() << '\n';
+                break;
+            case Kind::SampledCounter:
+                out << "# TYPE " << entry->name << " counter\n"
+                    << entry->name << plain << ' ' << entry->gauge->Value() << '\n';
+                break;
+            case Kind::Gauge:
+                out << "# TYPE " << entry->name << " gauge\n"
+                    << entry->name << plain << ' ' << entry->gauge->Value() << '\n';
+                break;
+            case Kind::Histogram: {
+                const Histogram& h = *entry->histogram;
+                // Read the count first: buckets recorded after it only push the
+                // cumulative counts up, which +Inf then covers
+                const uint64_t count = h.Count();
+                out << "# TYPE " << entry->name << " histogram\n";
+                for (int octave = 0; octave < EXPORT_OCTAVES; ++octave) {
+                    const uint64_t boundMicros = uint64_t{1} << octave;
+                    std::ostringstream le;
+                    le << std::setprecision(9) << "le=\"" << static_cast<double>(boundMicros) / 1e6 << '"';
+                    const uint64_t atMost = h.CountAtMost(boundMicros);
+                    out << entry->name << "_bucket" << JoinLabels(labels, le.str()) << ' '
+                        << (atMost < count ? atMost : count) << '\n';
+                }
+                out << entry->name << "_bucket" << JoinLabels(labels, "le=\"+Inf\"") << ' ' << count << '\n'
+                    << entry->name << "_sum" << plain << ' ' << static_cast<double>(h.SumMicros()) / 1e6 << '\n'
+                    << entry->name << "_count" << plain << ' ' << count << '\n';
+                break;
+            }
+            }
+        }
+        return out.str();
+    }
+
+    bool WriteTextFile(const fs::path& file, const std::string& labels) noexcept {
+        fs::path tempPath = file;
+        tempPath += ".tmp";
+
+        try {
+            const std::string text = RenderPrometheus(labels);
+
+            std::error_code ec;
+            fs::create_directories(file.parent_path(), ec);
+            {
+                std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+                if (!ofs) return false;
+                ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+                ofs << text;
+            }
+            fs::rename(tempPath, file);
+            return true;
+        } catch (const std::exception& e) {
+            CJ_LOG_ERROR("Metrics", "Export failed: " << e.what());
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    // ----- Periodic Export -----
+    namespace {
+        std::mutex g_exportMutex;
+        std::condition_variable g_exportWake;
+        std::thread g_exportThread;
+        bool g_exportStop = false;
+        ExportConfig g_exportConfig;
+
+        void ExportLoop() {
+            std::unique_lock<std::mutex> lock(g_exportMutex);
+            while (!g_exportStop) {
+                lock.unlock();
+                UpdateProcessMetrics();
+                WriteTextFile(g_exportConfig.file, g_exportConfig.labels);
+                lock.lock();
+                g_exportWake.wait_for(lock, g_exportConfig.interval, [] { return g_exportStop; });
+            }
+        }
+    }
+
+    bool StartExporter(const ExportConfig& config) {
+        std::lock_guard<std::mutex> lock(g_exportMutex);
+        if (g_exportThread.joinable()) return true;
+
+        g_exportConfig = config;
+        g_exportStop = false;
+        try {
+            g_exportThread = std::thread(ExportLoop);
+        } catch (const std::exception& e) {
+            CJ_LOG_ERROR("Metrics", "Failed to start exporter: " << e.what());
+            return false;
+        }
+        CJ_LOG_INFO("Metrics", "Exporting metrics to " << config.file << " every "
+                    << static_cast<int64_t>(config.interval.count()) << "s");
+        return true;
+    }
+
+    void StopExporter() {
+        {
+            std::lock_guard<std::mutex> lock(g_exportMutex);
+            if (!g_exportThread.joinable()) return;
+            g_exportStop = true;
+        }
+        g_exportWake.notify_all();
+        g_exportThread.join();
+
+        UpdateProcessMetrics();
+        WriteTextFile(g_exportConfig.file, g_exportConfig.labels);
+    }
+} // namespace Metrics
@@ -0,0 +1,119 @@
+// metrics.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace Metrics {
+    namespace fs = std::filesystem;
+
+    // ----- Counter -----
+    // Monotonic, lock-free. Safe to bump from any thread.
+    class Counter {
+    public:
+        void Add(uint64_t amount = 1) noexcept { m_value.fetch_add(amount, std::memory_order_relaxed); }
+        uint64_t Value() const noexcept { return m_value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<uint64_t> m_value{0};
+    };
+
+    // ----- Gauge -----
+    class Gauge {
+    public:
+        void Set(double value) noexcept { m_value.store(value, std::memory_order_relaxed); }
+        double Value() const noexcept { return m_value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<double> m_value{0.0};
+    };
+
+    // ----- Histogram -----
+    // HDR-style log-linear histogram over microseconds: 8 linear sub-buckets per
+    // power of two, so any reported value is within 12.5% of the recorded one.
+    // Recording is a handful of relaxed atomic adds; no locks, no allocation.
+    class Histogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 3;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static constexpr int MAX_EXPONENT = 39;   // ~12 days in microseconds
+        static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+        void Record(uint64_t micros) noexcept;
+
+        template <typename Rep, typename Period>
+        void Record(std::chrono::duration<Rep, Period> elapsed) noexcept {
+            const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+            Record(static_cast<uint64_t>(micros > 0 ? micros : 0));
+        }
+
+        uint64_t Count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+        uint64_t SumMicros() const noexcept { return m_sum.load(std::memory_order_relaxed); }
+        uint64_t MaxMicros() const noexcept { return m_max.load(std::memory_order_relaxed); }
+
+        // Upper bound of the bucket holding the q-th quantile (0 <= q <= 1)
+        uint64_t Percentile(double q) const noexcept;
+
+        // Number of recorded values at or below `micros`, at bucket resolution
+        // (exact at powers of two)
+        uint64_t CountAtMost(uint64_t micros) const noexcept;
+
+        static size_t BucketIndex(uint64_t micros) noexcept;
+        static uint64_t BucketUpperBound(size_t index) noexcept;  // Highest value bucket `index` holds
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_buckets{};
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<uint64_t> m_sum{0};
+        std::atomic<uint64_t> m_max{0};
+    };
+
+    // ----- Registry -----
+    // Metrics live for the whole process; the returned references stay valid.
+    // Asking twice for the same name returns the same metric. Look them up once
+    // (e.g. into a function-local static) and keep the reference on hot paths.
+    Counter& GetCounter(std::string_view name, std::string_view help);
+    Gauge& GetGauge(std::string_view name, std::string_view help);
+    Histogram& GetHistogram(std::string_view name, std::string_view help);
+    // A total kept by someone else (e.g. the OS's CPU time), copied in with
+    // Set() and exported as a counter; it must never go down
+    Gauge& GetSampledCounter(std::string_view name, std::string_view help);
+
+    // Refreshes the built-in process metrics (resident memory, CPU seconds)
+    void UpdateProcessMetrics() noexcept;
+
+    // Renders every registered metric in Prometheus text exposition format.
+    // `labels` (e.g. `role="A"`) is attached to every sample.
+    std::string RenderPrometheus(const std::string& labels = {});
+
+    // Writes RenderPrometheus() to `file` via a temp file and rename, so a
+    // scraper never observes a half-written file
+    bool WriteTextFile(const fs::path& file, const std::string& labels = {}) noexcept;
+
+    // ----- Periodic Export -----
+    struct ExportConfig {
+        fs::path file;
+        std::string labels;
+        std::chrono::seconds interval{15};
+    };
+
+    // Starts a background thread that refreshes process metrics and rewrites
+    // the export file every interval. Stop() writes a final snapshot.
+    bool StartExporter(const ExportConfig& config);
+    void StopExporter();
+
+    // RAII wrapper for StartExporter()/StopExporter(); does nothing with an empty path
+    class ExportSession {
+    public:
+        explicit ExportSession(const ExportConfig& config)
+            : m_active(!config.file.empty() && StartExporter(config)) {}
+        ~ExportSession() { if (m_active) StopExporter(); }
+        ExportSession(const ExportSession&) = delete;
+        ExportSession& operator=(const ExportSession&) = delete;
+    private:
+        bool m_active;
+    };
+} // namespace Metrics
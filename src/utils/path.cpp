@@ -1,17 +1,19 @@
 // path.cpp
 
+#ifdef _WIN32
 #define NOMINMAX
-
 #include <windows.h>
+#endif
 #include "path.h"
+#include "asyncio.h"
+#include "log.h"
+#include "trace.h"
 #include <filesystem>
-#include <fstream>
 #include <random>
 #include <string>
 #include <vector>
 #include <system_error>
 #include <mutex>
-#include <iostream>
 #include <thread>
 #include <chrono>
 
@@ -97,8 +99,8 @@ namespace PathUtil {
                 continue;
             }
             
-            std::cerr << "[PathUtil] Directory creation failed: " << directory 
-                      << " - " << ec.message() << "\n";
+            CJ_LOG_ERROR("PathUtil", "Directory creation failed: " << directory
+                         << " - " << ec.message());
             return false;
         }
         
@@ -107,55 +109,48 @@ namespace PathUtil {
 
     // ----- Secure File Writing -----
     bool WriteFile(const fs::path& full_path, const std::vector<unsigned char>& data) noexcept {
-        fs::path temp_path = full_path;
-        temp_path += ".tmp";
-        
+        Trace::Span span("PathUtil::WriteFile");
+        span.Arg("bytes", data.size());
         try {
-            {
-                std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
-                if (!ofs) return false;
-                
-                ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-                ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
-            }
-            
-            // Atomic file replacement
-            if (!ReplaceFileW(full_path.c_str(), temp_path.c_str(), NULL, REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL)) {
-                std::wcerr << L"[PathUtil] ReplaceFile failed. Error: " << GetLastError() << "\n";
-                fs::remove(temp_path); // Clean up the temp file
+            // Replaced atomically; the temporary file is removed if anything fails
+            utils::IoBatch batch;
+            batch.WriteAtomically(full_path, data.data(), data.size());
+            if (!batch.Wait()) {
+                CJ_LOG_ERROR("PathUtil", "Write failed: " << batch.GetError());
                 return false;
             }
-            
+
             fs::permissions(full_path,
                 fs::perms::owner_read | fs::perms::owner_write,
                 fs::perm_options::replace);
-            
+
             return true;
         } catch (const std::exception& e) {
-            std::cerr << "[PathUtil] Write failed: " << e.what() << "\n";
-            fs::remove(temp_path);
+            CJ_LOG_ERROR("PathUtil", "Write failed: " << e.what());
             return false;
         }
     }
 
-    // ----- Secure File Reading -----
     bool ReadFile(const fs::path& full_path, std::vector<unsigned char>& data) noexcept {
+        Trace::Span span("PathUtil::ReadFile");
         try {
             std::error_code ec;
             auto file_size = fs::file_size(full_path, ec);
             if (ec || file_size == static_cast<uintmax_t>(-1)) return false;
 
             data.resize(static_cast<size_t>(file_size));
-            
-            std::ifstream ifs(full_path, std::ios::binary);
-            if (!ifs) return false;
-            
-            ifs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            ifs.read(reinterpret_cast<char*>(data.data()), data.size());
-            
+            span.Arg("bytes", data.size());
+
+            utils::IoBatch batch;
+            batch.Read(full_path, data.data(), data.size());
+            if (!batch.Wait()) {
+                CJ_LOG_ERROR("PathUtil", "Read failed: " << batch.GetError());
+                data.clear();
+                return false;
+            }
             return true;
         } catch (const std::exception& e) {
-            std::cerr << "[PathUtil] Read failed: " << e.what() << "\n";
+            CJ_LOG_ERROR("PathUtil", "Read failed: " << e.what());
             data.clear();
             return false;
         }
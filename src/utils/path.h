@@ -71,6 +71,8 @@ namespace PathUtil {
     // fullPath: Source file path
     // data: Output buffer (will be cleared on failure)
     // Returns: true if read succeeded
+    // Callers that only walk the bytes once should use utils::MappedFile
+    // (mappedfile.h), which reads them in place without this copy
     bool ReadFile(const fs::path& fullPath, std::vector<unsigned char>& data) noexcept;
 
     // Backward-compatible version using string
@@ -0,0 +1,233 @@
+// schedule.cpp
+#include "schedule.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace utils {
+
+namespace {
+
+constexpr uint32_t MINUTES_PER_DAY = 24 * 60;
+constexpr uint8_t ALL_DAYS = 0x7F;
+constexpr std::string_view DAY_NAMES[7] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun" };
+
+std::string_view TrimView(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+    return text;
+}
+
+// Next whitespace-separated field, consumed from `text`
+std::string_view NextField(std::string_view& text) {
+    text = TrimView(text);
+    size_t end = 0;
+    while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end]))) ++end;
+    const std::string_view field = text.substr(0, end);
+    text.remove_prefix(end);
+    return field;
+}
+
+int DayIndex(std::string_view name) {
+    if (name.size() != 3) return -1;
+    for (int day = 0; day < 7; ++day) {
+        bool same = true;
+        for (size_t i = 0; i < 3; ++i) {
+            if (std::tolower(static_cast<unsigned char>(name[i])) != DAY_NAMES[day][i]) same = false;
+        }
+        if (same) return day;
+    }
+    return -1;
+}
+
+// `*`, or a comma list of days and day ranges; bit 0 is Monday
+bool ParseDays(std::string_view field, uint8_t& days) {
+    days = 0;
+    if (field == "*") {
+        days = ALL_DAYS;
+        return true;
+    }
+    while (!field.empty()) {
+        const size_t comma = field.find(',');
+        const std::string_view item = field.substr(0, comma);
+        field = comma == std::string_view::npos ? std::string_view() : field.substr(comma + 1);
+
+        const size_t dash = item.find('-');
+        const int first = DayIndex(item.substr(0, dash));
+        const int last = dash == std::string_view::npos ? first : DayIndex(item.substr(dash + 1));
+        if (first < 0 || last < 0) return false;
+        for (int day = first;; day = (day + 1) % 7) {
+            days |= static_cast<uint8_t>(1u << day);
+            if (day == last) break;
+        }
+    }
+    return days != 0;
+}
+
+// HH:MM, 00:00 through 24:00
+bool ParseClock(std::string_view text, uint32_t& minute) {
+    if (text.size() != 5 || text[2] != ':') return false;
+    for (size_t i : { 0, 1, 3, 4 }) {
+        if (!std::isdigit(static_cast<unsigned char>(text[i]))) return false;
+    }
+    const uint32_t hours = (text[0] - '0') * 10 + (text[1] - '0');
+    const uint32_t minutes = (text[3] - '0') * 10 + (text[4] - '0');
+    if (minutes > 59 || hours > 24 || (hours == 24 && minutes != 0)) return false;
+    minute = hours * 60 + minutes;
+    return true;
+}
+
+} // anonymous namespace
+
+// ----- Parsing -----
+bool Schedule::Parse(std::string_view text, const DomainCatalog& catalog) {
+    Trace::Span span("Schedule::Parse");
+    Clear();
+    std::vector<uint32_t> minutes(MINUTES_PER_WEEK, 0);
+    size_t rules = 0;
+    size_t lineNumber = 0;
+
+    while (!text.empty()) {
+        const size_t eol = text.find('\n');
+        std::string_view line = text.substr(0, eol);
+        text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+        ++lineNumber;
+
+        const size_t hash = line.find('#');
+        if (hash != std::string_view::npos) line = line.substr(0, hash);
+        if (TrimView(line).empty()) continue;
+
+        const std::string_view categoryField = NextField(line);
+        const std::string_view dayField = NextField(line);
+        const std::string_view windowField = NextField(line);
+        const std::string where = "line " + std::to_string(lineNumber) + ": ";
+        if (windowField.empty() || !TrimView(line).empty()) {
+            m_error = where + "expected <categories> <days> <HH:MM-HH:MM>";
+            CJ_LOG_ERROR("Schedule", m_error);
+            return false;
+        }
+
+        uint32_t mask = 0;
+        for (std::string_view names = categoryField; !names.empty();) {
+            const size_t comma = names.find(',');
+            const std::string_view name = names.substr(0, comma);
+            names = comma == std::string_view::npos ? std::string_view() : names.substr(comma + 1);
+            const uint32_t bit = catalog.CategoryMask(name);
+            if (bit == 0) {
+                m_error = where + "unknown category \"" + std::string(name) + "\"";
+                CJ_LOG_ERROR("Schedule", m_error);
+                return false;
+            }
+            mask |= bit;
+        }
+
+        uint8_t days = 0;
+        if (!ParseDays(dayField, days)) {
+            m_error = where + "bad days \"" + std::string(dayField) + "\"";
+            CJ_LOG_ERROR("Schedule", m_error);
+            return false;
+        }
+
+        const size_t dash = windowField.find('-');
+        uint32_t start = 0, end = 0;
+        if (dash == std::string_view::npos || !ParseClock(windowField.substr(0, dash), start) ||
+            !ParseClock(windowField.substr(dash + 1), end) || start == MINUTES_PER_DAY || start == end) {
+            m_error = where + "bad window \"" + std::string(windowField) + "\"";
+            CJ_LOG_ERROR("Schedule", m_error);
+            return false;
+        }
+        // Overnight windows spill into the next day (and Sunday's into Monday)
+        const uint32_t length = end > start ? end - start : MINUTES_PER_DAY - start + end;
+
+        for (uint32_t day = 0; day < 7; ++day) {
+            if (!(days & (1u << day))) continue;
+            const uint32_t first = day * MINUTES_PER_DAY + start;
+            for (uint32_t i = 0; i < length; ++i) minutes[(first + i) % MINUTES_PER_WEEK] |= mask;
+        }
+        ++rules;
+    }
+
+    m_minutes = std::move(minutes);
+    m_rules = rules;
+    span.Arg("rules", rules);
+    CJ_LOG_DEBUG("Schedule", "Parsed " << rules << " rule(s) into " << States().size() << " state(s)");
+    return true;
+}
+
+bool Schedule::Load(const fs::path& path, const DomainCatalog& catalog) {
+    try {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) {
+            m_error = "can't read " + path.u8string();
+            CJ_LOG_ERROR("Schedule", "Can't read " << path);
+            return false;
+        }
+        std::ostringstream text;
+        text << ifs.rdbuf();
+        return Parse(text.str(), catalog);
+    } catch (const std::exception& e) {
+        m_error = e.what();
+        CJ_LOG_ERROR("Schedule", "Load failed: " << e.what());
+        return false;
+    }
+}
+
+void Schedule::Clear() noexcept {
+    m_minutes.clear();
+    m_rules = 0;
+    m_error.clear();
+}
+
+// ----- Queries -----
+uint32_t Schedule::MaskAt(uint32_t minuteOfWeek) const noexcept {
+    return m_minutes.empty() ? 0 : m_minutes[minuteOfWeek % MINUTES_PER_WEEK];
+}
+
+uint32_t Schedule::CurrentMask(std::time_t now) const {
+    uint32_t minute = 0, second = 0;
+    if (!LocalMinuteOfWeek(now, minute, second)) return 0;
+    return MaskAt(minute);
+}
+
+std::vector<uint32_t> Schedule::States() const {
+    std::vector<uint32_t> states;
+    if (m_minutes.empty()) return states;
+    // Masks change rarely along the week; only run starts need a look
+    uint32_t previous = m_minutes.back() + 1;
+    for (uint32_t mask : m_minutes) {
+        if (mask != previous) states.push_back(mask);
+        previous = mask;
+    }
+    std::sort(states.begin(), states.end());
+    states.erase(std::unique(states.begin(), states.end()), states.end());
+    return states;
+}
+
+uint32_t Schedule::SecondsUntilChange(std::time_t now) const {
+    uint32_t minute = 0, second = 0;
+    if (m_minutes.empty() || !LocalMinuteOfWeek(now, minute, second)) return MINUTES_PER_WEEK * 60;
+    const uint32_t current = MaskAt(minute);
+    for (uint32_t ahead = 1; ahead < MINUTES_PER_WEEK; ++ahead) {
+        if (MaskAt(minute + ahead) != current) return (ahead - 1) * 60 + (60 - second);
+    }
+    return MINUTES_PER_WEEK * 60;
+}
+
+bool Schedule::LocalMinuteOfWeek(std::time_t time, uint32_t& minute, uint32_t& second) {
+    std::tm local{};
+#ifdef _WIN32
+    if (localtime_s(&local, &time) != 0) return false;
+#else
+    if (!localtime_r(&time, &local)) return false;
+#endif
+    const uint32_t day = static_cast<uint32_t>((local.tm_wday + 6) % 7);   // tm_wday counts from Sunday
+    minute = day * MINUTES_PER_DAY + static_cast<uint32_t>(local.tm_hour * 60 + local.tm_min);
+    second = static_cast<uint32_t>(std::min(local.tm_sec, 59));   // Leap second reads as :59
+    return true;
+}
+
+} // namespace utils
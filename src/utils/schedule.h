@@ -0,0 +1,68 @@
+// schedule.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "catalog.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Weekly time windows that enforce catalog categories, one rule per line:
+//
+//   # categories   days       window
+//   social         mon-fri    09:00-17:00
+//   ads,trackers   *          00:00-24:00
+//   gaming         sat,sun    22:00-02:00
+//
+// Days are `*`, names (mon..sun), ranges (`fri-mon` wraps) or comma lists of
+// either. A window whose end is before its start runs past midnight into the
+// next day. Rules overlap freely; a minute enforces every category whose
+// window covers it.
+//
+// Categories are resolved against the catalog (filled by the headless
+// `catalog add <category> <list>`) when the schedule is parsed, and the rules
+// are expanded into a mask per minute of the week, so asking what to enforce
+// now is an array index. States() lists the distinct masks, which is what the
+// Blocker compiles ahead of time.
+class Schedule {
+public:
+    static constexpr const char* FILENAME = "schedule.txt";
+    static constexpr uint32_t MINUTES_PER_WEEK = 7 * 24 * 60;
+
+    bool Parse(std::string_view text, const DomainCatalog& catalog);
+    bool Load(const fs::path& path, const DomainCatalog& catalog);
+    void Clear() noexcept;
+
+    const std::string& GetError() const noexcept { return m_error; }
+
+    size_t RuleCount() const noexcept { return m_rules; }
+    bool empty() const noexcept { return m_rules == 0; }
+
+    // Categories enforced at a minute of the week (Monday 00:00 is 0)
+    uint32_t MaskAt(uint32_t minuteOfWeek) const noexcept;
+    uint32_t CurrentMask(std::time_t now) const;
+
+    // Distinct masks over the week, ascending (0 if some minute has no rule)
+    std::vector<uint32_t> States() const;
+
+    // Seconds from `now` until the enforced mask next changes; a full week if it never does
+    uint32_t SecondsUntilChange(std::time_t now) const;
+
+    // Local time as minute of the week plus the second within that minute
+    static bool LocalMinuteOfWeek(std::time_t time, uint32_t& minute, uint32_t& second);
+
+private:
+    std::vector<uint32_t> m_minutes;   // MINUTES_PER_WEEK masks once parsed
+    size_t m_rules = 0;
+    std::string m_error;
+};
+
+} // namespace utils
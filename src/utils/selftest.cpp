@@ -0,0 +1,379 @@
+// selftest.cpp
+#include "selftest.h"
+#include "blocker.h"
+#include "catalog.h"
+#include "compiled.h"
+#include "crypto.h"
+#include "dnsbench.h"
+#include "domainset.h"
+#include "idna.h"
+#include "importer.h"
+#include "journal.h"
+#include "schedule.h"
+#include "sinkhole.h"
+#include "snapshot.h"
+#include "tamper.h"
+
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace SelfTest {
+
+namespace {
+
+constexpr const char* BACKUP_FILENAME = "hosts_backup.txt";
+constexpr const char* STOCK_HOSTS = "127.0.0.1 localhost\n::1 localhost\n";
+
+bool ReadText(const fs::path& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+bool WriteText(const fs::path& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+    return static_cast<bool>(out);
+}
+
+// A directory of its own with a stock hosts file, for one Blocker
+bool PrepareHosts(const fs::path& dir, std::string& failure) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec || !WriteText(dir / "hosts", STOCK_HOSTS)) {
+        failure = "can't set up " + dir.u8string();
+        return false;
+    }
+    return true;
+}
+
+// Adblock rules cover their subdomains, which only sinkhole mode keeps (as *.name)
+constexpr const char* WILDCARD_LIST = "[Adblock Plus 2.0]\n||ads.example^\n||tracker.example^\n";
+constexpr size_t WILDCARD_LIST_ENTRIES = 4;
+
+utils::DomainPool Import(std::string_view text, bool wildcards = false) {
+    utils::ListImporter::Options options;
+    options.wildcards = wildcards;
+    utils::DomainPool pool;
+    utils::ListImporter::ImportText(text, options, pool);
+    return pool;
+}
+
+bool Fail(std::string& failure, std::string message) {
+    failure = std::move(message);
+    return false;
+}
+
+} // anonymous namespace
+
+bool CheckImport(std::string& failure) {
+    using Format = utils::ListImporter::Format;
+    struct ImportCase { const char* text; Format format; };
+    const ImportCase importCases[] = {
+        { "# hosts\n0.0.0.0 Ads.Example.com\n", Format::Hosts },
+        { "[Adblock Plus 2.0]\n||ads.example.com^\n@@||ok.example^\n", Format::Adblock },
+        { "[Adblock Plus 2.0]\n||ads.example.com^$important\n||tp.example^$third-party\n"
+          "||popup.example^$popup\n||scoped.example^$domain=site.example\n", Format::Adblock },
+        { "address=/ads.example.com/0.0.0.0\n", Format::Dnsmasq },
+        { "server:\n  local-zone: \"ads.example.com\" always_nxdomain\n", Format::Unbound },
+        { "$TTL 60\nads.example.com CNAME .\n", Format::Rpz },
+    };
+    for (const ImportCase& importCase : importCases) {
+        utils::DomainPool imported;
+        Format detected = Format::Auto;
+        utils::ListImporter::ImportText(importCase.text, {}, imported, nullptr, &detected);
+        if (detected != importCase.format || imported.size() != 1 || *imported.begin() != "ads.example.com") {
+            return Fail(failure, std::string(utils::ListImporter::FormatName(importCase.format)) +
+                        " list imported as " + utils::ListImporter::FormatName(detected) + " with " +
+                        std::to_string(imported.size()) + " domain(s)");
+        }
+    }
+
+    // Internationalized names are imported in their punycode form
+    utils::DomainPool idnImported;
+    utils::ListImporter::Stats idnStats;
+    utils::ListImporter::ImportText(u8"0.0.0.0 B\u00FCcher.example\n0.0.0.0 \u4F8B\u3048\u3002\u30C6\u30B9\u30C8\n"
+                                    "0.0.0.0 bad\xC3.example\n", {}, idnImported, &idnStats);
+    if (idnImported.size() != 2 || idnImported[0] != "xn--bcher-kva.example" ||
+        idnImported[1] != "xn--r8jz45g.xn--zckzah" || idnStats.converted != 2 || idnStats.invalid != 1) {
+        return Fail(failure, std::string("IDN names not converted by ") + Idna::BackendName(Idna::ActiveBackend()));
+    }
+
+    // The built-in mapping on its own, whichever backend is active
+    std::string builtin;
+    const Idna::Backend active = Idna::ActiveBackend();
+    Idna::ForceBackend(Idna::Backend::Builtin);
+    const bool builtinOk = Idna::ToAscii(u8"\u041F\u0420\u0418\u041C\u0415\u0420.\u0440\u0444", builtin);
+    Idna::ForceBackend(active);
+    if (!builtinOk || builtin != "xn--e1afmkfd.xn--p1ai") return Fail(failure, "built-in IDN mapping wrong");
+    return true;
+}
+
+bool CheckCatalog(const fs::path& workDir, std::string& failure) {
+    const utils::DomainPool adsList = Import("ads.example\nshared.example\n");
+    const utils::DomainPool trackersList = Import("shared.example\ntrack.example\n");
+    const fs::path catalogPath = workDir / utils::DomainCatalog::FILENAME;
+
+    utils::DomainCatalog catalog;
+    if (!catalog.AddDomains("ads", adsList) || !catalog.AddDomains("Trackers", trackersList) ||
+        catalog.size() != 3 || !catalog.Save(catalogPath)) {
+        return Fail(failure, "catalog not built and saved with 3 distinct domains");
+    }
+
+    utils::DomainCatalog reloaded;
+    if (!reloaded.Load(catalogPath)) return Fail(failure, "catalog not loaded back");
+    const uint32_t adsMask = reloaded.CategoryMask("ads");
+    const uint32_t trackersMask = reloaded.CategoryMask("trackers");
+    utils::DomainPool selected;
+    reloaded.Select(trackersMask, selected);
+    if (adsMask == 0 || trackersMask == 0 || adsMask == trackersMask || selected.size() != 2 ||
+        reloaded.Count(reloaded.AllCategories()) != 3 ||
+        reloaded.Lookup("shared.example") != (adsMask | trackersMask)) {
+        return Fail(failure, "category masks wrong after reload");
+    }
+
+    // Weekday hours plus a Sunday window that runs into Monday
+    utils::Schedule schedule;
+    if (!schedule.Parse("ads mon-fri 09:00-17:00\ntrackers sun 22:00-02:00 # late\n", reloaded) ||
+        schedule.MaskAt(9 * 60) != adsMask || schedule.MaskAt(17 * 60) != 0 ||
+        schedule.MaskAt(6 * 24 * 60 + 23 * 60) != trackersMask || schedule.MaskAt(60) != trackersMask ||
+        schedule.States().size() != 3 || schedule.Parse("ads weekdays 09:00-17:00", reloaded)) {
+        return Fail(failure, "schedule resolved the wrong category mask");
+    }
+    return true;
+}
+
+bool CheckProfile(std::string& failure) {
+    const utils::DomainPool adsList = Import("ads.example\nshared.example\n");
+    const utils::DomainPool trackersList = Import("shared.example\ntrack.example\n");
+    const utils::DomainPool allowList = Import("shared.example\n");
+
+    utils::SetExpression expression;
+    utils::DomainSet profile;
+    const bool evaluated = expression.Parse("(ads | trackers) - allow") &&
+        expression.Evaluate([&](std::string_view name, utils::DomainSet& out) {
+            const utils::DomainPool* list = name == "ads" ? &adsList : name == "trackers" ? &trackersList :
+                                            name == "allow" ? &allowList : nullptr;
+            if (list) out = utils::DomainSet::FromPool(*list);
+            return list != nullptr;
+        }, profile);
+    if (!evaluated || profile.size() != 2 || profile[0] != "ads.example" || profile[1] != "track.example") {
+        return Fail(failure, "(ads | trackers) - allow didn't leave ads.example and track.example");
+    }
+    if (expression.Parse("(ads | trackers")) return Fail(failure, "unbalanced expression accepted");
+    return true;
+}
+
+bool CheckApply(const fs::path& workDir, std::string& failure) {
+    const fs::path dir = workDir / "apply";
+    if (!PrepareHosts(dir, failure)) return false;
+
+    Blocker blocker(dir / "hosts", dir / BACKUP_FILENAME);
+    if (!blocker.loadDomains(std::vector<std::string>{ "example.com", "test.org", "debug.example.net" }) ||
+        !blocker.applyBlock()) {
+        return Fail(failure, "block not applied");
+    }
+    if (!blocker.verifyBlock()) return Fail(failure, "applied block didn't verify");
+    if (!blocker.isHostBlocked("Debug.Example.NET.") || blocker.isHostBlocked("not-blocked.invalid")) {
+        return Fail(failure, "filter lookup wrong");
+    }
+
+    std::string text;
+    const size_t entry = ReadText(blocker.getHostsPath(), text) ? text.find("test.org") : std::string::npos;
+    if (entry == std::string::npos) return Fail(failure, "test.org missing from the hosts file");
+    text.replace(entry, 8, "test.net");
+    if (!WriteText(blocker.getHostsPath(), text)) return Fail(failure, "can't edit the hosts file");
+    if (blocker.verifyBlock()) return Fail(failure, "edited block still verified");
+    if (!blocker.reapplyBlock() || !blocker.verifyBlock()) return Fail(failure, "edited block not reapplied");
+    return true;
+}
+
+bool CheckJournal(const fs::path& workDir, std::string& failure) {
+    using Outcome = utils::HostsJournal::Outcome;
+    const fs::path dir = workDir / "journal";
+    if (!PrepareHosts(dir, failure)) return false;
+
+    Blocker blocker(dir / "hosts", dir / BACKUP_FILENAME);
+    utils::HostsJournal journal(dir);
+    utils::SnapshotStore::Version original;
+    if (!blocker.getSnapshots().Save(STOCK_HOSTS, "selftest", &original)) {
+        return Fail(failure, "snapshot not saved");
+    }
+
+    // Each case leaves a BEGIN without its COMMIT, as a crash would, after the
+    // writer got `written` into the hosts file (if anything) and, with
+    // `lostStaged`, after the staged copy was lost too
+    auto recover = [&](const std::string& content, const char* written, bool lostStaged, uint64_t snapshotId,
+                       Outcome expected, const std::string& after) {
+        {
+            utils::FileLock lock;
+            uint64_t transaction = 0;
+            if (!journal.Lock(lock) || !journal.Begin(blocker.getHostsPath(), content, snapshotId, transaction)) {
+                return Fail(failure, "transition not begun");
+            }
+            if (written && !WriteText(blocker.getHostsPath(), written)) {
+                return Fail(failure, "can't write the hosts file");
+            }
+            std::error_code ec;
+            if (lostStaged) fs::remove(journal.GetStagedPath(transaction), ec);
+        }
+        const Outcome outcome = blocker.recoverHostsTransition();
+        std::string text;
+        if (outcome != expected || !ReadText(blocker.getHostsPath(), text) || text != after) {
+            return Fail(failure, std::string("expected ") + utils::HostsJournal::OutcomeName(expected) + ", got " +
+                        utils::HostsJournal::OutcomeName(outcome));
+        }
+        return true;
+    };
+
+    const std::string blocked = std::string(STOCK_HOSTS) + "0.0.0.0 ads.example\n";
+    return recover(blocked, nullptr, false, 0, Outcome::RolledForward, blocked) &&
+           recover(STOCK_HOSTS, STOCK_HOSTS, false, 0, Outcome::Completed, STOCK_HOSTS) &&
+           recover(blocked, "127.0.0.1 local", true, original.id, Outcome::RolledBack, STOCK_HOSTS) &&
+           (blocker.recoverHostsTransition() == Outcome::Clean || Fail(failure, "journal not clean afterwards"));
+}
+
+bool CheckCompiled(const fs::path& workDir, std::string& failure) {
+    const fs::path dir = workDir / "compiled";
+    if (!PrepareHosts(dir, failure)) return false;
+    const fs::path output = dir / "out";
+
+    Blocker blocker(dir / "hosts", dir / BACKUP_FILENAME);
+    uint64_t first = 0, second = 0;
+    if (!blocker.loadDomains(Import("ads.example\nTrack.Example.\n")) || !blocker.compileBlock(output, &first)) {
+        return Fail(failure, "first generation not compiled");
+    }
+    if (!blocker.loadDomains(Import("ads.example\ntrack.example\nthird.example\n")) ||
+        !blocker.compileBlock(output, &second)) {
+        return Fail(failure, "second generation not compiled");
+    }
+    if (second != first + 1 || utils::CompiledBlocklist::CurrentGeneration(output) != second) {
+        return Fail(failure, "generations " + std::to_string(first) + ", " + std::to_string(second) +
+                    ", current " + std::to_string(utils::CompiledBlocklist::CurrentGeneration(output)));
+    }
+
+    utils::CompiledBlocklist compiled;
+    if (!compiled.Attach(output) || compiled.GetGeneration() != second || compiled.IsSinkhole() ||
+        compiled.size() != 3 || !compiled.Contains("THIRD.example.") || compiled.Contains("example") ||
+        compiled.GetBlock().find(Blocker::BLOCK_START_MARKER) == std::string_view::npos) {
+        return Fail(failure, "current generation doesn't map the last compile");
+    }
+    std::error_code ec;
+    if (fs::exists(blocker.getHostsPath().parent_path() / utils::CompiledBlocklist::DIRNAME, ec)) {
+        return Fail(failure, "compile published into the data directory too");
+    }
+    return true;
+}
+
+bool CheckCompileSinkhole(const fs::path& workDir, std::string& failure) {
+    const fs::path dir = workDir / "compile-sinkhole";
+    if (!PrepareHosts(dir, failure)) return false;
+    const fs::path output = dir / "out";
+
+    Blocker blocker(dir / "hosts", dir / BACKUP_FILENAME);
+    blocker.setSinkholeMode(true);
+    uint64_t generation = 0;
+    if (!blocker.loadDomains(Import(WILDCARD_LIST, true)) ||
+        !blocker.compileBlock(output, &generation)) {
+        return Fail(failure, "sinkhole generation not compiled");
+    }
+
+    utils::CompiledBlocklist compiled;
+    if (!compiled.Attach(output) || !compiled.IsSinkhole() || compiled.size() != WILDCARD_LIST_ENTRIES) {
+        return Fail(failure, "generation not flagged sinkhole with every entry");
+    }
+    utils::DomainPool entries;
+    compiled.ToPool(entries);
+    const std::string list = utils::DnsSinkhole::RenderList(entries);
+    crypto::Digest digest{};
+    if (!crypto::Sha256(list.data(), list.size(), digest)) return Fail(failure, "can't hash the list");
+    const std::string_view block = compiled.GetBlock();
+    if (list.find("*.tracker.example") == std::string::npos ||
+        block.find(utils::DnsSinkhole::LIST_FILENAME) == std::string_view::npos ||
+        block.find(crypto::ToHex(digest)) == std::string_view::npos ||
+        block.find("0.0.0.0 ads.example") != std::string_view::npos) {
+        return Fail(failure, "block doesn't name the list by its digest");
+    }
+    std::error_code ec;
+    if (fs::exists(blocker.getSinkholeListPath(), ec)) return Fail(failure, "compile wrote the sinkhole list");
+    return true;
+}
+
+bool CheckSinkholeApply(const fs::path& workDir, std::string& failure) {
+    const fs::path dir = workDir / "sinkhole-apply";
+    if (!PrepareHosts(dir, failure)) return false;
+
+    Blocker blocker(dir / "hosts", dir / BACKUP_FILENAME);
+    blocker.setSinkholeMode(true);
+    if (!blocker.loadDomains(Import(WILDCARD_LIST, true)) || !blocker.applyBlock()) {
+        return Fail(failure, "sinkhole block not applied");
+    }
+    fs::path staged = blocker.getSinkholeListPath();
+    staged += ".staged";
+    std::error_code ec;
+    utils::DomainPool entries;
+    if (fs::exists(staged, ec) || !utils::DnsSinkhole::LoadList(blocker.getSinkholeListPath(), entries) ||
+        entries.size() != WILDCARD_LIST_ENTRIES) {
+        return Fail(failure, "sinkhole list not in place");
+    }
+    if (!blocker.verifyBlock() || !blocker.repairSinkholeList()) {
+        return Fail(failure, "list doesn't match the digest in the block");
+    }
+
+    // An edited list is rewritten from the enforced domains
+    utils::DomainPool repaired;
+    if (!WriteText(blocker.getSinkholeListPath(), "evil.example\n") || !blocker.repairSinkholeList() ||
+        !utils::DnsSinkhole::LoadList(blocker.getSinkholeListPath(), repaired) ||
+        repaired.size() != WILDCARD_LIST_ENTRIES) {
+        return Fail(failure, "edited list not repaired");
+    }
+    return true;
+}
+
+bool CheckSinkholeAnswers(std::string& failure) {
+    // Exact names, wildcards below (not at) their apex
+    utils::DomainPool entries;
+    entries.Add("ads.example.com");
+    entries.Add("*.tracker.example");
+    utils::SuffixIndex index;
+    if (!index.Build(entries) || !index.Matches("ADS.example.com.") ||
+        !index.Matches("a.b.tracker.example") || index.Matches("tracker.example") || index.Matches("example.com")) {
+        return Fail(failure, "suffix index matched the wrong names");
+    }
+
+    utils::DnsBenchmark::Options options;
+    options.queries = 2000;
+    options.domains = 200;
+    options.clients = 2;
+    options.tcpQueries = 8;
+    utils::DnsBenchmark::Result result;
+    if (!utils::DnsBenchmark::Measure(options, result)) return Fail(failure, "sinkhole not started on loopback");
+    if (!result.Passed(options)) {
+        return Fail(failure, std::to_string(result.lost) + " lost, " + std::to_string(result.wrong) +
+                    " wrong, tcp " + std::to_string(result.tcpCorrect) + '/' + std::to_string(options.tcpQueries));
+    }
+    return true;
+}
+
+bool CheckGuard(std::string& failure) {
+    using Simulator = utils::TamperSimulator;
+    Simulator::Options options;
+    options.rounds = static_cast<size_t>(Simulator::Mode::Count);
+    options.domains = 100;
+    options.pollInterval = std::chrono::milliseconds(20);
+    options.tamperGap = std::chrono::milliseconds(30);
+    options.restoreTimeout = std::chrono::milliseconds(5000);
+    Simulator::Result result;
+    if (!Simulator::Measure(options, result)) return Fail(failure, "simulation not set up");
+    const Simulator::Summary all = Simulator::Summarize(result.samples, Simulator::Mode::Count);
+    if (all.repaired != all.events) {
+        return Fail(failure, std::to_string(all.events - all.repaired) + " tamper event(s) not repaired");
+    }
+    return true;
+}
+
+} // namespace SelfTest
@@ -0,0 +1,53 @@
+// selftest.h
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+// End-to-end checks of the engine behind the headless `selftest` command (see
+// cli.cpp), so they run wherever the engine builds and under ctest rather than
+// only in the Windows --debug diagnostics. Each check works on its own files
+// below `workDir`, a scratch directory the caller creates and removes, and
+// returns false with `failure` naming the first thing that went wrong.
+namespace SelfTest {
+    namespace fs = std::filesystem;
+
+    // Format sniffing and each format's blocking rule, adblock rules whose
+    // options narrow them (third-party, popup) skipped, IDN names in punycode
+    // through the active backend and the built-in mapping
+    bool CheckImport(std::string& failure);
+
+    // Categories sharing a domain stored once, their masks after a save and
+    // load, and a schedule resolving those masks by the minute
+    bool CheckCatalog(const fs::path& workDir, std::string& failure);
+
+    // (ads | trackers) - allow over in-memory lists
+    bool CheckProfile(std::string& failure);
+
+    // Apply to a temp hosts file, verify, look up through the filter, detect an
+    // edited block and reapply it
+    bool CheckApply(const fs::path& workDir, std::string& failure);
+
+    // Interrupted transitions rolled forward (staged content intact), back
+    // (hosts file torn) and completed (only the COMMIT missing)
+    bool CheckJournal(const fs::path& workDir, std::string& failure);
+
+    // Successive compiles number their generations, compiled.current follows
+    // the newest, and the mapping answers lookups
+    bool CheckCompiled(const fs::path& workDir, std::string& failure);
+
+    // compile in sinkhole mode: the generation is flagged, keeps wildcards and
+    // names the list by the digest of its entries without writing the list
+    bool CheckCompileSinkhole(const fs::path& workDir, std::string& failure);
+
+    // apply in sinkhole mode: the list lands (no staged copy left behind) and
+    // matches the digest the block records
+    bool CheckSinkholeApply(const fs::path& workDir, std::string& failure);
+
+    // Suffix matching, then a short DnsBenchmark run: every blocked name
+    // answered with 0.0.0.0, every other one forwarded, over UDP and TCP
+    bool CheckSinkholeAnswers(std::string& failure);
+
+    // A few tamper events against the watchdog's guard, each repaired
+    bool CheckGuard(std::string& failure);
+} // namespace SelfTest
@@ -0,0 +1,920 @@
+// sinkhole.cpp
+#include "sinkhole.h"
+#include "domainset.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+
+// Winsock must be included before anything pulls in windows.h
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <system_error>
+#include <thread>
+
+namespace utils {
+
+// ----- Platform Sockets -----
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using Socket = SOCKET;
+using SockLen = int;
+constexpr Socket INVALID_SOCK = INVALID_SOCKET;
+
+void CloseSocket(Socket s) { closesocket(s); }
+int PollSockets(pollfd* fds, size_t count, int timeoutMs) {
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+}
+int LastSocketError() { return WSAGetLastError(); }
+bool WouldBlock(int error) { return error == WSAEWOULDBLOCK; }
+bool Interrupted(int error) { return error == WSAEINTR; }
+bool SetNonBlocking(Socket s) {
+    u_long enabled = 1;
+    return ioctlsocket(s, FIONBIO, &enabled) == 0;
+}
+#else
+using Socket = int;
+using SockLen = socklen_t;
+constexpr Socket INVALID_SOCK = -1;
+
+void CloseSocket(Socket s) { ::close(s); }
+int PollSockets(pollfd* fds, size_t count, int timeoutMs) {
+    return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+}
+int LastSocketError() { return errno; }
+bool WouldBlock(int error) { return error == EAGAIN || error == EWOULDBLOCK || error == EINPROGRESS; }
+bool Interrupted(int error) { return error == EINTR; }
+bool SetNonBlocking(Socket s) {
+    const int flags = ::fcntl(s, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+constexpr size_t MAX_UDP_MESSAGE = 65535;
+constexpr size_t PENDING_SLOTS = 65536;
+constexpr size_t UDP_BATCH = 64;
+constexpr int POLL_INTERVAL_MS = 100;
+constexpr size_t MAX_TCP_CONNECTIONS = 64;
+constexpr std::chrono::seconds TCP_IDLE_TIMEOUT(10);
+
+constexpr uint16_t TYPE_A = 1;
+constexpr uint16_t TYPE_AAAA = 28;
+constexpr uint16_t CLASS_IN = 1;
+
+uint16_t ReadU16(const uint8_t* p) noexcept {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void WriteU16(uint8_t* p, uint16_t value) noexcept {
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value);
+}
+
+bool ParseAddress(const std::string& address, uint16_t port, sockaddr_in& out) {
+    std::memset(&out, 0, sizeof(out));
+    out.sin_family = AF_INET;
+    out.sin_port = htons(port);
+    return inet_pton(AF_INET, address.c_str(), &out.sin_addr) == 1;
+}
+
+bool SameEndpoint(const sockaddr_in& a, const sockaddr_in& b) noexcept {
+    return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr;
+}
+
+// Waits until `s` is readable/writable or the deadline passes
+bool WaitSocket(Socket s, short events, Clock::time_point deadline, const std::atomic<bool>& stop) {
+    while (!stop.load(std::memory_order_relaxed)) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        if (remaining.count() <= 0) return false;
+        pollfd fd{};
+        fd.fd = s;
+        fd.events = events;
+        const int ready = PollSockets(&fd, 1, static_cast<int>(std::min<long long>(remaining.count(), POLL_INTERVAL_MS)));
+        if (ready > 0) return (fd.revents & (events | POLLHUP | POLLERR)) != 0;
+        if (ready < 0 && !Interrupted(LastSocketError())) return false;
+    }
+    return false;
+}
+
+bool RecvExact(Socket s, uint8_t* data, size_t length, Clock::time_point deadline, const std::atomic<bool>& stop) {
+    size_t received = 0;
+    while (received < length) {
+        if (!WaitSocket(s, POLLIN, deadline, stop)) return false;
+        const int n = ::recv(s, reinterpret_cast<char*>(data + received), static_cast<int>(length - received), 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (WouldBlock(LastSocketError()) || Interrupted(LastSocketError())) continue;
+            return false;
+        }
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool SendAll(Socket s, const uint8_t* data, size_t length, Clock::time_point deadline, const std::atomic<bool>& stop) {
+    size_t sent = 0;
+    while (sent < length) {
+        const int n = ::send(s, reinterpret_cast<const char*>(data + sent), static_cast<int>(length - sent), 0);
+        if (n < 0) {
+            if (!WouldBlock(LastSocketError()) && !Interrupted(LastSocketError())) return false;
+            if (!WaitSocket(s, POLLOUT, deadline, stop)) return false;
+            continue;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// DNS-over-TCP frames carry a 2-byte length prefix
+bool SendFramed(Socket s, const uint8_t* message, size_t length, Clock::time_point deadline,
+                const std::atomic<bool>& stop) {
+    if (length > std::numeric_limits<uint16_t>::max()) return false;
+    uint8_t prefix[2];
+    WriteU16(prefix, static_cast<uint16_t>(length));
+    return SendAll(s, prefix, sizeof(prefix), deadline, stop) && SendAll(s, message, length, deadline, stop);
+}
+
+bool RecvFramed(Socket s, std::vector<uint8_t>& message, Clock::time_point deadline, const std::atomic<bool>& stop) {
+    uint8_t prefix[2];
+    if (!RecvExact(s, prefix, sizeof(prefix), deadline, stop)) return false;
+    message.resize(ReadU16(prefix));
+    return message.empty() || RecvExact(s, message.data(), message.size(), deadline, stop);
+}
+
+// Sends one query to the upstream over a fresh TCP connection
+bool ExchangeTcp(const sockaddr_in& upstream, const std::vector<uint8_t>& query, std::vector<uint8_t>& response,
+                 std::chrono::milliseconds timeout, const std::atomic<bool>& stop) {
+    const Socket s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCK) return false;
+
+    const auto deadline = Clock::now() + timeout;
+    bool ok = SetNonBlocking(s);
+    if (ok && ::connect(s, reinterpret_cast<const sockaddr*>(&upstream), sizeof(upstream)) != 0) {
+        ok = WouldBlock(LastSocketError()) && WaitSocket(s, POLLOUT, deadline, stop);
+        int error = 0;
+        SockLen errorLength = sizeof(error);
+        ok = ok && ::getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorLength) == 0 &&
+             error == 0;
+    }
+    ok = ok && SendFramed(s, query.data(), query.size(), deadline, stop) && RecvFramed(s, response, deadline, stop);
+    CloseSocket(s);
+    return ok;
+}
+
+// ----- Label Hashing -----
+uint64_t Murmur64(uint64_t h) noexcept {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Labels must already be lowercase
+uint64_t LabelHash(std::string_view label) noexcept {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : label) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hash of a suffix extended by one more label on the left
+uint64_t ExtendSuffix(uint64_t suffixHash, std::string_view label) noexcept {
+    return Murmur64(suffixHash * 0x9E3779B97F4A7C15ULL + LabelHash(label));
+}
+
+constexpr uint64_t ROOT_HASH = 0x5bd1e9955bd1e995ULL;
+
+// Lowercases and strips a trailing dot. Returns false for names that can't appear in a query.
+bool NormalizeName(std::string_view raw, std::string& out) {
+    if (!raw.empty() && raw.back() == '.') raw.remove_suffix(1);
+    if (raw.empty() || raw.size() > 253 || raw.front() == '.') return false;
+    out.assign(raw.data(), raw.size());
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c == ' ' || c == '\t') return false;
+    }
+    return out.find("..") == std::string::npos;
+}
+
+uint64_t NameHash(std::string_view name) noexcept {
+    uint64_t hash = ROOT_HASH;
+    size_t end = name.size();
+    while (end > 0) {
+        const size_t dot = name.rfind('.', end - 1);
+        const size_t start = dot == std::string_view::npos ? 0 : dot + 1;
+        hash = ExtendSuffix(hash, name.substr(start, end - start));
+        end = dot == std::string_view::npos ? 0 : dot;
+    }
+    return hash;
+}
+
+} // anonymous namespace
+
+// ----- SuffixIndex -----
+bool SuffixIndex::Build(const DomainPool& entries) {
+    Trace::Span span("SuffixIndex::Build");
+    span.Arg("entries", entries.size());
+
+    try {
+        m_names.Clear();
+        m_names.Reserve(entries.size(), entries.ArenaBytes());
+
+        size_t capacity = 16;
+        while (capacity < entries.size() * 2) capacity <<= 1;
+        m_slots.assign(capacity, Slot{ 0, std::numeric_limits<uint32_t>::max(), 0 });
+        m_mask = capacity - 1;
+
+        std::string name;
+        size_t skipped = 0;
+        for (std::string_view entry : entries) {
+            uint8_t flag = MATCH_EXACT;
+            if (entry.size() > 2 && entry[0] == '*' && entry[1] == '.') {
+                flag = MATCH_SUBDOMAINS;
+                entry.remove_prefix(2);
+            }
+            if (!NormalizeName(entry, name)) {
+                ++skipped;
+                continue;
+            }
+
+            const uint64_t hash = NameHash(name);
+            size_t i = hash & m_mask;
+            while (m_slots[i].name != std::numeric_limits<uint32_t>::max()) {
+                if (m_slots[i].hash == hash && m_names[m_slots[i].name] == name) break;
+                i = (i + 1) & m_mask;
+            }
+            if (m_slots[i].name == std::numeric_limits<uint32_t>::max()) {
+                m_slots[i].hash = hash;
+                m_slots[i].name = static_cast<uint32_t>(m_names.size());
+                m_names.Add(name);
+            }
+            m_slots[i].flags |= flag;
+        }
+
+        if (skipped > 0) {
+            CJ_LOG_WARN("Sinkhole", "Skipped " << skipped << " invalid sinkhole entr" << (skipped == 1 ? "y" : "ies"));
+        }
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Sinkhole", "Index build failed: " << e.what());
+        m_names.Clear();
+        m_slots.clear();
+        m_mask = 0;
+        return false;
+    }
+}
+
+const SuffixIndex::Slot* SuffixIndex::Find(uint64_t hash, std::string_view suffix) const noexcept {
+    size_t i = hash & m_mask;
+    while (m_slots[i].name != std::numeric_limits<uint32_t>::max()) {
+        if (m_slots[i].hash == hash && m_names[m_slots[i].name] == suffix) return &m_slots[i];
+        i = (i + 1) & m_mask;
+    }
+    return nullptr;
+}
+
+bool SuffixIndex::Matches(std::string_view name) const noexcept {
+    if (m_slots.empty()) return false;
+
+    // Queries are parsed into lowercase already; other callers may pass any case
+    char lowered[256];
+    if (!name.empty() && name.back() == '.') name.remove_suffix(1);
+    if (name.empty() || name.size() >= sizeof(lowered)) return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+        const char c = name[i];
+        lowered[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    const std::string_view lower(lowered, name.size());
+
+    uint64_t hash = ROOT_HASH;
+    size_t end = lower.size();
+    while (end > 0) {
+        const size_t dot = lower.rfind('.', end - 1);
+        const size_t start = dot == std::string_view::npos ? 0 : dot + 1;
+        hash = ExtendSuffix(hash, lower.substr(start, end - start));
+
+        if (const Slot* slot = Find(hash, lower.substr(start))) {
+            const bool whole = start == 0;
+            if ((whole && (slot->flags & MATCH_EXACT)) || (!whole && (slot->flags & MATCH_SUBDOMAINS))) {
+                return true;
+            }
+        }
+        end = dot == std::string_view::npos ? 0 : dot;
+    }
+    return false;
+}
+
+// ----- DnsSinkhole -----
+struct DnsSinkhole::State {
+    struct Pending {
+        bool used = false;
+        uint16_t clientId = 0;
+        sockaddr_in client{};
+        Clock::time_point sent;
+    };
+
+    struct Connection {
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    Config config;
+    std::shared_ptr<const SuffixIndex> index;   // Swapped under indexMutex
+    std::mutex indexMutex;
+    sockaddr_in upstream{};
+    uint16_t port = 0;
+
+    Socket udp = INVALID_SOCK;
+    Socket upstreamUdp = INVALID_SOCK;
+    Socket tcp = INVALID_SOCK;
+#ifdef _WIN32
+    bool winsockStarted = false;
+#endif
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> running{false};
+    std::thread udpThread;
+    std::thread tcpThread;
+    std::mutex connectionsMutex;
+    std::vector<std::unique_ptr<Connection>> connections;
+
+    std::vector<Pending> pending;
+    size_t pendingCount = 0;
+    uint32_t idState = 0;
+
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> blocked{0};
+    std::atomic<uint64_t> forwarded{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> malformed{0};
+
+    Metrics::Counter& queriesMetric = Metrics::GetCounter(
+        "cj_sinkhole_queries_total", "DNS queries received by the sinkhole");
+    Metrics::Counter& blockedMetric = Metrics::GetCounter(
+        "cj_sinkhole_blocked_total", "DNS queries answered with a sinkhole address");
+    Metrics::Counter& forwardedMetric = Metrics::GetCounter(
+        "cj_sinkhole_forwarded_total", "DNS queries relayed to the upstream resolver");
+    Metrics::Counter& timeoutMetric = Metrics::GetCounter(
+        "cj_sinkhole_upstream_timeouts_total", "Relayed queries the upstream never answered");
+    Metrics::Histogram& forwardLatency = Metrics::GetHistogram(
+        "cj_sinkhole_forward_latency_seconds", "Upstream round trip for relayed queries");
+
+    void CountQuery() {
+        queries.fetch_add(1, std::memory_order_relaxed);
+        queriesMetric.Add();
+    }
+
+    void CountBlocked() {
+        blocked.fetch_add(1, std::memory_order_relaxed);
+        blockedMetric.Add();
+    }
+
+    void CountForwarded() {
+        forwarded.fetch_add(1, std::memory_order_relaxed);
+        forwardedMetric.Add();
+    }
+
+    void CountTimeout() {
+        timeouts.fetch_add(1, std::memory_order_relaxed);
+        timeoutMetric.Add();
+    }
+
+    // Random transaction IDs so upstream replies can't be spoofed by guessing
+    uint16_t NextId() {
+        for (int attempt = 0; attempt < 8; ++attempt) {
+            idState ^= idState << 13;
+            idState ^= idState >> 17;
+            idState ^= idState << 5;
+            const uint16_t id = static_cast<uint16_t>(idState);
+            if (!pending[id].used) return id;
+        }
+        return static_cast<uint16_t>(idState);
+    }
+
+    // Held for a batch of UDP queries or one TCP query, so a swap never
+    // frees an index that is being probed
+    std::shared_ptr<const SuffixIndex> CurrentIndex() {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        return index;
+    }
+
+    void CloseSockets() {
+        for (Socket* s : { &udp, &upstreamUdp, &tcp }) {
+            if (*s != INVALID_SOCK) CloseSocket(*s);
+            *s = INVALID_SOCK;
+        }
+    }
+
+    void UdpLoop();
+    void TcpLoop();
+    void ServeConnection(Socket client, Connection* connection);
+    void Forward(uint8_t* query, size_t length, const sockaddr_in& client);
+    void Relay(uint8_t* response, size_t length);
+    void ExpirePending();
+};
+
+void DnsSinkhole::State::Forward(uint8_t* query, size_t length, const sockaddr_in& client) {
+    const uint16_t id = NextId();
+    Pending& slot = pending[id];
+    if (slot.used) {
+        CountTimeout();  // Oldest in-flight query loses its slot
+    } else {
+        ++pendingCount;
+    }
+    slot.used = true;
+    slot.clientId = ReadU16(query);
+    slot.client = client;
+    slot.sent = Clock::now();
+
+    WriteU16(query, id);
+    ::sendto(upstreamUdp, reinterpret_cast<const char*>(query), static_cast<int>(length), 0,
+             reinterpret_cast<const sockaddr*>(&upstream), sizeof(upstream));
+    CountForwarded();
+}
+
+void DnsSinkhole::State::Relay(uint8_t* response, size_t length) {
+    if (length < 12) return;
+    Pending& slot = pending[ReadU16(response)];
+    if (!slot.used) return;  // Late or unsolicited reply
+
+    slot.used = false;
+    --pendingCount;
+    forwardLatency.Record(Clock::now() - slot.sent);
+    WriteU16(response, slot.clientId);
+    ::sendto(udp, reinterpret_cast<const char*>(response), static_cast<int>(length), 0,
+             reinterpret_cast<const sockaddr*>(&slot.client), sizeof(slot.client));
+}
+
+void DnsSinkhole::State::ExpirePending() {
+    const auto cutoff = Clock::now() - config.upstreamTimeout;
+    for (auto& slot : pending) {
+        if (slot.used && slot.sent < cutoff) {
+            // The client's own resolver retries; nothing useful to send back
+            slot.used = false;
+            --pendingCount;
+            CountTimeout();
+        }
+    }
+}
+
+void DnsSinkhole::State::UdpLoop() {
+    std::vector<uint8_t> buffer(MAX_UDP_MESSAGE);
+    std::vector<uint8_t> reply;
+    auto lastSweep = Clock::now();
+
+    pollfd fds[2]{};
+    fds[0].fd = udp;
+    fds[0].events = POLLIN;
+    fds[1].fd = upstreamUdp;
+    fds[1].events = POLLIN;
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        const int ready = PollSockets(fds, 2, POLL_INTERVAL_MS);
+        if (ready < 0) {
+            if (Interrupted(LastSocketError())) continue;
+            CJ_LOG_ERROR("Sinkhole", "UDP poll failed (" << LastSocketError() << ")");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            const std::shared_ptr<const SuffixIndex> current = CurrentIndex();
+            for (size_t i = 0; i < UDP_BATCH; ++i) {
+                sockaddr_in client{};
+                SockLen clientLength = sizeof(client);
+                const int n = ::recvfrom(udp, reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0,
+                                         reinterpret_cast<sockaddr*>(&client), &clientLength);
+                if (n < 0) break;
+
+                CountQuery();
+                if (Answer(*current, buffer.data(), static_cast<size_t>(n), config.blockedTtl, reply)) {
+                    CountBlocked();
+                    ::sendto(udp, reinterpret_cast<const char*>(reply.data()), static_cast<int>(reply.size()), 0,
+                             reinterpret_cast<const sockaddr*>(&client), clientLength);
+                } else if (n < 12) {
+                    malformed.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    Forward(buffer.data(), static_cast<size_t>(n), client);
+                }
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            for (size_t i = 0; i < UDP_BATCH; ++i) {
+                sockaddr_in from{};
+                SockLen fromLength = sizeof(from);
+                const int n = ::recvfrom(upstreamUdp, reinterpret_cast<char*>(buffer.data()),
+                                         static_cast<int>(buffer.size()), 0,
+                                         reinterpret_cast<sockaddr*>(&from), &fromLength);
+                if (n < 0) break;
+                if (SameEndpoint(from, upstream)) Relay(buffer.data(), static_cast<size_t>(n));
+            }
+        }
+
+        const auto now = Clock::now();
+        if (pendingCount > 0 && now - lastSweep >= std::chrono::milliseconds(POLL_INTERVAL_MS)) {
+            ExpirePending();
+            lastSweep = now;
+        }
+    }
+}
+
+void DnsSinkhole::State::TcpLoop() {
+    pollfd fd{};
+    fd.fd = tcp;
+    fd.events = POLLIN;
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        const int ready = PollSockets(&fd, 1, POLL_INTERVAL_MS);
+
+        // Reap finished connection threads
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            for (auto it = connections.begin(); it != connections.end();) {
+                if ((*it)->done.load()) {
+                    (*it)->thread.join();
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        if (ready <= 0 || !(fd.revents & POLLIN)) continue;
+
+        const Socket client = ::accept(tcp, nullptr, nullptr);
+        if (client == INVALID_SOCK) continue;
+        if (!SetNonBlocking(client)) {
+            CloseSocket(client);
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        if (connections.size() >= MAX_TCP_CONNECTIONS) {
+            CloseSocket(client);
+            continue;
+        }
+        try {
+            auto connection = std::make_unique<Connection>();
+            Connection* raw = connection.get();
+            connection->thread = std::thread([this, client, raw] { ServeConnection(client, raw); });
+            connections.push_back(std::move(connection));
+        } catch (const std::exception& e) {
+            CJ_LOG_WARN("Sinkhole", "Dropping TCP connection: " << e.what());
+            CloseSocket(client);
+        }
+    }
+}
+
+void DnsSinkhole::State::ServeConnection(Socket client, Connection* connection) {
+    std::vector<uint8_t> query, reply;
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (!RecvFramed(client, query, Clock::now() + TCP_IDLE_TIMEOUT, stop)) break;
+
+        CountQuery();
+        const auto deadline = Clock::now() + config.upstreamTimeout;
+        if (Answer(*CurrentIndex(), query.data(), query.size(), config.blockedTtl, reply)) {
+            CountBlocked();
+        } else if (query.size() < 12) {
+            malformed.fetch_add(1, std::memory_order_relaxed);
+            break;
+        } else {
+            CountForwarded();
+            const auto sent = Clock::now();
+            if (!ExchangeTcp(upstream, query, reply, config.upstreamTimeout, stop)) {
+                CountTimeout();
+                break;
+            }
+            forwardLatency.Record(Clock::now() - sent);
+        }
+        if (!SendFramed(client, reply.data(), reply.size(), deadline, stop)) break;
+    }
+    CloseSocket(client);
+    connection->done.store(true);
+}
+
+DnsSinkhole::DnsSinkhole() = default;
+
+DnsSinkhole::~DnsSinkhole() {
+    Stop();
+}
+
+bool DnsSinkhole::Start(const Config& config, SuffixIndex index) {
+    return Start(config, std::make_shared<const SuffixIndex>(std::move(index)));
+}
+
+bool DnsSinkhole::Start(const Config& config, std::shared_ptr<const SuffixIndex> index) {
+    Stop();
+    if (!index) return false;
+
+    auto state = std::make_unique<State>();
+    state->config = config;
+    state->index = std::move(index);
+    state->pending.resize(PENDING_SLOTS);
+    state->idState = std::random_device{}() | 1u;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        CJ_LOG_ERROR("Sinkhole", "WSAStartup failed");
+        return false;
+    }
+    state->winsockStarted = true;
+#endif
+
+    auto fail = [&state](const char* what) {
+        CJ_LOG_ERROR("Sinkhole", what << " (" << LastSocketError() << ")");
+        state->CloseSockets();
+#ifdef _WIN32
+        if (state->winsockStarted) WSACleanup();
+#endif
+        return false;
+    };
+
+    sockaddr_in listen{};
+    if (!ParseAddress(config.listenAddress, config.port, listen)) return fail("Invalid listen address");
+    if (!ParseAddress(config.upstreamAddress, config.upstreamPort, state->upstream)) return fail("Invalid upstream address");
+
+    state->udp = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (state->udp == INVALID_SOCK) return fail("Can't create UDP socket");
+#ifdef _WIN32
+    // Nobody else may bind the port on top of us while we serve it
+    BOOL exclusive = TRUE;
+    setsockopt(state->udp, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&exclusive), sizeof(exclusive));
+#endif
+    if (::bind(state->udp, reinterpret_cast<const sockaddr*>(&listen), sizeof(listen)) != 0) {
+        return fail("Can't bind UDP listener");
+    }
+
+    sockaddr_in bound{};
+    SockLen boundLength = sizeof(bound);
+    ::getsockname(state->udp, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+    state->port = ntohs(bound.sin_port);
+    listen.sin_port = bound.sin_port;
+
+    state->upstreamUdp = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (state->upstreamUdp == INVALID_SOCK) return fail("Can't create upstream socket");
+
+#ifdef _WIN32
+    // Don't let an ICMP port-unreachable from one client fail the next recvfrom()
+    BOOL reportReset = FALSE;
+    DWORD ignored = 0;
+    WSAIoctl(state->udp, SIO_UDP_CONNRESET, &reportReset, sizeof(reportReset), nullptr, 0, &ignored, nullptr, nullptr);
+    WSAIoctl(state->upstreamUdp, SIO_UDP_CONNRESET, &reportReset, sizeof(reportReset), nullptr, 0, &ignored, nullptr, nullptr);
+#endif
+
+    if (!SetNonBlocking(state->udp) || !SetNonBlocking(state->upstreamUdp)) {
+        return fail("Can't make UDP sockets non-blocking");
+    }
+
+    if (config.tcp) {
+        state->tcp = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (state->tcp == INVALID_SOCK) return fail("Can't create TCP socket");
+#ifdef _WIN32
+        setsockopt(state->tcp, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&exclusive), sizeof(exclusive));
+#else
+        int reuse = 1;
+        ::setsockopt(state->tcp, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+        if (::bind(state->tcp, reinterpret_cast<const sockaddr*>(&listen), sizeof(listen)) != 0 ||
+            ::listen(state->tcp, SOMAXCONN) != 0) {
+            return fail("Can't bind TCP listener");
+        }
+        if (!SetNonBlocking(state->tcp)) return fail("Can't make TCP listener non-blocking");
+    }
+
+    try {
+        State* raw = state.get();
+        state->udpThread = std::thread([raw] { raw->UdpLoop(); });
+        if (config.tcp) state->tcpThread = std::thread([raw] { raw->TcpLoop(); });
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Sinkhole", "Can't start sinkhole threads: " << e.what());
+        state->stop.store(true);
+        if (state->udpThread.joinable()) state->udpThread.join();
+        state->CloseSockets();
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    state->running.store(true);
+    CJ_LOG_INFO("Sinkhole", "Serving DNS on " << config.listenAddress << ":" << state->port
+                << " (" << state->index->size() << " blocked entr" << (state->index->size() == 1 ? "y" : "ies")
+                << ", upstream " << config.upstreamAddress << ":" << config.upstreamPort << ")");
+    m_state = std::move(state);
+    return true;
+}
+
+void DnsSinkhole::Stop() {
+    if (!m_state) return;
+
+    m_state->stop.store(true);
+    if (m_state->udpThread.joinable()) m_state->udpThread.join();
+    if (m_state->tcpThread.joinable()) m_state->tcpThread.join();
+    {
+        std::lock_guard<std::mutex> lock(m_state->connectionsMutex);
+        for (auto& connection : m_state->connections) connection->thread.join();
+        m_state->connections.clear();
+    }
+    m_state->CloseSockets();
+#ifdef _WIN32
+    if (m_state->winsockStarted) WSACleanup();
+#endif
+    CJ_LOG_INFO("Sinkhole", "Stopped after " << m_state->queries.load() << " quer"
+                << (m_state->queries.load() == 1 ? "y" : "ies"));
+    m_state.reset();
+}
+
+bool DnsSinkhole::SwapIndex(std::shared_ptr<const SuffixIndex> index) {
+    if (!m_state || !index) return false;
+    const size_t entries = index->size();
+    {
+        std::lock_guard<std::mutex> lock(m_state->indexMutex);
+        m_state->index.swap(index);
+    }
+    CJ_LOG_INFO("Sinkhole", "Now serving " << entries << " blocked entr" << (entries == 1 ? "y" : "ies"));
+    return true;   // The old index goes when its last reader lets go
+}
+
+bool DnsSinkhole::IsRunning() const noexcept {
+    return m_state && m_state->running.load();
+}
+
+uint16_t DnsSinkhole::Port() const noexcept {
+    return m_state ? m_state->port : 0;
+}
+
+DnsSinkhole::Stats DnsSinkhole::GetStats() const noexcept {
+    Stats stats{};
+    if (m_state) {
+        stats.queries = m_state->queries.load();
+        stats.blocked = m_state->blocked.load();
+        stats.forwarded = m_state->forwarded.load();
+        stats.upstreamTimeouts = m_state->timeouts.load();
+        stats.malformed = m_state->malformed.load();
+    }
+    return stats;
+}
+
+// ----- Message Handling -----
+bool DnsSinkhole::Answer(const SuffixIndex& index, const uint8_t* query, size_t length,
+                         uint32_t ttl, std::vector<uint8_t>& reply) {
+    if (length < 12) return false;
+
+    const uint16_t flags = ReadU16(query + 2);
+    const bool isResponse = (flags & 0x8000) != 0;
+    const unsigned opcode = (flags >> 11) & 0xF;
+    if (isResponse || opcode != 0 || ReadU16(query + 4) != 1) return false;
+
+    // QNAME as uncompressed labels; build the dotted lowercase name as we go
+    char name[256];
+    size_t nameLength = 0;
+    size_t pos = 12;
+    while (true) {
+        if (pos >= length) return false;
+        const uint8_t labelLength = query[pos++];
+        if (labelLength == 0) break;
+        if ((labelLength & 0xC0) != 0 || pos + labelLength > length) return false;
+        if (nameLength + labelLength + 1 >= sizeof(name)) return false;
+        if (nameLength > 0) name[nameLength++] = '.';
+        for (size_t i = 0; i < labelLength; ++i) {
+            const char c = static_cast<char>(query[pos + i]);
+            name[nameLength++] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+        pos += labelLength;
+    }
+    if (pos + 4 > length) return false;
+    const uint16_t qtype = ReadU16(query + pos);
+    const uint16_t qclass = ReadU16(query + pos + 2);
+    const size_t questionEnd = pos + 4;
+
+    if (!index.Matches(std::string_view(name, nameLength))) return false;
+
+    const bool hasAddress = qclass == CLASS_IN && (qtype == TYPE_A || qtype == TYPE_AAAA);
+    const uint16_t addressLength = qtype == TYPE_A ? 4 : 16;
+
+    reply.assign(query, query + questionEnd);
+    reply[2] = static_cast<uint8_t>(0x80 | (query[2] & 0x01));  // QR, keep RD
+    reply[3] = 0x80;                                              // RA, NOERROR
+    WriteU16(&reply[6], hasAddress ? 1 : 0);                      // ANCOUNT
+    WriteU16(&reply[8], 0);                                       // NSCOUNT
+    WriteU16(&reply[10], 0);                                      // ARCOUNT (EDNS dropped)
+
+    if (hasAddress) {
+        const uint8_t answer[12] = {
+            0xC0, 0x0C,                                           // Pointer to the question name
+            static_cast<uint8_t>(qtype >> 8), static_cast<uint8_t>(qtype),
+            0x00, static_cast<uint8_t>(CLASS_IN),
+            static_cast<uint8_t>(ttl >> 24), static_cast<uint8_t>(ttl >> 16),
+            static_cast<uint8_t>(ttl >> 8), static_cast<uint8_t>(ttl),
+            static_cast<uint8_t>(addressLength >> 8), static_cast<uint8_t>(addressLength),
+        };
+        reply.insert(reply.end(), answer, answer + sizeof(answer));
+        reply.insert(reply.end(), addressLength, 0);              // 0.0.0.0 or ::
+    }
+    return true;
+}
+
+// ----- List Files -----
+bool DnsSinkhole::LoadList(const fs::path& path, DomainPool& entries) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    entries.Clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string_view view(line);
+        const size_t comment = view.find('#');
+        if (comment != std::string_view::npos) view = view.substr(0, comment);
+        const size_t first = view.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos) continue;
+        const size_t last = view.find_last_not_of(" \t\r");
+        entries.Add(view.substr(first, last - first + 1));
+    }
+    return true;
+}
+
+std::string DnsSinkhole::RenderList(const DomainPool& entries) {
+    DomainPool normalized;
+    normalized.Reserve(entries.size(), entries.ArenaBytes());
+    std::string name;
+    for (std::string_view entry : entries) {
+        if (!entry.empty() && entry.back() == '.') entry.remove_suffix(1);
+        name.assign(entry);
+        for (char& c : name) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        }
+        normalized.Add(name);
+    }
+    const DomainSet sorted = DomainSet::FromPool(normalized);
+    normalized = DomainPool();
+
+    static constexpr std::string_view HEADER =
+        "# ChickenJockey DNS sinkhole list; \"*.example.com\" blocks every subdomain\n";
+    size_t bytes = HEADER.size();
+    for (size_t i = 0; i < sorted.size(); ++i) bytes += sorted[i].size() + 1;
+    std::string text;
+    text.reserve(bytes);
+    text += HEADER;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        text += sorted[i];
+        text += '\n';
+    }
+    return text;
+}
+
+bool DnsSinkhole::SaveList(const fs::path& path, const DomainPool& entries) {
+    try {
+        return SaveList(path, RenderList(entries));
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Sinkhole", "Can't save sinkhole list: " << e.what());
+        return false;
+    }
+}
+
+bool DnsSinkhole::SaveList(const fs::path& path, std::string_view text) {
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    try {
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        {
+            std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+            if (!ofs) return false;
+            ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            ofs.write(text.data(), static_cast<std::streamsize>(text.size()));
+        }
+        fs::rename(tempPath, path);
+        return true;
+    } catch (const std::exception& e) {
+        CJ_LOG_ERROR("Sinkhole", "Can't save sinkhole list: " << e.what());
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+}
+
+} // namespace utils
@@ -0,0 +1,116 @@
+// sinkhole.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "domainpool.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Blocked-name index for the DNS sinkhole. Entries are either exact names
+// ("ads.example.com") or wildcards ("*.example.com", which matches every name
+// below example.com but not example.com itself). A query is matched by hashing
+// its labels right to left, one hash step and one probe per label, so the
+// cost is O(labels) regardless of how many entries are loaded.
+class SuffixIndex {
+public:
+    // Builds from raw entries; case and a trailing dot are ignored
+    bool Build(const DomainPool& entries);
+
+    bool Matches(std::string_view name) const noexcept;
+
+    size_t size() const noexcept { return m_names.size(); }
+    bool empty() const noexcept { return m_names.empty(); }
+
+private:
+    enum : uint8_t { MATCH_EXACT = 1, MATCH_SUBDOMAINS = 2 };
+
+    struct Slot {
+        uint64_t hash;
+        uint32_t name;   // Index into m_names; UINT32_MAX marks an empty slot
+        uint8_t flags;
+    };
+
+    const Slot* Find(uint64_t hash, std::string_view suffix) const noexcept;
+
+    DomainPool m_names;       // Normalized names without the "*." prefix
+    std::vector<Slot> m_slots;
+    size_t m_mask = 0;
+};
+
+// Loopback DNS responder. Blocked names get 0.0.0.0 / :: (NODATA for other
+// record types); everything else is relayed to the upstream resolver over
+// the same transport. UDP is served by one event loop that multiplexes the
+// listening socket and a single upstream socket; TCP connections get a
+// short-lived thread each.
+class DnsSinkhole {
+public:
+    static constexpr const char* LIST_FILENAME = "sinkhole.list";
+
+    struct Config {
+        std::string listenAddress = "127.0.0.1";
+        uint16_t port = 53;                               // 0 picks a free port (see Port())
+        std::string upstreamAddress = "1.1.1.1";
+        uint16_t upstreamPort = 53;
+        std::chrono::milliseconds upstreamTimeout{2000};
+        uint32_t blockedTtl = 60;
+        bool tcp = true;
+    };
+
+    struct Stats {
+        uint64_t queries;
+        uint64_t blocked;
+        uint64_t forwarded;
+        uint64_t upstreamTimeouts;
+        uint64_t malformed;
+    };
+
+    DnsSinkhole();
+    ~DnsSinkhole();
+    DnsSinkhole(const DnsSinkhole&) = delete;
+    DnsSinkhole& operator=(const DnsSinkhole&) = delete;
+
+    // Binds and starts serving. Fails (without throwing) when the port is
+    // taken, e.g. because the peer watchdog already serves it. The index is
+    // shared, so a standby watchdog keeps the one it built for its next try.
+    bool Start(const Config& config, SuffixIndex index);
+    bool Start(const Config& config, std::shared_ptr<const SuffixIndex> index);
+    void Stop();
+
+    // Serves `index` from the next query on without giving up the port;
+    // queries already being answered finish against the old one
+    bool SwapIndex(std::shared_ptr<const SuffixIndex> index);
+
+    bool IsRunning() const noexcept;
+    uint16_t Port() const noexcept;
+    Stats GetStats() const noexcept;
+
+    // Builds the reply for a blocked query. Returns false when the query should
+    // be forwarded instead (not blocked, or not something we answer locally).
+    static bool Answer(const SuffixIndex& index, const uint8_t* query, size_t length,
+                       uint32_t ttl, std::vector<uint8_t>& reply);
+
+    // One entry per line; '#' starts a comment
+    static bool LoadList(const fs::path& path, DomainPool& entries);
+    static bool SaveList(const fs::path& path, const DomainPool& entries);
+    static bool SaveList(const fs::path& path, std::string_view text);
+    // The list file for `entries`: normalized, sorted and deduplicated, so
+    // the same set always gives the same bytes (and digest) whatever order
+    // it was collected in
+    static std::string RenderList(const DomainPool& entries);
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+} // namespace utils
@@ -0,0 +1,503 @@
+// snapshot.cpp
+#include "snapshot.h"
+#include "asyncio.h"
+#include "filelock.h"
+#include "mappedfile.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+// ----- Chunking -----
+// Gear table: one pseudo-random 64-bit value per byte (splitmix64), fixed so
+// boundaries are stable across runs and builds
+struct GearTable {
+    uint64_t values[256] = {};
+    constexpr GearTable() {
+        uint64_t state = 0x43484B4E4A4F434Bull;
+        for (uint64_t& value : values) {
+            state += 0x9E3779B97F4A7C15ull;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+    }
+};
+constexpr GearTable GEAR;
+
+// Normalized chunking: a stricter mask (15 bits) before the average size and
+// a looser one (11 bits) after it pulls chunk sizes towards the 8 KiB average.
+// The high bits are used because they depend on the most bytes.
+constexpr uint64_t MASK_SMALL = ~0ull << (64 - 15);
+constexpr uint64_t MASK_LARGE = ~0ull << (64 - 11);
+
+size_t CutPoint(const unsigned char* data, size_t length) noexcept {
+    if (length <= SnapshotStore::MIN_CHUNK) return length;
+    const size_t normal = std::min(length, SnapshotStore::AVG_CHUNK);
+    const size_t limit = std::min(length, SnapshotStore::MAX_CHUNK);
+
+    uint64_t hash = 0;
+    size_t i = SnapshotStore::MIN_CHUNK;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + GEAR.values[data[i]];
+        if (!(hash & MASK_SMALL)) return i + 1;
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + GEAR.values[data[i]];
+        if (!(hash & MASK_LARGE)) return i + 1;
+    }
+    return limit;
+}
+
+// ----- On-disk Format -----
+constexpr char MANIFEST_MAGIC[4] = { 'C', 'J', 'S', 'N' };
+constexpr uint32_t MANIFEST_VERSION = 1;
+constexpr const char* MANIFEST_EXTENSION = ".snap";
+constexpr size_t LABEL_SIZE = 32;
+constexpr size_t SUBMIT_CHUNKS = 64;   // New chunks queued per submission while saving
+
+// Fixed-size records; written and read as raw bytes on the same machine
+struct ManifestHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t id;
+    int64_t timestamp;
+    uint64_t size;
+    uint32_t chunkCount;
+    uint32_t reserved;
+    unsigned char digest[32];
+    char label[LABEL_SIZE];
+};
+
+struct ChunkRecord {
+    unsigned char digest[32];
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// Writes through a temporary file and a rename
+bool WriteAtomically(const fs::path& path, const void* data, size_t size) {
+    IoBatch batch;
+    batch.WriteAtomically(path, data, size);
+    if (batch.Wait()) return true;
+    CJ_LOG_ERROR("Snapshot", "Write failed: " << batch.GetError());
+    return false;
+}
+
+// Moves `temp` to `path` unless something already holds that name, which
+// sets `exists`. Unlike a rename it never replaces a file.
+bool RenameNew(const fs::path& temp, const fs::path& path, bool& exists) {
+    exists = false;
+#ifdef _WIN32
+    if (MoveFileExW(temp.c_str(), path.c_str(), MOVEFILE_WRITE_THROUGH)) return true;
+    const DWORD error = GetLastError();
+    exists = error == ERROR_ALREADY_EXISTS || error == ERROR_FILE_EXISTS;
+#else
+    if (::link(temp.c_str(), path.c_str()) == 0) {
+        ::unlink(temp.c_str());
+        return true;
+    }
+    exists = errno == EEXIST;
+    if (errno == EPERM || errno == ENOTSUP || errno == EOPNOTSUPP) {
+        // No hard links on this file system; the store lock still keeps ids apart
+        std::error_code ec;
+        if (!fs::exists(path, ec)) {
+            fs::rename(temp, path, ec);
+            return !ec;
+        }
+        exists = true;
+    }
+#endif
+    return false;
+}
+
+} // anonymous namespace
+
+SnapshotStore::SnapshotStore(const fs::path& root, size_t keep)
+    : m_root(root), m_keep(keep == 0 ? 1 : keep) {}
+
+void SnapshotStore::FindChunks(std::string_view data, std::vector<size_t>& ends) {
+    ends.clear();
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t offset = 0;
+    while (offset < data.size()) {
+        offset += CutPoint(bytes + offset, data.size() - offset);
+        ends.push_back(offset);
+    }
+}
+
+fs::path SnapshotStore::ChunkPath(const crypto::Digest& digest) const {
+    const std::string hex = crypto::ToHex(digest);
+    return m_root / "chunks" / hex.substr(0, 2) / hex;
+}
+
+fs::path SnapshotStore::VersionPath(uint64_t id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%010llu%s", static_cast<unsigned long long>(id), MANIFEST_EXTENSION);
+    return m_root / "versions" / name;
+}
+
+// ----- Manifests -----
+bool SnapshotStore::ReadManifest(const fs::path& path, Version& version, std::vector<ChunkRef>* chunks) const {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+    ManifestHeader header{};
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0 ||
+        header.version != MANIFEST_VERSION) {
+        return false;
+    }
+
+    version.id = header.id;
+    version.timestamp = header.timestamp;
+    version.size = header.size;
+    version.chunks = header.chunkCount;
+    std::memcpy(version.digest.data(), header.digest, version.digest.size());
+    version.label.assign(header.label, strnlen(header.label, LABEL_SIZE));
+    if (!chunks) return true;
+
+    chunks->clear();
+    chunks->reserve(header.chunkCount);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < header.chunkCount; ++i) {
+        ChunkRecord record{};
+        if (!ifs.read(reinterpret_cast<char*>(&record), sizeof(record))) return false;
+        ChunkRef ref{};
+        std::memcpy(ref.digest.data(), record.digest, ref.digest.size());
+        ref.size = record.size;
+        total += record.size;
+        chunks->push_back(ref);
+    }
+    return total == header.size;
+}
+
+// Publishes the manifest under the first free id from `version.id` on,
+// updating `version.id` to the one it got
+bool SnapshotStore::WriteManifest(Version& version, const std::vector<ChunkRef>& chunks) const {
+    std::string bytes(sizeof(ManifestHeader) + chunks.size() * sizeof(ChunkRecord), '\0');
+    ManifestHeader header{};
+    std::memcpy(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    header.version = MANIFEST_VERSION;
+    header.id = version.id;
+    header.timestamp = version.timestamp;
+    header.size = version.size;
+    header.chunkCount = static_cast<uint32_t>(chunks.size());
+    std::memcpy(header.digest, version.digest.data(), version.digest.size());
+    std::memcpy(header.label, version.label.data(), std::min(version.label.size(), LABEL_SIZE));
+
+    char* out = bytes.data() + sizeof(header);
+    for (const ChunkRef& ref : chunks) {
+        ChunkRecord record{};
+        std::memcpy(record.digest, ref.digest.data(), ref.digest.size());
+        record.size = ref.size;
+        std::memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+    }
+
+    constexpr int MAX_ATTEMPTS = 64;
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt, ++version.id) {
+        header.id = version.id;
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        const fs::path path = VersionPath(version.id);
+        fs::path tempPath = path;
+        tempPath += ".tmp";
+
+        IoBatch batch;
+        const IoBatch::File file = batch.Create(tempPath);
+        batch.Write(file, 0, bytes.data(), bytes.size());
+        std::error_code ec;
+        if (!batch.Wait()) {
+            CJ_LOG_ERROR("Snapshot", "Write failed: " << batch.GetError());
+            fs::remove(tempPath, ec);
+            return false;
+        }
+        bool exists = false;
+        if (RenameNew(tempPath, path, exists)) return true;
+        fs::remove(tempPath, ec);
+        if (!exists) {
+            CJ_LOG_ERROR("Snapshot", "Can't publish manifest " << path);
+            return false;
+        }
+        CJ_LOG_DEBUG("Snapshot", "Version " << version.id << " was taken meanwhile; trying the next id");
+    }
+    CJ_LOG_ERROR("Snapshot", "No free version id found");
+    return false;
+}
+
+std::vector<SnapshotStore::Version> SnapshotStore::List() const {
+    std::vector<Version> versions;
+    std::error_code ec;
+    for (fs::directory_iterator it(m_root / "versions", ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != MANIFEST_EXTENSION) continue;
+        Version version;
+        if (ReadManifest(it->path(), version, nullptr)) versions.push_back(std::move(version));
+        else CJ_LOG_WARN("Snapshot", "Unreadable manifest: " << it->path());
+    }
+    std::sort(versions.begin(), versions.end(),
+              [](const Version& a, const Version& b) { return a.id < b.id; });
+    return versions;
+}
+
+bool SnapshotStore::Latest(Version& version) const {
+    std::vector<Version> versions = List();
+    if (versions.empty()) return false;
+    version = std::move(versions.back());
+    return true;
+}
+
+// ----- Save -----
+bool SnapshotStore::Save(std::string_view content, std::string_view label, Version* saved, SaveStats* stats) {
+    Trace::Span span("SnapshotStore::Save");
+    span.Arg("bytes", content.size());
+    SaveStats result;
+
+    Version version;
+    if (!crypto::Sha256(content.data(), content.size(), version.digest)) return false;
+    FileLock lock;
+    if (!lock.Acquire(m_root / LOCK_FILENAME)) {
+        CJ_LOG_ERROR("Snapshot", "Can't lock the snapshot store");
+        return false;
+    }
+    Version latest;
+    const bool hasLatest = Latest(latest);
+    if (hasLatest && latest.digest == version.digest && latest.size == content.size()) {
+        CJ_LOG_DEBUG("Snapshot", "Content matches version " << latest.id << "; nothing stored");
+        result.unchanged = true;
+        result.chunks = latest.chunks;
+        if (saved) *saved = latest;
+        if (stats) *stats = result;
+        return true;
+    }
+
+    std::vector<size_t> ends;
+    FindChunks(content, ends);
+    std::vector<ChunkRef> chunks;
+    chunks.reserve(ends.size());
+    // New chunks are written while the next ones are hashed; the manifest
+    // only goes out once every chunk it names is in place
+    IoBatch writes;
+    std::set<crypto::Digest> queued;
+    size_t offset = 0;
+    for (size_t end : ends) {
+        const std::string_view piece = content.substr(offset, end - offset);
+        offset = end;
+
+        ChunkRef ref{};
+        ref.size = static_cast<uint32_t>(piece.size());
+        if (!crypto::Sha256(piece.data(), piece.size(), ref.digest)) return false;
+        chunks.push_back(ref);
+
+        // Already stored (a size mismatch means a damaged copy; replace it)
+        const fs::path path = ChunkPath(ref.digest);
+        std::error_code ec;
+        if (queued.count(ref.digest) || (fs::file_size(path, ec) == piece.size() && !ec)) continue;
+
+        fs::create_directories(path.parent_path(), ec);
+        writes.WriteAtomically(path, piece.data(), piece.size());
+        queued.insert(ref.digest);
+        if (queued.size() % SUBMIT_CHUNKS == 0) writes.Submit();
+        ++result.newChunks;
+        result.newBytes += piece.size();
+    }
+    result.chunks = chunks.size();
+    if (!writes.Wait()) {
+        CJ_LOG_ERROR("Snapshot", "Write failed: " << writes.GetError());
+        return false;
+    }
+
+    version.id = hasLatest ? latest.id + 1 : 1;
+    version.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    version.size = content.size();
+    version.chunks = chunks.size();
+    version.label.assign(label.substr(0, LABEL_SIZE));
+
+    std::error_code ec;
+    fs::create_directories(m_root / "versions", ec);
+    if (!WriteManifest(version, chunks)) return false;
+
+    span.Arg("chunks", result.chunks).Arg("newBytes", result.newBytes);
+    CJ_LOG_INFO("Snapshot", "Stored version " << version.id << " (" << version.label << "): "
+                << content.size() << " byte(s), " << result.newChunks << "/" << result.chunks
+                << " new chunk(s), " << result.newBytes << " new byte(s)");
+    PruneLocked();
+
+    if (saved) *saved = version;
+    if (stats) *stats = result;
+    return true;
+}
+
+bool SnapshotStore::SaveFile(const fs::path& path, std::string_view label, Version* saved, SaveStats* stats) {
+    // The hosts file is rewritten in place, so it is read rather than mapped
+    MappedFile content;
+    if (!content.Open(path, MappedFile::Access::Sequential, MappedFile::BUFFERED)) {
+        CJ_LOG_ERROR("Snapshot", "Can't read " << path);
+        return false;
+    }
+    return Save(content.View(), label, saved, stats);
+}
+
+// ----- Restore -----
+bool SnapshotStore::Load(uint64_t id, std::string& content) const {
+    Trace::Span span("SnapshotStore::Load");
+    Version version;
+    std::vector<ChunkRef> chunks;
+    if (!ReadManifest(VersionPath(id), version, &chunks)) {
+        CJ_LOG_ERROR("Snapshot", "Version " << id << " is missing or unreadable");
+        return false;
+    }
+
+    // Every chunk is read straight into its place, all at once
+    size_t total = 0;
+    for (const ChunkRef& ref : chunks) total += ref.size;
+    content.resize(total);
+    IoBatch reads;
+    size_t offset = 0;
+    for (const ChunkRef& ref : chunks) {
+        reads.Chain();
+        reads.Read(ChunkPath(ref.digest), content.data() + offset, ref.size);
+        offset += ref.size;
+    }
+    if (!reads.Wait()) {
+        CJ_LOG_ERROR("Snapshot", "Version " << id << ": a chunk is missing or truncated (" << reads.GetError() << ")");
+        content.clear();
+        return false;
+    }
+
+    crypto::Digest digest{};
+    if (!crypto::Sha256(content.data(), content.size(), digest) || digest != version.digest) {
+        CJ_LOG_ERROR("Snapshot", "Version " << id << " failed its integrity check");
+        return false;
+    }
+    span.Arg("bytes", content.size());
+    return true;
+}
+
+bool SnapshotStore::Restore(uint64_t id, const fs::path& target) const {
+    std::string content;
+    if (!Load(id, content)) return false;
+    if (!WriteAtomically(target, content.data(), content.size())) return false;
+    CJ_LOG_INFO("Snapshot", "Restored version " << id << " to " << target);
+    return true;
+}
+
+// ----- Maintenance -----
+bool SnapshotStore::Verify(VerifyReport* report) const {
+    Trace::Span span("SnapshotStore::Verify");
+    VerifyReport result;
+    std::set<crypto::Digest> good, bad;
+    std::vector<ChunkRef> chunks;
+    MappedFile piece;
+
+    for (const Version& listed : List()) {
+        ++result.versions;
+        Version version;
+        if (!ReadManifest(VersionPath(listed.id), version, &chunks)) {
+            ++result.badVersions;
+            continue;
+        }
+
+        bool intact = true;
+        for (const ChunkRef& ref : chunks) {
+            if (good.count(ref.digest)) continue;
+            if (bad.count(ref.digest)) {
+                intact = false;
+                continue;
+            }
+
+            ++result.chunks;
+            crypto::Digest digest{};
+            if (!piece.Open(ChunkPath(ref.digest))) {
+                ++result.missingChunks;
+            } else if (piece.size() != ref.size || !crypto::Sha256(piece.data(), piece.size(), digest) ||
+                       digest != ref.digest) {
+                ++result.corruptChunks;
+            } else {
+                good.insert(ref.digest);
+                continue;
+            }
+            CJ_LOG_WARN("Snapshot", "Chunk " << crypto::ToHex(ref.digest) << " of version " << version.id
+                        << " is missing or corrupt");
+            bad.insert(ref.digest);
+            intact = false;
+        }
+        if (!intact) ++result.badVersions;
+    }
+
+    span.Arg("versions", result.versions).Arg("chunks", result.chunks);
+    if (report) *report = result;
+    return result.badVersions == 0;
+}
+
+bool SnapshotStore::Prune() {
+    FileLock lock;
+    if (!lock.Acquire(m_root / LOCK_FILENAME)) {
+        CJ_LOG_ERROR("Snapshot", "Can't lock the snapshot store");
+        return false;
+    }
+    PruneLocked();
+    return true;
+}
+
+void SnapshotStore::PruneLocked() {
+    Trace::Span span("SnapshotStore::Prune");
+    std::vector<Version> versions = List();
+    std::error_code ec;
+
+    // Oldest (the original hosts file) plus the newest m_keep
+    size_t removed = 0;
+    for (size_t i = 1; i + m_keep < versions.size(); ++i) {
+        if (fs::remove(VersionPath(versions[i].id), ec)) ++removed;
+    }
+
+    // Chunks referenced by the surviving manifests
+    std::set<std::string> referenced;
+    std::vector<ChunkRef> chunks;
+    for (const Version& listed : List()) {
+        Version version;
+        if (!ReadManifest(VersionPath(listed.id), version, &chunks)) continue;
+        for (const ChunkRef& ref : chunks) referenced.insert(crypto::ToHex(ref.digest));
+    }
+
+    // Recent files may belong to a save whose manifest isn't out yet
+    const auto cutoff = fs::file_time_type::clock::now() - std::chrono::seconds(CHUNK_GRACE_SECONDS);
+    size_t collected = 0;
+    std::vector<fs::path> garbage;
+    for (fs::recursive_directory_iterator it(m_root / "chunks", ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        if (referenced.count(it->path().filename().string())) continue;
+        std::error_code timeError;
+        const fs::file_time_type written = it->last_write_time(timeError);
+        if (!timeError && written > cutoff) continue;
+        garbage.push_back(it->path());
+    }
+    for (const fs::path& path : garbage) {
+        if (fs::remove(path, ec)) ++collected;
+    }
+
+    span.Arg("versions", removed).Arg("chunks", collected);
+    if (removed || collected) {
+        CJ_LOG_DEBUG("Snapshot", "Pruned " << removed << " version(s) and " << collected << " chunk(s)");
+    }
+}
+
+} // namespace utils
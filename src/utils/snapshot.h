@@ -0,0 +1,115 @@
+// snapshot.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crypto.h"
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Versioned, deduplicated store for hosts file backups. Content is split at
+// content-defined boundaries (FastCDC with a gear hash: 2 KiB minimum, 8 KiB
+// average, 64 KiB maximum), so an edit only changes the chunks around it. Each
+// chunk is stored once under its SHA-256; a version is a small manifest
+// listing its chunks, so a new backup costs the changed bytes only.
+//
+//   <root>/chunks/ab/<sha256 hex>   chunk bytes
+//   <root>/versions/<id>.snap       manifest (header + chunk references)
+//
+// Chunks are written before the manifest that references them, both through a
+// temporary file and rename, so a crash never leaves a version that can't be
+// restored. The newest `keep` versions are retained, plus the oldest one: the
+// first backup is the hosts file as it was before anything was blocked.
+//
+// Save() and Prune() hold the store lock (<root>/store.lock), so processes
+// sharing a store never number two versions alike or collect each other's
+// fresh chunks. A manifest is also published only under a name nothing holds
+// yet, and Prune() leaves chunks and temporaries younger than CHUNK_GRACE_SECONDS
+// alone, for writers that don't take the lock.
+class SnapshotStore {
+public:
+    static constexpr const char* DIRNAME = "snapshots";
+    static constexpr const char* LOCK_FILENAME = "store.lock";
+    static constexpr size_t DEFAULT_KEEP = 16;
+    static constexpr int64_t CHUNK_GRACE_SECONDS = 600;
+
+    static constexpr size_t MIN_CHUNK = 2 * 1024;
+    static constexpr size_t AVG_CHUNK = 8 * 1024;
+    static constexpr size_t MAX_CHUNK = 64 * 1024;
+
+    struct Version {
+        uint64_t id = 0;
+        int64_t timestamp = 0;     // Seconds since the Unix epoch
+        uint64_t size = 0;
+        size_t chunks = 0;
+        crypto::Digest digest{};   // Of the whole content
+        std::string label;         // Why it was taken ("backup", "apply", ...)
+    };
+
+    struct SaveStats {
+        size_t chunks = 0;
+        size_t newChunks = 0;
+        uint64_t newBytes = 0;     // Chunk bytes actually written
+        bool unchanged = false;    // Same content as the latest version; nothing stored
+    };
+
+    struct VerifyReport {
+        size_t versions = 0;
+        size_t chunks = 0;         // Distinct chunks checked
+        size_t missingChunks = 0;
+        size_t corruptChunks = 0;  // Size or digest mismatch
+        size_t badVersions = 0;    // Unreadable manifest or a missing/corrupt chunk
+    };
+
+    explicit SnapshotStore(const fs::path& root, size_t keep = DEFAULT_KEEP);
+
+    const fs::path& GetRoot() const noexcept { return m_root; }
+
+    // Stores `content` as a new version unless it matches the latest one
+    bool Save(std::string_view content, std::string_view label, Version* saved = nullptr,
+              SaveStats* stats = nullptr);
+    bool SaveFile(const fs::path& path, std::string_view label, Version* saved = nullptr,
+                  SaveStats* stats = nullptr);
+
+    // Oldest first. Unreadable manifests are skipped.
+    std::vector<Version> List() const;
+    bool Latest(Version& version) const;
+
+    // Reassembles a version and checks it against its digest
+    bool Load(uint64_t id, std::string& content) const;
+    // Load() into a temporary file beside `target`, then rename over it
+    bool Restore(uint64_t id, const fs::path& target) const;
+
+    // Re-hashes every chunk referenced by every version
+    bool Verify(VerifyReport* report = nullptr) const;
+
+    // Drops versions beyond the retention limit and chunks nothing references
+    bool Prune();
+
+    // Chunk end offsets for `data` (exposed for benchmarks)
+    static void FindChunks(std::string_view data, std::vector<size_t>& ends);
+
+private:
+    struct ChunkRef {
+        crypto::Digest digest;
+        uint32_t size;
+    };
+
+    fs::path ChunkPath(const crypto::Digest& digest) const;
+    fs::path VersionPath(uint64_t id) const;
+    bool ReadManifest(const fs::path& path, Version& version, std::vector<ChunkRef>* chunks) const;
+    bool WriteManifest(Version& version, const std::vector<ChunkRef>& chunks) const;
+    void PruneLocked();
+
+    fs::path m_root;
+    size_t m_keep;
+};
+
+} // namespace utils
@@ -0,0 +1,136 @@
+// statecache.cpp
+#include "statecache.h"
+#include "log.h"
+
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace StateCache {
+    namespace fs = std::filesystem;
+
+    // ----- On-disk Format -----
+    namespace {
+        constexpr char STATE_MAGIC[4] = { 'C', 'J', 'S', 'T' };
+        constexpr uint32_t STATE_VERSION = 1;
+
+        // Fixed-size record; written and read as raw bytes on the same machine
+        struct Record {
+            char magic[4];
+            uint32_t version;
+            uint64_t volume;
+            uint64_t fileId;
+            uint64_t size;
+            uint64_t mtime;
+            uint64_t blockStart;
+            uint64_t blockEnd;
+            uint8_t blocked;
+            uint8_t hasDigest;
+            uint8_t reserved[6];
+            unsigned char digest[32];
+        };
+    }
+
+    // ----- File Identity -----
+    bool QueryIdentity(const fs::path& path, FileIdentity& identity) noexcept {
+#ifdef _WIN32
+        // Zero access rights: metadata only, never blocks concurrent writers
+        HANDLE file = CreateFileW(path.c_str(), 0,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        BY_HANDLE_FILE_INFORMATION info{};
+        const BOOL ok = GetFileInformationByHandle(file, &info);
+        CloseHandle(file);
+        if (!ok) return false;
+
+        identity.volume = info.dwVolumeSerialNumber;
+        identity.fileId = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        identity.mtime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                         info.ftLastWriteTime.dwLowDateTime;
+        return true;
+#else
+        struct stat st{};
+        if (::stat(path.c_str(), &st) != 0) return false;
+
+        identity.volume = static_cast<uint64_t>(st.st_dev);
+        identity.fileId = static_cast<uint64_t>(st.st_ino);
+        identity.size = static_cast<uint64_t>(st.st_size);
+        identity.mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull +
+                         static_cast<uint64_t>(st.st_mtim.tv_nsec);
+        return true;
+#endif
+    }
+
+    // ----- Persistence -----
+    bool Load(const fs::path& statePath, HostsState& state) noexcept {
+        try {
+            std::ifstream ifs(statePath, std::ios::binary);
+            if (!ifs) return false;
+
+            Record record{};
+            if (!ifs.read(reinterpret_cast<char*>(&record), sizeof(record))) return false;
+            if (std::memcmp(record.magic, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0 ||
+                record.version != STATE_VERSION) {
+                return false;
+            }
+
+            state.identity.volume = record.volume;
+            state.identity.fileId = record.fileId;
+            state.identity.size = record.size;
+            state.identity.mtime = record.mtime;
+            state.blocked = record.blocked != 0;
+            state.blockStart = record.blockStart;
+            state.blockEnd = record.blockEnd;
+            state.hasDigest = record.hasDigest != 0;
+            std::memcpy(state.blockDigest.data(), record.digest, state.blockDigest.size());
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool Save(const fs::path& statePath, const HostsState& state) noexcept {
+        fs::path tempPath = statePath;
+        tempPath += ".tmp";
+
+        try {
+            Record record{};
+            std::memcpy(record.magic, STATE_MAGIC, sizeof(STATE_MAGIC));
+            record.version = STATE_VERSION;
+            record.volume = state.identity.volume;
+            record.fileId = state.identity.fileId;
+            record.size = state.identity.size;
+            record.mtime = state.identity.mtime;
+            record.blockStart = state.blockStart;
+            record.blockEnd = state.blockEnd;
+            record.blocked = state.blocked ? 1 : 0;
+            record.hasDigest = state.hasDigest ? 1 : 0;
+            std::memcpy(record.digest, state.blockDigest.data(), state.blockDigest.size());
+
+            std::error_code ec;
+            fs::create_directories(statePath.parent_path(), ec);
+            {
+                std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+                if (!ofs) return false;
+                ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+                ofs.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            }
+            fs::rename(tempPath, statePath);
+            return true;
+        } catch (const std::exception& e) {
+            CJ_LOG_ERROR("StateCache", "Save failed: " << e.what());
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+} // namespace StateCache
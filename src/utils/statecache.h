@@ -0,0 +1,52 @@
+// statecache.h
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "crypto.h"
+
+namespace StateCache {
+    namespace fs = std::filesystem;
+
+    // ----- Constants -----
+    constexpr const char* STATE_FILENAME = "hosts_state.bin";
+
+    // ----- File Identity -----
+    // Everything needed to tell whether a file changed, gathered with a single
+    // metadata query (volume + file index on Windows, dev + inode on POSIX)
+    struct FileIdentity {
+        uint64_t volume = 0;
+        uint64_t fileId = 0;
+        uint64_t size = 0;
+        uint64_t mtime = 0;  // Platform-native timestamp, only compared for equality
+
+        bool operator==(const FileIdentity& other) const noexcept {
+            return volume == other.volume && fileId == other.fileId &&
+                   size == other.size && mtime == other.mtime;
+        }
+        bool operator!=(const FileIdentity& other) const noexcept { return !(*this == other); }
+    };
+
+    // Returns false if the file doesn't exist or can't be queried
+    bool QueryIdentity(const fs::path& path, FileIdentity& identity) noexcept;
+
+    // ----- Persisted Hosts State -----
+    // Snapshot of what the hosts file looked like the last time it was scanned
+    // or written. While the identity still matches, the rest is trusted as-is.
+    struct HostsState {
+        FileIdentity identity;
+        bool blocked = false;          // Markers present and block digest matched
+        uint64_t blockStart = 0;       // Offset of the start marker line
+        uint64_t blockEnd = 0;         // Offset just past the end marker line
+        bool hasDigest = false;
+        crypto::Digest blockDigest{};  // Digest of the managed block we expect
+    };
+
+    // Loads the record; returns false if it is missing, truncated or from
+    // another format version (callers then fall back to a scan)
+    bool Load(const fs::path& statePath, HostsState& state) noexcept;
+
+    // Persists the record via a temporary file and rename
+    bool Save(const fs::path& statePath, const HostsState& state) noexcept;
+} // namespace StateCache
@@ -0,0 +1,410 @@
+// tamper.cpp
+#include "tamper.h"
+#include "blocker.h"
+#include "hostsguard.h"
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* STOCK_HOSTS = "127.0.0.1 localhost\n::1 localhost\n";
+constexpr std::chrono::milliseconds GUARD_RESTART_DELAY(100);
+constexpr unsigned RANDOM_SEED = 0xC41C;
+
+// CPU time consumed by the calling thread
+std::chrono::nanoseconds CurrentThreadCpuTime() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return std::chrono::nanoseconds(0);
+    }
+    auto toTicks = [](const FILETIME& ft) {
+        return (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    };
+    // FILETIME counts 100 ns intervals
+    return std::chrono::nanoseconds((toTicks(kernel) + toTicks(user)) * 100);
+#else
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+}
+
+unsigned long CurrentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+bool ReadText(const fs::path& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+void WriteText(const fs::path& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+}
+
+// Extracts the managed block (start marker through end marker line) from hosts text
+std::string ExtractManagedBlock(const std::string& text) {
+    const size_t start = text.find(Blocker::BLOCK_START_MARKER);
+    if (start == std::string::npos) return "";
+    size_t end = text.find(Blocker::BLOCK_END_MARKER, start);
+    if (end == std::string::npos) return "";
+    end = text.find('\n', end);
+    return text.substr(start, end == std::string::npos ? std::string::npos : end + 1 - start);
+}
+
+// Splits text into lines, dropping any line for which `drop` returns true
+template <typename Pred>
+std::string FilterLines(const std::string& text, Pred drop) {
+    std::string out;
+    out.reserve(text.size());
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!drop(line)) {
+            out += line;
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+std::chrono::microseconds Percentile(const std::vector<std::chrono::microseconds>& sorted, double p) {
+    if (sorted.empty()) return std::chrono::microseconds(0);
+    const size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+bool ParseMillis(const std::string& value, std::chrono::milliseconds& out) {
+    try {
+        out = std::chrono::milliseconds(std::stoul(value));
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+} // anonymous namespace
+
+const char* TamperSimulator::ModeName(Mode mode) {
+    switch (mode) {
+        case Mode::Modify:        return "modify";
+        case Mode::Truncate:      return "truncate";
+        case Mode::StripMarkers:  return "strip";
+        case Mode::DeleteEntries: return "delete";
+        case Mode::Replace:       return "replace";
+        default:                  return "unknown";
+    }
+}
+
+bool TamperSimulator::ParseOptions(const std::vector<std::string>& args, Options& options) {
+    for (const auto& arg : args) {
+        const size_t eq = arg.find('=');
+        if (eq == std::string::npos) {
+            CJ_LOG_ERROR("TamperSim", "Expected key=value, got: " << arg);
+            return false;
+        }
+        const std::string key = arg.substr(0, eq);
+        const std::string value = arg.substr(eq + 1);
+        bool ok = true;
+
+        try {
+            if (key == "rounds") options.rounds = std::stoul(value);
+            else if (key == "domains") options.domains = std::stoul(value);
+            else if (key == "poll") ok = ParseMillis(value, options.pollInterval);
+            else if (key == "gap") ok = ParseMillis(value, options.tamperGap);
+            else if (key == "timeout") ok = ParseMillis(value, options.restoreTimeout);
+            else if (key == "probe") ok = ParseMillis(value, options.probeInterval);
+            else if (key == "csv") options.csvPath = fs::u8path(value);
+            else if (key == "mix") {
+                std::fill(std::begin(options.weights), std::end(options.weights), 0u);
+                std::istringstream entries(value);
+                std::string entry;
+                while (ok && std::getline(entries, entry, ',')) {
+                    const size_t colon = entry.find(':');
+                    const std::string name = entry.substr(0, colon);
+                    const unsigned weight = colon == std::string::npos
+                        ? 1u : static_cast<unsigned>(std::stoul(entry.substr(colon + 1)));
+                    ok = false;
+                    for (size_t m = 0; m < static_cast<size_t>(Mode::Count); ++m) {
+                        if (name == ModeName(static_cast<Mode>(m))) {
+                            options.weights[m] = weight;
+                            ok = true;
+                        }
+                    }
+                }
+            } else {
+                CJ_LOG_ERROR("TamperSim", "Unknown option: " << key);
+                return false;
+            }
+        } catch (...) {
+            ok = false;
+        }
+
+        if (!ok) {
+            CJ_LOG_ERROR("TamperSim", "Invalid value for " << key << ": " << value);
+            return false;
+        }
+    }
+
+    if (std::all_of(std::begin(options.weights), std::end(options.weights),
+                    [](unsigned w) { return w == 0; })) {
+        CJ_LOG_ERROR("TamperSim", "mix selects no tamper modes");
+        return false;
+    }
+    return options.rounds > 0 && options.domains > 0;
+}
+
+void TamperSimulator::Tamper(Mode mode, const fs::path& hostsPath) {
+    std::string text;
+    ReadText(hostsPath, text);
+
+    switch (mode) {
+        case Mode::Modify: {
+            // Comment out the first managed entry
+            const size_t start = text.find(Blocker::BLOCK_START_MARKER);
+            const size_t entry = start == std::string::npos ? start : text.find('\n', start);
+            if (entry != std::string::npos && entry + 1 < text.size()) {
+                text.insert(entry + 1, "# ");
+            }
+            WriteText(hostsPath, text);
+            break;
+        }
+        case Mode::Truncate:
+            WriteText(hostsPath, "");
+            break;
+        case Mode::StripMarkers:
+            WriteText(hostsPath, FilterLines(text, [](const std::string& line) {
+                return line.find(Blocker::BLOCK_START_MARKER) != std::string::npos ||
+                       line.find(Blocker::BLOCK_END_MARKER) != std::string::npos;
+            }));
+            break;
+        case Mode::DeleteEntries: {
+            bool inside = false;
+            WriteText(hostsPath, FilterLines(text, [&inside](const std::string& line) {
+                if (line.find(Blocker::BLOCK_START_MARKER) != std::string::npos) {
+                    inside = true;
+                    return false;
+                }
+                if (line.find(Blocker::BLOCK_END_MARKER) != std::string::npos) {
+                    inside = false;
+                    return false;
+                }
+                return inside;
+            }));
+            break;
+        }
+        case Mode::Replace: {
+            fs::path staged = hostsPath;
+            staged += ".adversary";
+            WriteText(staged, STOCK_HOSTS);
+            std::error_code ec;
+            fs::rename(staged, hostsPath, ec);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool TamperSimulator::IsRestored(const fs::path& hostsPath, const std::string& managedBlock) {
+    std::string text;
+    return ReadText(hostsPath, text) && text.find(managedBlock) != std::string::npos;
+}
+
+bool TamperSimulator::Result::Passed() const noexcept {
+    return std::all_of(samples.begin(), samples.end(), [](const Sample& s) { return s.restored; });
+}
+
+TamperSimulator::Summary TamperSimulator::Summarize(const std::vector<Sample>& samples, Mode mode) {
+    Summary summary;
+    std::vector<std::chrono::microseconds> latencies;
+    for (const auto& s : samples) {
+        if (mode != Mode::Count && s.mode != mode) continue;
+        ++summary.events;
+        if (s.restored) latencies.push_back(s.latency);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    summary.repaired = latencies.size();
+    if (!latencies.empty()) {
+        summary.p50 = Percentile(latencies, 0.50);
+        summary.p99 = Percentile(latencies, 0.99);
+        summary.max = latencies.back();
+    }
+    return summary;
+}
+
+bool TamperSimulator::Measure(const Options& options, Result& result) {
+    const fs::path workDir = fs::temp_directory_path() /
+        ("cj-tamper-" + std::to_string(CurrentProcessId()));
+    const fs::path hostsPath = workDir / "hosts";
+    const fs::path backupPath = workDir / "hosts_backup.txt";
+
+    std::error_code ec;
+    fs::create_directories(workDir, ec);
+    if (ec) {
+        CJ_LOG_ERROR("TamperSim", "Can't create work directory: " << ec.message());
+        return false;
+    }
+    WriteText(hostsPath, STOCK_HOSTS);
+
+    std::vector<std::string> domains;
+    domains.reserve(options.domains);
+    for (size_t i = 0; i < options.domains; ++i) {
+        domains.push_back("tamper-sim-" + std::to_string(i) + ".example");
+    }
+
+    // The harness keeps its own Blocker to establish and reset the baseline;
+    // the guard thread gets an independent one, as a watchdog process would.
+    Blocker harness(hostsPath, backupPath);
+    Blocker guarded(hostsPath, backupPath);
+    if (!harness.loadDomains(domains) || !harness.applyBlock() || !guarded.loadManagedDomains()) {
+        CJ_LOG_ERROR("TamperSim", "Failed to establish the initial block");
+        fs::remove_all(workDir, ec);
+        return false;
+    }
+
+    std::string text;
+    ReadText(hostsPath, text);
+    const std::string managedBlock = ExtractManagedBlock(text);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> guardRestarts{0};
+    std::chrono::nanoseconds guardCpu{0};
+
+    CJ_LOG_INFO("TamperSim", "Work directory: " << workDir);
+    const auto started = Clock::now();
+
+    std::thread guardThread([&] {
+        HostsGuard guard(guarded);
+        while (!stop.load()) {
+            if (!guard.Run(stop, options.pollInterval)) {
+                // A failed watchdog is restarted by its peer; model that as a short delay
+                guardRestarts.fetch_add(1);
+                std::this_thread::sleep_for(GUARD_RESTART_DELAY);
+            }
+        }
+        guardCpu = CurrentThreadCpuTime();
+    });
+
+    std::mt19937 rng(RANDOM_SEED);
+    std::discrete_distribution<size_t> pick(std::begin(options.weights), std::end(options.weights));
+    std::vector<Sample>& samples = result.samples;
+    samples.reserve(options.rounds);
+
+    for (size_t round = 0; round < options.rounds; ++round) {
+        std::this_thread::sleep_for(options.tamperGap);
+
+        const Mode mode = static_cast<Mode>(pick(rng));
+        const auto tampered = Clock::now();
+        Tamper(mode, hostsPath);
+
+        Sample sample{mode, false, std::chrono::microseconds(0)};
+        while (Clock::now() - tampered < options.restoreTimeout) {
+            if (IsRestored(hostsPath, managedBlock)) {
+                sample.restored = true;
+                break;
+            }
+            std::this_thread::sleep_for(options.probeInterval);
+        }
+        sample.latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - tampered);
+        samples.push_back(sample);
+
+        CJ_LOG_INFO("TamperSim", "#" << (round + 1) << ' ' << ModeName(mode) << ": "
+                    << (sample.restored ? "restored in " : "NOT restored after ")
+                    << sample.latency.count() / 1000.0 << " ms");
+
+        // Reset the baseline so an undetected tamper doesn't leak into the next event
+        if (!sample.restored) {
+            harness.applyBlock();
+        }
+    }
+
+    stop.store(true);
+    guardThread.join();
+    result.wall = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started);
+    result.guardRestarts = guardRestarts.load();
+    result.guardCpu = guardCpu;
+
+    if (!options.csvPath.empty()) {
+        std::ofstream csv(options.csvPath, std::ios::trunc);
+        csv << "mode,restored,latency_us\n";
+        for (const auto& s : samples) {
+            csv << ModeName(s.mode) << ',' << (s.restored ? 1 : 0) << ',' << s.latency.count() << '\n';
+        }
+    }
+
+    fs::remove_all(workDir, ec);
+    return true;
+}
+
+int TamperSimulator::Run(const Options& options) {
+    Result result;
+    if (!Measure(options, result)) return 1;
+    PrintReport(options, result);
+    return result.Passed() ? 0 : 1;
+}
+
+void TamperSimulator::PrintReport(const Options& options, const Result& result) {
+    auto print = [](const char* label, const Summary& summary) {
+        std::cout << "  " << std::left << std::setw(10) << label
+                  << " repaired " << summary.repaired << '/' << summary.events;
+        if (summary.repaired > 0) {
+            std::cout << std::fixed << std::setprecision(1)
+                      << "  p50 " << summary.p50.count() / 1000.0 << " ms"
+                      << "  p99 " << summary.p99.count() / 1000.0 << " ms"
+                      << "  max " << summary.max.count() / 1000.0 << " ms";
+        }
+        std::cout << '\n';
+    };
+
+    std::cout << "\n===== [TamperSim] Report =====\n"
+              << "  events " << result.samples.size() << ", domains " << options.domains
+              << ", poll " << options.pollInterval.count() << " ms\n";
+
+    for (size_t m = 0; m < static_cast<size_t>(Mode::Count); ++m) {
+        const Mode mode = static_cast<Mode>(m);
+        const Summary summary = Summarize(result.samples, mode);
+        if (summary.events > 0) print(ModeName(mode), summary);
+    }
+    print("all", Summarize(result.samples, Mode::Count));
+
+    const double cpuMs = std::chrono::duration<double, std::milli>(result.guardCpu).count();
+    const double wallMs = std::chrono::duration<double, std::milli>(result.wall).count();
+    std::cout << std::fixed << std::setprecision(1)
+              << "  watchdog restarts " << result.guardRestarts << '\n'
+              << "  watchdog CPU " << cpuMs << " ms over " << wallMs / 1000.0 << " s ("
+              << std::setprecision(3) << (wallMs > 0 ? 100.0 * cpuMs / wallMs : 0.0) << "%)\n";
+}
+
+} // namespace utils
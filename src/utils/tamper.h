@@ -0,0 +1,87 @@
+// tamper.h
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+namespace fs = std::filesystem;
+
+// Adversarial harness for the watchdog: runs its hosts-file guard (HostsGuard)
+// against a hosts file in a temporary directory while an adversary thread
+// tampers with it, and measures how long the file stays unblocked.
+class TamperSimulator {
+public:
+    enum class Mode {
+        Modify,         // Comment out one managed entry
+        Truncate,       // Truncate the hosts file to zero bytes
+        StripMarkers,   // Remove the managed block markers, keep the entries
+        DeleteEntries,  // Remove every entry between the markers
+        Replace,        // Atomically replace the file with a stock hosts file
+        Count
+    };
+
+    struct Options {
+        size_t rounds = 20;                                 // Tamper events to inject
+        size_t domains = 1000;                              // Size of the managed block
+        std::chrono::milliseconds pollInterval{5000};       // Watchdog check interval
+        std::chrono::milliseconds tamperGap{1000};          // Pause between events
+        std::chrono::milliseconds restoreTimeout{15000};    // Give up on a repair after this
+        std::chrono::milliseconds probeInterval{1};         // How often restoration is checked
+        unsigned weights[static_cast<size_t>(Mode::Count)] = { 1, 1, 1, 1, 1 };
+        fs::path csvPath;                                   // Optional per-event samples
+    };
+
+    struct Sample {
+        Mode mode;
+        bool restored;
+        std::chrono::microseconds latency;
+    };
+
+    struct Result {
+        std::vector<Sample> samples;
+        size_t guardRestarts = 0;
+        std::chrono::nanoseconds guardCpu{0};
+        std::chrono::nanoseconds wall{0};
+
+        bool Passed() const noexcept;                       // Every event was repaired
+    };
+
+    // Repair latencies of one mode's events, or of every event for Mode::Count
+    struct Summary {
+        size_t events = 0;
+        size_t repaired = 0;
+        std::chrono::microseconds p50{0};
+        std::chrono::microseconds p99{0};
+        std::chrono::microseconds max{0};
+    };
+
+    // Parses key=value tokens (UTF-8) that follow --tamper-sim or bench tamper:
+    //   rounds=N domains=N poll=MS gap=MS timeout=MS probe=MS csv=PATH
+    //   mix=modify:W,truncate:W,strip:W,delete:W,replace:W
+    // Returns false (with a message on stderr) on unknown keys or bad values.
+    static bool ParseOptions(const std::vector<std::string>& args, Options& options);
+
+    // Runs the simulation into `result`, writing the CSV when asked. False
+    // only when the temporary hosts file couldn't be set up and blocked.
+    static bool Measure(const Options& options, Result& result);
+
+    // Measure() plus the printed latency report.
+    // Returns 0 when every event was repaired, 1 otherwise.
+    static int Run(const Options& options);
+
+    static Summary Summarize(const std::vector<Sample>& samples, Mode mode);
+    static const char* ModeName(Mode mode);
+
+private:
+    TamperSimulator() = delete;
+
+    static void Tamper(Mode mode, const fs::path& hostsPath);
+    static bool IsRestored(const fs::path& hostsPath, const std::string& managedBlock);
+    static void PrintReport(const Options& options, const Result& result);
+};
+
+} // namespace utils
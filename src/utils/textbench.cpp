@@ -0,0 +1,221 @@
+// textbench.cpp
+#include "textbench.h"
+#include "transcode.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <string_view>
+
+namespace TextBench {
+    namespace {
+        void AppendUtf8(std::string& out, char32_t c) {
+            if (c < 0x80) {
+                out += static_cast<char>(c);
+            } else if (c < 0x800) {
+                out += static_cast<char>(0xC0 | (c >> 6));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            } else if (c < 0x10000) {
+                out += static_cast<char>(0xE0 | (c >> 12));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (c >> 18));
+                out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+
+        void AppendUtf16(std::u16string& out, char32_t c) {
+            if (c < 0x10000) {
+                out += static_cast<char16_t>(c);
+            } else {
+                out += static_cast<char16_t>(0xD800 + ((c - 0x10000) >> 10));
+                out += static_cast<char16_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+            }
+        }
+
+        // Mostly ASCII with runs of every encoded length, like a list with
+        // internationalized names and comments
+        char32_t RandomCodePoint(std::mt19937_64& rng) {
+            switch (rng() % 8) {
+                case 0:  return static_cast<char32_t>(0x80 + rng() % 0x780);
+                case 1: {
+                    const char32_t c = static_cast<char32_t>(0x800 + rng() % 0xF800);
+                    return c >= 0xD800 && c <= 0xDFFF ? 0xFFFD : c;
+                }
+                case 2:  return static_cast<char32_t>(0x10000 + rng() % 0x100000);
+                case 3:  return rng() % 2 ? U'\r' : U'\n';
+                default: return static_cast<char32_t>(0x20 + rng() % 0x5F);
+            }
+        }
+
+        // Everything the kernels compute for one input, compared as a whole
+        struct Outputs {
+            std::u16string utf16;
+            std::string utf8;
+            std::u16string crlf;
+            std::string lf;
+            size_t utf16Length = 0;
+            size_t utf8Length = 0;
+            size_t crlfLength = 0;
+            size_t asciiLength = 0;
+
+            bool operator==(const Outputs& other) const {
+                return utf16 == other.utf16 && utf8 == other.utf8 && crlf == other.crlf && lf == other.lf &&
+                       utf16Length == other.utf16Length && utf8Length == other.utf8Length &&
+                       crlfLength == other.crlfLength && asciiLength == other.asciiLength;
+            }
+        };
+
+        Outputs Run(const std::string& bytes, const std::u16string& units) {
+            Outputs out;
+            out.utf16 = Transcode::Utf8ToUtf16(bytes);
+            out.utf8 = Transcode::Utf16ToUtf8(units);
+            out.crlf = Transcode::ToCrlf(units);
+            out.lf = bytes;
+            Transcode::ToLf(out.lf);
+            out.utf16Length = Transcode::Utf16Length(bytes.data(), bytes.size());
+            out.utf8Length = Transcode::Utf8Length(units.data(), units.size());
+            out.crlfLength = Transcode::CrlfLength(units.data(), units.size());
+            out.asciiLength = Transcode::AsciiLength(bytes.data(), bytes.size());
+            return out;
+        }
+    } // anonymous namespace
+
+    bool CheckTranscode(size_t rounds, uint64_t seed, std::string& failure) {
+        using Transcode::Isa;
+        const Isa active = Transcode::ActiveIsa();
+        std::mt19937_64 rng(seed);
+        bool ok = true;
+
+        for (size_t round = 0; ok && round < rounds; ++round) {
+            // Well-formed text, encoded here, must decode to exactly the other form
+            std::string utf8;
+            std::u16string utf16;
+            const size_t length = rng() % 300;
+            for (size_t i = 0; i < length; ++i) {
+                const char32_t c = RandomCodePoint(rng);
+                AppendUtf8(utf8, c);
+                AppendUtf16(utf16, c);
+            }
+
+            // Ill-formed text only has to come out the same from every ISA
+            std::string bytes(rng() % 300, '\0');
+            for (char& c : bytes) {
+                const uint64_t pick = rng();
+                c = static_cast<char>(round % 3 == 0 ? pick : round % 3 == 1 ? pick % 0x80
+                                      : pick % 4 ? 'a' + pick % 26 : 0xC0 + pick % 0x40);
+            }
+            std::u16string units(rng() % 300, u'\0');
+            for (char16_t& c : units) {
+                const uint64_t pick = rng();
+                c = static_cast<char16_t>(pick % 5 == 0 ? 0xD800 + pick % 0x800 : pick % 7 == 0 ? u'\n'
+                                          : pick % 11 == 0 ? u'\r' : pick % 3 == 0 ? pick % 0x10000
+                                          : 'a' + pick % 26);
+            }
+
+            Transcode::ForceIsa(Isa::Scalar);
+            const Outputs scalar = Run(bytes, units);
+            if (Transcode::Utf8ToUtf16(utf8) != utf16 || Transcode::Utf16ToUtf8(utf16) != utf8) {
+                failure = "scalar kernels disagree with the reference encoding in round " + std::to_string(round);
+                ok = false;
+                break;
+            }
+            for (Isa wanted : { Isa::Sse2, Isa::Avx2 }) {
+                const Isa isa = Transcode::ForceIsa(wanted);
+                if (isa != wanted) continue;   // Not on this CPU
+                if (!(Run(bytes, units) == scalar) || Transcode::Utf8ToUtf16(utf8) != utf16 ||
+                    Transcode::Utf16ToUtf8(utf16) != utf8) {
+                    failure = std::string(Transcode::IsaName(isa)) + " kernels disagree with scalar in round "
+                              + std::to_string(round);
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        Transcode::ForceIsa(active);
+        return ok;
+    }
+
+    Idna::Backend ReferenceBackend() noexcept {
+        const Idna::Backend active = Idna::ActiveBackend();
+        Idna::Backend reference = Idna::ForceBackend(Idna::Backend::Windows);
+        if (reference != Idna::Backend::Windows) reference = Idna::ForceBackend(Idna::Backend::Icu);
+        Idna::ForceBackend(active);
+        return reference;
+    }
+
+    bool CheckIdna(size_t& checked, size_t& referenceOnly, std::string& failure) {
+        checked = referenceOnly = 0;
+        const Idna::Backend reference = ReferenceBackend();
+        if (reference == Idna::Backend::Builtin) {
+            failure = "no reference backend compiled in";
+            return false;
+        }
+
+        const Idna::Backend active = Idna::ActiveBackend();
+        size_t disagreements = 0;
+        std::string name, expected, actual;
+        for (char32_t c = 0x80; c < 0x10000; ++c) {
+            if (c >= 0xD800 && c <= 0xDFFF) continue;
+            for (int form = 0; form < 2; ++form) {
+                name.clear();
+                if (form) name += 'x';
+                AppendUtf8(name, c);
+                name += form ? "y.com" : "ab.example";
+
+                Idna::ForceBackend(Idna::Backend::Builtin);
+                const bool builtin = Idna::ToAscii(name, actual);
+                Idna::ForceBackend(reference);
+                const bool encoded = Idna::ToAscii(name, expected);
+                if (!builtin) {
+                    if (encoded) ++referenceOnly;
+                    continue;
+                }
+                ++checked;
+                if (encoded && actual == expected) continue;
+                if (disagreements++ == 0) {
+                    char codePoint[16];
+                    std::snprintf(codePoint, sizeof(codePoint), "U+%04X", static_cast<unsigned>(c));
+                    failure = std::string(codePoint) + ": builtin \"" + actual + "\", " +
+                              Idna::BackendName(reference) + (encoded ? " \"" + expected + "\"" : " rejects it");
+                }
+            }
+        }
+        Idna::ForceBackend(active);
+        if (disagreements > 1) failure += " (and " + std::to_string(disagreements - 1) + " more)";
+        return disagreements == 0;
+    }
+
+    std::string HostsCorpus(size_t bytes, unsigned idnPermille, bool crlf) {
+        static constexpr std::string_view IDN_LABELS[] = {
+            u8"bücher", u8"例え", u8"пример", u8"straße",
+            u8"한국"
+        };
+        const std::string_view newline = crlf ? "\r\n" : "\n";
+        const size_t idnEvery = idnPermille == 0 ? 0 : 1000 / std::min(idnPermille, 1000u);
+        std::string text;
+        text.reserve(bytes + 64);
+        for (size_t line = 0; text.size() < bytes; ++line) {
+            if (line % 50 == 0) {
+                text += u8"# Liste für Werbung – ñ";
+                text += newline;
+            }
+            text += "0.0.0.0 ";
+            if (idnEvery && line % idnEvery == 0) {
+                text += IDN_LABELS[line % std::size(IDN_LABELS)];
+                text += std::to_string(line);
+                text += ".example.com";
+            } else {
+                text += "ad-server";
+                text += std::to_string(line);
+                text += ".tracker.example.com";
+            }
+            text += newline;
+        }
+        return text;
+    }
+} // namespace TextBench
@@ -0,0 +1,36 @@
+// textbench.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "idna.h"
+
+// Cross-checks and corpora for the text paths of list import, behind the
+// headless `bench` command (see cli.cpp) so they run wherever the engine
+// builds: the vector transcoding kernels against the scalar one and the
+// scalar one against an independent encoder, and the built-in IDN mapping
+// against the platform's (ICU or IdnToAscii).
+namespace TextBench {
+    // Random UTF-8 (ill-formed, ASCII and well-formed) and UTF-16 (with
+    // unpaired surrogates and mixed line endings) through every ISA the CPU
+    // has. False with `failure` naming the first disagreement.
+    bool CheckTranscode(size_t rounds, uint64_t seed, std::string& failure);
+
+    // The backend the built-in mapping is checked against, or Builtin when
+    // neither ICU nor IdnToAscii was compiled in
+    Idna::Backend ReferenceBackend() noexcept;
+
+    // Every BMP code point, leading a label and inside one, through the
+    // built-in mapping and the reference backend: whatever the built-in
+    // mapping accepts must come out exactly as the reference encodes it.
+    // `checked` counts those names, `referenceOnly` the ones only the
+    // reference accepts (the built-in subset rejects them by design).
+    bool CheckIdna(size_t& checked, size_t& referenceOnly, std::string& failure);
+
+    // A hosts-format list of at least `bytes` bytes. Every 50th line is a
+    // comment with non-ASCII text; `idnPermille` of the names are
+    // internationalized. Lines end in CRLF when `crlf` is set.
+    std::string HostsCorpus(size_t bytes, unsigned idnPermille, bool crlf);
+} // namespace TextBench
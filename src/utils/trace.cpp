@@ -0,0 +1,165 @@
+// trace.cpp
+#include "trace.h"
+#include "log.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Trace {
+    namespace fs = std::filesystem;
+
+    namespace detail {
+        std::atomic<bool> enabled{false};
+    }
+
+    namespace {
+        struct Event {
+            const char* name;
+            const char* category;
+            int64_t startUs;
+            int64_t durationUs;
+            int argCount;
+            const char* keys[Span::MAX_ARGS];
+            uint64_t values[Span::MAX_ARGS];
+        };
+
+        // One buffer per thread; the mutex is uncontended except while Stop() collects
+        struct ThreadBuffer {
+            uint32_t tid;
+            std::mutex mutex;
+            std::vector<Event> events;
+        };
+
+        std::mutex g_registryMutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+        std::atomic<uint32_t> g_nextTid{1};
+        std::chrono::steady_clock::time_point g_origin;
+        fs::path g_outputFile;
+
+        int64_t NowUs() noexcept {
+            using namespace std::chrono;
+            return duration_cast<microseconds>(steady_clock::now() - g_origin).count();
+        }
+
+        ThreadBuffer* CurrentBuffer() {
+            thread_local std::shared_ptr<ThreadBuffer> buffer;
+            if (!buffer) {
+                buffer = std::make_shared<ThreadBuffer>();
+                buffer->tid = g_nextTid.fetch_add(1, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(g_registryMutex);
+                g_buffers.push_back(buffer);
+            }
+            return buffer.get();
+        }
+
+        unsigned long ProcessId() noexcept {
+#ifdef _WIN32
+            return GetCurrentProcessId();
+#else
+            return static_cast<unsigned long>(getpid());
+#endif
+        }
+
+        void WriteJsonString(std::ostream& out, const char* text) {
+            out << '"';
+            for (const char* p = text; *p; ++p) {
+                if (*p == '"' || *p == '\\') out << '\\';
+                out << *p;
+            }
+            out << '"';
+        }
+    }
+
+    // ----- Session Control -----
+    bool Start(const fs::path& outputFile) {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        if (detail::enabled.load()) return true;
+
+        for (auto& buffer : g_buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->events.clear();
+        }
+        g_outputFile = outputFile;
+        g_origin = std::chrono::steady_clock::now();
+        detail::enabled.store(true, std::memory_order_release);
+        CJ_LOG_INFO("Trace", "Tracing to " << outputFile);
+        return true;
+    }
+
+    void Stop() {
+        if (!detail::enabled.exchange(false)) return;
+
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        std::ofstream out(g_outputFile, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            CJ_LOG_ERROR("Trace", "Can't write trace file " << g_outputFile);
+            return;
+        }
+
+        const unsigned long pid = ProcessId();
+        size_t written = 0;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (auto& buffer : g_buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            for (const Event& e : buffer->events) {
+                out << (written++ ? ",\n" : "\n") << "{\"name\":";
+                WriteJsonString(out, e.name);
+                out << ",\"cat\":";
+                WriteJsonString(out, e.category);
+                out << ",\"ph\":\"X\",\"ts\":" << e.startUs << ",\"dur\":" << e.durationUs
+                    << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid;
+                if (e.argCount > 0) {
+                    out << ",\"args\":{";
+                    for (int i = 0; i < e.argCount; ++i) {
+                        if (i) out << ',';
+                        WriteJsonString(out, e.keys[i]);
+                        out << ':' << e.values[i];
+                    }
+                    out << '}';
+                }
+                out << '}';
+            }
+            buffer->events.clear();
+        }
+        out << "\n]}\n";
+        CJ_LOG_INFO("Trace", "Wrote " << written << " span(s) to " << g_outputFile);
+    }
+
+    // ----- Scoped Span -----
+    Span::Span(const char* name, const char* category) noexcept
+        : m_name(name), m_category(category), m_active(IsEnabled()) {
+        if (m_active) m_startUs = NowUs();
+    }
+
+    Span::~Span() {
+        if (!m_active || !IsEnabled()) return;
+
+        Event event;
+        event.name = m_name;
+        event.category = m_category;
+        event.startUs = m_startUs;
+        event.durationUs = NowUs() - m_startUs;
+        event.argCount = m_argCount;
+        for (int i = 0; i < m_argCount; ++i) {
+            event.keys[i] = m_args[i].key;
+            event.values[i] = m_args[i].value;
+        }
+
+        try {
+            ThreadBuffer* buffer = CurrentBuffer();
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            buffer->events.push_back(event);
+        } catch (...) {
+            // Out of memory while tracing: drop the span rather than the caller
+        }
+    }
+} // namespace Trace
@@ -0,0 +1,71 @@
+// trace.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+namespace Trace {
+    namespace fs = std::filesystem;
+
+    // ----- Session Control -----
+    // Starts collecting spans; they are written as Chrome/Perfetto trace-event
+    // JSON (load in chrome://tracing or ui.perfetto.dev) when Stop() is called.
+    bool Start(const fs::path& outputFile);
+    void Stop();
+
+    namespace detail {
+        extern std::atomic<bool> enabled;
+    }
+
+    inline bool IsEnabled() noexcept {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+
+    // RAII wrapper for Start()/Stop(); does nothing with an empty path
+    class Session {
+    public:
+        explicit Session(const fs::path& outputFile) : m_active(!outputFile.empty() && Start(outputFile)) {}
+        ~Session() { if (m_active) Stop(); }
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+    private:
+        bool m_active;
+    };
+
+    // ----- Scoped Span -----
+    // Records a complete ("X") event covering its lifetime. When tracing is
+    // off the constructor is one relaxed load and Arg() returns immediately.
+    // Names, categories and argument keys must be string literals.
+    class Span {
+    public:
+        static constexpr int MAX_ARGS = 4;
+
+        explicit Span(const char* name, const char* category = "cj") noexcept;
+        ~Span();
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        Span& Arg(const char* key, uint64_t value) noexcept {
+            if (m_active && m_argCount < MAX_ARGS) {
+                m_args[m_argCount].key = key;
+                m_args[m_argCount].value = value;
+                ++m_argCount;
+            }
+            return *this;
+        }
+
+    private:
+        struct KeyValue {
+            const char* key;
+            uint64_t value;
+        };
+
+        const char* m_name;
+        const char* m_category;
+        int64_t m_startUs = 0;
+        bool m_active;
+        int m_argCount = 0;
+        KeyValue m_args[MAX_ARGS];
+    };
+} // namespace Trace
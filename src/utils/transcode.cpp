@@ -0,0 +1,579 @@
+// transcode.cpp
+#include "transcode.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CJ_TRANSCODE_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CJ_TARGET_AVX2
+#define CJ_TRANSCODE_AVX2 1
+#elif defined(__GNUC__)
+#define CJ_TARGET_AVX2 __attribute__((target("avx2")))
+#define CJ_TRANSCODE_AVX2 1
+#endif
+#endif
+
+namespace Transcode {
+    namespace {
+        constexpr char16_t REPLACEMENT = 0xFFFD;
+
+        inline unsigned CountTrailingZeros(uint32_t mask) noexcept {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return index;
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        // ----- Scalar Kernels -----
+        // Decodes one sequence at in[i]. Ill-formed input emits one U+FFFD per
+        // maximal invalid subpart, so a unit is never written for more than
+        // the bytes consumed and the output stays within `length` units.
+        inline void DecodeOne(const uint8_t* in, size_t length, size_t& i, char16_t*& out) noexcept {
+            const uint8_t lead = in[i];
+            if (lead < 0x80) {
+                *out++ = lead;
+                ++i;
+                return;
+            }
+
+            size_t need;
+            uint32_t cp;
+            uint8_t lo = 0x80, hi = 0xBF;
+            if (lead >= 0xC2 && lead <= 0xDF) {
+                need = 1;
+                cp = lead & 0x1F;
+            } else if (lead >= 0xE0 && lead <= 0xEF) {
+                need = 2;
+                cp = lead & 0x0F;
+                if (lead == 0xE0) lo = 0xA0;  // Overlong
+                if (lead == 0xED) hi = 0x9F;  // Surrogates
+            } else if (lead >= 0xF0 && lead <= 0xF4) {
+                need = 3;
+                cp = lead & 0x07;
+                if (lead == 0xF0) lo = 0x90;  // Overlong
+                if (lead == 0xF4) hi = 0x8F;  // Above U+10FFFF
+            } else {
+                *out++ = REPLACEMENT;
+                ++i;
+                return;
+            }
+
+            size_t j = i + 1;
+            for (size_t k = 0; k < need; ++k, ++j) {
+                if (j >= length || in[j] < lo || in[j] > hi) {
+                    *out++ = REPLACEMENT;
+                    i = j;
+                    return;
+                }
+                lo = 0x80;
+                hi = 0xBF;
+                cp = (cp << 6) | (in[j] & 0x3F);
+            }
+            i = j;
+
+            if (cp >= 0x10000) {
+                cp -= 0x10000;
+                *out++ = static_cast<char16_t>(0xD800 + (cp >> 10));
+                *out++ = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+            } else {
+                *out++ = static_cast<char16_t>(cp);
+            }
+        }
+
+        inline void EncodeOne(const char16_t* in, size_t length, size_t& i, uint8_t*& out) noexcept {
+            uint32_t cp = in[i++];
+            if (cp < 0x80) {
+                *out++ = static_cast<uint8_t>(cp);
+                return;
+            }
+            if (cp < 0x800) {
+                *out++ = static_cast<uint8_t>(0xC0 | (cp >> 6));
+                *out++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+                return;
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) {
+                if (cp <= 0xDBFF && i < length && in[i] >= 0xDC00 && in[i] <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (in[i++] - 0xDC00);
+                    *out++ = static_cast<uint8_t>(0xF0 | (cp >> 18));
+                    *out++ = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F));
+                    *out++ = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+                    *out++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+                    return;
+                }
+                cp = REPLACEMENT;
+            }
+            *out++ = static_cast<uint8_t>(0xE0 | (cp >> 12));
+            *out++ = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+        }
+
+        // Exact output sizes, so the string API doesn't allocate for the worst case
+        inline size_t DecodedUnits(const uint8_t* in, size_t length, size_t& i) noexcept {
+            char16_t units[2];
+            char16_t* out = units;
+            DecodeOne(in, length, i, out);
+            return static_cast<size_t>(out - units);
+        }
+
+        inline size_t EncodedBytes(const char16_t* in, size_t length, size_t& i) noexcept {
+            const char16_t c = in[i++];
+            if (c < 0x80) return 1;
+            if (c < 0x800) return 2;
+            if (c >= 0xD800 && c <= 0xDBFF && i < length && in[i] >= 0xDC00 && in[i] <= 0xDFFF) {
+                ++i;
+                return 4;
+            }
+            return 3;
+        }
+
+        size_t Utf16LengthScalar(const uint8_t* in, size_t length) noexcept {
+            size_t units = 0, i = 0;
+            while (i < length) units += DecodedUnits(in, length, i);
+            return units;
+        }
+
+        size_t Utf8LengthScalar(const char16_t* in, size_t length) noexcept {
+            size_t bytes = 0, i = 0;
+            while (i < length) bytes += EncodedBytes(in, length, i);
+            return bytes;
+        }
+
+        size_t Utf8ToUtf16Scalar(const uint8_t* in, size_t length, char16_t* out) noexcept {
+            char16_t* const start = out;
+            size_t i = 0;
+            while (i < length) DecodeOne(in, length, i, out);
+            return static_cast<size_t>(out - start);
+        }
+
+        size_t Utf16ToUtf8Scalar(const char16_t* in, size_t length, uint8_t* out) noexcept {
+            uint8_t* const start = out;
+            size_t i = 0;
+            while (i < length) EncodeOne(in, length, i, out);
+            return static_cast<size_t>(out - start);
+        }
+
+        // Newline scans return the index of the next CR or LF at or after `i`, or `length`
+        size_t FindCrScalar(const char* in, size_t i, size_t length) noexcept {
+            while (i < length && in[i] != '\r') ++i;
+            return i;
+        }
+
+        size_t FindNewline16Scalar(const char16_t* in, size_t i, size_t length) noexcept {
+            while (i < length && in[i] != u'\r' && in[i] != u'\n') ++i;
+            return i;
+        }
+
+        // Index of the first byte at or after `i` with the high bit set, or `length`
+        size_t FindNonAsciiScalar(const char* in, size_t i, size_t length) noexcept {
+            while (i < length && static_cast<unsigned char>(in[i]) < 0x80) ++i;
+            return i;
+        }
+
+        // ----- SSE2 Kernels -----
+#if CJ_TRANSCODE_SSE2
+        size_t Utf8ToUtf16Sse2(const uint8_t* in, size_t length, char16_t* out) noexcept {
+            char16_t* const start = out;
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            while (i + 16 <= length) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                if (_mm_movemask_epi8(bytes) == 0) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(bytes, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+                    i += 16;
+                    out += 16;
+                    continue;
+                }
+                // Finish this block in scalar code before trying the fast path again
+                const size_t blockEnd = i + 16;
+                while (i < blockEnd) DecodeOne(in, length, i, out);
+            }
+            while (i < length) DecodeOne(in, length, i, out);
+            return static_cast<size_t>(out - start);
+        }
+
+        size_t Utf16ToUtf8Sse2(const char16_t* in, size_t length, uint8_t* out) noexcept {
+            uint8_t* const start = out;
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+            size_t i = 0;
+            while (i + 16 <= length) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+                const __m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) == 0xFFFF) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+                    i += 16;
+                    out += 16;
+                    continue;
+                }
+                const size_t blockEnd = i + 16;
+                while (i < blockEnd) EncodeOne(in, length, i, out);
+            }
+            while (i < length) EncodeOne(in, length, i, out);
+            return static_cast<size_t>(out - start);
+        }
+
+        size_t Utf16LengthSse2(const uint8_t* in, size_t length) noexcept {
+            size_t units = 0, i = 0;
+            while (i + 16 <= length) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                if (_mm_movemask_epi8(bytes) == 0) {
+                    units += 16;
+                    i += 16;
+                    continue;
+                }
+                const size_t blockEnd = i + 16;
+                while (i < blockEnd) units += DecodedUnits(in, length, i);
+            }
+            while (i < length) units += DecodedUnits(in, length, i);
+            return units;
+        }
+
+        size_t Utf8LengthSse2(const char16_t* in, size_t length) noexcept {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+            size_t bytes = 0, i = 0;
+            while (i + 8 <= length) {
+                const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), zero)) == 0xFFFF) {
+                    bytes += 8;
+                    i += 8;
+                    continue;
+                }
+                const size_t blockEnd = i + 8;
+                while (i < blockEnd) bytes += EncodedBytes(in, length, i);
+            }
+            while (i < length) bytes += EncodedBytes(in, length, i);
+            return bytes;
+        }
+
+        size_t FindCrSse2(const char* in, size_t i, size_t length) noexcept {
+            const __m128i cr = _mm_set1_epi8('\r');
+            for (; i + 16 <= length; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, cr)));
+                if (mask) return i + CountTrailingZeros(mask);
+            }
+            return FindCrScalar(in, i, length);
+        }
+
+        size_t FindNewline16Sse2(const char16_t* in, size_t i, size_t length) noexcept {
+            const __m128i cr = _mm_set1_epi16(u'\r');
+            const __m128i lf = _mm_set1_epi16(u'\n');
+            for (; i + 8 <= length; i += 8) {
+                const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                const __m128i hit = _mm_or_si128(_mm_cmpeq_epi16(units, cr), _mm_cmpeq_epi16(units, lf));
+                const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+                if (mask) return i + CountTrailingZeros(mask) / 2;
+            }
+            return FindNewline16Scalar(in, i, length);
+        }
+
+        size_t FindNonAsciiSse2(const char* in, size_t i, size_t length) noexcept {
+            for (; i + 16 <= length; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+                if (mask) return i + CountTrailingZeros(mask);
+            }
+            return FindNonAsciiScalar(in, i, length);
+        }
+#endif
+
+        // ----- AVX2 Kernels -----
+#if CJ_TRANSCODE_AVX2
+        CJ_TARGET_AVX2 size_t Utf8ToUtf16Avx2(const uint8_t* in, size_t length, char16_t* out) noexcept {
+            char16_t* const start = out;
+            size_t i = 0;
+            while (i + 32 <= length) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                if (_mm256_movemask_epi8(bytes) == 0) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                                        _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16),
+                                        _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+                    i += 32;
+                    out += 32;
+                    continue;
+                }
+                const size_t blockEnd = i + 32;
+                while (i < blockEnd) DecodeOne(in, length, i, out);
+            }
+            while (i < length) DecodeOne(in, length, i, out);
+            return static_cast<size_t>(out - start);
+        }
+
+        CJ_TARGET_AVX2 size_t Utf16ToUtf8Avx2(const char16_t* in, size_t length, uint8_t* out) noexcept {
+            uint8_t* const start = out;
+            const __m256i nonAscii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+            size_t i = 0;
+            while (i + 32 <= length) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+                if (_mm256_testz_si256(_mm256_or_si256(a, b), nonAscii)) {
+                    // packus works per 128-bit lane; restore the order afterwards
+                    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+                    i += 32;
+                    out += 32;
+                    continue;
+                }
+                const size_t blockEnd = i + 32;
+                while (i < blockEnd) EncodeOne(in, length, i, out);
+            }
+            while (i < length) EncodeOne(in, length, i, out);
+            return static_cast<size_t>(out - start);
+        }
+
+        CJ_TARGET_AVX2 size_t Utf16LengthAvx2(const uint8_t* in, size_t length) noexcept {
+            size_t units = 0, i = 0;
+            while (i + 32 <= length) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                if (_mm256_movemask_epi8(bytes) == 0) {
+                    units += 32;
+                    i += 32;
+                    continue;
+                }
+                const size_t blockEnd = i + 32;
+                while (i < blockEnd) units += DecodedUnits(in, length, i);
+            }
+            while (i < length) units += DecodedUnits(in, length, i);
+            return units;
+        }
+
+        CJ_TARGET_AVX2 size_t Utf8LengthAvx2(const char16_t* in, size_t length) noexcept {
+            const __m256i nonAscii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+            size_t bytes = 0, i = 0;
+            while (i + 16 <= length) {
+                const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                if (_mm256_testz_si256(units, nonAscii)) {
+                    bytes += 16;
+                    i += 16;
+                    continue;
+                }
+                const size_t blockEnd = i + 16;
+                while (i < blockEnd) bytes += EncodedBytes(in, length, i);
+            }
+            while (i < length) bytes += EncodedBytes(in, length, i);
+            return bytes;
+        }
+
+        CJ_TARGET_AVX2 size_t FindCrAvx2(const char* in, size_t i, size_t length) noexcept {
+            const __m256i cr = _mm256_set1_epi8('\r');
+            for (; i + 32 <= length; i += 32) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, cr)));
+                if (mask) return i + CountTrailingZeros(mask);
+            }
+            return FindCrSse2(in, i, length);
+        }
+
+        CJ_TARGET_AVX2 size_t FindNewline16Avx2(const char16_t* in, size_t i, size_t length) noexcept {
+            const __m256i cr = _mm256_set1_epi16(u'\r');
+            const __m256i lf = _mm256_set1_epi16(u'\n');
+            for (; i + 16 <= length; i += 16) {
+                const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                const __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi16(units, cr), _mm256_cmpeq_epi16(units, lf));
+                const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                if (mask) return i + CountTrailingZeros(mask) / 2;
+            }
+            return FindNewline16Sse2(in, i, length);
+        }
+
+        CJ_TARGET_AVX2 size_t FindNonAsciiAvx2(const char* in, size_t i, size_t length) noexcept {
+            for (; i + 32 <= length; i += 32) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+                if (mask) return i + CountTrailingZeros(mask);
+            }
+            return FindNonAsciiSse2(in, i, length);
+        }
+#endif
+
+        // ----- Dispatch -----
+        struct Kernels {
+            Isa isa;
+            size_t (*utf8ToUtf16)(const uint8_t*, size_t, char16_t*) noexcept;
+            size_t (*utf16ToUtf8)(const char16_t*, size_t, uint8_t*) noexcept;
+            size_t (*utf16Length)(const uint8_t*, size_t) noexcept;
+            size_t (*utf8Length)(const char16_t*, size_t) noexcept;
+            size_t (*findCr)(const char*, size_t, size_t) noexcept;
+            size_t (*findNewline16)(const char16_t*, size_t, size_t) noexcept;
+            size_t (*findNonAscii)(const char*, size_t, size_t) noexcept;
+        };
+
+        constexpr Kernels SCALAR_KERNELS = {
+            Isa::Scalar, Utf8ToUtf16Scalar, Utf16ToUtf8Scalar, Utf16LengthScalar, Utf8LengthScalar,
+            FindCrScalar, FindNewline16Scalar, FindNonAsciiScalar };
+#if CJ_TRANSCODE_SSE2
+        constexpr Kernels SSE2_KERNELS = {
+            Isa::Sse2, Utf8ToUtf16Sse2, Utf16ToUtf8Sse2, Utf16LengthSse2, Utf8LengthSse2,
+            FindCrSse2, FindNewline16Sse2, FindNonAsciiSse2 };
+#endif
+#if CJ_TRANSCODE_AVX2
+        constexpr Kernels AVX2_KERNELS = {
+            Isa::Avx2, Utf8ToUtf16Avx2, Utf16ToUtf8Avx2, Utf16LengthAvx2, Utf8LengthAvx2,
+            FindCrAvx2, FindNewline16Avx2, FindNonAsciiAvx2 };
+#endif
+
+        bool CpuHasAvx2() noexcept {
+#if !CJ_TRANSCODE_AVX2
+            return false;
+#elif defined(_MSC_VER)
+            int regs[4];
+            __cpuid(regs, 1);
+            const bool osSavesYmm = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+            __cpuidex(regs, 7, 0);
+            return osSavesYmm && (regs[1] & (1 << 5));
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+
+        const Kernels* KernelsFor(Isa isa) noexcept {
+#if CJ_TRANSCODE_AVX2
+            if (isa == Isa::Avx2 && CpuHasAvx2()) return &AVX2_KERNELS;
+#endif
+#if CJ_TRANSCODE_SSE2
+            if (isa != Isa::Scalar) return &SSE2_KERNELS;
+#endif
+            return &SCALAR_KERNELS;
+        }
+
+        std::atomic<const Kernels*> g_kernels{nullptr};
+
+        const Kernels& Active() noexcept {
+            const Kernels* kernels = g_kernels.load(std::memory_order_acquire);
+            if (!kernels) {
+                kernels = KernelsFor(Isa::Avx2);
+                g_kernels.store(kernels, std::memory_order_release);
+            }
+            return *kernels;
+        }
+    } // anonymous namespace
+
+    Isa ActiveIsa() noexcept {
+        return Active().isa;
+    }
+
+    Isa ForceIsa(Isa isa) noexcept {
+        const Kernels* kernels = KernelsFor(isa);
+        g_kernels.store(kernels, std::memory_order_release);
+        return kernels->isa;
+    }
+
+    const char* IsaName(Isa isa) noexcept {
+        switch (isa) {
+            case Isa::Scalar: return "scalar";
+            case Isa::Sse2:   return "sse2";
+            case Isa::Avx2:   return "avx2";
+            default:          return "unknown";
+        }
+    }
+
+    // ----- Buffer API -----
+    size_t Utf8ToUtf16(const char* in, size_t length, char16_t* out) noexcept {
+        return Active().utf8ToUtf16(reinterpret_cast<const uint8_t*>(in), length, out);
+    }
+
+    size_t Utf16ToUtf8(const char16_t* in, size_t length, char* out) noexcept {
+        return Active().utf16ToUtf8(in, length, reinterpret_cast<uint8_t*>(out));
+    }
+
+    size_t Utf16Length(const char* in, size_t length) noexcept {
+        return Active().utf16Length(reinterpret_cast<const uint8_t*>(in), length);
+    }
+
+    size_t Utf8Length(const char16_t* in, size_t length) noexcept {
+        return Active().utf8Length(in, length);
+    }
+
+    size_t AsciiLength(const char* in, size_t length) noexcept {
+        return Active().findNonAscii(in, 0, length);
+    }
+
+    size_t CrlfLength(const char16_t* in, size_t length) noexcept {
+        const auto findNewline = Active().findNewline16;
+        size_t total = length, i = 0;
+        while ((i = findNewline(in, i, length)) < length) {
+            if (in[i] == u'\r' && i + 1 < length && in[i + 1] == u'\n') {
+                i += 2;  // Already CRLF
+            } else {
+                ++total;
+                ++i;
+            }
+        }
+        return total;
+    }
+
+    size_t ToCrlf(const char16_t* in, size_t length, char16_t* out) noexcept {
+        const auto findNewline = Active().findNewline16;
+        size_t i = 0, o = 0;
+        while (i < length) {
+            const size_t next = findNewline(in, i, length);
+            std::memcpy(out + o, in + i, (next - i) * sizeof(char16_t));
+            o += next - i;
+            if (next == length) break;
+
+            out[o++] = u'\r';
+            out[o++] = u'\n';
+            i = next + 1;
+            if (in[next] == u'\r' && i < length && in[i] == u'\n') ++i;
+        }
+        return o;
+    }
+
+    size_t ToLf(const char* in, size_t length, char* out) noexcept {
+        const auto findCr = Active().findCr;
+        size_t i = 0, o = 0;
+        while (i < length) {
+            const size_t next = findCr(in, i, length);
+            if (out + o != in + i) std::memmove(out + o, in + i, next - i);
+            o += next - i;
+            if (next == length) break;
+
+            out[o++] = '\n';
+            i = next + 1;
+            if (i < length && in[i] == '\n') ++i;
+        }
+        return o;
+    }
+
+    // ----- String API -----
+    // The length pass costs far less than allocating and zeroing the worst case
+    std::u16string Utf8ToUtf16(std::string_view in) {
+        std::u16string out(Utf16Length(in.data(), in.size()), u'\0');
+        Utf8ToUtf16(in.data(), in.size(), out.data());
+        return out;
+    }
+
+    std::string Utf16ToUtf8(std::u16string_view in) {
+        std::string out(Utf8Length(in.data(), in.size()), '\0');
+        Utf16ToUtf8(in.data(), in.size(), out.data());
+        return out;
+    }
+
+    std::u16string ToCrlf(std::u16string_view in) {
+        std::u16string out(CrlfLength(in.data(), in.size()), u'\0');
+        ToCrlf(in.data(), in.size(), out.data());
+        return out;
+    }
+
+    void ToLf(std::string& text) {
+        text.resize(ToLf(text.data(), text.size(), text.data()));
+    }
+
+    std::string_view StripBom(std::string_view utf8) noexcept {
+        if (utf8.size() >= 3 && utf8.compare(0, 3, "\xEF\xBB\xBF") == 0) utf8.remove_prefix(3);
+        return utf8;
+    }
+} // namespace Transcode
@@ -0,0 +1,48 @@
+// transcode.h
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// UTF-8 <-> UTF-16 conversion and line-ending normalization for list text.
+// ASCII runs, which are nearly all of a blocklist, are converted 16 or 32
+// bytes at a time with SSE2 or AVX2 (picked at runtime); everything else goes
+// through a scalar decoder. Conversion never fails: ill-formed UTF-8 and
+// unpaired surrogates become U+FFFD, as with MultiByteToWideChar and
+// WideCharToMultiByte without MB_ERR_INVALID_CHARS.
+namespace Transcode {
+    enum class Isa { Scalar, Sse2, Avx2 };
+
+    Isa ActiveIsa() noexcept;
+    // Restricts the kernels to `isa` or below (benchmarks and cross-checks).
+    // Returns the ISA actually selected, which is capped by what the CPU supports.
+    Isa ForceIsa(Isa isa) noexcept;
+    const char* IsaName(Isa isa) noexcept;
+
+    // ----- Buffer API -----
+    // `out` must hold the stated worst case; each returns the units written.
+    size_t Utf8ToUtf16(const char* in, size_t length, char16_t* out) noexcept;  // out: length units
+    size_t Utf16ToUtf8(const char16_t* in, size_t length, char* out) noexcept;  // out: 3 * length bytes
+
+    // Exact output sizes for the conversions above and below
+    size_t Utf16Length(const char* in, size_t length) noexcept;
+    size_t Utf8Length(const char16_t* in, size_t length) noexcept;
+    size_t CrlfLength(const char16_t* in, size_t length) noexcept;
+    // Bytes before the first non-ASCII one (`length` for pure ASCII)
+    size_t AsciiLength(const char* in, size_t length) noexcept;
+
+    // CRLF, lone LF and lone CR all become CRLF (what a multiline EDIT control wants)
+    size_t ToCrlf(const char16_t* in, size_t length, char16_t* out) noexcept;   // out: 2 * length units
+    // CRLF and lone CR become LF. `out` may equal `in`.
+    size_t ToLf(const char* in, size_t length, char* out) noexcept;             // out: length bytes
+
+    // ----- String API -----
+    std::u16string Utf8ToUtf16(std::string_view in);
+    std::string Utf16ToUtf8(std::u16string_view in);
+    std::u16string ToCrlf(std::u16string_view in);
+    void ToLf(std::string& text);
+
+    // Drops a leading UTF-8 byte order mark
+    std::string_view StripBom(std::string_view utf8) noexcept;
+} // namespace Transcode
@@ -5,10 +5,17 @@
 #define UTILS_WATCHER_H
 
 #include <windows.h>
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <memory>
 #include <filesystem>
 
+#include "dropdir.h"
+#include "hostsguard.h"
+#include "schedule.h"
+#include "sinkhole.h"
+
 namespace fs = std::filesystem;
 
 namespace utils {
@@ -18,15 +25,38 @@ public:
     static bool Initialize(); // <-- this was missing
     static int Run(int argc, char* argv[]);
 
+    static constexpr std::chrono::seconds MONITOR_INTERVAL{5};
+    // Extra wake-up after a schedule boundary, so localtime already reads the new minute
+    static constexpr std::chrono::milliseconds SCHEDULE_MARGIN{100};
+
 private:
     Watcher() = delete;
 
     struct ProcessInfo {
-        DWORD pid;
+        DWORD pid = 0;
         std::string role;
         fs::path exe_path;
     };
 
+    // schedule.txt as last loaded; the catalog's timestamp is tracked because
+    // the compiled states hold its domains
+    struct ScheduleWatch {
+        Schedule schedule;
+        fs::file_time_type scheduleTime{};
+        fs::file_time_type catalogTime{};
+        bool loaded = false;
+        bool applied = false;
+        uint32_t categories = 0;   // State last enforced
+    };
+
+    // The sinkhole index as built from the list's last-seen timestamp. Kept
+    // whether or not this watchdog serves it, so the standby one doesn't
+    // rebuild it on every attempt to take the port over.
+    struct SinkholeWatch {
+        fs::file_time_type listTime{};
+        std::shared_ptr<const SuffixIndex> index;
+    };
+
     class HandleGuard {
     public:
         explicit HandleGuard(HANDLE h = nullptr) noexcept : handle(h) {}
@@ -40,11 +70,13 @@ private:
     };
 
     static ProcessInfo ParseArguments(int argc, char* argv[]);
-    static FILETIME GetLastWriteTime(const fs::path& filePath);
-    static bool IsFileModified(const FILETIME& previous, const fs::path& filePath);
-    static bool RestartPeer(const ProcessInfo& info, const std::string& peerRole);
-    static bool MonitorHostsFile(Blocker& blocker, const fs::path& hostsPath, FILETIME& lastWriteTime);
+    static bool RestartPeer(const ProcessInfo& info, const std::string& peerRole, DWORD& peerPID);
     static bool MonitorPeerProcess(DWORD& peerPID, const ProcessInfo& info, int& restartCount);
+    // Returns how long the loop may sleep before the next boundary
+    static std::chrono::milliseconds MonitorSchedule(Blocker& blocker, ScheduleWatch& watch, HostsGuard& guard);
+    static void MonitorDropDirectory(Blocker& blocker, DropDirectory& dropDirectory, bool& adopted,
+                                     HostsGuard& guard);
+    static void MonitorSinkhole(Blocker& blocker, DnsSinkhole& sinkhole, SinkholeWatch& watch);
 };
 
 } // namespace utils
@@ -1,11 +1,16 @@
 // watcher.cpp
 #include "watcher.h"
 #include "blocker.h"
+#include "domainset.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
 #include <windows.h>
-#include <iostream>
+#include <algorithm>
 #include <sstream>
 #include <thread>
 #include <chrono>
+#include <ctime>
 #include <vector>
 #include <stringapiset.h>
 
@@ -14,17 +19,33 @@ namespace fs = std::filesystem;  // Filesystem namespace alias
 namespace {
 
 constexpr DWORD MAX_RESTARTS = 5;
-constexpr std::chrono::seconds MONITOR_INTERVAL(5);
 constexpr std::chrono::seconds RESTART_COOLDOWN(10);
 constexpr DWORD MAX_PATH_LENGTH = 32767;
 
-// Secure command line construction
+// Secure command line construction; the peer is told our PID so it can watch us back
 std::wstring CreateCommandLine(const std::wstring& exePath, const std::wstring& role) {
     std::wostringstream oss;
-    oss << L"\"" << exePath << L"\" --watchdog " << role;
+    oss << L"\"" << exePath << L"\" --watchdog " << role << L" " << GetCurrentProcessId();
     return oss.str();
 }
 
+constexpr std::chrono::seconds METRICS_EXPORT_INTERVAL(15);
+
+// Watchdog metrics, registered on first use; the repair ones are HostsGuard's
+struct WatchdogMetrics {
+    Metrics::Counter& peerRestarts = Metrics::GetCounter(
+        "cj_watchdog_peer_restarts_total", "Peer watchdog processes relaunched");
+    Metrics::Counter& heartbeatMisses = Metrics::GetCounter(
+        "cj_watchdog_heartbeat_misses_total", "Peer checks that found the peer missing or exited");
+    Metrics::Histogram& loopDuration = Metrics::GetHistogram(
+        "cj_watchdog_loop_duration_seconds", "Work done per monitoring iteration, excluding the sleep");
+};
+
+WatchdogMetrics& GetMetrics() {
+    static WatchdogMetrics metrics;
+    return metrics;
+}
+
 // RAII wrapper for process creation
 struct ProcessGuard {
     PROCESS_INFORMATION pi{};
@@ -40,7 +61,7 @@ namespace utils {
 
 // Initialize static method
 bool Watcher::Initialize() {
-    std::wcout << L"[Watcher] Initializing watchdog system\n";
+    CJ_LOG_INFO("Watcher", "Initializing watchdog system");
     return true; // Initialization logic placeholder
 }
 
@@ -48,28 +69,53 @@ int Watcher::Run(int argc, char* argv[]) {
     try {
         auto [pid, role, exe_path] = ParseArguments(argc, argv); // Fixed structured binding
         Blocker blocker;
-        fs::path hostsPath = L"C:\\Windows\\System32\\drivers\\etc\\hosts";
-        FILETIME lastWriteTime = GetLastWriteTime(hostsPath);
+        // Settle an update a crash interrupted before reading the managed block
+        blocker.recoverHostsTransition();
+        if (!blocker.loadManagedDomains()) {
+            CJ_LOG_WARN("Watcher", "No managed block found; repairs will be unavailable");
+        }
+        HostsGuard guard(blocker);
+        if (!guard.Reset()) return EXIT_FAILURE;
         int restartCount = 0;
-
-        std::wcout << L"[Watcher " << role.c_str() << L"] Monitoring system (PID: " 
-                  << GetCurrentProcessId() << L")\n";
+        DnsSinkhole sinkhole;
+        SinkholeWatch sinkholeWatch;
+        ScheduleWatch scheduleWatch;
+        DropDirectory dropDirectory(blocker.getBackupPath().parent_path() / DropDirectory::DIRNAME);
+        bool dropAdopted = false;
+
+        Metrics::ExportConfig exportConfig;
+        exportConfig.file = blocker.getBackupPath().parent_path() / "metrics" / ("watchdog-" + role + ".prom");
+        exportConfig.labels = "role=\"" + role + "\"";
+        exportConfig.interval = METRICS_EXPORT_INTERVAL;
+        Metrics::ExportSession metricsSession(exportConfig);
+        WatchdogMetrics& metrics = GetMetrics();
+
+        CJ_LOG_INFO("Watcher", "Watchdog " << role << " monitoring system (PID: "
+                    << GetCurrentProcessId() << ")");
 
         while (true) {
-            if (!MonitorHostsFile(blocker, hostsPath, lastWriteTime)) {
-                std::cerr << "[Critical] Hosts file monitoring failed\n";
+            const auto iterationStart = std::chrono::steady_clock::now();
+            // Before the tamper check, so our own transition isn't mistaken for one
+            const std::chrono::milliseconds untilBoundary = MonitorSchedule(blocker, scheduleWatch, guard);
+            // One importer is enough; the peer follows the rewritten block
+            if (role == "A") MonitorDropDirectory(blocker, dropDirectory, dropAdopted, guard);
+            if (!guard.Check()) {
+                CJ_LOG_ERROR("Watcher", "Hosts file monitoring failed");
                 return EXIT_FAILURE;
             }
 
             if (!MonitorPeerProcess(pid, {pid, role, exe_path}, restartCount)) { // Fixed struct init
-                std::cerr << "[Critical] Peer monitoring failed\n";
+                CJ_LOG_ERROR("Watcher", "Peer monitoring failed");
                 return EXIT_FAILURE;
             }
 
-            std::this_thread::sleep_for(MONITOR_INTERVAL);
+            MonitorSinkhole(blocker, sinkhole, sinkholeWatch);
+            metrics.loopDuration.Record(std::chrono::steady_clock::now() - iterationStart);
+
+            std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(MONITOR_INTERVAL, untilBoundary));
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Fatal Error] " << e.what() << '\n';
+        CJ_LOG_ERROR("Watcher", "Fatal: " << e.what());
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
@@ -96,7 +142,7 @@ Watcher::ProcessInfo Watcher::ParseArguments(int argc, char* argv[]) {
         try {
             info.pid = std::stoul(argv[3]);
         } catch (...) {
-            std::cerr << "[Warning] Invalid peer PID format\n";
+            CJ_LOG_WARN("Watcher", "Invalid peer PID format");
             info.pid = 0;
         }
     }
@@ -104,56 +150,172 @@ Watcher::ProcessInfo Watcher::ParseArguments(int argc, char* argv[]) {
     return info;
 }
 
-FILETIME Watcher::GetLastWriteTime(const fs::path& filePath) {
-    // CreateFileW returns a raw HANDLE, we wrap it with HandleGuard
-    HandleGuard hFile(CreateFileW(
-        filePath.c_str(),
-        GENERIC_READ,
-        FILE_SHARE_READ | FILE_SHARE_WRITE,
-        nullptr,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        nullptr
-    ));
+// Both watchdogs follow the schedule. The states are compiled when schedule.txt
+// (or the catalog it names) changes, never at a boundary: there the loop wakes
+// just after the minute turns and writes the state's compiled block. The peer
+// that wakes second finds its state already written and only adopts it; both
+// map the same compiled states.
+std::chrono::milliseconds Watcher::MonitorSchedule(Blocker& blocker, ScheduleWatch& watch, HostsGuard& guard) {
+    const fs::path dataDir = blocker.getBackupPath().parent_path();
+    const fs::path schedulePath = dataDir / Schedule::FILENAME;
+    std::error_code ec;
+    const fs::file_time_type scheduleTime = fs::last_write_time(schedulePath, ec);
+    if (ec) {
+        if (watch.loaded) {
+            CJ_LOG_INFO("Watcher", "Schedule removed; keeping the current block");
+            blocker.clearSchedule();
+            watch = ScheduleWatch{};
+        }
+        return MONITOR_INTERVAL;
+    }
 
-    if (!hFile || hFile == INVALID_HANDLE_VALUE) {
-        throw std::runtime_error("Failed to open file for timestamp check");
+    const fs::file_time_type catalogTime = fs::last_write_time(blocker.getCatalogPath(), ec);
+    if (!watch.loaded || scheduleTime != watch.scheduleTime || catalogTime != watch.catalogTime) {
+        Trace::Span span("Watcher::loadSchedule");
+        // Remembered even on failure, so a broken file is reported once, not every iteration
+        watch.scheduleTime = scheduleTime;
+        watch.catalogTime = catalogTime;
+        watch.loaded = true;
+        watch.applied = false;
+        DomainCatalog catalog;
+        if (!catalog.Load(blocker.getCatalogPath()) || !watch.schedule.Load(schedulePath, catalog) ||
+            !blocker.prepareSchedule(catalog, watch.schedule.States())) {
+            CJ_LOG_ERROR("Watcher", "Schedule not loaded: " << (watch.schedule.GetError().empty()
+                         ? std::string("catalog unavailable or states not compiled") : watch.schedule.GetError()));
+            watch.schedule.Clear();
+            blocker.clearSchedule();
+            return MONITOR_INTERVAL;
+        }
+        CJ_LOG_INFO("Watcher", "Schedule loaded: " << watch.schedule.RuleCount() << " rule(s), "
+                    << watch.schedule.States().size() << " state(s)");
     }
+    if (!blocker.hasSchedule()) return MONITOR_INTERVAL;
+
+    const auto clock = std::chrono::system_clock::now();
+    const std::time_t now = std::chrono::system_clock::to_time_t(clock);
+    const uint32_t categories = watch.schedule.CurrentMask(now);
+    if (!watch.applied || categories != watch.categories) {
+        CJ_LOG_INFO("Watcher", "Schedule transition to category mask " << categories);
+        if (blocker.applyScheduledState(categories)) {
+            watch.applied = true;
+            watch.categories = categories;
+            guard.Reset();
+        } else {
+            CJ_LOG_ERROR("Watcher", "Schedule transition failed; retrying next iteration");
+        }
+    }
+    // SecondsUntilChange() counts from the whole second; take off the part already gone
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        clock - std::chrono::system_clock::from_time_t(now));
+    const auto remaining = std::chrono::seconds(watch.schedule.SecondsUntilChange(now)) -
+        std::clamp(elapsed, std::chrono::milliseconds(0), std::chrono::milliseconds(999));
+    return remaining + SCHEDULE_MARGIN;
+}
 
-    FILETIME ftWrite{};
-    if (!GetFileTime(hFile, nullptr, nullptr, &ftWrite)) {
-        throw std::runtime_error("Failed to get file timestamp");
+// Lists dropped into lists.d replace the enforced domains; after the first
+// scan only changed files are imported, and the block is rewritten only when
+// the union changed. The first scan compares against the block already in
+// place, so restarting a watchdog doesn't rewrite an unchanged hosts file.
+// Importing and merging cost what changed; the write doesn't. The hosts
+// file, the lookup filter and the compiled blocklist are each rewritten
+// whole, so the union, mapped from the drop directory's cache, is copied
+// out for applyBlock() as one list. It arrives sorted, which spares the
+// publish a second sort, and the copy goes again once the result is attached.
+void Watcher::MonitorDropDirectory(Blocker& blocker, DropDirectory& dropDirectory, bool& adopted,
+                                   HostsGuard& guard) {
+    if (blocker.hasSchedule()) return;  // The schedule decides what is enforced
+
+    ListImporter::Options options;
+    options.wildcards = blocker.isSinkholeMode();
+    DropDirectory::Changes changes;
+    if (!dropDirectory.Refresh(options, &changes) || dropDirectory.FileCount() == 0) return;
+    if (adopted && !changes.Any()) return;
+
+    Trace::Span span("Watcher::applyDropDirectory");
+    const CompiledBlocklist& domains = dropDirectory.GetDomains();
+    if (!adopted) {
+        adopted = true;
+        bool same = false;
+        const CompiledBlocklist& compiled = blocker.getCompiled();
+        if (blocker.getDomains().empty() && compiled.IsAttached()) {
+            // Both are sorted the same way; compare in one sequential pass
+            same = compiled.size() == domains.size();
+            for (size_t i = 0; same && i < domains.size(); ++i) same = compiled[i] == domains[i];
+        } else {
+            const DomainSet current = DomainSet::FromPool(blocker.getDomains());
+            same = current.size() == domains.size();
+            for (size_t i = 0; same && i < current.size(); ++i) same = domains.Contains(current[i]);
+        }
+        if (same) {
+            CJ_LOG_DEBUG("Watcher", "Drop directory matches the managed block");
+            return;
+        }
+    }
+    if (domains.empty()) {
+        CJ_LOG_WARN("Watcher", "Drop directory lists no domains; keeping the current block");
+        return;
     }
 
-    return ftWrite;
+    DomainPool pool;
+    domains.ToPool(pool);
+    if (!blocker.loadDomains(std::move(pool)) || !blocker.applyBlock()) {
+        CJ_LOG_ERROR("Watcher", "Failed to apply drop directory lists");
+        return;
+    }
+    // Our copy is no longer needed once the result is published
+    blocker.attachCompiled();
+    guard.Reset();
+    CJ_LOG_INFO("Watcher", "Applied drop directory: " << domains.size() << " domain(s) from "
+                << dropDirectory.FileCount() << " file(s)");
 }
 
+// Both watchdogs try to serve the sinkhole, but only one can bind the port.
+// The other keeps retrying each iteration, so it takes over within one
+// monitoring interval when the serving watchdog dies. When the list changes
+// it is first checked against the digest in the managed block (and restored
+// if it was edited), then indexed once; the serving watchdog swaps the new
+// index in without letting go of the port.
+void Watcher::MonitorSinkhole(Blocker& blocker, DnsSinkhole& sinkhole, SinkholeWatch& watch) {
+    if (!blocker.isSinkholeMode()) {
+        if (sinkhole.IsRunning()) sinkhole.Stop();
+        watch = SinkholeWatch{};
+        return;
+    }
 
-bool Watcher::IsFileModified(const FILETIME& previous, const fs::path& filePath) {
-    const FILETIME current = GetLastWriteTime(filePath);
-    return CompareFileTime(&previous, &current) != 0;
-}
+    const fs::path& listPath = blocker.getSinkholeListPath();
+    std::error_code ec;
+    fs::file_time_type writeTime = fs::last_write_time(listPath, ec);
+    if (ec) {
+        CJ_LOG_WARN("Watcher", "Sinkhole list unavailable: " << ec.message());
+        return;
+    }
 
-bool Watcher::MonitorHostsFile(Blocker& blocker, const fs::path& hostsPath, FILETIME& lastWriteTime) {
-    try {
-        if (IsFileModified(lastWriteTime, hostsPath)) {
-            std::wcout << L"[Watcher] Hosts file modification detected\n";
-            
-            if (!blocker.isBlocked() && !blocker.reapplyBlock()) {
-                std::cerr << "[Error] Failed to restore block\n";
-                return false;
+    if (!watch.index || writeTime != watch.listTime) {
+        Trace::Span span("Watcher::loadSinkholeList");
+        // A restored list has a new timestamp; take that one, not the edit's
+        const bool verified = blocker.repairSinkholeList();
+        writeTime = fs::last_write_time(listPath, ec);
+        // Remembered even on failure, so a bad list is reported once, not every iteration
+        watch.listTime = writeTime;
+        DomainPool entries;
+        auto index = std::make_shared<SuffixIndex>();
+        if (!verified || !DnsSinkhole::LoadList(listPath, entries) || !index->Build(entries)) {
+            CJ_LOG_ERROR("Watcher", "Failed to load sinkhole list" << (watch.index ? "; serving the previous one" : ""));
+        } else {
+            watch.index = std::move(index);
+            if (sinkhole.IsRunning()) {
+                CJ_LOG_INFO("Watcher", "Sinkhole list changed; reloading");
+                sinkhole.SwapIndex(watch.index);
             }
-
-            lastWriteTime = GetLastWriteTime(hostsPath);
         }
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[Monitor Error] " << e.what() << '\n';
-        return false;
+    }
+
+    if (watch.index && !sinkhole.IsRunning() && !sinkhole.Start(DnsSinkhole::Config{}, watch.index)) {
+        CJ_LOG_DEBUG("Watcher", "Sinkhole port busy; the peer watchdog is likely serving it");
     }
 }
 
-bool Watcher::RestartPeer(const ProcessInfo& info, const std::string& peerRole) {
+bool Watcher::RestartPeer(const ProcessInfo& info, const std::string& peerRole, DWORD& peerPID) {
     // Proper wide-string conversion
     const std::wstring wPeerRole(peerRole.begin(), peerRole.end());
     const std::wstring commandLine = CreateCommandLine(info.exe_path.wstring(), wPeerRole);
@@ -173,18 +335,20 @@ bool Watcher::RestartPeer(const ProcessInfo& info, const std::string& peerRole)
         &si,
         &process.pi
     )) {
-        std::cerr << "[Restart Error] CreateProcess failed (" << GetLastError() << ")\n";
+        CJ_LOG_ERROR("Watcher", "CreateProcess failed (" << GetLastError() << ")");
         return false;
     }
 
-    std::wcout << L"[Watcher] Successfully restarted peer " << wPeerRole 
-              << L" (PID: " << process.pi.dwProcessId << L")\n";
+    CJ_LOG_INFO("Watcher", "Successfully restarted peer " << wPeerRole
+                << " (PID: " << process.pi.dwProcessId << ")");
+    peerPID = process.pi.dwProcessId;
+    GetMetrics().peerRestarts.Add();
     return true;
 }
 
 bool Watcher::MonitorPeerProcess(DWORD& peerPID, const ProcessInfo& info, int& restartCount) {
     if (peerPID == 0) {
-        if (restartCount < MAX_RESTARTS && RestartPeer(info, info.role == "A" ? "B" : "A")) {
+        if (restartCount < MAX_RESTARTS && RestartPeer(info, info.role == "A" ? "B" : "A", peerPID)) {
             restartCount++;
             std::this_thread::sleep_for(RESTART_COOLDOWN);
         }
@@ -193,14 +357,16 @@ bool Watcher::MonitorPeerProcess(DWORD& peerPID, const ProcessInfo& info, int& r
 
     HandleGuard hProcess(OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, peerPID));
     if (!hProcess || hProcess == INVALID_HANDLE_VALUE) {
-        std::cerr << "[Peer Error] Process " << peerPID << " not found\n";
+        CJ_LOG_WARN("Watcher", "Peer process " << peerPID << " not found");
+        GetMetrics().heartbeatMisses.Add();
         peerPID = 0;
         return true;
     }
     
     DWORD exitCode = STILL_ACTIVE;
     if (!GetExitCodeProcess(hProcess, &exitCode) || exitCode != STILL_ACTIVE) {
-        std::cerr << "[Peer Alert] Process " << peerPID << " terminated\n";
+        CJ_LOG_WARN("Watcher", "Peer process " << peerPID << " terminated");
+        GetMetrics().heartbeatMisses.Add();
         peerPID = 0;
     }
     